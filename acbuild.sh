@@ -355,10 +355,13 @@ if $DO_SHIP; then
         --exclude='test/roots/*'        \
         --exclude='test/tmp/*'          \
         --exclude='kit/usr/lib/*'       \
+        --exclude='kit/usr/include/*'   \
         --exclude='kit/usr/bin/catjob'  \
         --exclude='kit/usr/bin/mkjob'   \
         --exclude='kit/usr/bin/queman'  \
         --exclude='kit/usr/bin/jobman'  \
+        --exclude='kit/usr/bin/jobstat' \
+        --exclude='kit/usr/bin/lsjob'   \
         --exclude='kit/var/lib/job/*'   \
         --exclude='kit/var/log/job/*'   \
         --exclude='kit/usr/share/man/man5/*'  \
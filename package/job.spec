@@ -73,8 +73,10 @@ install  -m744 -d $RPM_BUILD_ROOT/etc/init.d
 install  -m744 -d $RPM_BUILD_ROOT/etc/job
 install  -m755 -d $RPM_BUILD_ROOT/etc/job/qdefs
 install  -m755 -d $RPM_BUILD_ROOT/usr/bin
+install  -m755 -d $RPM_BUILD_ROOT/usr/include/job
 install  -m755 -d $RPM_BUILD_ROOT/usr/share/doc/job
 install  -m755 -d $RPM_BUILD_ROOT/usr/share/man
+install  -m755 -d $RPM_BUILD_ROOT/usr/share/man/man3
 install  -m755 -d $RPM_BUILD_ROOT/usr/share/man/man5
 install  -m755 -d $RPM_BUILD_ROOT/usr/share/man/man7
 install  -m755 -d $RPM_BUILD_ROOT/usr/share/man/man8
@@ -87,6 +89,7 @@ install  -m755 kit/etc/init.d/job    $RPM_BUILD_ROOT/etc/init.d
 install  -m755 kit/etc/job/job.conf  $RPM_BUILD_ROOT/etc/job
 install  -m755 kit/usr/bin/queman    $RPM_BUILD_ROOT/usr/bin
 install  -m755 kit/usr/bin/jobman    $RPM_BUILD_ROOT/usr/bin
+install  -m755 kit/usr/bin/jobstat   $RPM_BUILD_ROOT/usr/bin
 install  -m755 kit/usr/bin/catjob    $RPM_BUILD_ROOT/usr/bin
 install  -m755 kit/usr/bin/edjob     $RPM_BUILD_ROOT/usr/bin
 install  -m755 kit/usr/bin/edjobq    $RPM_BUILD_ROOT/usr/bin
@@ -99,9 +102,11 @@ install  -m755 kit/usr/bin/mvjobq    $RPM_BUILD_ROOT/usr/bin
 install  -m755 kit/usr/bin/rmjob     $RPM_BUILD_ROOT/usr/bin
 install  -m755 kit/usr/bin/rmjobq    $RPM_BUILD_ROOT/usr/bin
 install  -m644 package/LICENSE       $RPM_BUILD_ROOT/usr/share/doc/job/
+install  -m755 man/libjob.3.gz       $RPM_BUILD_ROOT/usr/share/man/man3
 install  -m755 man/job.conf.5.gz     $RPM_BUILD_ROOT/usr/share/man/man5
 install  -m755 man/job.7.gz          $RPM_BUILD_ROOT/usr/share/man/man7
 install  -m755 man/jobman.8.gz       $RPM_BUILD_ROOT/usr/share/man/man8
+install  -m755 man/jobstat.8.gz      $RPM_BUILD_ROOT/usr/share/man/man8
 install  -m755 man/catjob.8.gz       $RPM_BUILD_ROOT/usr/share/man/man8
 install  -m755 man/edjob.8.gz        $RPM_BUILD_ROOT/usr/share/man/man8
 install  -m755 man/edjobq.8.gz       $RPM_BUILD_ROOT/usr/share/man/man8
@@ -111,9 +116,10 @@ install  -m755 man/mkjob.8.gz        $RPM_BUILD_ROOT/usr/share/man/man8
 install  -m755 man/mkjobq.8.gz       $RPM_BUILD_ROOT/usr/share/man/man8
 install  -m755 man/rmjob.8.gz        $RPM_BUILD_ROOT/usr/share/man/man8
 install  -m755 man/rmjobq.8.gz       $RPM_BUILD_ROOT/usr/share/man/man8
-install  -m755 kit/usr/lib/libjob.so.1.0.0   $RPM_BUILD_ROOT%{_libdir}
-ln -sf                     libjob.so.1.0.0   $RPM_BUILD_ROOT%{_libdir}/libjob.so
-ln -sf                     libjob.so.1.0.0   $RPM_BUILD_ROOT%{_libdir}/libjob.so.1
+install  -m755 kit/usr/lib/libjob.so.2.0.0   $RPM_BUILD_ROOT%{_libdir}
+ln -sf                     libjob.so.2.0.0   $RPM_BUILD_ROOT%{_libdir}/libjob.so
+ln -sf                     libjob.so.2.0.0   $RPM_BUILD_ROOT%{_libdir}/libjob.so.2
+install  -m644 kit/usr/include/job/*         $RPM_BUILD_ROOT/usr/include/job
 install  -m755 test/load/job-pump            $RPM_BUILD_ROOT/usr/bin
 
 exit 0
@@ -123,6 +129,8 @@ exit 0
 %defattr(-,root,root,-)
 /etc/init.d/job
 /usr/bin/*
+/usr/include/job
+/usr/share/man/man3/*
 /usr/share/man/man5/*
 /usr/share/man/man7/*
 /usr/share/man/man8/*
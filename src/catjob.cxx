@@ -32,13 +32,14 @@
 #include <unistd.h>
 
 // CLI options and usage help
-enum  {opNONE, opHELP, opLOG,  opOUT, opRES, 
-       opROOT, opTRY,  opVERB, opRAW };
+enum  {opNONE, opHELP, opFOLL, opLOG,  opOUT, 
+       opRES,  opROOT, opTRY,  opVERB, opRAW };
 const option::Descriptor usage[] = {
     {opNONE, 0, "",  "",          Arg::None, 
         "Dump the output from a batch job.\n\n"
         "Usage: catjob [options] job-id\n\n"
         "Options:" },
+    {opFOLL, 0, "f", "follow",    Arg::None, "  -f  --follow       Follow the output of a running job until it ends"},
     {opHELP, 0, "h", "help",      Arg::None, "  -h  --help         Show this help message and exit"},
     {opLOG,  0, "l", "log-level", Arg::Reqd, "  -l  --log-level    Debugging log level (info, verbose, debug...)"},
     {opOUT,  0, "o", "output",    Arg::None, "  -o  --output       Show output (use with -r)"},
@@ -54,11 +55,22 @@ const option::Descriptor usage[] = {
         "  individual tries may be selected using --try.  The result status may\n"
         "  instead be shown using --result; to see both the output and the result\n"
         "  status use both --output and --result.  Additional details about the\n"
-        "  job are shown using --verbose.\n"
+        "  job are shown using --verbose.  If the job is running, --follow shows\n"
+        "  its output as it's made, until the try ends.\n"
         },
     {0,0,0,0,0,0}
 };
 
+// Show a try's result
+static void show_result(job::file & jf, const size_t s, const int tri) {
+    say("\nTry %d result:", jf.geti(s, "Try-Count", tri));
+    typedef job::vecmap_t::value_type secmap_t;
+    for (secmap_t::iterator it = jf[s].begin(); it != jf[s].end(); ++it) {
+        if (it->first == job::file::BODY_TAG) continue;
+        say("  %s: %s", it->first, it->second);
+    }
+}
+
 //
 // Main entry point
 //
@@ -96,10 +108,10 @@ int main(int argc, const char* argv[]) {
         job::logger::set_level(cfg.get("jobs", "log-level", "info"));
 
 
-    // Open the job
+    // Open the job, reading just its section 0.
     job::file jf(id);
     if (jf.error) quit(jf.error);
-    jf.load();
+    jf.load(true);
     if (jf.error) quit(jf.error);
 
     // Raw dump?
@@ -109,17 +121,47 @@ int main(int argc, const char* argv[]) {
             say("Job-Owner-UID: %d", (int)jf.uid);
             say("Job-Owner-GID: %d", (int)jf.gid);
         }
-        fputs(jf.to_string().c_str(), stdout);  // we use fputs() instead of puts() 
-                                                //   so to NOT get the \n at the end.
+        fflush(stdout);
+        jf.send(STDOUT_FILENO);     // straight from the file, however big
+        if (jf.error) quit(jf.error);
         exit(ERR_OK);
     }
 
-    // Show captured output
-    int tri = 0;
+    // Now the headers of the other sections; the bodies stay in the file,
+    //  and are sent from there as we show them.  That way memory use doesn't
+    //  grow with the job's output.
+    jf.load_headers();
+    if (jf.error) quit(jf.error);
+
+    // Show captured output and/or results, of all tries or just the one
+    bool show_out = cli.opts[opOUT] || cli.opts[opFOLL] || !cli.opts[opRES];
+    bool show_res = cli.opts[opRES];
+    int  want     = cli.opts[opTRY] ? str2int(cli.opts[opTRY].arg) : 0;
+    int  tri      = 0;
     for (size_t s=1; s<jf.size(); s++) {    // Note start at section 1
-        if (jf[s]["section"] != "output") continue;
-        say("\nTry %d:", ++tri);
-        say("%s\n", jf[s][job::file::BODY_TAG]);
+        std::string sect = jf.get(s, "Section");
+        if (sect == "output") tri = jf.geti(s, "Try-Count", tri+1);
+        if (want && (jf.geti(s, "Try-Count", tri) != want)) continue;
+        bool live = cli.opts[opFOLL] && (jf.state == job::run) && !jf.closed
+                 && (sect == "output") && ((s+1) == jf.size());
+        if (show_out && (sect == "output")) {
+            say("\nTry %d:", tri);
+            fflush(stdout);
+            if (live) jf.follow_body(s, STDOUT_FILENO);
+            else      jf.send_body(s, STDOUT_FILENO);
+            if (jf.error) quit(jf.error);
+            say("\n");
+        }
+        if (show_res && (sect == "result")) show_result(jf, s, tri);
+
+        // The try we followed is done; its result is in the job file, which has moved
+        if (live && show_res) {
+            job::file jr(id);
+            if (!jr.error) jr.load(true);
+            if (!jr.error) jr.load_headers(s+1);
+            if (jr.error) quit(jr.error);
+            if (jr.get(s+1, "Section") == "result") show_result(jr, s+1, tri);
+        }
     }
 
     exit(ERR_OK);
@@ -0,0 +1,87 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/array.hxx"
+#include "job/path.hxx"
+#include "job/string.hxx"
+#define __STDC_FORMAT_MACROS    // Enable PRI macros
+#include <inttypes.h>           // PRI macros
+#include <limits.h>             // PATH_MAX
+#include <stdio.h>              // snprintf()
+#include <stdlib.h>             // strtoull()
+
+#define ARRAY_MAX 100000000     // elements; each takes a bit in the job manager
+
+using job::ERR_OK;
+
+job::array::array(const std::string & spec)
+    : first(0)
+    , last(0)
+    , step(0) {
+    if (spec.size()) parse(spec);
+}
+
+job::status job::array::parse(const std::string & spec) {
+    first = last = step = 0;
+    const char* s = spec.c_str();
+    char* end;
+    if ((*s < '0') || (*s > '9')) return error.set("Bad array, want first-last[:step]", spec);
+    uint64_t lo = strtoull(s, &end, 10);
+    if (*end != '-') return error.set("Bad array, want first-last[:step]", spec);
+    s = end + 1;
+    if ((*s < '0') || (*s > '9')) return error.set("Bad array, want first-last[:step]", spec);
+    uint64_t hi = strtoull(s, &end, 10);
+    uint64_t by = 1;
+    if (*end == ':') {
+        s = end + 1;
+        if ((*s < '0') || (*s > '9')) return error.set("Bad array step", spec);
+        by = strtoull(s, &end, 10);
+    }
+    if (*end)     return error.set("Bad array, want first-last[:step]", spec);
+    if (hi < lo)  return error.set("Bad array, last is before first", spec);
+    if (by < 1)   return error.set("Bad array step", spec);
+    if ((hi - lo) / by >= ARRAY_MAX) return error.set("Too many array elements", spec);
+    first = lo;
+    last  = hi;
+    step  = by;
+    return error = ERR_OK;
+}
+
+size_t job::array::size() const {
+    return step ? (last - first) / step + 1 : 0;
+}
+
+std::string job::array::to_string() const {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%" PRIu64 "-%" PRIu64 ":%" PRIu64, first, last, step);
+    return buf;
+}
+
+std::string job::array::output_name(const std::string & queue, const id_t id, const uint64_t index) {
+    char nam[PATH_MAX+1];
+    snprintf(nam, sizeof(nam), "%s%s/.array/j%7.7" PRIu64 ".%" PRIu64,
+                path.jobdir.c_str(),
+                queue.c_str(),
+                (uint64_t)id,
+                index);
+    return nam;
+}
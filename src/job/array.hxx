@@ -0,0 +1,79 @@
+#ifndef _JOB_ARRAY_HXX_
+#define _JOB_ARRAY_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/jobkey.hxx"       // id_t
+#include "job/status.hxx"
+#include <stdint.h>
+#include <string>
+
+namespace job {
+
+class array {
+  public:
+    status      error;
+    uint64_t    first;          // Index of the first element
+    uint64_t    last;           // ...of the last one; not all between need be elements
+    uint64_t    step;           // ...and the step from one to the next
+
+                array(const std::string & spec = "");
+
+    status      parse(const std::string & spec);
+    size_t      size() const;
+    uint64_t    at(const size_t k) const { return first + k*step; }
+    std::string to_string() const;
+
+    static std::string output_name(const std::string & queue, const id_t id, const uint64_t index);
+};
+}
+
+/*! @file
+@class job::array
+  @brief Which elements an array job has, as in "1-10000" or "0-99:3"
+
+  An array job is one job file that stands for many near-identical jobs,
+  its elements, which differ only by their index.  Its Job-Array header
+  says which indices it has: first to last, and the step between them
+  (1 if not given).  The job manager starts the elements as run slots free
+  up, telling each its index in JOB_ARRAY_INDEX, and adds each element's
+  output and result, with an Array-Index header, to the array's job file.
+  So an array takes just the one job file in the spool, however big it is.
+
+  While an element runs, its output goes to a file of its own, named by
+  output_name(), in the queue's .array directory; when it's done, that's
+  added to the job file and removed.
+
+@fn job::status job::array::parse(const std::string & spec)
+  @brief Set the elements from the spec, "first-last" or "first-last:step".
+  The last must not be before the first, and the step must be at least 1.
+  There may be up to a hundred million elements.
+
+@fn size_t job::array::size() const
+  @brief How many elements; 0 if none have been set.
+
+@fn uint64_t job::array::at(const size_t k) const
+  @brief The index of the k-th element, from 0.
+*/
+
+#endif
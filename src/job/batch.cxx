@@ -0,0 +1,138 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/batch.hxx"
+#include "job/isafe.hxx"
+#include "job/path.hxx"
+#include "job/seqnum.hxx"
+#include <strings.h>            // strncasecmp()
+#include <sys/fsuid.h>          // setfsuid()
+#include <sys/stat.h>           // umask()
+#include <unistd.h>
+
+using job::ERR_OK;
+using job::int2str;
+
+job::batch::batch(file & proto, const size_t n)
+    : failed(0)
+    , proto(proto)
+    , first(proto.id)
+    , num(0)
+    , left(0) {
+
+    if (proto.error) {
+        error = proto.error;
+        return;
+    }
+    if (!proto.ties.empty()) {
+        error = "Batch jobs cannot be tied";
+        return;
+    }
+
+    // IDs for the rest, all in one go; the first has the template's
+    if (n > 1) {
+        seqnum sq(path.seqfile);
+        sq.paged = true;
+        num = sq.next(n - 1);
+        if (sq.error) {
+            error.set("Sequence number", sq.error);
+            return;
+        }
+        left = n - 1;
+    }
+
+    // Render the template without the headers that vary; they all sort
+    //  ahead of the rest, so each job is just its own headers then this.
+    proto.command.clear();
+    proto.args.clear();
+    proto._set_headers();
+    vecmap_t::value_type & h = proto[0];
+    vecmap_t::value_type::iterator it = h.lower_bound("Job-Arg-");
+    while ((it != h.end()) && !strncasecmp(it->first.c_str(), "Job-Arg-", 8)) h.erase(it++);
+    h.erase("Command");
+    h.erase("job-id");
+    it = h.begin();
+    if ((it != h.end()) && (it->first == multipart::BODY_TAG)) ++it;
+    if ((it != h.end()) && caseless()(it->first, "job-id")) {
+        error = "Cannot make job template: header " + it->first + " sorts too soon";
+        return;
+    }
+    post = proto.to_string(proto.header_pad);
+    std::string ixnam = proto.index_name();
+    mkdir(ixnam.substr(0, ixnam.rfind('/')).c_str(), 0755);     // if not there yet
+    error = ERR_OK;
+}
+
+job::id_t job::batch::make(const std::string & command, const stringlist & args) {
+    id_t id = first;
+    if (id) first = 0;
+    else if (left) {
+        id = file::zone ? num*10 + file::zone : num;
+        ++num;
+        --left;
+    }
+    else {
+        error = "No more job IDs reserved for this batch";
+        ++failed;
+        return 0;
+    }
+
+    vecmap_t::value_type h;
+    h["Command"] = command;
+    for (size_t i = 0; i < args.size(); i++) h["Job-Arg-" + int2str(i+1)] = args[i];
+    h["job-id"] = int2str(id);
+
+    proto.id = id;
+    mode_t oldum = umask(007);  // mode: user & group get all, others get nothing
+    proto._spool(multipart::render_headers(h) + post, "");
+    umask(oldum);               // mode: set it back
+    if (proto.error) {
+        error = proto.error;
+        ++failed;
+        return 0;
+    }
+    made.push_back(id);
+    return id;
+}
+
+// Read all of a batch file, or stdin if "-".  We may be setuid root, so
+//  the file's opened as the user who ran us: no reading what they can't.
+job::status job::batch::read(const std::string & fnam, std::string & text) {
+    status error;
+    int fd = 0;
+    if (fnam != "-") {
+        uid_t fsuid = setfsuid(getuid());
+        gid_t fsgid = setfsgid(getgid());
+        fd = isafe::open(fnam.c_str(), O_RDONLY | O_CLOEXEC);
+        int err = errno;
+        setfsgid(fsgid);
+        setfsuid(fsuid);
+        errno = err;
+    }
+    if (fd < 0) return error.set("Cannot open " + fnam, SYS_status);
+    char buf[65536];
+    ssize_t amt;
+    while ((amt = isafe::read(fd, buf, sizeof(buf))) > 0) text.append(buf, amt);
+    if (amt < 0) error.set("Cannot read " + fnam, SYS_status);
+    if (fd) isafe::close(fd);
+    return error;
+}
@@ -0,0 +1,88 @@
+#ifndef _JOB_BATCH_HXX_
+#define _JOB_BATCH_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/file.hxx"
+#include "job/status.hxx"
+#include <string>
+
+namespace job {
+
+class batch {
+  public:
+    status      error;
+    idlist_t    made;           // IDs of the jobs made, in order
+    size_t      failed;         // How many we couldn't make
+
+                batch(file & proto, const size_t n);
+
+    id_t        make(const std::string & command, const stringlist & args);
+
+    static status read(const std::string & fnam, std::string & text);
+
+  private:
+    file &      proto;          // The job template
+    std::string post;           // The template's file, rendered after its job-id
+    id_t        first;          // The template's own ID, until it's used
+    uint64_t    num;            // Next reserved job number...
+    uint64_t    left;           // ...and how many are left
+
+    // Not copyable
+                batch(const batch & other);
+    batch &     operator=(const batch & other);
+};
+}
+
+/*! @file
+@class job::batch
+  @brief Makes many jobs at once, that differ only by command and arguments
+
+  Submitting jobs one process at a time costs a config load, a job ID and
+  a job::file apiece.  A batch makes them all from one job::file, the
+  template: it's given everything the jobs have in common (queue, priority,
+  submitter, run time, and so on), and is never stored itself.  IDs for
+  all the jobs are reserved at once when the batch is made.  Each job file
+  is then written from the template, rendered just once, with only the
+  command, arguments and job ID headers made anew for each job.
+
+  Jobs are written in the hold state with their section index and ID link,
+  then moved to the template's state, normally pending.  Batch jobs can't
+  be tied; use a group job (see job::fanout) for that.
+
+@fn job::batch::batch(file & proto, const size_t n)
+  @brief Reserve IDs for n jobs, and render the template.  proto must be a
+  new job::file; its ID is the first job's.  It's changed to suit, so it's
+  of no other use after.
+
+@fn job::id_t job::batch::make(const std::string & command, const stringlist & args)
+  @brief Write one job; returns its ID, or 0 if it failed (see error).
+  No more than n can be made.
+
+@fn job::status job::batch::read(const std::string & fnam, std::string & text)
+  @brief Read a whole batch file, or stdin if fnam is "-", onto text.
+  The file is opened as the real user, not as root if we're setuid root;
+  so a user can only submit a batch they could read themselves.
+*/
+
+#endif
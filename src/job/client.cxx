@@ -0,0 +1,309 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/batch.hxx"
+#include "job/client.h"
+#include "job/client.hxx"
+#include "job/config.hxx"
+#include "job/isafe.hxx"
+#include "job/notice.hxx"
+#include "job/path.hxx"
+#include "job/queue.hxx"
+#include <errno.h>              // ECANCELED etc
+#include <fcntl.h>
+#include <pwd.h>                // getpwuid()
+#include <signal.h>             // SIGTERM
+#include <stdlib.h>             // getenv()
+#include <unistd.h>             // getuid(), usleep()
+
+#define CANCEL_TRIES 5          // Looks at a job the jobman is taking, before giving up
+
+using job::ERR_OK;
+using job::int2str;
+
+job::jobspec::jobspec()
+    : priority(PRIORITY_DEFAULT)
+    , run_time(JOB_ASAP)
+    , try_limit(100)
+    , notify(false) {
+}
+
+job::client::client(const std::string & root) {
+    if (root.size()) path.set_root(root);
+    config cfg(path.cfgfile);
+    if (cfg.error) {
+        error.set("Cannot load config", cfg.error);
+        return;
+    }
+    default_queue = cfg.get("job", "default-queue", "batch");
+    file::zone    = cfg.geti("job", "zone");
+    file::lease   = cfg.geti("job", "lease");
+    error = ERR_OK;
+}
+
+job::client::~client() {
+    for (queues_t::iterator it = queues.begin(); it != queues.end(); ++it) delete it->second;
+    queues.clear();
+}
+
+// The queue, if it's there; we need only look once
+job::notice* job::client::_queue(const std::string & qnam) {
+    queues_t::iterator it = queues.find(qnam);
+    if (it != queues.end()) return it->second;
+    queue jq(qnam);
+    if (!jq.exists()) {
+        if (jq.error) error.set("Queue " + qnam, jq.error);
+        else error = "No such queue '" + qnam + "'";
+        return NULL;
+    }
+    return queues[qnam] = new notice(qnam);
+}
+
+// Who we are, for the submitter; a job's file name needs one
+static std::string _whoami() {
+    if (getenv("USER") && *getenv("USER")) return getenv("USER");
+    struct passwd* pw = getpwuid(getuid());
+    return pw ? pw->pw_name : "u" + int2str(getuid());
+}
+
+// Fill in what's the same for all the jobs of a spec
+job::status job::client::_prep(file & jf, const jobspec & js, const std::string & qnam) {
+    if (jf.error) return error.set("Cannot make job", jf.error);
+    if ((js.priority < PRIORITY_MIN) || (js.priority > PRIORITY_MAX))
+        return error = "Bad priority, must be " + int2str(PRIORITY_MIN) + " to " + int2str(PRIORITY_MAX);
+    if (js.try_limit < 1)
+        return error = "Bad try limit";
+    if (js.run_time < 0)
+        return error = "Bad run time";
+    jf.run_time  = js.run_time;
+    jf.queue     = qnam;
+    jf.priority  = js.priority;
+    jf.try_limit = js.try_limit;
+    jf.submitter = js.submitter.size() ? js.submitter : _whoami();
+    jf.type      = js.type;
+    jf.notify    = js.notify;
+    jf.closed    = true;
+    jf.uid       = getuid();
+    jf.gid       = getgid();
+    return error = ERR_OK;
+}
+
+// Made as mkjob does: in hold, then moved into pend, so the jobman never sees it half-written
+job::id_t job::client::submit(const jobspec & js) {
+    std::string qnam = js.queue.size() ? js.queue : default_queue;
+    notice* nt = _queue(qnam);
+    if (!nt) return 0;
+    if (js.command.empty() && js.type.empty()) {
+        error = "Provide a command or a job type";
+        return 0;
+    }
+    file jf;
+    if (_prep(jf, js, qnam)) return 0;
+    jf.command = js.command;
+    jf.args    = js.args;
+    jf.state   = hold;
+    jf.store();
+    if (jf.error) {
+        error.set("Cannot make job", jf.error);
+        return 0;
+    }
+    jf.state = pend;
+    jf.repath();
+    if (jf.error) {
+        error.set("Cannot move job into queue", jf.error);
+        jf.remove();
+        return 0;
+    }
+    nt->send(stringlist(1, jf.name()));     // if it's lost, the jobman finds the job anyway
+    error = ERR_OK;
+    return jf.id;
+}
+
+// Like mkjob --batch: the IDs are reserved together, and the jobman's told once
+size_t job::client::submit_batch(const jobspec & proto,
+                                 const std::vector<stringlist> & cmds,
+                                 idlist_t & ids) {
+    size_t first = ids.size();
+    ids.resize(first + cmds.size(), 0);
+    std::string qnam = proto.queue.size() ? proto.queue : default_queue;
+    notice* nt = _queue(qnam);
+    if (!nt) return 0;
+    if (cmds.empty()) {
+        error = ERR_OK;
+        return 0;
+    }
+    file jf;
+    if (_prep(jf, proto, qnam)) return 0;
+    jf.state = pend;
+    batch bt(jf, cmds.size());
+    if (bt.error) {
+        error.set("Batch", bt.error);
+        return 0;
+    }
+
+    bool typed = proto.type.size();
+    status bad;
+    stringlist names;
+    for (size_t i = 0; i < cmds.size(); i++) {
+        if (!typed && cmds[i].empty()) {
+            bad = "Job " + int2str(i+1) + " of the batch has no command";
+            continue;
+        }
+        stringlist args(cmds[i].begin() + !typed, cmds[i].end());
+        id_t id = bt.make(typed ? "" : cmds[i][0], args);
+        if (!id) {
+            bad.set("Job " + int2str(i+1) + " of the batch", bt.error);
+            continue;
+        }
+        ids[first + i] = id;
+        jf.id = id;
+        names.push_back(jf.name());
+    }
+    if (names.size()) nt->send(names);
+    error = bad;
+    return names.size();
+}
+
+job::state_t job::client::state(const id_t id) {
+    file jf(id);
+    if (jf.error) {
+        error = jf.error;
+        return unk;
+    }
+    error = ERR_OK;
+    return jf.state;
+}
+
+// Move a job that's not started yet (and that we've locked) to done
+static job::status call_it_off(job::file & jf) {
+    jf.load(true);
+    if (!jf.error) {
+        size_t n = jf.size();
+        jf.resize(n+1);
+        jf[n]["Section"]     = "result";
+        jf[n]["Try-Count"]   = int2str(jf.try_count);
+        jf[n]["End-Time"]    = job::tim2str(time(NULL));
+        jf[n]["Exit-Note"]   = "Cancelled";
+        jf[n]["Exit-Signal"] = int2str(SIGTERM);
+        jf[n]["Exit-Status"] = int2str(ECANCELED);
+        jf[n]["__BODY__"]    = "";
+        jf.closed   = true;
+        jf.state    = job::done;
+        jf[n]["State"] = job::state2str(jf.state);
+        jf.run_time = time(NULL);       // Easy for the housekeeper to find, as jobman does
+        jf.store_section(n);
+        if (!jf.error) jf.store_headers();
+    }
+    job::status err = jf.error;
+    jf.unlock();
+    return err;
+}
+
+// A running job is killed by its jobman, when it sees the kill file
+static job::status kill_order(const std::string & queue, const job::id_t id) {
+    job::status error;
+    std::string knam = job::path.jobdir + queue + "/kill/" + int2str(id);
+    int fd = isafe::open(knam.c_str(), O_WRONLY | O_CREAT, 0666);
+    if (fd < 0) return error.set("Cannot make kill file " + knam, SYS_status);
+    isafe::close(fd);
+    return error = ERR_OK;
+}
+
+job::status job::client::cancel(const id_t id) {
+    for (int tries = 0; tries < CANCEL_TRIES; tries++) {
+        file jf(id);
+        if (jf.error) return error = jf.error;
+        if (jf.state == run) return error = kill_order(jf.queue, id);
+        if ((jf.state != hold) && (jf.state != pend))
+            return error.set(ERR_BADSTATE, "Job " + int2str(id) + " is " + state2str(jf.state));
+        jf.lock();
+        if (!jf.error) return error = call_it_off(jf);
+        if ((jf.error != ERR_LOCKED) && (jf.error != ERR_MOVED)) return error = jf.error;
+        usleep(20000);      // The jobman's taking it; it'll be running shortly
+    }
+    return error.set(ERR_AGAIN, "Job " + int2str(id) + " is changing state");
+}
+
+//
+// The C API
+//
+struct job_client {
+    job::client jc;
+    mutable std::string msg;    // Our last error, for job_error()
+
+    job_client(const char* root) : jc(root ? root : "") {}
+};
+
+job_client* job_open(const char* root) {
+    return new job_client(root);
+}
+
+void job_close(job_client* jc) {
+    delete jc;
+}
+
+const char* job_error(const job_client* jc) {
+    jc->msg = jc->jc.error ? std::string(jc->jc.error) : "";
+    return jc->msg.c_str();
+}
+
+// Fill in a spec from a C one
+static void c2spec(const struct job_spec* cs, job::jobspec & js) {
+    if (cs->queue)     js.queue     = cs->queue;
+    if (cs->command)   js.command   = cs->command;
+    if (cs->type)      js.type      = cs->type;
+    if (cs->submitter) js.submitter = cs->submitter;
+    for (const char* const* a = cs->args; a && *a; ++a) js.args.push_back(*a);
+    if (cs->priority)  js.priority  = cs->priority;
+    if (cs->run_time)  js.run_time  = cs->run_time;
+    if (cs->try_limit) js.try_limit = cs->try_limit;
+    js.notify = cs->notify;
+}
+
+job_id_t job_submit(job_client* jc, const struct job_spec* js) {
+    job::jobspec spec;
+    c2spec(js, spec);
+    return jc->jc.submit(spec);
+}
+
+size_t job_submit_batch(job_client* jc, const struct job_spec* proto,
+                        const char* const* const* cmds, size_t n, job_id_t* ids) {
+    job::jobspec spec;
+    c2spec(proto, spec);
+    std::vector<job::stringlist> specs(n);
+    for (size_t i = 0; i < n; i++) {
+        for (const char* const* w = cmds[i]; w && *w; ++w) specs[i].push_back(*w);
+    }
+    job::idlist_t made;
+    size_t got = jc->jc.submit_batch(spec, specs, made);
+    for (size_t i = 0; i < n; i++) ids[i] = (i < made.size()) ? made[i] : 0;
+    return got;
+}
+
+int job_status(job_client* jc, job_id_t id) {
+    job::state_t s = jc->jc.state(id);
+    return jc->jc.error ? -1 : (int)s;
+}
+
+int job_cancel(job_client* jc, job_id_t id) {
+    return jc->jc.cancel(id);
+}
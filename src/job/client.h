@@ -0,0 +1,103 @@
+#ifndef _JOB_CLIENT_H_
+#define _JOB_CLIENT_H_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+/*  The C API of libjob: submit jobs, and look after them, from a program.
+    It wraps job::client; see job/client.hxx for the details.  Link with -ljob.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint64_t job_id_t;
+typedef struct job_client job_client;
+
+/* Job states; the same values as job::state_t */
+enum job_state {JOB_UNK = 0, JOB_HOLD, JOB_PEND, JOB_RUN, JOB_TIED, JOB_KILL, JOB_DONE};
+
+/* What to submit.  Zero it, then fill in at least a command or a type. */
+struct job_spec {
+    const char*         queue;      /* Queue to use; NULL for the default queue */
+    const char*         command;    /* The command to run... */
+    const char*         type;       /* ...or the job type, in lieu of a command */
+    const char* const*  args;       /* Its arguments, NULL-terminated; or NULL for none */
+    int                 priority;   /* 1=best ... 9=slowest; 0 for normal (5) */
+    time_t              run_time;   /* When to run it; 0 for as soon as can be */
+    int                 try_limit;  /* Most tries; 0 for the default (100) */
+    const char*         submitter;  /* Who's submitting it; NULL for this user */
+    int                 notify;     /* Non-zero to notify the submitter on their tty/pts */
+};
+
+job_client* job_open(const char* root);
+void        job_close(job_client* jc);
+const char* job_error(const job_client* jc);
+
+job_id_t    job_submit(job_client* jc, const struct job_spec* js);
+size_t      job_submit_batch(job_client* jc, const struct job_spec* proto,
+                             const char* const* const* cmds, size_t n, job_id_t* ids);
+int         job_status(job_client* jc, job_id_t id);
+int         job_cancel(job_client* jc, job_id_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*
+  job_open()
+    Read job.conf, under root if not NULL, and return a client to use for
+    the rest; NULL if out of memory.  Check job_error() after, as it's
+    returned even if the config can't be read, to tell you why.
+
+  job_close()
+    Done with the client.
+
+  job_error()
+    What went wrong with the client's last call; "" if nothing did.
+
+  job_submit()
+    Submit one job.  Returns its ID, or 0 if it's not submitted.
+
+  job_submit_batch()
+    Submit n jobs, all like proto but for their commands and arguments.
+    Each cmds[i] is NULL-terminated: the command then its arguments; or if
+    proto has a type, just the arguments.  The jobs' IDs go in ids[0..n-1],
+    with 0 for any not made.  Returns how many were made.  Much faster than
+    that many job_submit()s: the IDs are reserved at once, and the job
+    manager told of them all together.
+
+  job_status()
+    The job's state, one of enum job_state; or -1 if there's no such job.
+
+  job_cancel()
+    Cancel a job that's on hold, pending or running.  Returns 0 if done,
+    else an error number, such as EBADFD if the job's in another state,
+    or -1; job_error() says what.
+*/
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef _JOB_CLIENT_HXX_
+#define _JOB_CLIENT_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/file.hxx"
+#include "job/status.hxx"
+#include "job/string.hxx"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace job {
+
+class notice;
+
+// What to submit; like the options to mkjob(8)
+struct jobspec {
+    std::string queue;          // Queue to use; empty for the default queue
+    std::string command;        // The command to run...
+    std::string type;           // ...or the job type to run, in lieu of a command
+    stringlist  args;           // Its arguments
+    int         priority;       // 1=best, 5=normal, 9=slowest
+    time_t      run_time;       // When to run it; JOB_ASAP for as soon as can be
+    int         try_limit;      // Most tries to give it
+    std::string submitter;      // Who's submitting it; empty for this user
+    bool        notify;         // Notify the submitter of job updates on their tty/pts
+
+                jobspec();
+};
+
+class client {
+  public:
+    status      error;
+    std::string default_queue;  // Where jobs go that don't say; from job.conf
+
+                client(const std::string & root = "");
+                ~client();
+
+    id_t        submit(const jobspec & js);
+    size_t      submit_batch(const jobspec & proto,
+                             const std::vector<stringlist> & cmds,
+                             idlist_t & ids);
+    state_t     state(const id_t id);
+    status      cancel(const id_t id);
+
+  private:
+    typedef std::map<std::string, notice*> queues_t;
+    queues_t    queues;         // Queues known to exist, and how to tell their jobman
+
+    notice*     _queue(const std::string & qnam);
+    status      _prep(file & jf, const jobspec & js, const std::string & qnam);
+
+    client(const client &);             // not copyable
+    client & operator=(const client &);
+};
+}
+
+/*! @file
+@class job::client
+  @brief Submit and look after jobs from within a program, with no mkjob to run
+
+  Running mkjob(8) for each job costs a fork and exec, a read of job.conf,
+  and a look for the queue, every time.  A client does those once: it reads
+  the config when made, remembers each queue it's found (and the socket of
+  its jobman, see job::notice), and then each job costs just the writing of
+  its file.  This is the API that's kept stable in libjob; link with -ljob.
+  For C, see job/client.h, which wraps it.
+
+  submit() does what mkjob does: the job file is written in hold, then moved
+  into pend, and its jobman told it's there.  submit_batch() makes many jobs
+  alike but for their commands and arguments, as mkjob --batch does: the
+  job IDs are reserved for all of them at once, their files are made from
+  the one template, and the jobman is told of them all in a notice or two.
+
+  state() and cancel() find a job by its ID alone, thru the ID index, so the
+  queue isn't needed.  A job that's not yet running is cancelled by moving
+  it to done, with a result saying so; a running job by dropping a kill file
+  for its jobman, which kills it (see job(7)).  Other jobs can't be cancelled.
+
+  A client is not thread-safe; use one per thread.  Making one sets the
+  filesystem root for the whole process (see job::path), as do the tools'
+  --root options.
+
+  @code
+    job::client jc;
+    if (jc.error) ...
+    job::jobspec js;
+    js.command = "make";
+    js.args.push_back("world");
+    job::id_t id = jc.submit(js);
+    if (!id) printf("Not submitted: %s\n", jc.error.c_str());
+     ...
+    if (jc.state(id) == job::run) jc.cancel(id);
+  @endcode
+
+@fn job::client::client(const std::string & root)
+  @brief Read job.conf, under root if one is given.  Check error after.
+
+@fn job::id_t job::client::submit(const jobspec & js)
+  @brief Submit one job.  Returns its ID, or 0 with error set.
+
+@fn size_t job::client::submit_batch(const jobspec & proto, const std::vector<stringlist> & cmds, idlist_t & ids)
+  @brief Submit a job for each of cmds, all like proto but for their commands and arguments.
+  Each of cmds is the command then its arguments; or if proto has a type, just the arguments.
+  An ID is appended to ids for each of cmds, in order, or 0 for one not made (such as an empty
+  command).  Returns how many were made; if not all of them, error says why.
+
+@fn job::state_t job::client::state(const id_t id)
+  @brief The job's state, or job::unk with error set if there's no such job.
+
+@fn job::status job::client::cancel(const id_t id)
+  @brief Cancel a job that's on hold, pending, or running.  ERR_BADSTATE if it's neither.
+*/
+
+#endif
@@ -0,0 +1,104 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/fanout.hxx"
+#include "job/path.hxx"
+#include "job/seqnum.hxx"
+#include <sys/stat.h>           // umask()
+
+using job::ERR_OK;
+using job::int2str;
+
+job::fanout::fanout(file & group)
+    : made(0)
+    , failed(0)
+    , kid(group.name()) {
+
+    // IDs for the children that have none yet, all in one go
+    uint64_t need = 0;
+    for (ties_t::iterator it = group.ties.begin(); it != group.ties.end(); ++it) {
+        if (!it->second) ++need;
+    }
+    if (need) {
+        seqnum sq(path.seqfile);
+        sq.paged = true;
+        uint64_t n = sq.next(need);
+        if (sq.error) {
+            error.set("Sequence number", sq.error);
+            return;
+        }
+        for (ties_t::iterator it = group.ties.begin(); it != group.ties.end(); ++it) {
+            if (it->second) continue;
+            it->second = file::zone ? (n++)*10 + file::zone : n++;
+        }
+    }
+    todo = group.ties;
+
+    // Render one child; the rest differ only by ID and tie
+    kid.copy(group);
+    kid.mid       = group.id;
+    kid.mnode     = "";
+    kid.try_count = 0;
+    kid.state     = pend;
+    kid.id        = 0;
+    kid._set_headers();
+    std::string all = kid.to_string(kid.header_pad);
+    size_t at = all.find("\njob-id:");
+    size_t val = (at == std::string::npos) ? at : all.find_first_not_of(' ', at + 8);
+    size_t eol = (val == std::string::npos) ? val : all.find('\n', val);
+    if (eol == std::string::npos) {
+        error = "Cannot make child job template";
+        return;
+    }
+    pre  = all.substr(0, val);
+    post = all.substr(eol);
+    std::string ixnam = kid.index_name();
+    mkdir(ixnam.substr(0, ixnam.rfind('/')).c_str(), 0755);     // if not there yet
+    error = ERR_OK;
+}
+
+size_t job::fanout::step(const size_t most) {
+    status last = ERR_OK;       // the last failure, if any
+    size_t n = 0;
+    mode_t oldum = umask(007);  // mode: user & group get all, others get nothing
+    while (!todo.empty() && (n < most)) {
+        ties_t::iterator it = todo.begin();
+        make(it->first, it->second);
+        if (error) {
+            ++failed;
+            last = error;
+        }
+        else ++made;
+        todo.erase(it);
+        ++n;
+    }
+    umask(oldum);               // mode: set it back
+    error = last;
+    return n;
+}
+
+// Write one child, in hold, then move it to pending
+void job::fanout::make(const std::string & station, const id_t id) {
+    kid.id    = id;
+    kid.state = pend;
+    error = kid._spool(pre + int2str(id) + post, "tie " + station + " 0\n");
+}
@@ -0,0 +1,88 @@
+#ifndef _JOB_FANOUT_HXX_
+#define _JOB_FANOUT_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+
+#include "job/file.hxx"
+#include "job/status.hxx"
+#include <string>
+
+namespace job {
+
+class fanout {
+  public:
+    status      error;
+    ties_t      todo;           // Children yet to be made: station and child job ID
+    size_t      made;           // How many have been made
+    size_t      failed;         // ...and how many we couldn't make
+
+                fanout(file & group);
+
+    size_t      step(const size_t most);
+    bool        done() const { return todo.empty(); }
+
+  private:
+    file        kid;            // The child job, as a template
+    std::string pre;            // The child job file, rendered up to its job-id...
+    std::string post;           // ...and after it, to the end of its headers
+
+    void        make(const std::string & station, const id_t id);
+
+    // Not copyable
+                fanout(const fanout & other);
+    fanout &    operator=(const fanout & other);
+};
+}
+
+/*! @file
+@class job::fanout
+  @brief Makes the child jobs of a group job, in bulk, a few at a time
+
+  The children of a group job differ only in their job ID and the station
+  they're tied to, so one child is rendered as a template and each of the
+  rest is written from it, without building a job::file for each.  IDs for
+  all the children the group still needs are reserved from the sequence
+  file at once, and put in the group's ties, when the fanout is made.  So
+  the group can be stored with its ties before any child exists, and no
+  matter how many tries it takes, each station gets the one child ID.
+
+  The children are then made by step(), which writes up to so many, so a
+  big group can be made across many turns of the job manager's loop
+  while other jobs keep running.  Each child is written in the hold state,
+  owned by the group's user, with its section index and ID link; then it's
+  moved to pending.  Those that fail are counted, the last failure is
+  in error, and they're dropped from todo like the rest; a later fanout
+  of the same group can make them.
+
+@fn job::fanout::fanout(file & group)
+  @brief Reserve child IDs for the group's ties that have none, and make
+  the child template.  The group's section 0 must be loaded.  Initially todo
+  has all the group's ties; drop any whose child is already made.
+
+@fn size_t job::fanout::step(const size_t most)
+  @brief Make up to most more children; returns how many were tried.
+  error is set if any of them failed.
+*/
+
+#endif
@@ -34,8 +34,8 @@
 #define __STDC_FORMAT_MACROS    // Enable PRI macros
 #include <inttypes.h>           // PRI macros
 #include <limits.h>             // PATH_MAX
-#include <stdio.h>              // snprintf(), sscanf()
-#include <string.h>             // strtok()
+#include <stdio.h>              // snprintf()
+#include <string.h>             // strtok_r()
 #include <unistd.h>             // close() etc
 #include <sys/file.h>           // flock()
 #include <sys/stat.h>           // umask()
@@ -44,7 +44,16 @@ using job::ERR_OK;
 using job::int2str;
 using std::string;
 
-int job::file::zone = 0;
+// Room left after the section 0 headers, so they can be updated in place
+//  as the job changes (a boundary gets added, the PID changes, etc)
+#define HEADER_ROOM 128
+
+int job::file::zone  = 0;
+int job::file::lease = 0;
+
+// Job IDs for this process: from the node's counter page, or leased.
+//  At exit, the rest of a lease is given back.
+static job::seqnum our_ids;
 
 std::string job::state2str(const state_t s) {
     switch (s) {
@@ -76,17 +85,17 @@ job::status job::file::parse(const std::string & fnam,
                              int & priority,
                              id_t & id, 
                              std::string & submitter) {
-    char subm[PATH_MAX];
-    int amt = sscanf(fnam.c_str(), 
-                     "t%" PRI_time_t".p%d.j%" PRI_id_t ".%s", 
-                     &run_time, &priority, &id, subm);
-    if (amt != 4)
+    jobkey k;
+    k.priority = PRIORITY_DEFAULT;
+    if (!k.parse(fnam.c_str(), false)) {            // as given, not only as we'd name it
+        if ((k.priority < PRIORITY_MIN) || (k.priority > PRIORITY_MAX))
+            return status("Bad priority", fnam);
         return status("Bad jobfile format", fnam); 
-    if ((priority < PRIORITY_MIN) || (priority > PRIORITY_MAX))
-        return status("Bad priority", fnam);
-    submitter = subm;
-    if (submitter.size() < 1)
-        return status("Missing submitter", fnam);
+    }
+    run_time  = k.run_time;
+    priority  = k.priority;
+    id        = k.id;
+    submitter = k.submitter();
     return ERR_OK;
 }
 
@@ -110,9 +119,15 @@ job::file::file()
 {
     // Ensure we have a section 0
     if (!size()) resize(1);
+    header_pad = HEADER_ROOM;
 
     // Create a new job ID (job number [+ zone])
-    seqnum q(path.seqfile);
+    seqnum & q = our_ids;
+    if ((q.filename != path.seqfile) || (q.lease != (uint64_t)lease)) {
+        q.reset(path.seqfile);  // (new root, as in tests)
+        q.lease    = lease;
+        q.paged    = true;
+    }
     id = q.next();
     if (q.error) {
         error.set("Sequence number", q.error);
@@ -145,6 +160,7 @@ job::file::file(const job::id_t & wanted_id)
     , lockfd(-1)
 {
     if (!size()) resize(1); // Ensure we have a section 0
+    header_pad = HEADER_ROOM;
 
     // Find the job file, if it exists
     oldnam = find(wanted_id);
@@ -177,6 +193,7 @@ job::file::file(const std::string & filepath)
     , lockfd(-1)
 {
     if (!size()) resize(1);  // Ensure we have a section 0
+    header_pad = HEADER_ROOM;
     _init_from_path(filepath);
 }
 
@@ -233,35 +250,50 @@ job::status job::file::copy(const job::file & jf) {
 static std::string found_filename;
 
     // Callback for following function
-    static int _finder_cb(const job::file & jf, void* ua) {
+    static int _finder_cb(const job::queue & q, const job::jobkey & k, job::state_t s, void* ua) {
         id_t wanted_id = *(id_t*)ua;
-        if (jf.id != wanted_id) return 1;
-        found_filename = jf.name();
+        if (k.id != wanted_id) return 1;
+        found_filename = q.dir_path(s) + k.name();
         return 0;   // We found it, we're done!
     }
 
 std::string job::file::find(const id_t & wanted_id) {
 
-    // For all queues...
+    // The ID index says where it is, if it's right
+    std::string lnk = id_name(wanted_id);
+    char target[PATH_MAX+1];
+    ssize_t n = readlink(lnk.c_str(), target, PATH_MAX);
+    if ((n > 6) && !strncmp(target, "../../", 6)) {
+        std::string fnam = path.jobdir + std::string(target+6, n-6);
+        if (!access(fnam.c_str(), F_OK)) return fnam;
+    }
+
+    // Not indexed, or gone stale; look thru all queues...
     found_filename.erase();
     stringlist qlist;
     status e = job::queue::get_queues(qlist);
     if (e) return error = e;
     for (size_t i=0; i<qlist.size(); i++) {
         job::queue q(qlist[i]);
-        q.scan_queue(_finder_cb, (void*)&wanted_id);
+        q.scan_keys(_finder_cb, (void*)&wanted_id);
         if (found_filename.size()) break;
     }
+    if (found_filename.size()) _link_id(found_filename);   // ...and fix the index
     return found_filename;
 }
 
 // Load a job file into ourselves
-job::status job::file::load() {
+job::status job::file::load(const bool head_only) {
 
     // Load by our derived name
     oldnam = name();
-    job::multipart::load(oldnam);
+    index  = index_name();
+    job::multipart::load(oldnam, head_only);
     if (error) return error;
+    if (lazy && !exists(0, "Try-Count")) {
+        load_headers();         // Older job file, must look at the tries for the count
+        if (error) return error;
+    }
     uid = statbuf.st_uid;   // statbuf is in our multipart base object, filled in by load() above
     gid = statbuf.st_gid;   // statbuf is in our multipart base object, filled in by load() above
 
@@ -292,8 +324,9 @@ job::status job::file::load() {
     //    through the --groups option.  It's one of the things listed there.
     //  The second item is our job number for the child job.
     ties.clear();
+    char* save = NULL;
     for (char* body = (char*)(*this)[0][BODY_TAG].c_str();
-         char* line = strtok(body, "\n"); 
+         char* line = strtok_r(body, "\n", &save);
          body = NULL) {
         stringlist parts = split(line, " ");
         if (parts.size() != 3) continue;
@@ -346,11 +379,107 @@ std::string job::file::name() const {
     return nam;
 }
 
+// A job's link in the ID index, sharded by the low byte of the ID
+std::string job::file::id_name(const id_t id) {
+    char nam[PATH_MAX+1];
+    snprintf(nam, sizeof(nam), "%s.ids/%2.2x/j%7.7" PRI_id_t,
+                path.jobdir.c_str(),
+                (unsigned int)(id & 0xff),
+                id);
+    return nam;
+}
+
+// Point our ID index link at the job file, replacing any old link.
+//  The index is just a help to find(), so if this fails, so be it.
+void job::file::_link_id(const std::string & filename) const {
+    if (filename.compare(0, path.jobdir.size(), path.jobdir)) return;   // not in the queues
+    std::string lnk    = id_name(id);
+    std::string target = "../../" + filename.substr(path.jobdir.size());
+    std::string tmp    = lnk + "." + int2str(getpid());
+    int err = symlink(target.c_str(), tmp.c_str());
+    if (err && (SYS_errno == EEXIST)) {     // left over from a crash
+        isafe::unlink(tmp.c_str());
+        err = symlink(target.c_str(), tmp.c_str());
+    }
+    if (err && (SYS_errno == ENOENT)) {     // first in this shard
+        mkdir((path.jobdir + ".ids").c_str(), 0755);
+        mkdir(lnk.substr(0, lnk.rfind('/')).c_str(), 0755);
+        err = symlink(target.c_str(), tmp.c_str());
+    }
+    if (err) return;
+    if (isafe::rename(tmp.c_str(), lnk.c_str())) isafe::unlink(tmp.c_str());
+}
+
+// Write a new job file from its rendered text, with its section index and ID
+//  link, without going thru store().  It's written in hold, then moved to our
+//  state, so jobman never sees it half-written.  The caller sets the umask.
+job::status job::file::_spool(const std::string & head, const std::string & body) {
+    state_t want = state;
+    state = hold;
+    std::string hnam = name();
+    state = want;
+    std::string nam  = name();
+    std::string text = body.size() ? head + "\n" + body : head;
+    bool own = uid && gid;
+
+    int fd = isafe::open(hnam.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd < 0) return error.set("Cannot create " + hnam, SYS_status);
+    if ((isafe::write(fd, text.data(), text.size()) != (ssize_t)text.size())
+            || (own && fchown(fd, uid, gid))) {
+        error.set("Cannot write " + hnam, SYS_status);
+        isafe::close(fd);
+        isafe::unlink(hnam.c_str());
+        return error;
+    }
+    isafe::close(fd);
+
+    // Its section index: just section 0, which may yet grow
+    secrec r;
+    r.head  = 0;
+    r.body  = body.size() ? (int64_t)head.size() + 1 : -1;
+    r.end   = -1;
+    r.tries = 0;
+    r.type  = secindex::MAIN;
+    std::string ixnam = index_name();
+    fd = isafe::open(ixnam.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0660);
+    if (fd >= 0) {
+        bool bad = (isafe::write(fd, &r, sizeof(r)) != (ssize_t)sizeof(r))
+                || (own && fchown(fd, uid, gid));
+        isafe::close(fd);
+        if (bad) isafe::unlink(ixnam.c_str());  // else it's no use
+    }
+
+    if (isafe::rename(hnam.c_str(), nam.c_str())) {
+        error.set("Cannot move " + hnam + " to " + state2str(state), SYS_status);
+        isafe::unlink(hnam.c_str());
+        isafe::unlink(ixnam.c_str());
+        return error;
+    }
+    _link_id(nam);
+    return error = ERR_OK;
+}
+
+// The section index is kept by ID, so it stays put as the job file moves
+std::string job::file::index_name() const {
+    return index_name(queue, id);
+}
+
+std::string job::file::index_name(const std::string & queue, const id_t id) {
+    char nam[PATH_MAX+1];
+    snprintf(nam, sizeof(nam), "%s%s/.index/j%7.7" PRI_id_t,
+                path.jobdir.c_str(),
+                queue.c_str(),
+                id);
+    return nam;
+}
+
 job::status job::file::remove() {
     if (oldnam != "") {
         int err = isafe::remove(oldnam.c_str());
         if (err) return error.set("remove: ", SYS_status);
         oldnam.clear();
+        isafe::unlink(index_name().c_str());    // if any
+        isafe::unlink(id_name(id).c_str());
     }
     return error = ERR_OK;
 }
@@ -371,6 +500,7 @@ job::status job::file::repath() {
                                   "   to: "+newnam+"\n"
                                   "\t", SYS_status);
         oldnam = newnam;
+        _link_id(oldnam);
 
         // Release lock (if state not run)
         if (state != run) unlock();
@@ -403,9 +533,8 @@ job::status job::file::unlock() {
     return error = ERR_OK;
 }
 
-job::status job::file::store() {
-
-    // Update section 0 header items
+// Update section 0 header items from our attributes
+void job::file::_set_headers() {
 
     // -(these come from file pathname attributes: note lowercase)-
     (*this)[0]["job-id"]     = int2str(id);
@@ -420,30 +549,62 @@ job::status job::file::store() {
     (*this)[0]["Job-Type"]   = type;
     (*this)[0]["TTY-Notify"] = yn2str(notify);
     (*this)[0]["Try-Limit"]  = int2str(try_limit);
+    if (try_count || exists(0, "Try-Count"))
+        (*this)[0]["Try-Count"] = int2str(try_count);            // varies
     for (size_t i=0; i<args.size(); i++) {
         (*this)[0]["Job-Arg-" + int2str(i+1)] = args[i];
     }
+}
+
+job::status job::file::store() {
+
+    // Update section 0 header items, and the ties in its body
+    _set_headers();
     (*this)[0][BODY_TAG].clear();
     for (ties_t::iterator it = ties.begin(); it != ties.end(); ++it) {
         (*this)[0][BODY_TAG] += "tie " + it->first + " " + int2str(it->second) + "\n";
     }
 
-    // Store it - the whole thing
+    // Store it - the whole thing, and its index
     repath();
     if (oldnam.empty()) oldnam = name();
+    index = index_name();
+    mkdir(index.substr(0, index.rfind('/')).c_str(), 0755);   // if not there yet
     mode_t oldum = umask(007);  // mode: user & group get all, others get nothing
     multipart::store(oldnam);   // store the contents
     umask(oldum);               // mode: set it back
     if (error) return error.set("write "+oldnam, std::string(error));   // "error" from multipart
 
+    _link_id(oldnam);
+
     // Set user and group
     if (uid && gid) {
         int ret = chown(oldnam.c_str(), uid, gid);
         if (ret) return error.set(logstr("write %s: chown(%d, %d): %s", 
                                   oldnam, (int)uid, (int)gid, SYS_status));
+        if (chown(index.c_str(), uid, gid)) isafe::unlink(index.c_str());  // else it's no use
     }
 
     // Done
     return error = ERR_OK;
 }
 
+// Store just the section 0 headers, in place if they fit, then move the file if need be.
+//  The ties (section 0 body) are not changed; use store() for that.
+job::status job::file::store_headers() {
+    if (oldnam.empty()) return store();     // never written, do the whole thing
+    _set_headers();
+    index = index_name();
+    multipart::update_headers(oldnam, &lockfd);    // keeps our lock, if it's a new file
+    if (error) return error.set("update "+oldnam, std::string(error));
+    return repath();
+}
+
+// Add a section to the end of the file, where it is now
+job::status job::file::store_section(const unsigned int sec, const int bodyfd) {
+    if (oldnam.empty()) return error.set("append: job file not yet stored");
+    index = index_name();
+    multipart::append(oldnam, sec, bodyfd);
+    if (error) return error.set("append "+oldnam, std::string(error));
+    return error = ERR_OK;
+}
@@ -23,6 +23,7 @@
     USA
 */
 
+#include "job/jobkey.hxx"
 #include "job/multipart.hxx"
 #include "job/status.hxx"
 #include "job/string.hxx"
@@ -58,6 +59,7 @@ class file : public multipart {
     ~file();
 
     static int  zone;           // 0=no zones, 1-9 valid
+    static int  lease;          // Claim job IDs this many at a time (see job::seqnum); 0=don't
 
                                 // Letters below indicate where the info is encoded/stored
                                 //  P = in path of jobfile
@@ -89,7 +91,8 @@ class file : public multipart {
 
     job::status         copy(const job::file & jf);  // Copy some parts of a job::file
     std::string         find(const id_t & want_id);  // Find job filename by ID
-    job::status         load();         // Load the file using the name it should be
+    std::string         index_name() const;             // Section index path & name
+    job::status         load(const bool head_only = false); // Load the file using the name it should be
     job::status         lock();         // Lock the file (if use_locks is true)
     std::string         name() const;   // Job file path & name
     job::status         remove();       // Remove the job file from the file system
@@ -107,6 +110,9 @@ class file : public multipart {
 
     // Store the information back to disk.  Invokes repath() if needed.
     job::status         store();
+    job::status         store_headers();                    // Update section 0 in place, then repath()
+    job::status         store_section(const unsigned int sec,   // Append a section to the file,
+                                      const int bodyfd = -1);   //  its body (or the rest) from bodyfd
 
     // Parse just the filename of a jobfile
     static job::status  parse(const std::string & fnam,
@@ -114,10 +120,17 @@ class file : public multipart {
                               int    & priority,
                               id_t   & id, 
                               std::string & submitter);
+    static std::string  index_name(const std::string & queue, const id_t id);
+    static std::string  id_name(const id_t id);         // Job's link in the ID index
   private:
+    friend class batch;         // makes jobs from a template of one
+    friend class fanout;        // makes child jobs from a template of one
     std::string oldnam;         // Prior file name, before state/time/prio changes
     int         lockfd;         // fd used to lock the file during transitions and run
     void        _init_from_path(const std::string & filename);
+    void        _set_headers();
+    void        _link_id(const std::string & filename) const;
+    job::status _spool(const std::string & head, const std::string & body);
 };
 }
 
@@ -132,6 +145,34 @@ class file : public multipart {
  *   This class "is-a" job::multipart file, so all those access functions
  *   are available.
  *
+ *   store() writes the whole file, and is used to create it.  After that,
+ *   a job's file grows by sections (output, result) for each try; add those
+ *   with store_section(), and save changes to the job's attributes with
+ *   store_headers().  Neither reads nor rewrites the bodies already in the
+ *   file, so they stay cheap however much output the job has made.  A new
+ *   section's body may come straight from another file; see multipart::append().
+ *   Only section 0 needs to be in memory for them.
+ *
+ *   Most users of a job only need its section 0, which holds the job's
+ *   attributes and ties; load(true) reads just that.  The try count is kept
+ *   in section 0 too, so it's known without reading the tries.  For job files
+ *   written before that was done, the tries' headers are read to find it.
+ *
+ *   To find a job by ID without looking thru every queue, there's an ID
+ *   index: a symlink per job, .ids/<xx>/j<id> under the queues directory,
+ *   sharded by the ID's low byte, pointing at where the job file is.
+ *   store(), repath() and remove() keep it current.  find() checks that the
+ *   link still leads to the job; if not, or if there's no link (say, a job
+ *   file from before the index), it looks thru the queues, and fixes the link.
+ *
+ *   A new job file gets its ID from the node's counter page, or from a lease
+ *   if lease is set; see job::seqnum.  Either way, it's one sequence for all.
+ *
+ *   Each job file has a section index (see job::secindex) in the queue's
+ *   .index directory, named by the job's ID so it needn't move when the job
+ *   file does.  With it, the headers of the tries are found without reading
+ *   their output.  Job files without one are read as before.
+ *
 */
 
 #endif
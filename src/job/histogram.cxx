@@ -0,0 +1,74 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/histogram.hxx"
+#include <string.h>             // memset()
+
+#define HIST_SHIFT 3            // log2(HIST_SUB)
+
+void job::histogram::clear() {
+    memset(this, 0, sizeof(*this));
+}
+
+// Values below HIST_SUB each have their own; then HIST_SUB per power of two
+int job::histogram::index(const uint64_t v) {
+    if (v < HIST_SUB) return v;
+    int e = 63 - __builtin_clzll(v);                    // highest bit
+    int i = HIST_SUB + (e - HIST_SHIFT) * HIST_SUB + ((v >> (e - HIST_SHIFT)) & (HIST_SUB - 1));
+    return (i < HIST_BUCKETS) ? i : HIST_BUCKETS - 1;
+}
+
+uint64_t job::histogram::lowest(const int i) {
+    if (i < HIST_SUB) return i;
+    int e = (i - HIST_SUB) / HIST_SUB + HIST_SHIFT;
+    uint64_t m = HIST_SUB + (i % HIST_SUB);
+    return m << (e - HIST_SHIFT);
+}
+
+uint64_t job::histogram::highest(const int i) {
+    if (i >= HIST_BUCKETS - 1) return (uint64_t)-1;
+    return lowest(i + 1) - 1;
+}
+
+void job::histogram::record(const uint64_t v) {
+    if (!count || (v < min)) min = v;
+    if (v > max) max = v;
+    ++count;
+    sum += v;
+    ++bucket[index(v)];
+}
+
+uint64_t job::histogram::percentile(const double pct) const {
+    if (!count) return 0;
+    uint64_t want = (uint64_t)(count * pct / 100.0 + 0.5);
+    if (want < 1) want = 1;
+    if (want > count) want = count;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += bucket[i];
+        if (seen >= want) {
+            uint64_t top = highest(i);
+            return (top < max) ? top : max;
+        }
+    }
+    return max;
+}
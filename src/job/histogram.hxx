@@ -0,0 +1,77 @@
+#ifndef _JOB_HISTOGRAM_HXX_
+#define _JOB_HISTOGRAM_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include <stdint.h>
+
+#define HIST_SUB     8          // Buckets per power of two; so within 12.5%
+#define HIST_BUCKETS 328        // Up to 2^43 (over 100 days in microseconds)
+
+namespace job {
+
+struct histogram {
+    uint64_t    count;
+    uint64_t    sum;
+    uint64_t    min;
+    uint64_t    max;
+    uint64_t    bucket[HIST_BUCKETS];
+
+    void        clear();
+    void        record(const uint64_t v);
+    uint64_t    percentile(const double pct) const;
+    uint64_t    mean() const { return count ? sum / count : 0; }
+
+    static int      index(const uint64_t v);
+    static uint64_t lowest(const int i);
+    static uint64_t highest(const int i);
+};
+}
+
+/*! @file
+@class job::histogram
+  @brief A fixed-size histogram of values over a wide range, within a set precision
+
+  Like an HDR histogram: the buckets are log-linear, HIST_SUB of them for
+  each power of two, so any value is counted in a bucket no more than 12.5%
+  wide, from one to many days' worth of microseconds, in a few KB.  Values
+  under HIST_SUB each have a bucket of their own.  Recording is a few shifts
+  and adds, with no allocation; the struct is plain data, so it can live in
+  shared memory (see job::stats) and be copied as-is.  Zero it with clear()
+  or memset() before use.
+
+@fn void job::histogram::record(const uint64_t v)
+  @brief Count a value.  Those past the top bucket are counted in it.
+
+@fn uint64_t job::histogram::percentile(const double pct) const
+  @brief The value that pct percent of those recorded are at or below (0-100);
+  it's the top of that value's bucket, but no more than the max seen.  0 if none.
+
+@fn int job::histogram::index(const uint64_t v)
+  @brief Which bucket a value goes in.
+
+@fn uint64_t job::histogram::lowest(const int i)
+  @brief The least value counted in bucket i; highest() is the greatest.
+*/
+
+#endif
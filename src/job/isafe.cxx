@@ -153,6 +153,40 @@ int isafe::open(const char* pathname, int flags, mode_t mode) {
     }
 }
 
+ssize_t isafe::pread(int fd, void* buf, size_t count, off_t offset) {
+    ssize_t ret;
+    unsigned int num = busy_try_limit;
+    for (;;--num) {
+        do {
+            ret = ::pread(fd, buf, count, offset);
+        } while ((ret == -1) && (errno == EINTR));
+        if (ret != -1)      return ret;     // it worked
+        if (num == 0)       return ret;     // we're out of tries
+        if (errno != EBUSY) return ret;     // not something to retry
+        usleep(busy_try_delay);
+#ifdef _BLURT
+        fprintf(stderr, "%s BUSYWAIT\n", __FUNCTION__);
+#endif
+    }
+}
+
+ssize_t isafe::pwrite(int fd, const void* buf, size_t count, off_t offset) {
+    ssize_t ret;
+    unsigned int num = busy_try_limit;
+    for (;;--num) {
+        do {
+            ret = ::pwrite(fd, buf, count, offset);
+        } while ((ret == -1) && (errno == EINTR));
+        if (ret != -1)      return ret;     // it worked
+        if (num == 0)       return ret;     // we're out of tries
+        if (errno != EBUSY) return ret;     // not something to retry
+        usleep(busy_try_delay);
+#ifdef _BLURT
+        fprintf(stderr, "%s BUSYWAIT\n", __FUNCTION__);
+#endif
+    }
+}
+
 ssize_t isafe::read(int fd, void* buf, size_t count) {
     ssize_t ret;
     unsigned int num = busy_try_limit;
@@ -42,6 +42,8 @@ namespace isafe {
     off_t   lseek(int fd, off_t offset, int whence);
     int     open(const char* pathname, int flags);
     int     open(const char* pathname, int flags, mode_t mode);
+    ssize_t pread(int fd, void* buf, size_t count, off_t offset);
+    ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset);
     ssize_t read(int fd, void* buf, size_t count);
     int     remove(const char* pathname);
     int     rename(const char* oldpath, const char* newpath);
@@ -85,7 +87,9 @@ namespace isafe {
  @fn    int     open(const char* pathname, int flags, mode_t mode);
   @brief Interrupt-safe (signal-safe) and busy-retry flavor of the same-named system function.
 
- @fn    ssize_t read(int fd, void* buf, size_t count);
+ @fn    ssize_t pread(int fd, void* buf, size_t count, off_t offset);
+    ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset);
+    ssize_t read(int fd, void* buf, size_t count);
   @brief Interrupt-safe (signal-safe) and busy-retry flavor of the same-named system function.
 
  @fn    ssize_t remove(const char* pathname);
@@ -0,0 +1,183 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/base.hxx"
+#include "job/jobkey.hxx"
+#define __STDC_FORMAT_MACROS    // Enable PRI macros
+#include <algorithm>            // std::sort
+#include <deque>
+#include <inttypes.h>           // PRI macros
+#include <map>
+#include <stdio.h>              // snprintf()
+#include <string.h>             // memset()
+
+// Below this many keys, a plain comparison sort wins
+#define RADIX_MIN 64
+
+// Interned submitter names.  A deque never moves its elements, so the
+//  references we hand out stay good as the table grows.
+static std::deque<std::string>          _names(1, "");  // handle 0 is the empty name
+static std::map<std::string, uint32_t>  _handles;
+static volatile int                     _lock = 0;
+
+static void take_lock() { while (__sync_lock_test_and_set(&_lock, 1)) ; }
+static void give_lock() { __sync_lock_release(&_lock); }
+
+uint32_t job::jobkey::intern(const char* s, size_t len) {
+    if (!len) return 0;
+    std::string nam(s, len);
+    take_lock();
+    std::map<std::string, uint32_t>::iterator it = _handles.find(nam);
+    uint32_t who;
+    if (it != _handles.end()) {
+        who = it->second;
+    }
+    else {
+        who = _names.size();
+        _names.push_back(nam);
+        _handles[nam] = who;
+    }
+    give_lock();
+    return who;
+}
+
+const std::string & job::jobkey::submitter(uint32_t who) {
+    take_lock();
+    const std::string & nam = (who < _names.size()) ? _names[who] : _names[0];
+    give_lock();
+    return nam;
+}
+
+const std::string & job::jobkey::submitter() const {
+    return submitter(who);
+}
+
+// A number, as name() writes it if exact: zero-padded to at least width
+//  digits, but no more.  Never so many it overflows.  Returns where it ends,
+//  NULL if it's not one.
+static const char* _digits(const char* p, int width, bool exact, uint64_t & v) {
+    const char* s = p;
+    v = 0;
+    while ((*p >= '0') && (*p <= '9')) {
+        if (p - s >= 18) return NULL;
+        v = v*10 + (*p++ - '0');
+    }
+    int n = p - s;
+    if (!n) return NULL;
+    if (exact && ((n < width) || ((n > width) && (*s == '0')))) return NULL;
+    return p;
+}
+
+// Parse t<time>.p<prio>.j<id>.<submitter>
+bool job::jobkey::parse(const char* fnam, const bool exact) {
+    const char* p = fnam;
+    uint64_t v;
+
+    if (*p++ != 't') return false;
+    bool neg = (*p == '-');
+    if (neg) ++p;
+    if (!(p = _digits(p, 10, exact, v))) return false;
+    run_time = neg ? -(time_t)v : (time_t)v;
+
+    if (*p++ != '.') return false;
+    if (*p++ != 'p') return false;
+    if ((*p < '0') || (*p > '9')) return false;
+    int32_t pr = 0;
+    int n = 0;
+    for (; (n < 2) && (*p >= '0') && (*p <= '9'); n++) pr = pr*10 + (*p++ - '0');
+    priority = pr;
+    if ((pr < 1) || (pr > 9) || (exact && (n > 1))) return false;
+
+    if (*p++ != '.') return false;
+    if (*p++ != 'j') return false;
+    if (!(p = _digits(p, 7, exact, v))) return false;
+    id = v;
+
+    if (*p++ != '.') return false;
+    const char* s = p;
+    while (*p && (*p != ' ') && (*p != '\t') && (*p != '\n')) ++p;
+    if ((p == s) || (exact && *p)) return false;
+    who = intern(s, p - s);
+    return true;
+}
+
+// Our file name - see also job::file::name()
+std::string job::jobkey::name() const {
+    char nam[64];
+    snprintf(nam, sizeof(nam), "t%10.10" PRI_time_t ".p%d.j%7.7" PRIu64 ".",
+             run_time, priority, id);
+    return nam + submitter();
+}
+
+// Byte b of a key field, flipped so signed values sort right
+enum field_t {F_TIME, F_PRIO, F_ID};
+static inline unsigned int digit(const job::jobkey & k, field_t f, int b) {
+    uint64_t v = (f == F_TIME) ? (uint64_t)k.run_time ^ 0x8000000000000000ULL
+               : (f == F_PRIO) ? (uint64_t)(uint32_t)k.priority
+               :                 k.id;
+    return (v >> (b*8)) & 0xff;
+}
+
+// One counting pass of the radix sort, from src into dst.
+//  Returns false (and does nothing) if all keys have the same digit.
+static bool radix_pass(const job::keylist_t & src, job::keylist_t & dst, field_t f, int b) {
+    size_t count[257];
+    memset(count, 0, sizeof(count));
+    size_t n = src.size();
+    for (size_t i = 0; i < n; i++) ++count[digit(src[i], f, b) + 1];
+    for (int d = 1; d <= 256; d++) if (count[d] == n) return false;
+    for (int d = 1; d <= 256; d++) count[d] += count[d-1];
+    for (size_t i = 0; i < n; i++) dst[count[digit(src[i], f, b)]++] = src[i];
+    return true;
+}
+
+// Least significant digit first radix sort over the given fields (least significant first)
+static void radix_sort(job::keylist_t & keys, const field_t* fields, int nfields) {
+    job::keylist_t tmp(keys.size());
+    job::keylist_t* src = &keys;
+    job::keylist_t* dst = &tmp;
+    for (int f = 0; f < nfields; f++) {
+        int nbytes = (fields[f] == F_PRIO) ? 4 : 8;
+        for (int b = 0; b < nbytes; b++) {
+            if (radix_pass(*src, *dst, fields[f], b)) std::swap(src, dst);
+        }
+    }
+    if (src != &keys) keys.swap(tmp);
+}
+
+void job::jobkey::sort(keylist_t & keys) {
+    if (keys.size() < RADIX_MIN) {
+        std::sort(keys.begin(), keys.end(), by_time());
+        return;
+    }
+    static const field_t order[] = {F_ID, F_PRIO, F_TIME};
+    radix_sort(keys, order, 3);
+}
+
+void job::jobkey::sort_by_prio(keylist_t & keys) {
+    if (keys.size() < RADIX_MIN) {
+        std::sort(keys.begin(), keys.end(), by_prio());
+        return;
+    }
+    static const field_t order[] = {F_ID, F_TIME, F_PRIO};
+    radix_sort(keys, order, 3);
+}
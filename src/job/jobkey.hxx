@@ -0,0 +1,118 @@
+#ifndef _JOB_JOBKEY_HXX_
+#define _JOB_JOBKEY_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include <stdint.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+namespace job {
+
+typedef uint64_t id_t;      // Job ID type (same as in job/file.hxx)
+
+struct jobkey {
+    time_t      run_time;   // When next eligible to run
+    id_t        id;         // Job identifier
+    int32_t     priority;   // 1=best ... 9=slowest
+    uint32_t    who;        // Interned submitter handle; see submitter()
+
+    bool                parse(const char* fnam, const bool exact = true);  // Parse a job file's basename
+    std::string         name() const;               // Job file basename
+    const std::string & submitter() const;          // Submitter's name
+
+    // Order jobs by priority, then run time (the order to run them)
+    struct by_prio {
+        bool operator()(const jobkey & a, const jobkey & b) const {
+            if (a.priority != b.priority) return a.priority < b.priority;
+            if (a.run_time != b.run_time) return a.run_time < b.run_time;
+            return a.id < b.id;
+        }
+    };
+
+    // Order jobs by run time, then priority (the order of their file names)
+    struct by_time {
+        bool operator()(const jobkey & a, const jobkey & b) const {
+            if (a.run_time != b.run_time) return a.run_time < b.run_time;
+            if (a.priority != b.priority) return a.priority < b.priority;
+            return a.id < b.id;
+        }
+    };
+
+    static void                 sort(std::vector<jobkey> & keys);           // by_time order
+    static void                 sort_by_prio(std::vector<jobkey> & keys);   // by_prio order
+    static uint32_t             intern(const char* s, size_t len);
+    static const std::string &  submitter(uint32_t who);
+};
+
+typedef std::vector<jobkey> keylist_t;
+
+inline bool operator==(const jobkey & a, const jobkey & b) {
+    return (a.id == b.id) && (a.run_time == b.run_time) && (a.priority == b.priority);
+}
+inline bool operator!=(const jobkey & a, const jobkey & b) {
+    return !(a == b);
+}
+inline bool operator<(const jobkey & a, const jobkey & b) {
+    return jobkey::by_time()(a, b);
+}
+}
+
+/*! @file
+@class job::jobkey
+  @brief The attributes encoded in a job file's name, in a small flat struct
+
+  A job file is named t<run-time>.p<priority>.j<id>.<submitter>, and a
+  great deal of work is done using only those attributes -- picking jobs
+  to run, finding a job by ID, cleaning up old ones, listing queues.
+  A jobkey holds them without any strings or allocations, so it can be
+  copied, compared and sorted cheaply; that makes directory scans of
+  many thousands of jobs fast.
+
+  The submitter is interned: the key holds a small integer handle, and
+  the name is kept once in a process-wide table.  The table only grows,
+  and is safe to use from multiple threads.
+
+  Comparisons and sort() use the order of the file names (run time, then
+  priority, then ID); use by_prio or sort_by_prio() for the order to run them.
+  The sorts are radix sorts, and skip any byte that's the same for all keys.
+
+  @code
+    job::jobkey k;
+    if (k.parse(d->d_name)) printf("job %lu by %s\n", k.id, k.submitter().c_str());
+  @endcode
+
+@fn bool job::jobkey::parse(const char* fnam, const bool exact)
+  @brief Parse a job file's basename (no directories).  Returns false if it's not a job file name.
+  The priority must be 1-9, and the submitter not empty.
+  If exact, the name must be just as name() makes it, padding and all, so that
+  the file can be found again by its key; use this for names read from the spool.
+  Otherwise the numbers needn't be padded, and the submitter ends at a blank.
+  On failure, the fields parsed up to the error are left set.
+
+@fn std::string job::jobkey::name() const
+  @brief Build the job file's basename from the key; it is the same as job::file names it.
+*/
+
+#endif
@@ -26,15 +26,21 @@
 #include "job/log.hxx"
 #include <errno.h>
 #include <fcntl.h>
+#include <grp.h>                // getgrouplist()
+#include <pwd.h>                // getpwuid()
+#include <sched.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include <sys/prctl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <vector>
 #include <wordexp.h>
 
 // Character to send to the child process for sync purposes
@@ -43,6 +49,12 @@
 #define SYNC_TMO 100000     // 0.1 sec
 // The maximum number of times that child will check for the 'go-ahead' from the parent
 #define SYNC_MAX 7
+// Stack size for a spawned child; it only needs enough to get to exec
+#define SPAWN_STACK (256*1024)
+// Older headers don't know pidfd_open(2); the number is the same on all arches
+#ifndef SYS_pidfd_open
+  #define SYS_pidfd_open 434
+#endif
 
 // Statics
 extern  char** environ;
@@ -52,8 +64,10 @@ int     job::launch::_count = 0;
 struct sigaction      job::launch::_new_action;
 struct sigaction      job::launch::_old_action;
 job::launch::finmap_t job::launch::finmap;
+job::poller*          job::launch::events = NULL;
 bool                  job::launch::_sigchld_handler_set = false;
 volatile sig_atomic_t job::launch::needs_reaping        = 0;
+std::set<pid_t>       job::launch::_unwatched;
 
 // Constructor
 job::launch::launch()
@@ -62,11 +76,13 @@ job::launch::launch()
     , xstat(0)
     , niceness(0)
     , pid(0)
+    , pidfd(-1)
     , uid(0)
     , gid(0)
     , envp(NULL)
     , append(false)
     , kill_kids(false)
+    , method(FORK)
     , term_cb(NULL)
     , term_ua(NULL)
 {
@@ -84,7 +100,9 @@ job::launch::launch()
 job::launch::~launch() {
     if (state == RUN) {
         logwarn("Destroying launcher for running child %d; child now unmanaged", pid);
+        if (events) _unwatched.insert(pid);     // no pidfd will reap it now
     }
+    unwatch_child();
     finmap.erase(pid);
     --_count;
     logdebug("Removed child %d from process table", pid);
@@ -118,6 +136,7 @@ job::status job::launch::kill(const int sig) {
 //  the child won't launch the application until it has read from the pipe.
 job::status job::launch::start() {
     error = ERR_OK;
+    if (method == SPAWN) return spawn();
 
     // Pipe to sync with the child
     int sync_fd[2];
@@ -140,6 +159,12 @@ job::status job::launch::start() {
             if (err) die("child prctl(): %s", SYS_status);
         }
 
+        // Our parent may have blocked signals to take them thru a signalfd;
+        //  don't let the application inherit that.
+        sigset_t nomask;
+        sigemptyset(&nomask);
+        sigprocmask(SIG_SETMASK, &nomask, NULL);
+
         // Lets be nice and lower our priority
         //  If we can't do it (get an EPERM), keep going anyway -- ignore the return value
         if (niceness) {
@@ -227,9 +252,168 @@ SUPPRESS_DIAGNOSTIC_END
     isafe::close(sync_fd[1]);     // done with pipe
     logdebug("Child PID %d given go-ahead", pid);
 
+    watch_child();
+    return error = ERR_OK;
+}
+
+// What a spawned child needs.  It's all made ready by the parent,
+//  since the child runs on our memory and must not allocate.
+struct spawn_args {
+    const char* bin;
+    char**      argv;
+    char**      envp;
+    const char* logfile;
+    int         logflags;
+    int         niceness;
+    uid_t       uid;
+    gid_t       gid;
+    bool        set_groups;
+    const gid_t* groups;        // The user's supplementary groups
+    size_t      ngroups;
+    bool        kill_kids;
+};
+
+// Report why a spawned child can't go on, and exit.  No allocations here.
+static void spawn_fail(const char* what, const char* arg, int err) {
+    char buf[1024];
+    int n = snprintf(buf, sizeof(buf), "spawned child %s(%s): %s\n", what, arg, strerror(err));
+    if (n > 0) {
+        ssize_t ret __attribute__((unused)) = write(2, buf, n < (int)sizeof(buf) ? n : sizeof(buf)-1);
+    }
+    _exit(EXIT_FAILURE);
+}
+
+// The spawned child, up until it execs.  We're on the parent's memory
+//  (the parent is suspended until we exec or exit), so only system calls here.
+int job::launch::spawned_child(void* arg) {
+    spawn_args* sa = (spawn_args*)arg;
+
+    // Don't run any of our parent's signal handlers; then take the signals again
+    for (int sig = 1; sig < NSIG; sig++) {
+        struct sigaction act;
+        if (sigaction(sig, NULL, &act)) continue;
+        if ((act.sa_handler == SIG_DFL) || (act.sa_handler == SIG_IGN)) continue;
+        act.sa_handler = SIG_DFL;
+        act.sa_flags   = 0;
+        sigaction(sig, &act, NULL);
+    }
+    sigset_t nomask;
+    sigemptyset(&nomask);
+    sigprocmask(SIG_SETMASK, &nomask, NULL);
+
+    // Set the death signal we'll get if our parent dies
+    if (sa->kill_kids && prctl(PR_SET_PDEATHSIG, SIGKILL)) spawn_fail("prctl", "PDEATHSIG", errno);
+
+    // Lets be nice and lower our priority; ignore any failure
+    if (sa->niceness) {
+        int ret __attribute__((unused)) = nice(sa->niceness);
+    }
+
+    // Redirect stdout, stderr to the logfile
+    int logfd = open(sa->logfile, sa->logflags, S_IRUSR | S_IWUSR);
+    if (logfd < 0) spawn_fail("open", sa->logfile, errno);
+    if ((dup2(logfd, 1) < 0) || (dup2(logfd, 2) < 0)) spawn_fail("dup2", sa->logfile, errno);
+    close(logfd);
+
+    // Set our groups, then user.  Raw system calls, so it's just this task.
+    if (sa->set_groups && syscall(SYS_setgroups, sa->ngroups, sa->groups)) spawn_fail("setgroups", "", errno);
+    if (sa->gid && syscall(SYS_setgid, sa->gid)) spawn_fail("setgid", "", errno);
+    if (sa->uid && syscall(SYS_setuid, sa->uid)) spawn_fail("setuid", "", errno);
+
+    // Replace our mind with the new binary
+    execvpe(sa->bin, sa->argv, sa->envp);
+    spawn_fail("execvp*", sa->bin, errno);  // only get here on error :-(
+    return EXIT_FAILURE;
+}
+
+// Start the child with clone(CLONE_VM|CLONE_VFORK).
+//  The child shares our memory until it execs, so there's no copying
+//  of page tables, and the cost doesn't grow as we do.  We're suspended
+//  until the child execs (or fails), so we do all the prep work here.
+job::status job::launch::spawn() {
+
+    // Build the args array, from wordexp() results.  We're not yet the job's
+    //  user, so no command substitution here; fork for that, it expands in the child.
+    wordexp_t parts;
+    int wstat = wordexp(command.c_str(), &parts, WRDE_NOCMD);
+    if (wstat == WRDE_CMDSUB) {
+        logverbose("Command substitution in %s; forking it instead", command);
+        method = FORK;
+        return start();
+    }
+    if (wstat == WRDE_BADCHAR) return error.set("wordexp: bad characters in command");
+    if (wstat == WRDE_NOSPACE) return error.set("wordexp: out of memory");
+    if (wstat == WRDE_SYNTAX)  return error.set("wordexp: command syntax error");
+    if (wstat)                 return error.set(logstr("wordexp: undefined error %d", wstat));
+    if (!parts.we_wordc) {
+        wordfree(&parts);
+        return error.set("empty command");
+    }
+    std::vector<char*> argv(parts.we_wordv, parts.we_wordv + parts.we_wordc);
+    argv.push_back(NULL);
+
+    // To allow the process name to live thru the exec(), we'll put it in argv[0]
+    std::string pnm;
+    if (procname.size()) {
+        pnm = procname + ": " + argv[0];
+        argv[0] = (char*)pnm.c_str();
+    }
+
+    // The user's own supplementary groups, not ours
+    std::vector<gid_t> groups;
+    bool set_groups = uid && !geteuid();
+    if (set_groups) {
+        struct passwd* pw = getpwuid(uid);
+        int ng = 32;
+        groups.resize(ng);
+        if (pw && (getgrouplist(pw->pw_name, gid, &groups[0], &ng) < 0)) {
+            groups.resize(ng);
+            if (getgrouplist(pw->pw_name, gid, &groups[0], &ng) < 0) ng = 0;
+        }
+        groups.resize(pw ? ng : 0);
+    }
+
+    spawn_args sa;
+    sa.bin       = parts.we_wordv[0];
+    sa.argv      = &argv[0];
+    sa.envp      = envp ? envp : environ;
+    sa.logfile   = logfile.c_str();
+    sa.logflags  = O_RDWR | O_CREAT | (append ? O_APPEND : O_TRUNC);
+    sa.niceness  = niceness;
+    sa.uid       = uid;
+    sa.gid       = gid;
+    sa.set_groups = set_groups;
+    sa.groups    = groups.empty() ? NULL : &groups[0];
+    sa.ngroups   = groups.size();
+    sa.kill_kids = kill_kids;
+
+    // Block all signals, so none of our handlers run in the child on our memory
+    char* stack = new char[SPAWN_STACK];
+    sigset_t all, old;
+    sigfillset(&all);
+    sigprocmask(SIG_SETMASK, &all, &old);
+    pid = clone(spawned_child, stack + SPAWN_STACK, CLONE_VM | CLONE_VFORK | SIGCHLD, &sa);
+    int err = errno;
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    delete[] stack;
+    wordfree(&parts);
+    if (pid < 0) {
+        pid = 0;
+        return error.set("clone", job::status(err));
+    }
+
+    finmap[pid] = this;     // Add to process table
+    logdebug("Child PID %d spawned, added to process table", pid);
+    state = RUN;
+    watch_child();
     return error = ERR_OK;
 }
 
+// Parse a launch method name
+job::launch::method_t job::launch::str2method(const std::string & s) {
+    return (s == "spawn") ? SPAWN : FORK;
+}
+
 // Wait for completion, at most for the given duration.  -1 = infinite.
 //  Display optional message (with the seconds count as the only param)
 job::status job::launch::wait(const int duration,
@@ -267,54 +451,118 @@ size_t job::launch::running() {
  *  It is caught by the signal handler, but we can't do the wait in the
  *  signal handler because waitpid is not safe to call within a signal handler.
  *  So we clean up the zombies here.
+ *  If the caller takes SIGCHLD some other way (eg. a signalfd), our handler
+ *  never runs, so it must pass force=true to reap.
  */
-void job::launch::reap_zombies() {
-    if (!needs_reaping) return;
+void job::launch::reap_zombies(const bool force) {
+    if (!needs_reaping && !force) return;
 
     needs_reaping = 0;
-    logdebug("%s", __FUNCTION__);
-
     int cstat = 0;  // child status (core + signal + exit status)
+
+    // With an event loop, each child with a pidfd is reaped thru it as it
+    //  exits; look only for the few without, so as not to race those.
+    if (events) {
+        if (_unwatched.empty()) return;
+        logdebug("%s: %d unwatched", __FUNCTION__, (int)_unwatched.size());
+        std::vector<pid_t> kids(_unwatched.begin(), _unwatched.end());  // callbacks may launch more
+        for (size_t i = 0; i < kids.size(); i++) {
+            pid_t cpid = isafe::waitpid(kids[i], &cstat, WNOHANG);
+            if (cpid == 0) continue;            // still running
+            _unwatched.erase(kids[i]);
+            if (cpid > 0) _reaped(cpid, cstat);
+        }
+        return;
+    }
+
+    logdebug("%s", __FUNCTION__);
     while (pid_t cpid = isafe::waitpid(-1, &cstat, WNOHANG)) {
         if (cpid < 0) break;    // ignore, spurious signals are common
         if (cpid == 0) {
             logdebug("Skip child non-exit state change stat=%%x%x", cstat);
             continue;  // normally won't happen with pid==-1, but maybe a child is traced
         }
+        _reaped(cpid, cstat);
+    }
+}
 
-        // Look for the job::launch object that made this child
-        if (finmap.find(cpid) != finmap.end()) {
-            job::launch* pad = finmap[cpid];
+// A child was reaped: look for the job::launch object that made it
+void job::launch::_reaped(pid_t cpid, int cstat) {
+    finmap_t::iterator it = finmap.find(cpid);
+    if (it != finmap.end()) {
+        job::launch* pad = it->second;
+        pad->unwatch_child();
+        pad->finished(cstat);
+    }
+    else {
+        logwarn("Lost child %d exit with sig:stat %d:%d",
+                        cpid, WTERMSIG(cstat), WEXITSTATUS(cstat));
+    }
+}
 
-            if (WIFSIGNALED(cstat)) {
-                pad->state = FAIL;
-                pad->xsig  = WTERMSIG(cstat);
-                pad->xstat = 0;
-            }
-            else {
-                pad->state = DONE;
-                pad->xsig  = 0;
-                pad->xstat = WEXITSTATUS(cstat);
-            }
-            logdebug("Child %d exit sig:stat %d:%d", cpid, pad->xsig, pad->xstat);
-
-            // Invoke the child termination handler, if defined (it's a one shot callback)
-            callback tcb = pad->term_cb;
-            if (tcb) {
-                int ret = (tcb)(*pad, pad->term_ua, cpid, cstat);
-                if (ret != EIDRM) {
-                    pad->term_cb  = NULL;
-                    pad->term_ua  = NULL;
-                }
-            }
-        }
-        else {
-            logwarn("Lost child %d exit with sig:stat %d:%d",
-                            cpid, WTERMSIG(cstat), WEXITSTATUS(cstat));
+// Record the child's exit, and invoke the termination callback.
+//  Careful, the callback may delete us.
+void job::launch::finished(int cstat) {
+    if (WIFSIGNALED(cstat)) {
+        state = FAIL;
+        xsig  = WTERMSIG(cstat);
+        xstat = 0;
+    }
+    else {
+        state = DONE;
+        xsig  = 0;
+        xstat = WEXITSTATUS(cstat);
+    }
+    logdebug("Child %d exit sig:stat %d:%d", pid, xsig, xstat);
+
+    // Invoke the child termination handler, if defined (it's a one shot callback)
+    callback tcb = term_cb;
+    if (tcb) {
+        int ret = (tcb)(*this, term_ua, pid, cstat);
+        if (ret != EIDRM) {
+            term_cb  = NULL;
+            term_ua  = NULL;
         }
     }
 }
 
+// Watch the child thru a pidfd, if we've been given a poller
+void job::launch::watch_child() {
+    if (!events) return;
+    int fd = syscall(SYS_pidfd_open, pid, 0);   // always close-on-exec
+    if (fd < 0) {
+        logdebug("No pidfd for child %d, will reap on SIGCHLD: %s", pid, SYS_status);
+        _unwatched.insert(pid);
+        return;
+    }
+    if (events->add(fd, EPOLLIN, child_ready, this)) {
+        logdebug("Cannot watch child %d, will reap on SIGCHLD: %s", pid, events->error);
+        isafe::close(fd);
+        _unwatched.insert(pid);
+        return;
+    }
+    pidfd = fd;
+}
+
+void job::launch::unwatch_child() {
+    if (pidfd < 0) return;
+    if (events) events->remove(pidfd);
+    isafe::close(pidfd);
+    pidfd = -1;
+}
+
+// The pidfd says our child exited; reap just that one
+int job::launch::child_ready(poller & pol, int fd, uint32_t what, void* ua) {
+    launch* pad = (launch*)ua;
+    int cstat = 0;
+    pid_t cpid = isafe::waitpid(pad->pid, &cstat, WNOHANG);
+    if (cpid == 0) return 0;    // not yet
+    pad->unwatch_child();
+    if (cpid < 0) return 0;     // already reaped by reap_zombies()
+    pad->finished(cstat);
+    return 0;
+}
+
 /*! @brief Signal Handler to catch when the application (child) exits
  *  @param[in]  sig The signal that we've just caught - it should be a SIGCHLD
  *
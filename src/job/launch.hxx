@@ -23,9 +23,11 @@
     USA
 */
 
+#include "job/poller.hxx"
 #include "job/status.hxx"
 #include "job/string.hxx"
 #include <map>
+#include <set>
 #include <signal.h>
 #include <string>
 #include <sys/types.h>      // uid_t, gid_t, pid_t, etc...
@@ -43,6 +45,12 @@ class launch {
         FAIL
     };
 
+    // how the child is made
+    enum method_t {
+        FORK = 0,                       // fork(), then exec
+        SPAWN                           // clone(CLONE_VM|CLONE_VFORK), then exec; no page table copy
+    };
+
     status error;
 
     launch();
@@ -57,6 +65,7 @@ class launch {
     int         xstat;                  // exit status of child
     int         niceness;               // priority adjust (+ is lower/worse/nicer). See nice(1)(2)
     pid_t       pid;                    // my process ID
+    int         pidfd;                  // READONLY: pidfd watching the child, or -1
     uid_t       uid;                    // User ID to use for child
     gid_t       gid;                    // Group ID to use for child
     std::string logfile;                // name of our logfile
@@ -64,14 +73,19 @@ class launch {
     char**      envp;                   // environment array to pass; if null, inherits it
     bool        append;                 // append to log insted of wiping it out
     bool        kill_kids;              // ...when I die
+    method_t    method;                 // how to make the child process
 
     typedef int (*callback)(launch & pad, void* ua, pid_t cpid, int cstat);
     callback    term_cb;                // child termination callback
     void*       term_ua;                // callback user arg 
 
     static void     dump_table();       // Dump process map table - for debugging
-    static void     reap_zombies();     // Call frequently to check kids
+    static void     reap_zombies(const bool force = false);
+                                        // Call frequently to check kids; force if
+                                        //   SIGCHLD is caught elsewhere (eg. signalfd)
     static size_t   running();          // Number of NEW or RUN launched processes
+    static poller*  events;             // If set, each child is watched with a pidfd here
+    static method_t str2method(const std::string & s);
     static void     set_process_name(const std::string & name);
                                         // Set our process name.  Caller MUST set
     static int      ac;                 //      job::launch::ac = argc;
@@ -89,8 +103,18 @@ class launch {
     static struct sigaction      _old_action;
     static bool                  _sigchld_handler_set;   // current state of sigchld handler
     static volatile sig_atomic_t needs_reaping;
+    static std::set<pid_t>       _unwatched;             // children not reaped thru a pidfd, with events set
+
+    static void                  _reaped(pid_t cpid, int cstat);
 
     static void                  child_exit_handler(int sig);
+    static int                   spawned_child(void* arg);
+    static int                   child_ready(poller & pol, int fd, uint32_t what, void* ua);
+
+    status                       spawn();
+    void                         watch_child();
+    void                         unwatch_child();
+    void                         finished(int cstat);
 };
 }
 
@@ -121,6 +145,14 @@ class launch {
   termination of the child, even if the specific launch object instance
   has already been destroyed.
 
+  If the caller has an event loop, set job::launch::events to its job::poller,
+  before launching anything.
+  Each child then gets a pidfd watched by that poller, and the child is reaped
+  and its callback invoked as soon as it exits, without searching for it.
+  On kernels without pidfds, or for children whose launch object is gone,
+  reap_zombies() on SIGCHLD still does the job; it then looks only for those
+  children, so while every child has a pidfd, it does nothing at all.
+
   By default, a child process will continue to run if the parent process dies.
   To guarantee that the children will die when the parent dies for any reason,
   set the public member variable .kill_kids to true.
@@ -130,6 +162,13 @@ class launch {
   To do this, set the public member variable .envp to an array of environment strings.
   See execvpe() for details.
 
+  By default the child is made with fork().  Set .method to SPAWN to instead use
+  clone(CLONE_VM|CLONE_VFORK), where the child borrows the parent's memory until
+  it execs; its cost doesn't grow with the size of the parent, as fork()'s does.
+  The command is expanded in the parent, and the parent is suspended until the
+  child execs, so no sync pipe is needed.  The child's process name is only
+  set in argv[0] of the exec, since it cannot rewrite the shared argv space.
+
 
 @typedef typedef int(*job::launch::callback )(launch & lau, void* ua, pid_t cpid, int cstat)
   @brief Function signature for the child termination callback function.
@@ -22,28 +22,46 @@
 
 #include "job/isafe.hxx"
 #include "job/multipart.hxx"
+#include <algorithm>        // std::count
 #include <assert.h>
 #include <fcntl.h>          // open
+#include <limits.h>         // UINT_MAX
 #include <stdio.h>          // fileno etc...
+#include <poll.h>           // poll
+#include <stdlib.h>         // mkostemp
 #include <string.h>         // strncmp
+#include <sys/file.h>       // flock
+#include <sys/inotify.h>    // inotify_init1
+#include <sys/mman.h>       // mmap
+#include <sys/sendfile.h>   // sendfile
 #include <sys/stat.h>       // open
 #include <sys/types.h>      // open
 #include <unistd.h>         // read
+#ifdef __SSE2__
+  #include <emmintrin.h>    // SSE2 intrinsics
+#endif
 
 #define isid(c) (isalnum(c) || (c == '-') || (c == '_') || (c == '.'))
 #define LINE_MAXLEN 4096
 #define BOUND_MAXLEN 80
 #define FIELD_MINLEN 13
+#define MOVE_CHUNK (64*1024)
+#define FOLLOW_MSECS 1000
 
 using job::ERR_OK;
 using job::int2str;
 using job::lc;
+using job::str2int;
 
 const char* job::multipart::BODY_TAG = "__BODY__";
+bool        job::multipart::use_mmap = true;
 
 // Constructor (inherits from vector-of-map, so most of the work is done there)
 job::multipart::multipart() 
-    : closed(true) {
+    : closed(true)
+    , lazy(false)
+    , header_pad(0)
+    , resume(0) {
 }
 
 // Does a tag exist in a section?
@@ -62,6 +80,15 @@ std::string job::multipart::get(const unsigned int sec,
         ;
 }
 
+// Get an integer value, or if not present, use a default
+int job::multipart::geti(const unsigned int sec,
+                         const std::string & tag,
+                         const int dfl) {
+    return exists(sec, tag)
+        ? str2int((*this)[sec][lc(tag)])
+        : dfl;
+}
+
 // Get a random UUID
 std::string job::multipart::get_uuid() {
     int fd = isafe::open("/proc/sys/kernel/random/uuid", O_RDONLY);
@@ -74,21 +101,537 @@ std::string job::multipart::get_uuid() {
 }
 
 
-// Load a multipart file (adding to whatever is already there)
-job::status job::multipart::load(const std::string & fnam) {
-    FILE* fp = fopen(fnam.c_str(), "r");
-    if (!fp) return error.set("Cannot open " + fnam, SYS_status);
-    if (fstat(fileno(fp), &statbuf) < 0) return error.set("Cannot stat " + fnam, SYS_status);
+// Load a multipart file (adding to whatever is already there).
+//  If head_only, stop after section 0; the rest is left for load_headers() and body().
+job::status job::multipart::load(const std::string & fnam, const bool head_only) {
+    source = fnam;
+    parts.clear();
+    substatus.clear();
+    known.clear();
+    if (head_only && !index.empty()) {
+        known.fnam = index;
+        if (known.load()) known.clear();    // none, or unreadable; we'll scan
+    }
+    return scan(0, head_only ? 0 : UINT_MAX, true);
+}
+
+// Load the headers of more sections of a lazily loaded file, up thru section upto.
+//  Their bodies stay on disk; see body().
+job::status job::multipart::load_headers(const unsigned int upto) {
+    if (!lazy || (upto < parts.size())) return error = ERR_OK;
+    if (index_headers(upto)) return error;
+    return scan(resume, upto, false);
+}
+
+// Find the last sub-status line in [b, e); true if there is one
+static bool last_substatus(const char* b, const char* e, std::string & sub) {
+    for (const char* p = e; p > b; ) {
+        const char* nl = (const char*)memrchr(b, '\n', p - b);
+        const char* ls = nl ? nl+1 : b;
+        if ((p - ls >= 3) && (ls[0] == '#') && (ls[1] == '#') && (ls[2] == ' ')) {
+            sub.assign(ls+3, p);
+            return true;
+        }
+        if (!nl) break;
+        p = nl;
+    }
+    return false;
+}
+
+// Load the headers of more sections, from where the section index says they are.
+//  The index is checked against the file first: each section must follow a
+//  boundary, and after the last only the final boundary may come.  Returns
+//  false, having loaded nothing, if there's no index or it doesn't fit.
+bool job::multipart::index_headers(const unsigned int upto) {
+    size_t k = parts.size();
+    if ((known.size() <= k) || (known[k].head != resume) || boundary.empty()) return false;
+
+    int fd = isafe::open(source.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    if ((fstat(fd, &statbuf) < 0) || !statbuf.st_size) {
+        isafe::close(fd);
+        return false;
+    }
+    off_t len = statbuf.st_size;
+    const char* map = (const char*)mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    isafe::close(fd);
+    if (map == MAP_FAILED) return false;
+
+    std::string mark = "\n--" + boundary + "\n";
+    std::string tail = "--" + boundary + "--\n";
+    bool fits = true;
+    for (size_t i = k; fits && (i < known.size()); i++) {
+        const secrec & r = known[i];
+        off_t stop = (r.end >= 0) ? r.end : len;
+        fits = (r.head >= (off_t)mark.size()) && (r.head <= stop) && (stop <= len)
+            && ((r.body < 0) || ((r.body > r.head) && (r.body <= stop)))
+            && ((r.end >= 0) || ((i+1) == known.size()))
+            && !mark.compare(0, mark.size(), map + r.head - mark.size(), mark.size());
+    }
+    const secrec & z = known.back();
+    off_t fin = (z.body >= 0) ? z.end+1 : z.end;    // where the final boundary must be
+    bool ends = (z.end >= 0);
+    if (fits && ends) {
+        fits = (fin + (off_t)tail.size() == len)
+            && !tail.compare(0, tail.size(), map + fin, tail.size());
+    }
+    if (!fits) {
+        munmap((void*)map, len);
+        known.clear();
+        return false;
+    }
+
+    // Just the headers of each section
+    error = ERR_OK;
+    size_t first = k;
+    for (; (k <= upto) && (k < known.size()) && !error; k++) {
+        const secrec & r = known[k];
+        off_t hend = (r.body >= 0) ? r.body : ((r.end >= 0) ? r.end : len);
+        parse(map, hend, r.head, k, false);
+        parts[k].body = r.body;
+        parts[k].end  = (r.end >= 0) ? r.end : len;
+    }
+
+    // If we got to the end, the last sub-status is in the latest output that has one
+    lazy = !error && (k < known.size());
+    if (lazy) resume = known[k].head;
+    else {
+        closed = ends;
+        for (size_t i = parts.size(); i > first; --i) {
+            if ((parts[i-1].body >= 0)
+                    && last_substatus(map + parts[i-1].body, map + parts[i-1].end, substatus))
+                break;
+        }
+    }
+    munmap((void*)map, len);
+    return true;
+}
+
+// Parse our source file from offset 'from', with the chosen parser
+job::status job::multipart::scan(const off_t from, const unsigned int last, const bool bodies) {
+    if (!use_mmap) {
+        FILE* fp = fopen(source.c_str(), "r");
+        if (!fp) return error.set("Cannot open " + source, SYS_status);
+        if (fstat(fileno(fp), &statbuf) < 0) {
+            fclose(fp);
+            return error.set("Cannot stat " + source, SYS_status);
+        }
+        if (fseeko(fp, from, SEEK_SET) < 0) {
+            fclose(fp);
+            return error.set("Cannot seek " + source, SYS_status);
+        }
+        parse(fp, last, bodies);
+        fclose(fp);
+        return error;
+    }
+
+    int fd = isafe::open(source.c_str(), O_RDONLY);
+    if (fd < 0) return error.set("Cannot open " + source, SYS_status);
+    if (fstat(fd, &statbuf) < 0) {
+        isafe::close(fd);
+        return error.set("Cannot stat " + source, SYS_status);
+    }
+    size_t len = statbuf.st_size;
+    void*  map = NULL;
+    if (len) {
+        map = mmap(NULL, len, PROT_READ, MAP_PRIVATE | ((last == UINT_MAX) ? MAP_POPULATE : 0), fd, 0);
+        if (map == MAP_FAILED) {
+            isafe::close(fd);
+            return error.set("Cannot map " + source, SYS_status);
+        }
+        if (last == UINT_MAX) madvise(map, len, MADV_SEQUENTIAL);
+    }
+    isafe::close(fd);
+    parse((const char*)map, len, from, last, bodies);
+    if (map) munmap(map, len);
+    return error;
+}
+
+// Get a section's body, from memory if we have it, else from the file
+std::string job::multipart::body(const unsigned int sec) {
+    if ((sec < size()) && (*this)[sec].count(BODY_TAG)) return (*this)[sec][BODY_TAG];
+    load_headers(sec);
+    if ((sec >= parts.size()) || (parts[sec].body < 0)) return "";
+
+    size_t len = parts[sec].end - parts[sec].body;
+    std::string ret(len, '\0');
+    int fd = isafe::open(source.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error.set("Cannot open " + source, SYS_status);
+        return "";
+    }
+    ssize_t amt = len ? isafe::pread(fd, &ret[0], len, parts[sec].body) : 0;
+    isafe::close(fd);
+    if (amt != (ssize_t)len) {
+        error.set("Cannot read " + source, SYS_status);
+        return "";
+    }
+    return ret;
+}
+
+// Write all of buf, however many tries it takes
+static bool write_all(const int fd, const char* buf, size_t len) {
+    while (len) {
+        ssize_t n = isafe::write(fd, buf, len);
+        if (n <= 0) return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Copy infd's bytes from pos up to end onto outfd, straight from the file where
+//  we can.  pos is left where the copy stopped; short of end if infd shrank.
+static job::status copy_range(const int outfd, const int infd, off_t & pos, const off_t end) {
+    bool copy = false;      // can't sendfile() to outfd
+    while (pos < end) {
+        ssize_t n = -1;
+        if (!copy) {
+            n = sendfile(outfd, infd, &pos, end - pos);
+            if ((n < 0) && (errno == EINTR)) continue;
+            if ((n < 0) && ((errno == EINVAL) || (errno == ENOSYS))) copy = true;
+            else if (n < 0) return job::status("Cannot send", SYS_status);
+        }
+        if (copy) {
+            char buf[MOVE_CHUNK];
+            size_t want = ((end - pos) < MOVE_CHUNK) ? (end - pos) : MOVE_CHUNK;
+            n = isafe::pread(infd, buf, want, pos);
+            if ((n > 0) && !write_all(outfd, buf, n)) return job::status("Cannot write", SYS_status);
+            if (n > 0) pos += n;
+        }
+        if (n == 0) break;      // it shrank
+        if (n < 0) return job::status("Cannot read", SYS_status);
+    }
+    return job::ERR_OK;
+}
+
+// Copy part of our source file to outfd, straight from the file where we can
+job::status job::multipart::send(const int outfd, const off_t from, const off_t to) {
+    int fd = isafe::open(source.c_str(), O_RDONLY);
+    if (fd < 0) return error.set("send: Cannot open " + source, SYS_status);
+    off_t pos = from;
+    off_t end = to;
+    if (end < 0) {
+        struct stat sb;
+        end = (fstat(fd, &sb) < 0) ? 0 : sb.st_size;
+    }
+    job::status err = copy_range(outfd, fd, pos, end);
+    isafe::close(fd);
+    if (err) return error.set("send: " + source, err);
+    return error = ERR_OK;
+}
+
+// Copy a section's body to outfd, from memory if we have it, else from the file
+job::status job::multipart::send_body(const unsigned int sec, const int outfd) {
+    if ((sec < size()) && (*this)[sec].count(BODY_TAG)) {
+        const std::string & b = (*this)[sec][BODY_TAG];
+        if (!write_all(outfd, b.data(), b.size())) return error.set("send: Cannot write", SYS_status);
+        return error = ERR_OK;
+    }
+    load_headers(sec);
+    if (error) return error;
+    if ((sec >= parts.size()) || (parts[sec].body < 0)) return error = ERR_OK;
+    return send(outfd, parts[sec].body, parts[sec].end);
+}
+
+// Copy a section's body to outfd as it grows, until the boundary that ends it.
+//  Only a chunk is held at a time.  The tail of a read is held back until
+//  there's more if it could be the start of the boundary.
+job::status job::multipart::follow_body(const unsigned int sec, const int outfd) {
+    load_headers(sec);
+    if (error) return error;
+    if ((sec >= parts.size()) || (parts[sec].body < 0)) return error = ERR_OK;
+    int fd = isafe::open(source.c_str(), O_RDONLY);
+    if (fd < 0) return error.set("follow: Cannot open " + source, SYS_status);
+
+    // Watch the inode we have open, not the name, which may change
+    int ifd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (ifd >= 0) {
+        std::string self = "/proc/self/fd/" + int2str(fd);
+        if (inotify_add_watch(ifd, self.c_str(), IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF) < 0) {
+            isafe::close(ifd);
+            ifd = -1;
+        }
+    }
+
+    std::string mark = "\n--" + boundary;
+    size_t hold = mark.size() - 1;
+    off_t  pos  = parts[sec].body;
+    char   buf[MOVE_CHUNK];
+    error = ERR_OK;
+    for (;;) {
+        ssize_t n = isafe::pread(fd, buf, sizeof(buf), pos);
+        if (n < 0) {
+            error.set("follow: Cannot read " + source, SYS_status);
+            break;
+        }
+        const char* m = n ? (const char*)memmem(buf, n, mark.data(), mark.size()) : NULL;
+        size_t safe = m ? (size_t)(m - buf) : n;
+        for (size_t t = ((size_t)n > hold) ? n - hold : 0; !m && (t < (size_t)n); t++) {
+            if (!mark.compare(0, n - t, buf + t, n - t)) {
+                safe = t;       // may be the start of the boundary
+                break;
+            }
+        }
+        if (safe && !write_all(outfd, buf, safe)) {
+            error.set("follow: Cannot write", SYS_status);
+            break;
+        }
+        pos += safe;
+        if (m) break;                           // the section's done
+        if (n == (ssize_t)sizeof(buf)) continue;   // there's more now
+
+        // Wait for more, unless the file's gone
+        struct stat sb;
+        if ((fstat(fd, &sb) < 0) || !sb.st_nlink) {
+            if ((size_t)n > safe) write_all(outfd, buf + safe, n - safe);
+            break;
+        }
+        struct pollfd pfd;
+        pfd.fd     = ifd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, (ifd >= 0) ? 1 : 0, FOLLOW_MSECS) > 0) {
+            char ebuf[4096];
+            while (isafe::read(ifd, ebuf, sizeof(ebuf)) > 0) {}
+        }
+    }
+    if (ifd >= 0) isafe::close(ifd);
+    isafe::close(fd);
+    return error;
+}
+
+// Bring all of a lazily loaded file into memory, bodies and all
+job::status job::multipart::load_rest() {
+    if (parts.size() < 2) return error = ERR_OK;
+    load_headers();
+    if (error) return error;
+    for (size_t k = 1; (k < parts.size()) && (k < size()); k++) {
+        if ((*this)[k].count(BODY_TAG) || (parts[k].body < 0)) continue;
+        std::string b = body(k);
+        if (error) return error;
+        (*this)[k][BODY_TAG] = b;
+    }
+    return error = ERR_OK;
+}
+
+// Start a new section's offsets
+void job::multipart::new_part(const off_t head) {
+    part p;
+    p.head = head;
+    p.body = -1;
+    p.end  = -1;
+    parts.push_back(p);
+}
+
+// Parse a "tag: value" header line (len bytes, maybe with its \n) into section sec.
+//  Returns what's wrong with it, or NULL if it's ok.
+const char* job::multipart::parse_tag(const char* line, const size_t len, 
+                                      const unsigned int sec) {
+    size_t n  = (size_t)-1;
+    size_t t  = 0;      // start of tag
+    size_t tl = 0;      // tag length
+    size_t v  = 1;      // start of value
+    size_t w  = 0;      // end of value
+    enum {WANT_TAG, WANT_TEND, WANT_DELIM, WANT_VAL, WANT_VEND} state = WANT_TAG;
+    while (++n < len) {
+        char c = line[n];
+        if (!c || (c == '\n')) break;
+        switch (state) {
+            case WANT_TAG:
+                if (isblank(c)) continue;
+                if (!isid(c)) return "Bad tag";
+                t = n;
+                state = WANT_TEND;
+                break;
+            case WANT_TEND:
+                tl++;
+                if (isid(c)) continue;
+                if (c == ':') state = WANT_VAL;
+                else          state = WANT_DELIM;
+                break;
+            case WANT_DELIM:
+                if (isblank(c)) continue;
+                if (c != ':') return "No delimiter";
+                state = WANT_VAL;
+                break;
+            case WANT_VAL:
+                if (isblank(c)) continue;
+                v = w = n;
+                state = WANT_VEND;
+                break;
+            case WANT_VEND:
+                if (isblank(c)) continue;
+                w = n;
+                break;
+        }
+    }
+    if (state == WANT_TAG) return NULL;     // just a line with blanks, ignore it
+    if ((state == WANT_TEND) || (state == WANT_DELIM)) 
+        return "Tag with no value";
+    std::string tag(line+t, tl);
+    std::string val(line+v, w-v+1);
+    if (sec >= size()) resize(sec+1);
+    (*this)[sec][tag] = val;
+
+    if ((sec == 0)
+          && boundary.empty()
+          && (lc(tag) == "content-type")
+          && (lc(val.substr(0, 26)) == "multipart/mixed; boundary=")) {
+        boundary = val.substr(26);
+    }
+    return NULL;
+}
+
+// Find the next \n in [p, end) that's followed by a '-' or '#' -- a line that
+//  may be a boundary or a sub-status.  Returns end if there's none.
+//  Output is mostly long runs of other lines, so we look at 16 bytes at a
+//  time where we can.
+static const char* next_mark(const char* p, const char* end) {
+#ifdef __SSE2__
+    const __m128i nl   = _mm_set1_epi8('\n');
+    const __m128i dash = _mm_set1_epi8('-');
+    const __m128i hash = _mm_set1_epi8('#');
+    while (p + 17 <= end) {
+        __m128i a = _mm_loadu_si128((const __m128i*)p);
+        __m128i b = _mm_loadu_si128((const __m128i*)(p+1));
+        __m128i m = _mm_and_si128(_mm_cmpeq_epi8(a, nl),
+                                  _mm_or_si128(_mm_cmpeq_epi8(b, dash), _mm_cmpeq_epi8(b, hash)));
+        unsigned int hits = _mm_movemask_epi8(m);
+        if (hits) return p + __builtin_ctz(hits);
+        p += 16;
+    }
+#endif
+    for (; p + 1 < end; ++p) {
+        if ((*p == '\n') && ((p[1] == '-') || (p[1] == '#'))) return p;
+    }
+    return end;
+}
+
+// Is the line at p (n bytes, with its \n) a boundary?
+//  Returns 1 for one between sections, 2 for the final one, else 0.
+int job::multipart::bound_type(const char* p, const size_t n) const {
+    size_t b = boundary.size();
+    if ((n < b+3) || (p[0] != '-') || (p[1] != '-') || boundary.compare(0, b, p+2, b))
+        return 0;
+    if ((n == b+3) && (p[b+2] == '\n'))
+        return 1;
+    if ((n == b+5) && (p[b+2] == '-') && (p[b+3] == '-') && (p[b+4] == '\n'))
+        return 2;
+    return 0;
+}
+
+// Parse sections from a mapped file of len bytes, starting at offset from,
+//  which is the start of the next section.  Works as the stdio parse() does,
+//  but a body is found whole by looking for the next boundary, and copied
+//  once (if kept) instead of line by line.
+job::status job::multipart::parse(const char* map, const size_t len, const off_t from,
+                                  const unsigned int last, const bool bodies) {
+    unsigned int k   = parts.size();    // section number in the file
+    unsigned int sec = k ? size() : 0;  // where it goes in memory
+    new_part(from);
+    closed = false;
+    lazy   = false;
+    bool got_gap = false;
+    bool in_body = false;
+    bool keep    = bodies || !k;
+    size_t at = from;
+    while (at < len) {
+        const char* p  = map + at;
+        const char* nl = (const char*)memchr(p, '\n', len - at);
+        size_t n    = nl ? (size_t)(nl - p + 1) : (len - at);  // line length, with its \n
+        size_t here = at;
+        at += n;
+        if (!*p) continue;
+
+        int bt = bound_type(p, n);
+        if (bt) {
+            if (sec >= size())
+                resize(sec+1);
+            parts[k].end = in_body ? here-1 : here;     // the prior \n belongs to the boundary
+            if (bt == 2) {
+                // Done
+                closed = true;
+                return error = ERR_OK;
+            }
+
+            // Stop here for now?
+            if (k >= last) {
+                lazy   = true;
+                resume = at;
+                return error = ERR_OK;
+            }
+
+            // New section
+            got_gap = false;
+            in_body = false;
+            keep    = bodies;
+            sec = size();
+            new_part(at);
+            ++k;
+            continue;
+        }
+        if (*p == '#') continue;    // we allow comments in the header
+        if (got_gap) {
+
+            // The body runs up to the next boundary line, or the end of the file.
+            //  On the way, note any special sub-status lines; the last one counts.
+            in_body = true;
+            parts[k].body = here;
+            size_t end = len;
+            for (const char* c = map + here - 1; ; ++c) {
+                c = next_mark(c, map + len);
+                if (c + 1 >= map + len) break;
+                const char* e = (const char*)memchr(c+1, '\n', map + len - (c+1));
+                if ((c[1] == '-') && e && bound_type(c+1, e - c)) {
+                    end = c - map;
+                    break;
+                }
+                if ((c[1] == '#') && (c + 3 < map + len) && (c[2] == '#') && (c[3] == ' '))
+                    substatus.assign(c+4, e ? e : map + len);
+            }
+
+            if (sec >= size())
+                resize(sec+1);
+            if (keep) (*this)[sec][BODY_TAG].assign(map + here, end - here);
+            at = (end < len) ? end+1 : len;
+            continue;
+        }
+        if (*p == '\n') {
+            got_gap = true; 
+            continue;
+        }
+
+        // tag:value line
+        if (const char* why = parse_tag(p, n, sec)) {
+            int lnum = 1 + std::count(map, p, '\n');
+            return error.set(std::string(why) + " at line " + int2str(lnum));
+        }
+    }
+    if (parts[k].end < 0) parts[k].end = len;
+
+    return error = ERR_OK;
+}
+
+// Parse sections from fp, which is at the start of the next section of the file,
+//  until done with section 'last' or the end of the file.  Bodies of sections after
+//  the first are kept only if 'bodies'; else just where they are in the file.
+job::status job::multipart::parse(FILE* fp, const unsigned int last, const bool bodies) {
     assert(LINE_MAXLEN > (4+BOUND_MAXLEN)); // Should do a compile-time check of this, not run-time
 
+    unsigned int k   = parts.size();    // section number in the file
+    unsigned int sec = k ? size() : 0;  // where it goes in memory
+    new_part(ftello(fp));
     closed = false;
-    substatus.clear();
+    lazy   = false;
     int  lnum = 0;
     char line[LINE_MAXLEN];
     bool got_gap = false;
     bool in_body = false;
-    unsigned int sec = 0;
+    bool keep    = bodies || !k;
+    off_t at = ftello(fp);
     while (fgets(line, sizeof line, fp)) {
+        off_t here = at;
+        at = ftello(fp);
         ++lnum;
         if (!line[0]) continue;
         // "line" comparison note: we're guaranteed to have at the
@@ -110,7 +653,7 @@ job::status job::multipart::load(const std::string & fnam) {
                         // We don't have to worry about overflowing line[]
                         //  because the max boundary size is much less than
                         //  the line max; certainly at least 4 more.
-        if (end_bound) {
+        if (end_bound || mid_bound) {
 
             // The prior \n belongs to the boundary; remove it
             if (sec >= size())
@@ -121,27 +664,29 @@ job::status job::multipart::load(const std::string & fnam) {
                     (*this)[sec][BODY_TAG].resize(s-1);
                 }
             }
-
+            parts[k].end = (in_body && (here > parts[k].body)) ? here-1 : here;
+        }
+        if (end_bound) {
             // Done
             closed = true;
             break;
         }
         if (mid_bound) {
 
-            // The prior \n belongs to the boundary; remove it
-            if (sec >= size())
-                resize(sec+1);
-            if ((*this)[sec].count(BODY_TAG)) {
-                size_t s = (*this)[sec][BODY_TAG].size();
-                if (s && ((*this)[sec][BODY_TAG][s-1] == '\n')) {
-                    (*this)[sec][BODY_TAG].resize(s-1);
-                }
+            // Stop here for now?
+            if (k >= last) {
+                lazy   = true;
+                resume = at;
+                return error = ERR_OK;
             }
 
             // New section
             got_gap = false;
             in_body = false;
+            keep    = bodies;
             sec = size();
+            new_part(at);
+            ++k;
             continue;
         }
         if (in_body) {
@@ -157,16 +702,17 @@ job::status job::multipart::load(const std::string & fnam) {
 
             if (sec >= size())
                 resize(sec+1);
-            (*this)[sec][BODY_TAG].append(line);
+            if (keep) (*this)[sec][BODY_TAG].append(line);
             continue;
         }
         if (line[0] == '#') continue;   // we allow comments in the header
         if (got_gap) {
             // At start of body
             in_body = true;
+            parts[k].body = here;
             if (sec >= size())
                 resize(sec+1);
-            (*this)[sec][BODY_TAG] = line;
+            if (keep) (*this)[sec][BODY_TAG] = line;
             continue;
         }
         if (line[0] == '\n') {
@@ -175,68 +721,21 @@ job::status job::multipart::load(const std::string & fnam) {
         }
 
         // tag:value line
-        size_t n  = (size_t)-1;
-        size_t t  = 0;      // start of tag
-        size_t tl = 0;      // tag length
-        size_t v  = 1;      // start of value
-        size_t w  = 0;      // end of value
-        enum {WANT_TAG, WANT_TEND, WANT_DELIM, WANT_VAL, WANT_VEND} state = WANT_TAG;
-        while (char c = line[++n]) {
-            if (c == '\n') break;
-            switch (state) {
-                case WANT_TAG:
-                    if (isblank(c)) continue;
-                    if (!isid(c)) return error.set("Bad tag at line " + int2str(lnum));
-                    t = n;
-                    state = WANT_TEND;
-                    break;
-                case WANT_TEND:
-                    tl++;
-                    if (isid(c)) continue;
-                    if (c == ':') state = WANT_VAL;
-                    else          state = WANT_DELIM;
-                    break;
-                case WANT_DELIM:
-                    if (isblank(c)) continue;
-                    if (c != ':') return error.set("No delimiter at line " + int2str(lnum));
-                    state = WANT_VAL;
-                    break;
-                case WANT_VAL:
-                    if (isblank(c)) continue;
-                    v = w = n;
-                    state = WANT_VEND;
-                    break;
-                case WANT_VEND:
-                    if (isblank(c)) continue;
-                    w = n;
-                    break;
-            }
-        }
-        if (state == WANT_TAG) continue; // just a line with blanks, ignore it
-        if ((state == WANT_TEND) || (state == WANT_DELIM)) 
-            return error.set("Tag with no value at line " + int2str(lnum));
-        std::string tag(line+t, tl);
-        std::string val(line+v, w-v+1);
-        if (sec >= size()) resize(sec+1);
-        (*this)[sec][tag] = val;
-
-        if ((sec == 0)
-              && boundary.empty()
-              && (lc(tag) == "content-type")
-              && (lc(val.substr(0, 26)) == "multipart/mixed; boundary=")) {
-            boundary = val.substr(26);
-        }
+        if (const char* why = parse_tag(line, strlen(line), sec))
+            return error.set(std::string(why) + " at line " + int2str(lnum));
     }
+    if (parts[k].end < 0) parts[k].end = at;
 
-    fclose(fp);
     return error = ERR_OK;
 }
 
 job::status job::multipart::store(const std::string & fnam) {
+    if (load_rest()) return error;     // if we were loaded lazily
     FILE* fp = fopen(fnam.c_str(), "w");
     if (!fp) return error.set("store: Cannot create/open " + fnam, SYS_status);
 
-    std::string all_of_me = to_string();
+    std::vector<part> where;
+    std::string all_of_me = render(header_pad, &where);
     if (EOF == fputs(all_of_me.c_str(), fp))
         return error.set("store: Cannot write " + fnam, SYS_status);
 
@@ -244,42 +743,277 @@ job::status job::multipart::store(const std::string & fnam) {
         return error.set("store: Cannot stat " + fnam, SYS_status);
 
     fclose(fp);
+    if (!index.empty()) {
+        known.fnam = index;
+        known.clear();
+        for (size_t i = 0; i < where.size(); i++) {
+            secrec r;
+            r.head  = where[i].head;
+            r.body  = where[i].body;
+            r.end   = where[i].end;
+            r.tries = geti(i, "Try-Count", 0);
+            r.type  = i ? secindex::str2type(get(i, "Section")) : secindex::MAIN;
+            known.push_back(r);
+        }
+        store_index();
+    }
+    return error = ERR_OK;
+}
+
+// Write the section index; if we can't, remove it so it won't mislead
+void job::multipart::store_index() {
+    if (known.store()) known.remove();
+}
+
+// Add one section to the end of the file, without touching what's already there
+job::status job::multipart::append(const std::string & fnam, 
+                                   const unsigned int sec,
+                                   const int bodyfd) {
+    if (sec >= size()) return error.set("append: No section " + int2str(sec));
+    bool was_bound = !boundary.empty();
+    if (!was_bound) {
+        boundary = get_uuid();
+        (*this)[0]["Content-Type"] = "multipart/mixed; boundary="+boundary;
+        update_headers(fnam);
+        if (error) return error;
+    }
+
+    int fd = isafe::open(fnam.c_str(), O_RDWR | ((bodyfd < 0) ? O_APPEND : 0));
+    if (fd < 0) return error.set("append: Cannot open " + fnam, SYS_status);
+    if (fstat(fd, &statbuf) < 0) {
+        isafe::close(fd);
+        return error.set("append: Cannot stat " + fnam, SYS_status);
+    }
+
+    // If the file is closed, open up its final boundary; else start a new one
+    std::string tail = "\n--" + boundary + "--\n";
+    std::string text = "\n--" + boundary + "\n";
+    off_t bound = statbuf.st_size;      // where the boundary before our section starts
+    off_t at    = statbuf.st_size;      // where we write
+    if (was_bound && (statbuf.st_size >= (off_t)tail.size())) {
+        char buf[BOUND_MAXLEN+8];
+        ssize_t amt = isafe::pread(fd, buf, tail.size(), statbuf.st_size - tail.size());
+        if ((amt == (ssize_t)tail.size()) && !tail.compare(0, tail.size(), buf, amt)) {
+            if (ftruncate(fd, statbuf.st_size - 3) < 0) {  // 3 = "--\n"
+                isafe::close(fd);
+                return error.set("append: Cannot truncate " + fnam, SYS_status);
+            }
+            text  = "\n";
+            bound = statbuf.st_size - tail.size();
+            at    = statbuf.st_size - 3;
+        }
+    }
+
+    // The section, as to_string() would have it
+    secrec rec;
+    rec.head  = at + text.size();
+    rec.body  = -1;
+    rec.tries = geti(sec, "Try-Count", 0);
+    rec.type  = secindex::str2type(get(sec, "Section"));
+    text += headers(sec);
+    rec.end   = at + text.size() + 1;   // past the gap
+    vecmap_t::value_type::const_iterator body = (*this)[sec].find(BODY_TAG);
+    off_t more = 0;                     // the rest of the body, from bodyfd
+    struct stat sb;
+    if ((bodyfd >= 0) && !fstat(bodyfd, &sb)) more = sb.st_size;
+    if (((body != (*this)[sec].end()) && body->second.size()) || more) {
+        text += "\n";
+        rec.body = at + text.size();
+        if (body != (*this)[sec].end()) text += body->second;
+        rec.end  = at + text.size() + more;
+    }
+    std::string last;
+    if (closed && ((sec+1) == size())) last = "\n--" + boundary + "--\n";
+    else rec.end = -1;                  // it may yet grow
+
+    // The index first: readers can tell if it's ahead of the file, but not behind
+    if (!index.empty()) {
+        known.fnam = index;
+        if (known.append(rec, bound)) known.remove();
+    }
+
+    // Any body from bodyfd goes straight from it, not thru our memory
+    if (bodyfd < 0) text += last;
+    else if (lseek(fd, at, SEEK_SET) < 0) {
+        isafe::close(fd);
+        return error.set("append: Cannot seek " + fnam, SYS_status);
+    }
+    ssize_t amt = isafe::write(fd, text.c_str(), text.size());
+    if (amt != (ssize_t)text.size()) {
+        isafe::close(fd);
+        return error.set("append: Cannot write " + fnam, SYS_status);
+    }
+    if (bodyfd >= 0) {
+        off_t pos = 0;
+        job::status err = copy_range(fd, bodyfd, pos, more);
+        if (!err && (pos < more) && !index.empty()) known.remove();    // it shrank, the index is off
+        if (!err && !write_all(fd, last.data(), last.size())) err = job::status("Cannot write", SYS_status);
+        if (err) {
+            isafe::close(fd);
+            return error.set("append: " + fnam, err);
+        }
+    }
+    fstat(fd, &statbuf);
+    isafe::close(fd);
+    lazy = false;       // our sections no longer number like the file's
+    parts.clear();
+    return error = ERR_OK;
+}
+
+// Rewrite the section 0 headers in place, leaving the bodies be
+job::status job::multipart::update_headers(const std::string & fnam, int* lockfd) {
+    int fd = isafe::open(fnam.c_str(), O_RDWR);
+    if (fd < 0) return error.set("update: Cannot open " + fnam, SYS_status);
+    if (fstat(fd, &statbuf) < 0) {
+        isafe::close(fd);
+        return error.set("update: Cannot stat " + fnam, SYS_status);
+    }
+
+    // The old headers end at the first empty line, or the end of the file
+    std::string old;
+    size_t room = std::string::npos;
+    char buf[LINE_MAXLEN];
+    while (room == std::string::npos) {
+        ssize_t amt = isafe::pread(fd, buf, sizeof(buf), old.size());
+        if (amt < 0) {
+            isafe::close(fd);
+            return error.set("update: Cannot read " + fnam, SYS_status);
+        }
+        if (!amt) {
+            room = old.size();
+            break;
+        }
+        size_t from = old.size() ? old.size()-1 : 0;
+        old.append(buf, amt);
+        if (old[0] == '\n') room = 0;
+        else {
+            room = old.find("\n\n", from);
+            if (room != std::string::npos) ++room;
+        }
+    }
+
+    // Fill the old room if we fit, else write it all anew
+    std::string text = headers(0);
+    if ((text.size() != room) && (text.size() + 2 > room)) {
+        size_t grow = text.size() + (header_pad < 2 ? 2 : header_pad) - room;
+        int nfd = _replace(fnam, fd, room, text, grow, lockfd);
+        isafe::close(fd);
+        if (nfd < 0) return error;
+        if (!index.empty()) {
+            known.fnam = index;
+            if (known.shift(room, grow)) known.remove();
+        }
+        if (lockfd) *lockfd = nfd;
+        else isafe::close(nfd);
+        return error = ERR_OK;
+    }
+    if (text.size() < room) {
+        text += "#" + std::string(room - text.size() - 2, ' ') + "\n";
+    }
+    ssize_t amt = isafe::pwrite(fd, text.c_str(), text.size(), 0);
+    if (amt != (ssize_t)text.size()) {
+        isafe::close(fd);
+        return error.set("update: Cannot write " + fnam, SYS_status);
+    }
+    fstat(fd, &statbuf);
+    isafe::close(fd);
     return error = ERR_OK;
 }
 
-// Dump ourselves into a string
-std::string job::multipart::to_string() {
+// Write a new file with our section 0 headers, padded to grow past the room the
+//  old ones took, and the rest of the old one after; then put it in the old
+//  one's place.  Nothing's moved within a file that may be read meanwhile,
+//  and a crash leaves the old one whole.  If lockfd is given, the new file
+//  is flock()'d before it replaces the old, and the old lock is let go.
+//  Returns a descriptor on the new file, or -1 with error set.
+int job::multipart::_replace(const std::string & fnam, const int fd, const size_t room,
+                             const std::string & text, const size_t grow, int* lockfd) {
+    size_t slash = fnam.rfind('/');
+    std::string dir = (slash == std::string::npos) ? "" : fnam.substr(0, slash + 1);
+    std::string tmp = dir + "." + fnam.substr(dir.size()) + ".XXXXXX";  // a dot file, not a job's
+    std::vector<char> tnam(tmp.begin(), tmp.end());
+    tnam.push_back('\0');
+    int nfd = mkostemp(&tnam[0], O_CLOEXEC);
+    if (nfd < 0) {
+        error.set("update: Cannot create " + tmp, SYS_status);
+        return -1;
+    }
+    tmp = &tnam[0];
+    if (fchown(nfd, statbuf.st_uid, statbuf.st_gid)) {}     // as it was, if we may
+    fchmod(nfd, statbuf.st_mode & 07777);
+
+    std::string head = text + "#" + std::string(room + grow - text.size() - 2, ' ') + "\n";
+    off_t pos = room;
+    job::status err;
+    if (!write_all(nfd, head.data(), head.size())) err = job::status("Cannot write", SYS_status);
+    if (!err) err = copy_range(nfd, fd, pos, statbuf.st_size);
+    if (!err && lockfd && (*lockfd >= 0) && isafe::flock(nfd, LOCK_EX | LOCK_NB))
+        err = job::status("Cannot lock", SYS_status);
+    if (!err && isafe::rename(tmp.c_str(), fnam.c_str())) err = job::status("Cannot replace", SYS_status);
+    if (err) {
+        isafe::unlink(tmp.c_str());
+        isafe::close(nfd);
+        error.set("update: " + fnam, err);
+        return -1;
+    }
+    if (lockfd && (*lockfd >= 0)) isafe::close(*lockfd);
+    fstat(nfd, &statbuf);
+    return nfd;
+}
+
+// Dump ourselves into a string, as store() would with that much header_pad
+std::string job::multipart::to_string(const size_t pad) {
+    return render(pad);
+}
+
+// The "tag: value" lines of a section
+std::string job::multipart::headers(const unsigned int sec) {
+    return render_headers((*this)[sec]);
+}
+
+std::string job::multipart::render_headers(const vecmap_t::value_type & sec) {
+    std::string ret;
+    for (vecmap_t::value_type::const_iterator j = sec.begin(); j != sec.end(); ++j) {
+        if (j->first == BODY_TAG) continue;
+        // Add "tag: value\n"
+        ret += j->first + ": ";
+        for (size_t i=j->first.size(); i<FIELD_MINLEN; ++i) ret += ' '; // pad to min length
+        ret += j->second + "\n";
+    }
+    return ret;
+}
+
+// The whole file, with pad bytes of room after the section 0 headers.
+//  If where is given, it gets where each section is in it.
+std::string job::multipart::render(const size_t pad, std::vector<part>* where) {
     if ((size() > 1) && boundary.empty()) {
         boundary = get_uuid();
-//        if (!size()) resize(1);
         (*this)[0]["Content-Type"] = "multipart/mixed; boundary="+boundary;
     }
 
     std::string ret;
-    typedef std::map<std::string, std::string> umap;
     for (size_t i=0; i<size(); i++) {
+        part p;
+        p.head = ret.size();
+        p.body = -1;
         // TODO: header line (maybe - do we need this?)
-        std::string body = "";
-        for(umap::iterator j = (*this)[i].begin(); j != (*this)[i].end(); ++j) {
-            if (j->first == BODY_TAG) {
-                body = j->second;  // TODO: not very efficient!
-                continue;
-            }
-            // Add "tag: value\n"
-            ret += j->first + ": ";
-            for (size_t i=j->first.size(); i<FIELD_MINLEN; ++i) ret += ' '; // pad to min length
-            ret += j->second + "\n";
-        }
-        if (body.size()) {
+        ret += headers(i);
+        if (!i && (pad >= 2)) ret += "#" + std::string(pad-2, ' ') + "\n";
+        p.end = ret.size() + 1;             // past the gap
+        vecmap_t::value_type::const_iterator body = (*this)[i].find(BODY_TAG);
+        if ((body != (*this)[i].end()) && body->second.size()) {
             ret += "\n";
-            ret += body;
+            p.body = ret.size();
+            ret += body->second;
+            p.end = ret.size();
         }
         if (boundary.size() && (closed || (i+1) < size())) {
             ret += "\n--" + boundary;
             ret += ((i+1) == size())? "--\n" : "\n";
         }
+        else p.end = -1;                    // the last section may yet grow
+        if (where) where->push_back(p);
     }
 
     return ret;
 }
-
@@ -23,9 +23,11 @@
     USA
 */
 
+#include "job/secindex.hxx"
 #include "job/status.hxx"
 #include "job/string.hxx"
 #include <map>
+#include <stdio.h>              // FILE
 #include <string>
 #include <sys/types.h>          // stat()
 #include <sys/stat.h>           // stat()
@@ -37,13 +39,17 @@ typedef std::vector< std::map<std::string, std::string, job::caseless> > vecmap_
 class multipart : public vecmap_t {
   public:
     static const char* BODY_TAG;
+    static bool        use_mmap;    // Parse by mapping the file (default), else by stdio
 
     job::status error;
     std::string boundary;
     std::string substatus;
+    std::string index;          // Section index file kept alongside, if any; see job::secindex
     struct stat statbuf;
 
     bool        closed;         // Includes final terminating boundary
+    bool        lazy;           // Only some sections loaded, see load_headers()
+    size_t      header_pad;     // Room store() leaves after section 0 headers, for update_headers()
 
                 multipart();
 
@@ -55,14 +61,54 @@ class multipart : public vecmap_t {
     int         geti(const unsigned int sec, 
                      const std::string & tag, 
                      const int dfl);
-    job::status load(const std::string & fnam);
+    job::status load(const std::string & fnam, 
+                     const bool head_only = false);
+    job::status load_headers(const unsigned int upto = (unsigned int)-1);
+    std::string body(const unsigned int sec);
+    job::status send(const int outfd, 
+                     const off_t from = 0, 
+                     const off_t to = -1);
+    job::status send_body(const unsigned int sec, 
+                          const int outfd);
+    job::status follow_body(const unsigned int sec, 
+                            const int outfd);
     job::status store(const std::string & fnam);
+    job::status append(const std::string & fnam,
+                       const unsigned int sec,
+                       const int bodyfd = -1);
+    job::status update_headers(const std::string & fnam,
+                               int* lockfd = NULL);
 //    status      load(read_callback get_chunk,   // callback gets file data
 //                    );
-    std::string to_string();
+    std::string to_string(const size_t pad = 0);
+    static std::string render_headers(const vecmap_t::value_type & sec);
 
   private:
+    struct part {
+        off_t   head;           // Offset in the file of the section's headers
+        off_t   body;           // ...of its body, or -1 if none
+        off_t   end;            // ...of the end of its body (or headers)
+    };
+    std::vector<part> parts;    // Where each section is in the file, as far as we've parsed
+    std::string source;         // File we loaded from
+    off_t       resume;         // If lazy, where the next unparsed section starts
+    secindex    known;          // The section index as loaded, if any
+
+    job::status scan(const off_t from, const unsigned int last, const bool bodies);
+    job::status parse(FILE* fp, const unsigned int last, const bool bodies);
+    job::status parse(const char* map, const size_t len, const off_t from,
+                      const unsigned int last, const bool bodies);
+    const char* parse_tag(const char* line, const size_t len, const unsigned int sec);
+    int         bound_type(const char* p, const size_t n) const;
+    bool        index_headers(const unsigned int upto);
+    job::status load_rest();
+    void        new_part(const off_t head);
     std::string get_uuid();
+    std::string headers(const unsigned int sec);
+    std::string render(const size_t pad, std::vector<part>* where = NULL);
+    int         _replace(const std::string & fnam, const int fd, const size_t room,
+                         const std::string & text, const size_t grow, int* lockfd);
+    void        store_index();
 };
 }
 
@@ -131,11 +177,64 @@ class multipart : public vecmap_t {
  *     printf("The first body is:\n%s\n", mi[0]["__BODY__"].c_str());
  *   @endcode
  *
+ *   If head_only is set, loading stops at the end of section 0 (the
+ *   first boundary), and the object is marked lazy.  Only a few KB are read,
+ *   however big the rest of the file is.  Get the headers of later sections
+ *   with load_headers(), and their bodies with body(); those read just what's
+ *   needed, from where the sections were found in the file.
+ *
+ *   There are two parsers.  By default the file is mapped, and each body
+ *   is found whole by searching for the next boundary (memmem and memchr
+ *   are vectorized in glibc), then copied once -- or not at all, when it's
+ *   not being kept.  Set use_mmap false to read it with stdio line by line,
+ *   as was done before; both give the same results.
+ *
+ * @fn job::multipart::load_headers(const unsigned int upto)
+ *   @brief Loads the headers of more sections of a lazily loaded file.
+ *   @param upto Last section wanted; the default is all of them
+ *
+ *   Parsing resumes where it last stopped.  The bodies are passed over, not
+ *   kept, though sub-status lines in them are still noted.  When the end of
+ *   the file is reached the object is no longer lazy.  Asking for more
+ *   sections than there are is not an error; check size().
+ *
+ *   If there's a section index for the file (see below), the headers are
+ *   read from where it says they are, and the bodies aren't looked thru at
+ *   all, except from the end back to the last sub-status line.  If the index
+ *   doesn't match the file, it's ignored and the file is scanned.
+ *
+ * @fn job::multipart::body(const unsigned int sec)
+ *   @brief Returns a section's body, reading it from the file if it wasn't loaded.
+ *
+ *   Sections are numbered as in the file, so use this on an object that
+ *   only holds what was loaded from one file.  Once append() is used,
+ *   the bodies must have been loaded to be had.
+ *
+ * @fn job::multipart::send(const int outfd, const off_t from, const off_t to)
+ *   @brief Copies bytes of the file we loaded from to outfd, from up to to (or its end).
+ *
+ *   The bytes go straight from the file with sendfile(), never thru
+ *   our memory; if outfd can't take that, they're copied a chunk at a time.
+ *   Flush any stdio output to outfd first.
+ *
+ * @fn job::multipart::send_body(const unsigned int sec, const int outfd)
+ *   @brief Copies a section's body to outfd; as body() but without holding it.
+ *
+ * @fn job::multipart::follow_body(const unsigned int sec, const int outfd)
+ *   @brief Copies a section's body to outfd as it grows, until a boundary ends it.
+ *
+ *   For following a running job's output: returns once the next section
+ *   has begun (or the file is closed), or the file has been removed.
+ *   Between growths it waits on inotify, with a timeout so that files on
+ *   shares that don't notify are still followed.  The file is followed by
+ *   its inode, so it's fine if it's renamed meanwhile.
+ *
  * @fn job::multipart::store(const std::string & fnam)
  *   @brief Writes the multipart file.
  *   @param fnam File name of the multi file to create/update
  *
  *   Creates or overwrites the named multipart file with our present info.
+ *   If we were loaded lazily, the rest of the file is loaded first.
  *   Our error status will indicate success or failure and the reason(s).
  *
  *   @code
@@ -147,6 +246,48 @@ class multipart : public vecmap_t {
  *     if (mp.error) { ... do something for the error ... }
  *   @endcode
  *
+ *   If header_pad is set, a comment line of that size is written after the
+ *   section 0 headers, to leave room for update_headers().
+ *
+ *   If index is set, a job::secindex of where each section is in the file is
+ *   written there too.  append() and update_headers() keep it current, but
+ *   won't start one for a file that has none.  The index is only a help:
+ *   failing to write it is not an error, the index is just removed.
+ *
+ * @fn job::multipart::append(const std::string & fnam, const unsigned int sec, const int bodyfd)
+ *   @brief Appends one section to the end of an existing multipart file.
+ *   @param fnam   File name of the multi file to update
+ *   @param sec    Our section to append; normally the last one
+ *   @param bodyfd If given, the rest of the section's body is this file's
+ *                 contents, after any body we have; they're copied across
+ *                 with sendfile(), never held in memory.
+ *
+ *   Only the new section is written; the rest of the file isn't read or
+ *   rewritten, so this stays cheap no matter how big the file has grown.
+ *   If the file was closed, its final boundary is opened up first.  If this
+ *   is our last section and we're closed, the final boundary is written too.
+ *   If we have no boundary yet, one is made and section 0 is updated with
+ *   update_headers().
+ *
+ * @fn job::multipart::update_headers(const std::string & fnam, int* lockfd)
+ *   @brief Rewrites the section 0 headers of a multipart file.
+ *   @param fnam   File name of the multi file to update
+ *   @param lockfd A descriptor holding a flock() on the file, if any
+ *
+ *   The bodies are left alone.  If the new headers fit in the room taken by
+ *   the old ones (including any padding from store()), that's all that's
+ *   written, in place.  Otherwise a new file is written alongside (a dot
+ *   file, so it's not taken for a job), with the new headers, new padding
+ *   so the next update will fit, and the rest of the old file copied after;
+ *   then it's renamed over the old one.  Readers see the old file or the
+ *   new, never one half moved.  As that's a new inode, a lock on the old
+ *   one would be lost: given lockfd, the new file is locked before it takes
+ *   the old one's place, and *lockfd is replaced by a descriptor on it.
+ *
+ * @fn job::multipart::render_headers(const vecmap_t::value_type & sec)
+ *   @brief The "tag: value" lines of a section's headers, as they'd be written.
+ *   For those who make job files from a template, a few headers at a time.
+ *
 */
 
 #endif
@@ -0,0 +1,191 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/isafe.hxx"
+#include "job/notice.hxx"
+#include "job/path.hxx"
+#include <errno.h>              // EAGAIN
+#include <stddef.h>             // offsetof()
+#include <string.h>             // memcpy(), memset()
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>            // struct iovec
+#include <sys/un.h>
+#include <unistd.h>
+
+using job::ERR_OK;
+
+job::notice::notice(const std::string & queue)
+    : _fd(-1)
+    , _ino(0)
+    , _dir_ok(false) {
+    std::string qdir = path.jobdir + queue;
+    struct stat sb;
+    if (stat(qdir.c_str(), &sb)) {
+        error.set("Cannot find queue " + qdir, SYS_status);
+        return;
+    }
+    dir  = path.jobdir + NOTICE_DIR;
+    addr = dir + (queue.empty() ? ".spool" : queue);    // no queue is named with a dot
+    if (addr.size() >= sizeof(((struct sockaddr_un*)0)->sun_path)) {
+        error = "Notice socket name too long: " + addr;
+        addr.clear();
+    }
+}
+
+job::notice::~notice() {
+    if (_fd >= 0) {
+        struct stat sb;                 // take our socket with us, if it's still ours
+        if (!lstat(addr.c_str(), &sb) && (sb.st_ino == _ino)) isafe::unlink(addr.c_str());
+        isafe::close(_fd);
+    }
+    _fd = -1;
+}
+
+// Fill in a socket address
+static socklen_t _sockaddr(const std::string & addr, struct sockaddr_un & sa) {
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    memcpy(sa.sun_path, addr.data(), addr.size());
+    return offsetof(struct sockaddr_un, sun_path) + addr.size() + 1;
+}
+
+// Is the notice directory one that only root or we could have put a socket in?
+job::status job::notice::_check_dir() {
+    if (_dir_ok) return error = ERR_OK;
+    struct stat sb;
+    if (lstat(dir.c_str(), &sb)) return error.set("Cannot find notice directory " + dir, SYS_status);
+    if (!S_ISDIR(sb.st_mode) || (sb.st_uid && (sb.st_uid != geteuid())) || (sb.st_mode & (S_IWGRP | S_IWOTH)))
+        return error = "Notice directory " + dir + " isn't safe; it must be root's, and writable by no one else";
+    _dir_ok = true;
+    return error = ERR_OK;
+}
+
+int job::notice::listen() {
+    if (addr.empty()) return -1;
+    if (_fd >= 0) return _fd;
+    if (mkdir(dir.c_str(), 0755) && (SYS_errno != EEXIST)) {
+        error.set("Cannot make notice directory " + dir, SYS_status);
+        return -1;
+    }
+    if (_check_dir()) return -1;
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        error.set("Cannot make notice socket", SYS_status);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on));     // who sent each, for receive()
+    struct sockaddr_un sa;
+    socklen_t len = _sockaddr(addr, sa);
+    int err = bind(fd, (struct sockaddr*)&sa, len);
+    if (err && (SYS_errno == EADDRINUSE)) {
+        // Left behind by a jobman that died?  Nobody answers there, then.
+        int probe = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if ((probe >= 0) && connect(probe, (struct sockaddr*)&sa, len) && (SYS_errno == ECONNREFUSED)) {
+            isafe::unlink(addr.c_str());
+            err = bind(fd, (struct sockaddr*)&sa, len);
+        }
+        else errno = EADDRINUSE;
+        if (probe >= 0) isafe::close(probe);
+    }
+    struct stat sb;
+    if (err || chmod(addr.c_str(), 0666) || lstat(addr.c_str(), &sb)) {   // anyone may send
+        error.set("Cannot bind notice socket " + addr, SYS_status);
+        isafe::close(fd);
+        return -1;
+    }
+    _ino = sb.st_ino;
+    error = ERR_OK;
+    return _fd = fd;
+}
+
+// Drain the socket; each notice is names, one per line
+job::status job::notice::receive(stringlist & jobfiles, const bool ours_only) {
+    if (_fd < 0) return error = "Not listening for notices";
+    char buf[NOTICE_MAX + 1];
+    char cbuf[CMSG_SPACE(sizeof(struct ucred))];
+    for (;;) {
+        struct iovec iov = {buf, sizeof(buf)};
+        struct msghdr mh;
+        memset(&mh, 0, sizeof(mh));
+        mh.msg_iov        = &iov;
+        mh.msg_iovlen     = 1;
+        mh.msg_control    = cbuf;
+        mh.msg_controllen = sizeof(cbuf);
+        ssize_t amt = recvmsg(_fd, &mh, MSG_DONTWAIT);
+        if (amt < 0) {
+            if ((SYS_errno == EAGAIN) || (SYS_errno == EWOULDBLOCK)) break;
+            if (SYS_errno == EINTR) continue;
+            return error.set("Cannot read notice", SYS_status);
+        }
+        if (ours_only) {
+            struct cmsghdr* cm = CMSG_FIRSTHDR(&mh);
+            struct ucred* uc = (cm && (cm->cmsg_level == SOL_SOCKET) && (cm->cmsg_type == SCM_CREDENTIALS))
+                             ? (struct ucred*)CMSG_DATA(cm) : NULL;
+            if (!uc || (uc->uid && (uc->uid != geteuid()))) continue;
+        }
+        const char* p = buf;
+        const char* end = buf + amt;
+        while (p < end) {
+            const char* nl = (const char*)memchr(p, '\n', end - p);
+            if (!nl) nl = end;
+            if (nl > p) jobfiles.push_back(std::string(p, nl - p));
+            p = nl + 1;
+        }
+    }
+    return error = ERR_OK;
+}
+
+// Pack the basenames into as few notices as will hold them
+job::status job::notice::send(const stringlist & jobfiles) {
+    if (addr.empty()) return error;
+    if (_check_dir()) return error;
+    struct stat sb;
+    if (lstat(addr.c_str(), &sb)) return error.set("No jobman listening on " + addr, SYS_status);
+    if (!S_ISSOCK(sb.st_mode) || (sb.st_uid && (sb.st_uid != geteuid())))
+        return error = "Notice socket " + addr + " isn't a jobman's, it's uid " + int2str((int)sb.st_uid) + "'s";
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return error.set("Cannot make notice socket", SYS_status);
+    struct sockaddr_un sa;
+    socklen_t len = _sockaddr(addr, sa);
+    error = ERR_OK;
+    std::string msg;
+    for (size_t i = 0; i <= jobfiles.size(); i++) {
+        std::string nam;
+        if (i < jobfiles.size()) {
+            size_t slash = jobfiles[i].rfind('/');
+            nam = (slash == std::string::npos) ? jobfiles[i] : jobfiles[i].substr(slash + 1);
+            if (nam.empty() || (nam.size() >= NOTICE_MAX)) continue;
+        }
+        if (msg.size() && ((i == jobfiles.size()) || (msg.size() + nam.size() + 1 > NOTICE_MAX))) {
+            if (sendto(fd, msg.data(), msg.size(), MSG_DONTWAIT, (struct sockaddr*)&sa, len) < 0) {
+                error.set("Cannot send notice to " + addr, SYS_status);
+                break;
+            }
+            msg.clear();
+        }
+        if (nam.size()) msg += nam + '\n';
+    }
+    isafe::close(fd);
+    return error;
+}
@@ -0,0 +1,114 @@
+#ifndef _JOB_NOTICE_HXX_
+#define _JOB_NOTICE_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/status.hxx"
+#include "job/string.hxx"
+#include <string>
+#include <sys/types.h>      // ino_t
+
+namespace job {
+
+#define NOTICE_MAX  4096        // Most bytes of job file names sent in one notice
+#define NOTICE_DIR  ".notice/"  // Where the sockets are, in the spool
+
+class notice {
+  public:
+    status      error;
+    std::string dir;            // The directory of sockets
+    std::string addr;           // The socket's file name
+
+                notice(const std::string & queue = "");
+                ~notice();
+
+    int         listen();
+    status      receive(stringlist & jobfiles, const bool ours_only = false);
+    status      send(const stringlist & jobfiles);
+
+  private:
+    int         _fd;
+    ino_t       _ino;           // Our socket's, once bound
+    bool        _dir_ok;        // The directory's been checked
+
+    status      _check_dir();
+
+    notice(const notice &);             // not copyable
+    notice & operator=(const notice &);
+};
+}
+
+/*! @file
+@class job::notice
+  @brief Tell a queue's jobman, over a Unix socket, that jobs are pending
+
+  Each jobman listens on a datagram socket of its own, named for its queue,
+  in the spool's .notice directory (a dot name, so it's no queue).  Having put
+  jobs into pend, a submitter sends their job file names here, and the
+  jobman adds them straight to its index of pending jobs and looks for
+  work; no hunting for the jobman in /proc, no signal, no rescan.
+
+  The job files in the spool are still what counts.  A notice only says
+  where to look: the jobman takes a name only if it's a job file that's
+  in pend, so a stray (or forged) notice costs it a stat and nothing more.
+  Notices can be lost -- if there's no jobman, or it's too busy to keep up --
+  but then the jobman finds the jobs as it always has.
+
+  Whoever binds the name gets the notices, so it matters who can.  The
+  directory is made by the first jobman, and is root's (or the jobman's
+  user's, in a test root); no one else may write there.  Before sending,
+  we check that, once, and lstat() the socket: if it, or the directory,
+  isn't root's or our own user's, we don't send and say so, and mkjob
+  signals the jobman instead.  A jobman that dies leaves its socket
+  behind; the next one finds nobody answering there and takes its place.
+
+  With no queue named, it's the spool's own socket, .spool.  A jobman serving many queues takes its orders there, from
+  queman: which queues to take on, and which to let go.  Those do matter,
+  so that jobman takes them only from its own user (or root).
+
+  @code
+    job::notice nt("batch");
+    int fd = nt.listen();                   // the jobman
+    ...
+    job::stringlist todo;
+    nt.receive(todo);                       // from its poller callback
+
+    job::notice("batch").send(names);       // a submitter
+  @endcode
+
+@fn int job::notice::listen()
+  @brief Bind the queue's socket, for its jobman, making the directory if need be.
+  Returns the socket fd (non-blocking), or -1 with error set; EADDRINUSE means another
+  jobman has the queue.  It's closed, and the socket file removed, with us.
+
+@fn job::status job::notice::receive(stringlist & jobfiles, const bool ours_only)
+  @brief Append the names from all the notices waiting on the socket; doesn't block.
+  If ours_only, notices sent by other users than ours (and root) are dropped.
+
+@fn job::status job::notice::send(const stringlist & jobfiles)
+  @brief Send job file names (basenames, or paths) to the queue's jobman, as few notices
+  as will hold them.  Doesn't block; an error means the jobman didn't get them all,
+  or that the socket (or its directory) isn't root's or our user's, so none were sent.
+*/
+
+#endif
@@ -0,0 +1,229 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/base.hxx"
+#include "job/isafe.hxx"
+#include "job/log.hxx"
+#include "job/poller.hxx"
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// Max events we take from the kernel per wait
+#define MAX_EVENTS 32
+
+// Build/split the epoll user data: low half is the fd, high half the generation
+#define EV_DATA(fd, g)  (((uint64_t)(g) << 32) | (uint32_t)(fd))
+#define EV_FD(u)        ((int)(uint32_t)((u) & 0xffffffff))
+#define EV_GEN(u)       ((uint32_t)((u) >> 32))
+
+// Constructor
+job::poller::poller() : gen(0) {
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) error.set("epoll_create", SYS_status);
+}
+
+// Destructor - close what we made
+job::poller::~poller() {
+    for (handmap_t::iterator it = handlers.begin(); it != handlers.end(); it++) {
+        if (it->second.kind != FD) isafe::close(it->first);
+    }
+    if (epfd >= 0) isafe::close(epfd);
+}
+
+// Register a descriptor of the given kind
+job::status job::poller::_add(int fd, kind_t kind, uint32_t events, callback cb, void* ua) {
+    if (epfd < 0) return error = ERR_BADSTATE;
+    handler h;
+    h.kind = kind;
+    h.gen  = ++gen;
+    h.cb   = cb;
+    h.ua   = ua;
+    struct epoll_event ev;
+    ev.events   = events;
+    ev.data.u64 = EV_DATA(fd, h.gen);
+    int op = handlers.count(fd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(epfd, op, fd, &ev)) return error.set("epoll_ctl", SYS_status);
+    handlers[fd] = h;
+    return error = ERR_OK;
+}
+
+// Watch a caller's descriptor
+job::status job::poller::add(int fd, uint32_t events, callback cb, void* ua) {
+    return _add(fd, FD, events, cb, ua);
+}
+
+// Stop watching a descriptor; close it too if it's one we made
+job::status job::poller::remove(int fd) {
+    handmap_t::iterator it = handlers.find(fd);
+    if (it == handlers.end()) return error = ENOENT;
+    kind_t kind = it->second.kind;
+    handlers.erase(it);
+    int err = epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    if (kind != FD) isafe::close(fd);
+    return error = err ? SYS_status : ERR_OK;
+}
+
+// Take delivery of signals thru a signalfd
+int job::poller::signals(const sigset_t & mask, callback cb, void* ua) {
+    if (sigprocmask(SIG_BLOCK, &mask, NULL)) {
+        error.set("sigprocmask", SYS_status);
+        return -1;
+    }
+    int fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0) {
+        error.set("signalfd", SYS_status);
+        return -1;
+    }
+    if (_add(fd, SIGNALS, EPOLLIN, cb, ua)) {
+        isafe::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Make a new (disarmed) timer
+int job::poller::timer(callback cb, void* ua) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        error.set("timerfd_create", SYS_status);
+        return -1;
+    }
+    if (_add(fd, TIMER, EPOLLIN, cb, ua)) {
+        isafe::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Arm (or disarm, if msecs is 0) a timer
+job::status job::poller::arm(int tfd, unsigned int msecs, unsigned int repeat) {
+    struct itimerspec its;
+    its.it_value.tv_sec     = msecs / 1000;
+    its.it_value.tv_nsec    = (msecs % 1000) * 1000000L;
+    its.it_interval.tv_sec  = repeat / 1000;
+    its.it_interval.tv_nsec = (repeat % 1000) * 1000000L;
+    if (timerfd_settime(tfd, 0, &its, NULL)) return error.set("timerfd_settime", SYS_status);
+    return error = ERR_OK;
+}
+
+// Make the timer go off no later than msecs from now
+job::status job::poller::soon(int tfd, unsigned int msecs) {
+    struct itimerspec its;
+    if (timerfd_gettime(tfd, &its)) return error.set("timerfd_gettime", SYS_status);
+    bool armed = its.it_value.tv_sec || its.it_value.tv_nsec;
+    uint64_t left = its.it_value.tv_sec * 1000ULL + its.it_value.tv_nsec / 1000000L;
+    if (armed && (left <= msecs)) return error = ERR_OK;    // already due sooner
+    if (!msecs) msecs = 1;                                  // zero would disarm it
+    its.it_value.tv_sec  = msecs / 1000;
+    its.it_value.tv_nsec = (msecs % 1000) * 1000000L;
+    if (timerfd_settime(tfd, 0, &its, NULL)) return error.set("timerfd_settime", SYS_status);
+    return error = ERR_OK;
+}
+
+// Watch a directory for changes
+int job::poller::watch(const std::string & dir, uint32_t mask, callback cb, void* ua) {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        error.set("inotify_init", SYS_status);
+        return -1;
+    }
+    if (inotify_add_watch(fd, dir.c_str(), mask | IN_ONLYDIR) < 0) {
+        error.set("inotify_add_watch: "+dir, SYS_status);
+        isafe::close(fd);
+        return -1;
+    }
+    if (_add(fd, WATCH, EPOLLIN, cb, ua)) {
+        isafe::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Read the changes pending on a watch
+job::status job::poller::changes(int wfd, changes_t & chg) {
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    while (1) {
+        ssize_t n = isafe::read(wfd, buf, sizeof(buf));
+        if (n < 0) {
+            if (errno == EAGAIN) break;
+            return SYS_status;
+        }
+        if (!n) break;
+        for (char* p = buf; p < buf + n; ) {
+            struct inotify_event* ie = (struct inotify_event*)p;
+            chg.push_back(std::make_pair(ie->mask, std::string(ie->len ? ie->name : "")));
+            p += sizeof(struct inotify_event) + ie->len;
+        }
+    }
+    return ERR_OK;
+}
+
+// Wait for events, and dispatch them
+int job::poller::wait(int msecs) {
+    if (epfd < 0) {
+        error = ERR_BADSTATE;
+        return -1;
+    }
+    struct epoll_event evs[MAX_EVENTS];
+    int n = epoll_wait(epfd, evs, MAX_EVENTS, msecs);
+    if (n < 0) {
+        if (errno == EINTR) return 0;
+        error.set("epoll_wait", SYS_status);
+        return -1;
+    }
+
+    int calls = 0;
+    for (int i = 0; i < n; i++) {
+
+        // Look it up fresh each time; an earlier callback may have removed it
+        int fd = EV_FD(evs[i].data.u64);
+        handmap_t::iterator it = handlers.find(fd);
+        if (it == handlers.end()) continue;
+        if (it->second.gen != EV_GEN(evs[i].data.u64)) continue;
+        handler h = it->second;
+
+        if (h.kind == TIMER) {
+            uint64_t expired = 0;
+            if (isafe::read(fd, &expired, sizeof(expired)) != sizeof(expired)) continue;  // re-armed meanwhile
+            if (h.cb) h.cb(*this, fd, (uint32_t)expired, h.ua);
+            ++calls;
+        }
+        else if (h.kind == SIGNALS) {
+            struct signalfd_siginfo si;
+            while (isafe::read(fd, &si, sizeof(si)) == sizeof(si)) {
+                if (h.cb) h.cb(*this, fd, si.ssi_signo, h.ua);
+                ++calls;
+                if (!handlers.count(fd)) break;     // callback removed us
+            }
+        }
+        else {
+            if (h.cb) h.cb(*this, fd, evs[i].events, h.ua);
+            ++calls;
+        }
+    }
+    error = ERR_OK;
+    return calls;
+}
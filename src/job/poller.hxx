@@ -0,0 +1,147 @@
+#ifndef _JOB_POLLER_HXX_
+#define _JOB_POLLER_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/status.hxx"
+#include <map>
+#include <signal.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace job {
+
+class poller {
+  public:
+
+    // Event callback.  What 'what' holds depends on how the fd was added:
+    //  add()     - the epoll event mask (EPOLLIN etc)
+    //  timer()   - the number of expirations since last time
+    //  signals() - the signal number that was delivered
+    //  watch()   - the epoll event mask; use changes() to read what changed
+    typedef int (*callback)(poller & pol, int fd, uint32_t what, void* ua);
+
+    // List of (inotify mask, name) changes read from a watch
+    typedef std::vector< std::pair<uint32_t, std::string> > changes_t;
+
+    status error;
+
+    poller();
+    ~poller();
+
+    status      add(int fd, uint32_t events, callback cb, void* ua = NULL);
+    status      remove(int fd);
+    int         signals(const sigset_t & mask, callback cb, void* ua = NULL);
+    int         timer(callback cb, void* ua = NULL);
+    status      arm(int tfd, unsigned int msecs, unsigned int repeat = 0);
+    status      soon(int tfd, unsigned int msecs);
+    int         watch(const std::string & dir, uint32_t mask, callback cb, void* ua = NULL);
+    int         wait(int msecs = -1);
+
+    static status changes(int wfd, changes_t & chg);
+
+  private:
+    enum kind_t {FD, TIMER, SIGNALS, WATCH};
+    struct handler {
+        kind_t      kind;
+        uint32_t    gen;        // generation, so stale events for a reused fd are dropped
+        callback    cb;
+        void*       ua;
+    };
+    typedef std::map<int, handler> handmap_t;
+
+    int         epfd;
+    uint32_t    gen;
+    handmap_t   handlers;
+
+    status      _add(int fd, kind_t kind, uint32_t events, callback cb, void* ua);
+
+    poller(const poller &);             // no copies
+    poller & operator=(const poller &); // no assignment
+};
+}
+
+/*! @file
+@class job::poller
+  @brief Event loop - waits for descriptors, timers, signals, and directory changes
+
+  A thin wrapper around epoll(7) that dispatches each ready descriptor to
+  a callback function, along with a user arg, in the same style as the
+  job::launch termination callback.  Besides plain descriptors, it can
+  create and own three other kinds of event sources:
+
+    - timers, via timerfd(2); one-shot or repeating, in milliseconds
+    - signals, via signalfd(2); the signals are blocked so they arrive here
+    - directory watches, via inotify(7)
+
+  The poller closes the timer, signal, and watch descriptors it made when
+  they're removed or when the poller is destroyed.  Descriptors given
+  to add() belong to the caller and are never closed by us.
+
+  A callback may add or remove any descriptor, including its own, while
+  being dispatched.
+
+  @code
+    static int tick(job::poller & pol, int fd, uint32_t n, void* ua) {
+        say("Tick! (%d)", n);
+        return 0;
+    }
+     ...
+    job::poller pol;
+    int t = pol.timer(tick);
+    pol.arm(t, 1000, 1000);     // first in 1s, then every 1s
+    while (running) pol.wait();
+  @endcode
+
+@fn int job::poller::signals(const sigset_t & mask, callback cb, void* ua)
+  @brief Block the signals in mask, and deliver them thru the callback instead.
+  Returns the signalfd, or -1 on error with our error set.
+  Note that the signal mask is inherited by child processes;
+  job::launch clears it in the child before exec.
+
+@fn int job::poller::timer(callback cb, void* ua)
+  @brief Create a new timer, initially disarmed.  Returns the timer fd, or -1 on error.
+
+@fn status job::poller::arm(int tfd, unsigned int msecs, unsigned int repeat)
+  @brief Arm the timer to first fire in msecs, then every repeat msecs (0 = one shot).
+  A msecs of zero disarms the timer.
+
+@fn status job::poller::soon(int tfd, unsigned int msecs)
+  @brief Pull in a timer so it fires no later than msecs from now.
+  If it's already due sooner, it's left alone.  The repeat interval is kept.
+
+@fn int job::poller::watch(const std::string & dir, uint32_t mask, callback cb, void* ua)
+  @brief Watch a directory for the inotify events in mask.  Returns the watch fd, or -1 on error.
+
+@fn status job::poller::changes(int wfd, changes_t & chg)
+  @brief Read all pending changes from a watch fd.  Call from the watch's callback.
+  An IN_Q_OVERFLOW in the list means events were lost; rescan the directory.
+
+@fn int job::poller::wait(int msecs)
+  @brief Wait up to msecs (-1 = forever) for events and dispatch them.
+  Returns the number of callbacks made, or -1 on error (EINTR is not an error, it returns 0).
+*/
+
+#endif
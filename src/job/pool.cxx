@@ -0,0 +1,119 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/pool.hxx"
+#include <unistd.h>             // sysconf()
+
+using job::ERR_OK;
+
+job::pool::pool(const size_t nthreads)
+    : nthreads(nthreads ? nthreads : ncpus()) {
+}
+
+size_t job::pool::ncpus() {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? n : 1;
+}
+
+// Take tasks in turn until there's none left
+void* job::pool::_worker(void* arg) {
+    pool* p = (pool*)arg;
+    pthread_mutex_lock(&p->_mtx);
+    for (;;) {
+        while ((p->_next < p->_ntasks) && (p->_next >= p->_limit))
+            pthread_cond_wait(&p->_cv, &p->_mtx);   // too far ahead; wait for the orderer
+        if (p->_next >= p->_ntasks) break;
+        size_t i = p->_next++;
+        pthread_mutex_unlock(&p->_mtx);
+        (p->_work)(i, p->_ua);
+        pthread_mutex_lock(&p->_mtx);
+        p->_done[i] = 1;
+        pthread_cond_broadcast(&p->_cv);
+    }
+    pthread_mutex_unlock(&p->_mtx);
+    return NULL;
+}
+
+job::status job::pool::run(const size_t ntasks,
+                           taskfunc work,
+                           taskfunc ordered,
+                           void* ua,
+                           const size_t window) {
+
+    // One thread?  Then just do it all here
+    if ((nthreads <= 1) || (ntasks <= 1)) {
+        for (size_t i = 0; i < ntasks; i++) {
+            work(i, ua);
+            if (ordered) ordered(i, ua);
+        }
+        return error = ERR_OK;
+    }
+
+    _work   = work;
+    _ua     = ua;
+    _ntasks = ntasks;
+    _next   = 0;
+    _window = (ordered && window) ? window : ntasks;
+    _limit  = _window;
+    _done.assign(ntasks, 0);
+    pthread_mutex_init(&_mtx, NULL);
+    pthread_cond_init(&_cv, NULL);
+
+    // Start the workers
+    size_t n = (nthreads < ntasks) ? nthreads : ntasks;
+    std::vector<pthread_t> tids;
+    error = ERR_OK;
+    for (size_t t = 0; t < n; t++) {
+        pthread_t tid;
+        int rc = pthread_create(&tid, NULL, _worker, this);
+        if (rc) {
+            error.set("Cannot start thread", status(rc));
+            break;
+        }
+        tids.push_back(tid);
+    }
+    if (tids.empty()) {
+        for (size_t i = 0; i < ntasks; i++) {   // no threads at all; do it ourselves
+            work(i, ua);
+            if (ordered) ordered(i, ua);
+        }
+    }
+
+    // Hand each task on in order as it's done, letting the workers go further
+    else if (ordered) {
+        pthread_mutex_lock(&_mtx);
+        for (size_t i = 0; i < ntasks; i++) {
+            while (!_done[i]) pthread_cond_wait(&_cv, &_mtx);
+            pthread_mutex_unlock(&_mtx);
+            ordered(i, ua);
+            pthread_mutex_lock(&_mtx);
+            _limit = i + 1 + _window;
+            pthread_cond_broadcast(&_cv);
+        }
+        pthread_mutex_unlock(&_mtx);
+    }
+
+    for (size_t t = 0; t < tids.size(); t++) pthread_join(tids[t], NULL);
+    pthread_cond_destroy(&_cv);
+    pthread_mutex_destroy(&_mtx);
+    return tids.empty() ? error : (error = ERR_OK);
+}
@@ -0,0 +1,97 @@
+#ifndef _JOB_POOL_HXX_
+#define _JOB_POOL_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/status.hxx"
+#include <pthread.h>
+#include <stddef.h>
+#include <vector>
+
+namespace job {
+
+class pool {
+  public:
+    typedef void (*taskfunc)(const size_t i, void* ua);
+
+    status      error;
+    size_t      nthreads;       // How many worker threads to run tasks with
+
+                pool(const size_t nthreads = 0);
+
+    status      run(const size_t ntasks,
+                    taskfunc work,
+                    taskfunc ordered = NULL,
+                    void* ua = NULL,
+                    const size_t window = 0);
+
+    static size_t   ncpus();
+
+  private:
+    taskfunc            _work;
+    void*               _ua;
+    size_t              _ntasks;
+    size_t              _next;      // Next task to be taken by a worker
+    size_t              _limit;     // ...which may not go past this one
+    size_t              _window;
+    std::vector<char>   _done;
+    pthread_mutex_t     _mtx;
+    pthread_cond_t      _cv;
+
+    static void*        _worker(void* arg);
+};
+}
+
+/*! @file
+@class job::pool
+  @brief A few threads to work thru a numbered list of tasks, in parallel
+
+  Tasks are numbered 0 to ntasks-1 and are taken by the worker threads in
+  that order, though they may finish in any order.  If an ordered callback
+  is given, run() calls it in the calling thread for each task, in task
+  order, as soon as that task and all before it are done; so results made
+  in parallel can be put out in sequence as they come, without waiting for
+  all of them.  With a window, the workers never get more than that many
+  tasks ahead of the ordered callback, which bounds what's held waiting.
+
+  The work function is called from the worker threads, and must only touch
+  what's its own (its task's slot in some table, say) or what's read-only.
+  With no more than one thread, the tasks are just run one after another
+  in the calling thread.
+
+  @code
+    job::pool p(job::pool::ncpus());
+    p.run(dirs.size(), list_dir, print_dir, &dirs, 16);
+    if (p.error) quit(p.error);
+  @endcode
+
+@fn job::status job::pool::run(const size_t ntasks, taskfunc work, taskfunc ordered, void* ua, const size_t window)
+  @brief Run the work function for each task 0..ntasks-1 across the threads,
+  and the ordered function (if any) for each in order as they're done.  Returns
+  when all are done.  The threads are started for the run and stopped after it.
+
+@fn size_t job::pool::ncpus()
+  @brief The number of CPUs online, at least 1.
+*/
+
+#endif
@@ -23,7 +23,6 @@
 #include "job/log.hxx"
 #include "job/path.hxx"
 #include "job/queue.hxx"
-#include <stdio.h>          // sscanf()
 #include <stdlib.h>         // free()
 #include <sys/stat.h>       // stat()
 #include <sys/types.h>      // stat()
@@ -61,37 +60,42 @@ bool job::queue::exists() {
     return false;
 }
 
-std::string job::queue::time_limit;
-int job::queue::time_filter(const struct dirent* d) {
-    return d->d_name <= time_limit;
-}
-
 string job::queue::dir_path(const state_t s) const {
     return path.jobdir + qname + "/" + state2str(s) + "/";
 }
 
 // Return a list of jobfiles in the given state, with a runtime at or earlier than given,
-//  and return it in sorted order (priority, time, etc)...  No quantity limit, you get 'em all!
+//  and return it in sorted order (time, priority, etc)...  No quantity limit, you get 'em all!
 job::stringlist job::queue::get_jobs_by_state(state_t s, time_t t) {
     stringlist jobfiles;
-    struct dirent** namelist;
-    if (t) time_limit = "t" + int2str(t) + ".zzz";  // zzz ensures equal times pass compare
-                                                    // because the filename parts after this vary
+    keylist_t  keys;
+    if (get_keys_by_state(s, keys, t)) return jobfiles;
     string qdir = dir_path(s);
-    int n = scandir(qdir.c_str(), &namelist, t? time_filter : NULL, alphasort);
-    if (n < 0) {
-        error.set("scandir", SYS_errno);
-        return jobfiles;
-        }
-    for (int i=0; i<n; i++) {
-        if (namelist[i]->d_name[0] != '.')
-            jobfiles.push_back(qdir + namelist[i]->d_name);
-        free(namelist[i]);
+    jobfiles.reserve(keys.size());
+    for (size_t i=0; i<keys.size(); i++) {
+        jobfiles.push_back(qdir + keys[i].name());
     }
-    free(namelist);
     return jobfiles;
 }
 
+// Same as the above, but only the keys
+job::status job::queue::get_keys_by_state(state_t s, keylist_t & keys, time_t t) {
+    keys.clear();
+    string qdir = dir_path(s);
+    DIR* dirp = opendir(qdir.c_str());
+    if (!dirp) return error.set("opendir: "+qdir, SYS_errno);
+    struct dirent* d = NULL;
+    jobkey k;
+    while ((d = readdir(dirp))) {
+        if (!k.parse(d->d_name)) continue;      // dot files, junk, etc
+        if (t && (k.run_time > t)) continue;
+        keys.push_back(k);
+    }
+    closedir(dirp);
+    jobkey::sort(keys);
+    return error = ERR_OK;
+}
+
 // Get the states of all the jobs in the state map
 job::status job::queue::get_states_of_jobs(statemap_t & smap) {
 
@@ -103,92 +107,87 @@ job::status job::queue::get_states_of_jobs(statemap_t & smap) {
     }
 
     // Go thru all states, until we have all the requested jobs
-    ggot = 0;
+    size_t got = 0;
     size_t numwant = smap.size();
-    gpsmap = &smap;
     for (int s = job::hold; s <= job::done; ++s) {
-        if (ggot >= numwant) break;
-        gstate = (state_t)s;
-        struct dirent** namelist;
-        std::string qdir = dir_path(gstate);
-        int n = scandir(qdir.c_str(), &namelist, state_scanner, NULL);
-        if (n < 0) return error.set("scandir("+qdir+")", SYS_errno);
-        if (n > 0) return error.set("get_states_of_jobs: unexpected scandir() list");
-    }
-    return ERR_OK;
-}
-
-    // job match function for the above
-    size_t                  job::queue::ggot = 0;
-    job::state_t            job::queue::gstate;
-    job::queue::statemap_t* job::queue::gpsmap = NULL;
-    int job::queue::state_scanner(const struct dirent* d) {
-
-        // Parse-out the job ID from the file name
-        time_t      run_time;
-        int         priority;
-        id_t        id;
-        std::string submitter;
-        status e = job::file::parse(d->d_name, run_time, priority, id, submitter);
-        if (e) return 0;
-
-        // Interested in this ID?  Then store it's state
-        if (gpsmap->count(id)) {
-            ++ggot;
-            (*gpsmap)[id] = gstate;
+        if (got >= numwant) break;
+        if (s == job::kill) continue;   // not a state, just kill files
+        std::string qdir = dir_path((state_t)s);
+        DIR* dirp = opendir(qdir.c_str());
+        if (!dirp) return error.set("opendir("+qdir+")", SYS_errno);
+        struct dirent* d = NULL;
+        jobkey k;
+        while ((d = readdir(dirp))) {
+            if (!k.parse(d->d_name)) continue;
+
+            // Interested in this ID?  Then store it's state
+            statemap_t::iterator it = smap.find(k.id);
+            if (it == smap.end()) continue;
+            it->second = (state_t)s;
+            ++got;
         }
-        return 0;   // always, we just want the side-effect of calling this function
+        closedir(dirp);
     }
+    return error = ERR_OK;
+}
 
 // Calls the supplied callback function for every job in the queue.
 //  This can be used, for example, to find all jobs with userargs
 //  that match a some list.  The callback function would manage the
 //  building of the list, in this case.
 //  Callback profile: int scanfunc(const job::file & jf, void* ua);
-// TODO: add bitmask or set for the states to scan; I imagine we often want
-//  to ignore done jobs, or just check running jobs, etc.
-static job::queue::scanfunc _sf;
-static bool                 _sfdone;
-static void*                _ua;
-static string               _qdir;
+struct scan_ctx {
+    job::queue::scanfunc sf;
+    void*                ua;
+    bool                 full_load;
+};
+
+    // callback function for the below - make the job::file for the user's callback
+    static int _file_scanner(const job::queue & q, const job::jobkey & k, job::state_t s, void* ua) {
+        scan_ctx* ctx = (scan_ctx*)ua;
+        job::file jf(q.dir_path(s) + k.name());
+        if (jf.error) return 1; // skip
+        if (ctx->full_load) jf.load();
+        return (ctx->sf)(jf, ctx->ua);
+    }
+
 job::status job::queue::scan_queue(
         scanfunc sf, 
         void* ua, 
         unsigned int statemask, 
         bool full_load
 ) {
-    // Save for scandir()'s callback's use
-    _ua     = ua;
-    _sf     = sf;
-    _sfdone = false;
+    scan_ctx ctx;
+    ctx.sf        = sf;
+    ctx.ua        = ua;
+    ctx.full_load = full_load;
+    return scan_keys(_file_scanner, &ctx, statemask);
+}
 
+// Calls the supplied callback with the key of every job in the queue
+//  (of the states in the mask), while the callback returns non-zero.
+job::status job::queue::scan_keys(
+        keyfunc kf,
+        void* ua,
+        unsigned int statemask
+) {
     // For each state...
     for (int s = job::hold; s <= job::done; ++s) {
 
-        if (!(statemask && (1<<s))) continue;
-        state_t st = (state_t)s;
-        _qdir   = dir_path(st);
-
-        struct dirent** namelist;
-        std::string qdir = dir_path(st);
-        int n = scandir(qdir.c_str(), &namelist, cb_scanner, NULL);
-        if (n < 0) return error.set("scandir", SYS_errno);
-        if (n > 0) return error.set("get_states_of_jobs: unexpected scandir() list");
-        if (_sfdone) break;
+        if (!(statemask & (1<<s))) continue;
+        if (s == job::kill) continue;   // not a state, just kill files
+        std::string qdir = dir_path((state_t)s);
+        DIR* dirp = opendir(qdir.c_str());
+        if (!dirp) return error.set("opendir("+qdir+")", SYS_errno);
+        struct dirent* d = NULL;
+        jobkey k;
+        bool done = false;
+        while (!done && (d = readdir(dirp))) {
+            if (!k.parse(d->d_name)) continue;
+            done = !(kf)(*this, k, (state_t)s, ua);
+        }
+        closedir(dirp);
+        if (done) break;
     }
-    return ERR_OK;
+    return error = ERR_OK;
 }
-
-    // callback function for the above
-    int job::queue::cb_scanner(const struct dirent* d) {
-
-        // Call the user's callback from within _this_ callback
-        std::string fullpath = _qdir + d->d_name;
-        job::file jf(fullpath);
-        if (jf.error) return 0; // skip
-        int ret = (_sf)(jf, _ua);
-        if (!ret) _sfdone = true;
-        return 0;   // always
-    }
-
-
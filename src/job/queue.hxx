@@ -24,6 +24,7 @@
 */
 
 #include "job/file.hxx"
+#include "job/jobkey.hxx"
 #include "job/string.hxx"
 #include <dirent.h>         // scandir, alphasort
 #include <map>
@@ -50,6 +51,9 @@ class queue {
     // List of job files with state=s in the queue; if t given, must be <= t
     stringlist  get_jobs_by_state(state_t s, time_t t = 0);
 
+    // Same, but just the keys; sorted in file name order (time, priority, id)
+    status      get_keys_by_state(state_t s, keylist_t & keys, time_t t = 0);
+
     // Fill in the state for each job in the given statemap
     typedef     std::map<job::id_t, job::state_t> statemap_t;
     status      get_states_of_jobs(statemap_t & smap);
@@ -66,21 +70,15 @@ class queue {
                            unsigned int statemask = -1, 
                            bool full_load = false);
 
+    // Like scan_queue(), but passes just the job's key and state; much faster.
+    typedef     int (*keyfunc)(const queue & q, const jobkey & k, state_t s, void* ua);
+    status      scan_keys(keyfunc kf,
+                          void* ua = NULL,
+                          unsigned int statemask = -1);
+
     // return the directory path for this state
     string      dir_path(const state_t s) const;
 
-  private:
-
-    // Callback functions and related globals for scandir() use within
-    static string time_limit;                           // for time_filter()
-    static int    time_filter(const struct dirent* d);  // for scandir() filtering by time
-
-    static size_t      ggot;                            // for job_scanner(), global counter
-    static state_t     gstate;                          // for job_scanner(), global state var
-    static statemap_t* gpsmap;                          // for job_scanner(), global ptr to smap
-    static int    state_scanner(const struct dirent* d);  // for scandir() to match job id's
-    static int    cb_scanner(const struct dirent* d);   // for scandir() to match job id's
-
 };
 }
 
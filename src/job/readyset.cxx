@@ -0,0 +1,127 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/log.hxx"
+#include "job/readyset.hxx"
+#include <dirent.h>         // opendir(), readdir()
+
+job::readyset::readyset(const std::string & dir)
+    : dir(dir) {
+}
+
+// Read all the job file names in the directory
+job::status job::readyset::scan(waiting_t & all) {
+    DIR* dirp = opendir(dir.c_str());
+    if (!dirp) return error.set("opendir: "+dir, SYS_status);
+    struct dirent* d = NULL;
+    jobkey k;
+    while ((d = readdir(dirp))) {
+        if (k.parse(d->d_name)) all.insert(k);
+    }
+    closedir(dirp);
+    return error = ERR_OK;
+}
+
+// Load the index from scratch.  Everything starts as waiting;
+//  next() promotes what's eligible.
+job::status job::readyset::seed() {
+    waiting_t all;
+    if (scan(all)) return error;
+    ready.clear();
+    waiting.swap(all);
+    logverbose("Indexed %d pending jobs in %s", waiting.size(), dir);
+    return error = ERR_OK;
+}
+
+// Bring the index in line with what's really in the directory
+job::status job::readyset::reconcile() {
+    waiting_t disk;
+    if (scan(disk)) return error;
+
+    size_t dropped = 0;
+    for (ready_t::iterator it = ready.begin(); it != ready.end(); ) {
+        if (disk.count(*it)) ++it;
+        else { ready.erase(it++); ++dropped; }
+    }
+    for (waiting_t::iterator it = waiting.begin(); it != waiting.end(); ) {
+        if (disk.count(*it)) ++it;
+        else { waiting.erase(it++); ++dropped; }
+    }
+    size_t added = 0;
+    for (waiting_t::iterator it = disk.begin(); it != disk.end(); ++it) {
+        if (ready.count(*it) || waiting.count(*it)) continue;
+        waiting.insert(*it);
+        ++added;
+    }
+    if (added || dropped)
+        logverbose("Pending index for %s was off: %d added, %d dropped", dir, added, dropped);
+    return error = ERR_OK;
+}
+
+// A job file arrived
+bool job::readyset::add(const std::string & fnam) {
+    jobkey k;
+    if (!k.parse(fnam.c_str())) return false;
+    if (ready.count(k)) return false;
+    return waiting.insert(k).second;
+}
+
+// A job file left
+bool job::readyset::drop(const std::string & fnam) {
+    jobkey k;
+    if (!k.parse(fnam.c_str())) return false;
+    return ready.erase(k) || waiting.erase(k);
+}
+
+// Move jobs whose time has come to the ready set
+void job::readyset::promote(time_t now) {
+    while (!waiting.empty() && (waiting.begin()->run_time <= now)) {
+        ready.insert(*waiting.begin());
+        waiting.erase(waiting.begin());
+    }
+}
+
+// Take the best n jobs that may run now
+size_t job::readyset::next(time_t now, size_t n, stringlist & jobfiles) {
+    promote(now);
+    size_t got = 0;
+    while ((got < n) && !ready.empty()) {
+        jobfiles.push_back(dir + ready.begin()->name());
+        ready.erase(ready.begin());
+        ++got;
+    }
+    return got;
+}
+
+// When the soonest future job becomes eligible
+time_t job::readyset::due() const {
+    return waiting.empty() ? 0 : waiting.begin()->run_time;
+}
+
+size_t job::readyset::size() const {
+    return ready.size() + waiting.size();
+}
+
+size_t job::readyset::eligible(time_t now) {
+    promote(now);
+    return ready.size();
+}
@@ -0,0 +1,102 @@
+#ifndef _JOB_READYSET_HXX_
+#define _JOB_READYSET_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/jobkey.hxx"
+#include "job/status.hxx"
+#include "job/string.hxx"
+#include <set>
+#include <string>
+#include <time.h>
+
+namespace job {
+
+class readyset {
+  public:
+    status error;
+
+    readyset(const std::string & dir);
+
+    status      seed();                             // (Re)load from the directory
+    status      reconcile();                        // Check against the directory, fix any drift
+    bool        add(const std::string & fnam);      // A job file arrived
+    bool        drop(const std::string & fnam);     // A job file left
+    size_t      next(time_t now, size_t n, stringlist & jobfiles);
+    time_t      due() const;                        // When the next future job becomes eligible
+    size_t      size() const;
+    size_t      eligible(time_t now);
+
+  private:
+    typedef std::set<jobkey, jobkey::by_prio> ready_t;      // best first
+    typedef std::set<jobkey, jobkey::by_time> waiting_t;    // soonest first
+
+    std::string dir;        // the pending directory
+    ready_t     ready;      // eligible to run now
+    waiting_t   waiting;    // not yet eligible; run time in the future
+
+    status      scan(waiting_t & all);
+    void        promote(time_t now);
+};
+}
+
+/*! @file
+@class job::readyset
+  @brief In-memory index of a queue's pending jobs, best first
+
+  Keeps the pending jobs of one queue ordered by priority and run time,
+  so that the job manager can pick the next N jobs to run in O(N log n),
+  without rescanning and resorting the pending directory each time.
+
+  The index is seeded once from the directory, then kept current with
+  add() and drop() as job files arrive and leave (typically from inotify
+  events).  Since events can be lost, or files changed by other nodes
+  sharing the spool, call reconcile() now and then to check the index
+  against the directory.
+
+  Jobs whose run time is still in the future are held aside by time,
+  and become eligible as the clock passes them.  Use due() to learn
+  when the next one will.
+
+  Only the job file names are kept; the files themselves aren't read.
+
+  @code
+    job::readyset rs(q.dir_path(job::pend));
+    rs.seed();
+     ...
+    job::stringlist todo;
+    rs.next(time(NULL), 5, todo);   // up to five jobs, best first
+  @endcode
+
+@fn size_t job::readyset::next(time_t now, size_t n, stringlist & jobfiles)
+  @brief Take up to n eligible jobs, best first, and append their full paths to jobfiles.
+  They are removed from the index.  Returns how many were taken.
+
+@fn time_t job::readyset::due() const
+  @brief Returns the run time of the soonest future job, or 0 if none are waiting.
+
+@fn size_t job::readyset::eligible(time_t now)
+  @brief Returns the number of jobs eligible to run now.
+*/
+
+#endif
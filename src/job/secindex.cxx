@@ -0,0 +1,155 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/isafe.hxx"
+#include "job/secindex.hxx"
+#include "job/string.hxx"
+#include <sys/stat.h>
+#include <unistd.h>
+
+using job::ERR_OK;
+
+job::secindex::secindex(const std::string & fnam)
+    : fnam(fnam) {
+}
+
+job::secindex::type_t job::secindex::str2type(const std::string & s) {
+    if (s.empty())     return MAIN;
+    if (s == "output") return OUTPUT;
+    if (s == "result") return RESULT;
+    return OTHER;
+}
+
+job::status job::secindex::load() {
+    clear();
+    int fd = isafe::open(fnam.c_str(), O_RDONLY);
+    if (fd < 0) return error.set("Cannot open " + fnam, SYS_status);
+    struct stat sb;
+    if (fstat(fd, &sb) < 0) {
+        isafe::close(fd);
+        return error.set("Cannot stat " + fnam, SYS_status);
+    }
+    size_t n = sb.st_size / sizeof(secrec);
+    if (n) {
+        resize(n);
+        ssize_t amt = isafe::pread(fd, &(*this)[0], n * sizeof(secrec), 0);
+        if (amt != (ssize_t)(n * sizeof(secrec))) {
+            clear();
+            isafe::close(fd);
+            return error.set("Cannot read " + fnam, SYS_status);
+        }
+    }
+    isafe::close(fd);
+    return error = ERR_OK;
+}
+
+// Write the whole index anew
+job::status job::secindex::store() {
+    std::string tmp = fnam + ".new";
+    int fd = isafe::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0660);
+    if (fd < 0) return error.set("Cannot create " + tmp, SYS_status);
+    size_t len = size() * sizeof(secrec);
+    ssize_t amt = len ? isafe::write(fd, &(*this)[0], len) : 0;
+    if (amt != (ssize_t)len) {
+        isafe::close(fd);
+        isafe::unlink(tmp.c_str());
+        return error.set("Cannot write " + tmp, SYS_status);
+    }
+    isafe::close(fd);
+    if (isafe::rename(tmp.c_str(), fnam.c_str())) {
+        isafe::unlink(tmp.c_str());
+        return error.set("Cannot rename " + tmp, SYS_status);
+    }
+    return error = ERR_OK;
+}
+
+// Close off the last record at the boundary, and add one after it
+job::status job::secindex::append(const secrec & rec, const int64_t bound) {
+    int fd = isafe::open(fnam.c_str(), O_RDWR);
+    if (fd < 0) {
+        if (SYS_errno == ENOENT) return error = ERR_OK;     // no index, that's ok
+        return error.set("Cannot open " + fnam, SYS_status);
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) < 0) {
+        isafe::close(fd);
+        return error.set("Cannot stat " + fnam, SYS_status);
+    }
+    off_t at = (sb.st_size / sizeof(secrec)) * sizeof(secrec);
+    if (at) {
+        secrec last;
+        off_t lat = at - sizeof(secrec);
+        if (isafe::pread(fd, &last, sizeof(last), lat) != (ssize_t)sizeof(last)) {
+            isafe::close(fd);
+            return error.set("Cannot read " + fnam, SYS_status);
+        }
+        if (last.end < 0) {
+            last.end = (last.body >= 0) ? bound : bound+1;  // the \n is the body's, else the gap's
+            if (isafe::pwrite(fd, &last, sizeof(last), lat) != (ssize_t)sizeof(last)) {
+                isafe::close(fd);
+                return error.set("Cannot update " + fnam, SYS_status);
+            }
+        }
+    }
+    if (isafe::pwrite(fd, &rec, sizeof(rec), at) != (ssize_t)sizeof(rec)) {
+        isafe::close(fd);
+        return error.set("Cannot append to " + fnam, SYS_status);
+    }
+    isafe::close(fd);
+    return error = ERR_OK;
+}
+
+// Move the offsets at or past from
+job::status job::secindex::shift(const int64_t from, const int64_t by) {
+    load();
+    if (error) {
+        if (SYS_errno == ENOENT) return error = ERR_OK;     // no index, that's ok
+        return error;
+    }
+    int fd = isafe::open(fnam.c_str(), O_RDWR);
+    if (fd < 0) return error.set("Cannot open " + fnam, SYS_status);
+    for (size_t i = 0; i < size(); i++) {
+        secrec & r = (*this)[i];
+        if (r.head >= from) r.head += by;
+        if (r.body >= from) r.body += by;
+        if (r.end  >= from) r.end  += by;
+    }
+    size_t len = size() * sizeof(secrec);
+    ssize_t amt = len ? isafe::pwrite(fd, &(*this)[0], len, 0) : 0;
+    isafe::close(fd);
+    if (amt != (ssize_t)len) return error.set("Cannot update " + fnam, SYS_status);
+    return error = ERR_OK;
+}
+
+job::status job::secindex::remove() {
+    if (isafe::unlink(fnam.c_str()) && (SYS_errno != ENOENT))
+        return error.set("Cannot remove " + fnam, SYS_status);
+    return error = ERR_OK;
+}
+
+int job::secindex::find(const type_t type, const int tries) const {
+    for (int i = (int)size() - 1; i >= 0; --i) {
+        const secrec & r = (*this)[i];
+        if ((r.type == type) && (!tries || (r.tries == tries))) return i;
+    }
+    return -1;
+}
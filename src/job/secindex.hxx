@@ -0,0 +1,90 @@
+#ifndef _JOB_SECINDEX_HXX_
+#define _JOB_SECINDEX_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/status.hxx"
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace job {
+
+struct secrec {             // One section of a multipart file; 32 bytes on disk
+    int64_t     head;       // Offset of the section's headers
+    int64_t     body;       // ...of its body, or -1 if none
+    int64_t     end;        // ...of the end of its body (or headers); -1 while still growing
+    int32_t     tries;      // Its Try-Count, or 0
+    int32_t     type;       // What kind of section; see secindex::type_t
+};
+
+class secindex : public std::vector<secrec> {
+  public:
+    enum type_t {MAIN = 0, OUTPUT, RESULT, OTHER};
+
+    status      error;
+    std::string fnam;           // The index file
+
+                secindex(const std::string & fnam = "");
+
+    status      load();
+    status      store();
+    status      append(const secrec & rec, const int64_t bound);
+    status      shift(const int64_t from, const int64_t by);
+    status      remove();
+    int         find(const type_t type, const int tries) const;
+
+    static type_t   str2type(const std::string & s);
+};
+}
+
+/*! @file
+@class job::secindex
+  @brief Sidecar index of where each section of a multipart (job) file is
+
+  A job file grows by an output and a result section for every try,
+  and the output can be huge.  To get at one try without reading all that
+  came before it, this index keeps the offset of each section's headers
+  and body, with the section's type and try number, in fixed-size records.
+
+  The index is optional: files without one are simply read the slow way.
+  It's written whole when the multipart file is, then kept up to date as
+  sections are appended.  The last section may still be growing (a running
+  job's output); its end is -1, meaning the end of the file.  Since the
+  index can go stale, users check it against the file before trusting it.
+
+@fn job::status job::secindex::append(const secrec & rec, const int64_t bound)
+  @brief Add a section's record.  The file's prior last section was ended by the
+  boundary line that starts at offset bound (at the \n before the --), so the prior
+  record's end is filled in if it was still open.  Does nothing if there's no index file.
+
+@fn job::status job::secindex::shift(const int64_t from, const int64_t by)
+  @brief Offsets at or past from are moved by this much; for when bodies are moved down.
+
+@fn int job::secindex::find(const type_t type, const int tries) const
+  @brief Returns the number of the last section of that type and try, or -1 if none.
+  If tries is 0, the last of that type.
+*/
+
+#endif
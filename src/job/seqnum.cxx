@@ -22,9 +22,12 @@
 
 #include "job/isafe.hxx"
 #include "job/seqnum.hxx"
+#include "job/shmpage.hxx"
 #include <fcntl.h>
 #include <linux/version.h>
+#include <stdio.h>              // snprintf()
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -33,23 +36,52 @@
   #define O_CLOEXEC 0   // not available on RHEL5 & earlier
 #endif
 
+#define PAGE_DIR   "/dev/shm/"
+#define PAGE_MAGIC 0x6567617071657331ULL    // "1seqpage"
+#define PAGE_STEP  65536                    // numbers the page claims from the file at a time
+
+// The node's counter page for a sequence file.  The page owns the numbers
+//  from lo thru hi; they're handed out by fetch-and-add on next.  lo and hi
+//  are only changed with the sequence file locked, and gen is odd while
+//  they are, so they can be read together without the lock.
+struct job::seqnum::page {
+    uint64_t            magic;
+    volatile uint64_t   next;       // Last number fetched
+    volatile uint64_t   gen;        // Changes to lo & hi
+    volatile uint64_t   lo;         // First number owned
+    volatile uint64_t   hi;         // Last number owned; the sequence file is at least this
+};
+
 // constructors
-job::seqnum::seqnum() {}
-job::seqnum::seqnum(const std::string & seqfile) : value(0), filename(seqfile) {}
+job::seqnum::seqnum()
+    : value(0), lease(0), paged(false), _at(0), _top(0), _pid(0), _pg(NULL) {}
+job::seqnum::seqnum(const std::string & seqfile)
+    : value(0), filename(seqfile), lease(0), paged(false), _at(0), _top(0), _pid(0), _pg(NULL) {}
 
 // destructor
-job::seqnum::~seqnum() {}
+job::seqnum::~seqnum() {
+    release();
+    if (_pg) munmap((void*)_pg, sizeof(page));
+}
 
-// get the current number
-uint64_t job::seqnum::curr() {
+// Switch to another sequence file
+void job::seqnum::reset(const std::string & seqfile) {
+    release();
+    if (_pg) munmap((void*)_pg, sizeof(page));
+    _pg      = NULL;
+    value    = 0;
+    filename = seqfile;
+}
 
-    // Open file (create if it does not exist)
+// Open and lock the sequence file (create it if it does not exist).
+//  Returns the fd, or -1 with error set.  Closing the fd unlocks it.
+int job::seqnum::_lock() {
     int fd = isafe::open(filename.c_str(),
                   O_RDWR | O_CLOEXEC | O_CREAT, // | O_NOATIME,
                   S_IRWXU | S_IRGRP | S_IROTH); // 0744
     if (fd == -1) {
         error.set("open: "+filename, IO_status);
-        return value = 0;
+        return -1;
     }
 
     // Exclusive lock on the file
@@ -57,40 +89,82 @@ uint64_t job::seqnum::curr() {
     if (ret == -1) {
         error.set("flock", IO_status);
         isafe::close(fd);
-        return value = 0;
+        return -1;
     }
+    return fd;
+}
 
-    // read prior value.  Because there's a slight chance the read
-    //  can be intterrupted by a signal, and even slighter that
-    //  the interrupt will be partway thru our minuscule read of 8 bytes
-    //  (such as, we get only 4 bytes), we do this in a loop.
-    //  Then instead of reading and reassembling the fragments, 
-    //  we'll just seek back and try again from the beginning.
-    //  This is a lot to do for a infinitesimal chance, but
-    //  we want this module rock-solid.
+// read prior value.  Because there's a slight chance the read
+//  can be intterrupted by a signal, and even slighter that
+//  the interrupt will be partway thru our minuscule read of 8 bytes
+//  (such as, we get only 4 bytes), we do this in a loop.
+//  Then instead of reading and reassembling the fragments, 
+//  we'll just seek back and try again from the beginning.
+//  [We also seek to 0 here, so a following write is an overwrite].
+//  This is a lot to do for a infinitesimal chance, but
+//  we want this module rock-solid.
+bool job::seqnum::_get(const int fd, uint64_t & v) {
+    v = 0;
     while (1) {
-        ssize_t n = isafe::read(fd, &value, sizeof(value));
+        ssize_t n = isafe::read(fd, &v, sizeof(v));
         if (n == -1) {
             error.set("read: "+filename, IO_status);
-            isafe::close(fd);
-            return value = 0;
+            return false;
         }
         if (!n) break;  // empty file (probably was just created)
         off_t o = isafe::lseek(fd, 0, SEEK_SET);   // reset to top
         if (o == -1) {
             error.set("lseek", IO_status);
-            isafe::close(fd);
-            return value = 0;
+            return false;
+        }
+        if (n == sizeof(v)) break;
+    }
+    return true;
+}
+
+// Save the new number.
+//  Like the read above, there's a small chance the
+//  write will fail or be partial.  But this chance is bigger,
+//  because we could be running over a distributed file system
+//  like NFS or Gluster.  A partial write there is more likely
+//  than a fractured read.  Its still a very, very small chance,
+//  but we want to be solid.
+bool job::seqnum::_put(const int fd, const uint64_t v) {
+    while (1) {
+        ssize_t n = isafe::write(fd, &v, sizeof(v));
+        if (n == sizeof(v)) break;
+        if (n == -1) {
+            error.set("write: "+filename, IO_status);
+            return false;
+        }
+        off_t o = isafe::lseek(fd, 0, SEEK_SET);   // reset to top
+        if (o == -1) {
+            error.set("lseek", IO_status);
+            return false;
         }
-        if (n == sizeof(value)) break;
     }
+    return true;
+}
 
-    // close file (unlocks it too)
-    ret = isafe::close(fd);
+// Unlock and close; returns false with error set if that fails
+bool job::seqnum::_unlock(const int fd) {
+    int ret = isafe::close(fd);     // (unlocks it too)
     if (ret == -1) {
         error.set("close", IO_status);
+        return false;
+    }
+    return true;
+}
+
+// get the current number
+uint64_t job::seqnum::curr() {
+    int fd = _lock();
+    if (fd < 0) return value = 0;
+    if (!_get(fd, value)) {
+        isafe::close(fd);
         return value = 0;
     }
+    if (!_unlock(fd)) return value = 0;
 
     // now serving...
     error = ERR_OK;
@@ -99,85 +173,244 @@ uint64_t job::seqnum::curr() {
 
 // get the next number
 uint64_t job::seqnum::next() {
+    return next(1);
+}
 
-    // Open file (create if it does not exist)
-    int fd = isafe::open(filename.c_str(),
-                  O_RDWR | O_CLOEXEC | O_CREAT, // | O_NOATIME,
-                  S_IRWXU | S_IRGRP | S_IROTH); // 0744
-    if (fd == -1) {
-        error.set("open: "+filename, IO_status);
-        return value = 0;
+// get the next n numbers, all at once
+uint64_t job::seqnum::next(const uint64_t n) {
+
+    // From our lease, if it has room; else claim another if this is one
+    if (lease) {
+        if (_top && (_at + n <= _top) && (_pid == getpid())) {
+            _at  += n;
+            value = _at;
+            error = ERR_OK;
+            return value - n + 1;
+        }
+        if (n <= lease) {
+            release();
+            if (!_claim(n)) return value = 0;
+            _at  += n;
+            value = _at;
+            return value - n + 1;
+        }
     }
 
-    // Exclusive lock on the file
-    int ret = isafe::flock(fd, LOCK_EX);
-    if (ret == -1) {
-        error.set("flock", IO_status);
+    // From the node's page
+    if (paged && !lease && _map()) {
+        uint64_t first = _paged(n);
+        if (first) return first;
+        paged = false;          // can't; from now on, from the file
+    }
+
+    int fd = _lock();
+    if (fd < 0) return value = 0;
+    uint64_t v;
+    if (!_get(fd, v) || !_put(fd, v + n)) {
         isafe::close(fd);
         return value = 0;
     }
+    if (!_unlock(fd)) return value = 0;
 
-    // read prior value.  Because there's a slight chance the read
-    //  can be intterrupted by a signal, and even slighter that
-    //  the interrupt will be partway thru our minuscule read of 8 bytes
-    //  (such as, we get only 4 bytes), we do this in a loop.
-    //  Then instead of reading and reassembling the fragments, 
-    //  we'll just seek back and try again from the beginning.
-    //  [We also seek to 0 here, so the below write() is an overwrite].
-    //  This is a lot to do for a infinitesimal chance, but
-    //  we want this module rock-solid.
-    while (1) {
-        ssize_t n = isafe::read(fd, &value, sizeof(value));
-        if (n == -1) {
-            error.set("read: "+filename, IO_status);
-            isafe::close(fd);
-            return value = 0;
+    // now serving...
+    value = v + n;
+    error = ERR_OK;
+    return value - n + 1;
+}
+
+// Claim a block of numbers for our lease, with at least need in it.
+//  Blocks given up by others are taken first, so the numbers aren't wasted.
+bool job::seqnum::_claim(const uint64_t need) {
+    int fd = _lock();
+    if (fd < 0) return false;
+
+    // Any blocks recorded as unused?
+    uint64_t block[2] = {0, 0};     // first, last
+    std::string gapfile = filename + ".gaps";
+    int gfd = isafe::open(gapfile.c_str(), O_RDWR | O_CLOEXEC);
+    if (gfd >= 0) {
+        struct stat sb;
+        off_t at = 0;
+        if (!fstat(gfd, &sb) && (sb.st_size >= (off_t)sizeof(block))) {
+            at = (sb.st_size / sizeof(block) - 1) * sizeof(block);
+            if ((isafe::pread(gfd, block, sizeof(block), at) != (ssize_t)sizeof(block))
+                    || (block[0] > block[1])
+                    || (block[1] - block[0] + 1 < need)
+                    || ftruncate(gfd, at)) {
+                block[0] = block[1] = 0;
+            }
         }
-        if (!n) break;  // empty file (probably was just created)
-        off_t o = isafe::lseek(fd, 0, SEEK_SET);   // reset to top
-        if (o == -1) {
-            error.set("lseek", IO_status);
+        isafe::close(gfd);
+    }
+
+    // If not, a new one off the top
+    if (!block[1]) {
+        uint64_t v;
+        if (!_get(fd, v) || !_put(fd, v + lease)) {
             isafe::close(fd);
-            return value = 0;
+            return false;
         }
-        if (n == sizeof(value)) break;
+        block[0] = v + 1;
+        block[1] = v + lease;
     }
+    if (!_unlock(fd)) return false;
 
-    // increment
-    value++;
+    _at  = block[0] - 1;
+    _top = block[1];
+    _pid = getpid();
+    error = ERR_OK;
+    return true;
+}
 
-    // Save the new number.
-    //  Like the read above, there's a small chance the
-    //  write will fail or be partial.  But this chance is bigger,
-    //  because we could be running over a distributed file system
-    //  like NFS or Gluster.  A partial write there is more likely
-    //  than a fractured read.  Its still a very, very small chance,
-    //  but we want to be solid.
-    while (1) {
-        ssize_t n = isafe::write(fd, &value, sizeof(value));
-        if (n == sizeof(value)) break;
-        if (n == -1) {
-            error.set("write: "+filename, IO_status);
+// Give back what's left of our lease.  If nobody's claimed past it,
+//  the sequence is just wound back; else it's recorded for the next claim.
+job::status job::seqnum::release() {
+    if (!_top || (_at >= _top) || (_pid != getpid())) {    // nothing left, or not ours
+        _at = _top = 0;
+        return error = ERR_OK;
+    }
+    int fd = _lock();
+    if (fd < 0) return error;
+    uint64_t v;
+    if (!_get(fd, v)) {
+        isafe::close(fd);
+        return error;
+    }
+    if (v == _top) {
+        if (!_put(fd, _at)) {
             isafe::close(fd);
-            return value = 0;
+            return error;
         }
-        off_t o = isafe::lseek(fd, 0, SEEK_SET);   // reset to top
-        if (o == -1) {
-            error.set("lseek", IO_status);
+    }
+    else {
+        uint64_t block[2] = {_at + 1, _top};
+        std::string gapfile = filename + ".gaps";
+        int gfd = isafe::open(gapfile.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+                              S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);  // 0644
+        if ((gfd < 0) || (isafe::write(gfd, block, sizeof(block)) != (ssize_t)sizeof(block))) {
+            error.set("record unused: "+gapfile, IO_status);    // they're lost, that's all
+            if (gfd >= 0) isafe::close(gfd);
             isafe::close(fd);
-            return value = 0;
+            _at = _top = 0;
+            return error;
         }
+        isafe::close(gfd);
     }
+    _at = _top = 0;
+    if (!_unlock(fd)) return error;
+    return error = ERR_OK;
+}
 
-    // close file (unlocks it too)
-    ret = isafe::close(fd);
-    if (ret == -1) {
-        error.set("close", IO_status);
-        return value = 0;
+// Map the node's counter page for our sequence file; false if we can't.
+//  The page is in shared memory, so it's gone after a reboot; and it's
+//  named for the file's inode, so each node has its own.  Its numbers are
+//  trusted, so it must be one no one else could have made or changed.
+bool job::seqnum::_map() {
+    if (_pg) return true;
+    int fd = _lock();           // so only one of us makes the page
+    if (fd < 0) return false;
+    struct stat sb;
+    uint64_t v;
+    if (fstat(fd, &sb) || !_get(fd, v)) {
+        isafe::close(fd);
+        return false;
+    }
+    char nam[sizeof(PAGE_DIR) + 48];
+    snprintf(nam, sizeof(nam), PAGE_DIR "job-seq.%lx.%lx",
+             (unsigned long)sb.st_dev, (unsigned long)sb.st_ino);
+    int pfd = job::open_page(nam, O_RDWR | O_CREAT, sb.st_mode & 0644);
+    if (pfd < 0) {
+        isafe::close(fd);
+        return false;
+    }
+    page* pg = NULL;
+    struct stat pb;
+    if (!fstat(pfd, &pb) && ((pb.st_size >= (off_t)sizeof(page)) || !ftruncate(pfd, sizeof(page)))) {
+        void* m = mmap(NULL, sizeof(page), PROT_READ | PROT_WRITE, MAP_SHARED, pfd, 0);
+        if (m != MAP_FAILED) pg = (page*)m;
+    }
+    isafe::close(pfd);
+    if (!pg) {
+        isafe::close(fd);
+        return false;
     }
 
-    // now serving...
-    error = ERR_OK;
-    return value;
+    // New page, or one from before the sequence file was remade?  Start it empty.
+    if ((pg->magic != PAGE_MAGIC) || (pg->hi > v)) {
+        __sync_fetch_and_add(&pg->gen, 1);
+        pg->next  = v;
+        pg->lo    = v + 1;
+        pg->hi    = v;
+        pg->magic = PAGE_MAGIC;
+        __sync_fetch_and_add(&pg->gen, 1);
+    }
+    isafe::close(fd);
+    _pg = pg;
+    return true;
+}
+
+// The numbers the page owns, as of now
+void job::seqnum::_owned(uint64_t & lo, uint64_t & hi) {
+    uint64_t g;
+    do {
+        g = _pg->gen;
+        __sync_synchronize();
+        lo = _pg->lo;
+        hi = _pg->hi;
+        __sync_synchronize();
+    } while ((g & 1) || (g != _pg->gen));
 }
 
+// Take n numbers from the page, claiming more for it from the file when
+//  it runs out.  Returns the first, or 0 with error set.
+uint64_t job::seqnum::_paged(const uint64_t n) {
+    uint64_t last = __sync_add_and_fetch(&_pg->next, n);
+    while (1) {
+        uint64_t first = last - n + 1;
+        uint64_t lo, hi;
+        _owned(lo, hi);
+        if ((first >= lo) && (last <= hi)) {
+            value = last;
+            error = ERR_OK;
+            return first;
+        }
+        if (first < lo) last = __sync_add_and_fetch(&_pg->next, n);   // taken by others; again
+        else if (!_extend(last)) return 0;
+    }
+}
+
+// Claim more numbers for the page, so it owns up to at least last.
+//  The sequence file is moved past them, and synced, before the page is:
+//  whatever happens to the page, none of its numbers will be issued again.
+bool job::seqnum::_extend(const uint64_t last) {
+    int fd = _lock();
+    if (fd < 0) return false;
+    uint64_t lo, hi, v;
+    _owned(lo, hi);
+    if (hi >= last) return _unlock(fd);     // someone beat us to it
+    if (!_get(fd, v)) {
+        isafe::close(fd);
+        return false;
+    }
+
+    // If others took numbers from the file since, the page skips them
+    uint64_t next = _pg->next;
+    uint64_t from = (v == hi) ? lo : v + 1;
+    uint64_t top  = ((next > v) ? next : v) + PAGE_STEP;
+    if (!_put(fd, top)) {
+        isafe::close(fd);
+        return false;
+    }
+    if (fdatasync(fd)) {
+        error.set("fdatasync: "+filename, IO_status);
+        isafe::close(fd);
+        return false;
+    }
+    while ((next = _pg->next) < from - 1) __sync_bool_compare_and_swap(&_pg->next, next, from - 1);
+
+    __sync_fetch_and_add(&_pg->gen, 1);
+    _pg->lo = from;
+    _pg->hi = top;
+    __sync_fetch_and_add(&_pg->gen, 1);
+    return _unlock(fd);
+}
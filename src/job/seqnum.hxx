@@ -26,6 +26,7 @@
 #include "job/status.hxx"
 #include <stdint.h>
 #include <string>
+#include <sys/types.h>
 
 #define PRI_seqnum_t PRIu64   // for use in printf's
 
@@ -44,12 +45,39 @@ class seqnum {
     // Returns the next sequential number; on error 0 is returned and 'error' set.
     uint64_t    next();
 
+    // Reserves the next n numbers; returns the first.  On error 0 is returned and 'error' set.
+    uint64_t    next(const uint64_t n);
+
+    // Gives back the rest of a lease; see lease below.  The destructor does this too.
+    status      release();
+
+    // Use another sequence file, giving back any lease and letting go of any page
+    void        reset(const std::string & seqfile);
+
     // Public vars
     status      error;     // Error status
     uint64_t    value;     // Last value issued
     std::string filename;  // Name of sequence file
+    uint64_t    lease;     // If set, claim this many numbers at a time, then issue them from here
+    bool        paged;     // Issue numbers from the node's shared counter page
 
   private:
+    uint64_t    _at;       // Last number issued from the lease
+    uint64_t    _top;      // Last number in the lease; 0 if none
+    pid_t       _pid;      // Process that claimed it
+    struct page;
+    page*       _pg;       // The node's counter page, once mapped
+
+    int         _lock();
+    bool        _unlock(const int fd);
+    bool        _get(const int fd, uint64_t & v);
+    bool        _put(const int fd, const uint64_t v);
+    bool        _claim(const uint64_t need);
+    bool        _map();
+    void        _owned(uint64_t & lo, uint64_t & hi);
+    uint64_t    _paged(const uint64_t n);
+    bool        _extend(const uint64_t last);
+
     // Assignment operator
     seqnum & operator=(const seqnum & other);
 };
@@ -71,6 +99,29 @@ class seqnum {
  *      ...
  *   @endcode
  *
+ *   Every number costs a lock of the sequence file, which is shared by all
+ *   the nodes if the job spool is on a network filesystem.  To cut that,
+ *   set lease: the next number then claims a block of that many in one go,
+ *   and the rest are issued from the block without touching the file.
+ *   What's left of the block is given back by release(), or when the seqnum
+ *   is destroyed: if no one has claimed past it, the sequence file is wound
+ *   back; else the block is recorded in a .gaps file beside the sequence
+ *   file, and the next claim takes it from there.  A block left by a crash
+ *   is just skipped.  Numbers from a lease are unique but not in order
+ *   across processes.  A child process doesn't use its parent's lease.
+ *
+ *   On one node, set paged instead, and all the processes on the node share
+ *   one lease: a counter page in shared memory (/dev/shm), named for the
+ *   sequence file's inode.  A number is then just an atomic add to the page,
+ *   with no system call at all.  When the page runs out, it claims the next
+ *   block of numbers from the sequence file, which is synced to disk before
+ *   any of them are issued; so after a crash or reboot, when the page is
+ *   gone, the file is past every number the page gave out.  Numbers taken
+ *   from the file by others meanwhile are skipped.  If the page can't be
+ *   had (no /dev/shm, no permission, or it's not one we made; see
+ *   job::open_page()), numbers come from the file as usual.
+ *   A lease, if set, is used instead.
+ *
  * @fn job::seqnum::seqnum(const std::string & seqfile)
  *   @brief Construct a seuence number object
  *   @param seqfile Filename of the seuence file that will persiste and synchronize number generation.
@@ -78,8 +129,16 @@ class seqnum {
  * @fn uint64_t job::seqnum::next()
  *   @brief Returns the next number in the sequence, or 0 if an error occurs.
  *
+ * @fn uint64_t job::seqnum::next(const uint64_t n)
+ *   @brief Reserves the next n numbers in the sequence, with one lock of the file,
+ *   and returns the first of them; value is the last.  Returns 0 if an error occurs.
+ *   With a lease, they're from the lease if n is no more than the lease size.
+ *
+ * @fn job::status job::seqnum::release()
+ *   @brief Give back the rest of our lease, if any; see above.
+ *
  * @fn job::seqnum::~seqnum()
- *   @brief Destructor.
+ *   @brief Destructor; gives back the rest of our lease.
  *
  */
 
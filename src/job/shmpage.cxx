@@ -0,0 +1,50 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/isafe.hxx"
+#include "job/shmpage.hxx"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int job::open_page(const std::string & nam, const int flags, const mode_t mode) {
+    int fd = -1;
+    if (flags & O_CREAT) {
+        fd = isafe::open(nam.c_str(), flags | O_EXCL | O_NOFOLLOW | O_CLOEXEC, mode);
+        if ((fd < 0) && (errno != EEXIST)) return -1;
+    }
+    if (fd < 0) fd = isafe::open(nam.c_str(), (flags & ~O_CREAT) | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    // Ours, or root's, and no one else may change it
+    struct stat sb;
+    if (fstat(fd, &sb)
+        || !S_ISREG(sb.st_mode)
+        || ((sb.st_uid != geteuid()) && (sb.st_uid != 0))
+        || (sb.st_mode & (S_IWGRP | S_IWOTH))) {
+        isafe::close(fd);
+        errno = EPERM;
+        return -1;
+    }
+    return fd;
+}
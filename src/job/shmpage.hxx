@@ -0,0 +1,45 @@
+#ifndef _JOB_SHMPAGE_HXX_
+#define _JOB_SHMPAGE_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include <string>
+#include <sys/types.h>
+
+namespace job {
+    int open_page(const std::string & nam, const int flags, const mode_t mode = 0644);
+}
+
+/*! @file
+@fn int job::open_page(const std::string & nam, const int flags, const mode_t mode)
+  @brief Open a page in shared memory (/dev/shm) that no one else could have rigged.
+
+  Anyone may make a file in /dev/shm, and our pages have names that are
+  easy to guess; so one could be made ahead of us, world-writable, and
+  fed to a setuid program.  This opens with O_NOFOLLOW; with O_CREAT it
+  makes the page with O_EXCL if it can.  Then the page must be a plain
+  file, owned by us or by root, and writable by no one else.  Returns the
+  descriptor, or -1 with errno set (EPERM if it's not a page we'll trust).
+*/
+
+#endif
@@ -0,0 +1,290 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/isafe.hxx"
+#include "job/path.hxx"
+#include "job/shmpage.hxx"
+#include "job/slots.hxx"
+#include <errno.h>
+#include <signal.h>             // kill()
+#include <stdio.h>              // snprintf()
+#include <stdlib.h>             // strtoull()
+#include <string.h>             // memcpy(), memset()
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SLOTS_DIR     "/dev/shm/"
+#define SLOTS_MAGIC   0x736c6f7473626f6aULL     // "jobslots"
+#define SLOTS_VERSION 1
+
+using job::ERR_OK;
+
+// When a process started, in clock ticks since boot; 0 if we can't tell
+static uint64_t _born(const pid_t pid) {
+    char nam[32];
+    snprintf(nam, sizeof(nam), "/proc/%d/stat", (int)pid);
+    FILE* fp = fopen(nam, "r");
+    if (!fp) return 0;
+    char buf[1024];
+    size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[n] = '\0';
+    char* p = strrchr(buf, ')');    // the command name may have spaces, or parens
+    if (!p) return 0;
+    int field = 2;                  // that ends the 2nd field; the start time is the 22nd
+    for (p++; *p && (field < 22); p++) {
+        if (*p == ' ') ++field;
+    }
+    return strtoull(p, NULL, 10);
+}
+
+job::slots::slots()
+    : _pg(NULL)
+    , _fd(-1)
+    , _me(-1)
+    , _writer(false) {
+    struct stat sb;
+    if (stat(path.jobdir.c_str(), &sb)) {
+        error.set("Cannot find spool " + path.jobdir, SYS_status);
+        return;
+    }
+    char nam[sizeof(SLOTS_DIR) + 48];
+    snprintf(nam, sizeof(nam), SLOTS_DIR "job-slots.%lx.%lx",
+             (unsigned long)sb.st_dev, (unsigned long)sb.st_ino);
+    fnam = nam;
+}
+
+job::slots::~slots() {
+    leave();
+    _unmap();
+}
+
+void job::slots::_unmap() {
+    if (_pg) munmap(_pg, sizeof(slotpage));
+    if (_fd >= 0) isafe::close(_fd);
+    _pg = NULL;
+    _fd = -1;
+}
+
+bool job::slots::_lock() {
+    return !isafe::flock(_fd, LOCK_EX);
+}
+
+void job::slots::_unlock() {
+    isafe::flock(_fd, LOCK_UN);
+}
+
+// Put back the slots of jobmen that died holding them; once a second will do
+void job::slots::_sweep() {
+    time_t now = time(NULL);
+    if (_pg->swept == now) return;
+    _pg->swept = now;
+    for (int i = 0; i < SLOTS_HOLDERS; i++) {
+        slotpage::holder & h = _pg->holders[i];
+        if (!h.pid) continue;
+        bool dead = kill(h.pid, 0) && (errno == ESRCH);
+        if (!dead && h.born && (_born(h.pid) != h.born)) dead = true;     // the PID's been reused
+        if (dead) memset(&h, 0, sizeof(h));
+    }
+}
+
+// The sum of the weights of the queues using slots, or wanting them
+int job::slots::_weights() const {
+    int w = 0;
+    for (int i = 0; i < SLOTS_HOLDERS; i++) {
+        const slotpage::holder & h = _pg->holders[i];
+        if (h.pid && (h.held || h.want)) w += h.weight;
+    }
+    return w;
+}
+
+// A queue's share of the slots, among those using them; at least one
+int job::slots::_share(const slotpage::holder & h, const int weights) const {
+    if (weights <= 0) return _pg->total;
+    int s = (int)((int64_t)_pg->total * h.weight / weights);
+    return (s > 0) ? s : 1;
+}
+
+job::status job::slots::join(const std::string & queue, const int total, const int weight) {
+    if (fnam.empty()) return error;
+    leave();
+    if (!_writer) _unmap();
+    if (!_pg) {
+        _fd = job::open_page(fnam, O_RDWR | O_CREAT);
+        if (_fd < 0) return error.set("Cannot open " + fnam, SYS_status);
+    }
+    if (!_lock()) {
+        error.set("Cannot lock " + fnam, SYS_status);
+        _unmap();
+        return error;
+    }
+    if (!_pg) {
+        struct stat sb;
+        if (fstat(_fd, &sb) || ((sb.st_size < (off_t)sizeof(slotpage)) && ftruncate(_fd, sizeof(slotpage)))) {
+            error.set("Cannot size " + fnam, SYS_status);
+            _unlock();
+            _unmap();
+            return error;
+        }
+        void* m = mmap(NULL, sizeof(slotpage), PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+        if (m == MAP_FAILED) {
+            error.set("Cannot map " + fnam, SYS_status);
+            _unlock();
+            _unmap();
+            return error;
+        }
+        _pg     = (slotpage*)m;
+        _writer = true;
+    }
+
+    // New, or not one we know?  Start it afresh
+    if ((_pg->magic != SLOTS_MAGIC) || (_pg->version != SLOTS_VERSION) || (_pg->size != sizeof(slotpage))) {
+        memset(_pg, 0, sizeof(slotpage));
+        _pg->magic   = SLOTS_MAGIC;
+        _pg->version = SLOTS_VERSION;
+        _pg->size    = sizeof(slotpage);
+    }
+    _pg->total = (total > 0) ? total : 0;
+    _pg->swept = 0;
+    _sweep();
+
+    for (int i = 0; i < SLOTS_HOLDERS; i++) {
+        slotpage::holder & h = _pg->holders[i];
+        if (h.pid) continue;
+        memset(&h, 0, sizeof(h));
+        h.pid    = getpid();
+        h.weight = (weight > 0) ? weight : 1;
+        h.born   = _born(h.pid);
+        strncpy(h.queue, queue.c_str(), sizeof(h.queue) - 1);
+        _me = i;
+        break;
+    }
+    _unlock();
+    if (_me < 0) return error.set("No room for queue " + queue + " in the run slot pool " + fnam);
+    return error = ERR_OK;
+}
+
+void job::slots::leave() {
+    if (_me < 0) return;
+    _lock();
+    memset(&_pg->holders[_me], 0, sizeof(slotpage::holder));
+    _unlock();
+    _me = -1;
+}
+
+int job::slots::take(const int n) {
+    if (_me < 0) return n;          // no pool, no limit
+    if (!_lock()) return n;         // ...nor if we can't use it
+    _sweep();
+    slotpage::holder & me = _pg->holders[_me];
+    me.want = (n > 0) ? n : 0;
+
+    // Slots free, and those we should leave for queues short of their share
+    int weights  = _weights();
+    int avail    = _pg->total;
+    int reserved = 0;
+    for (int i = 0; i < SLOTS_HOLDERS; i++) {
+        const slotpage::holder & h = _pg->holders[i];
+        if (!h.pid) continue;
+        avail -= h.held;
+        if ((i == _me) || (h.want <= 0)) continue;
+        int shy = _share(h, weights) - h.held;
+        if (shy > h.want) shy = h.want;
+        if (shy > 0) reserved += shy;
+    }
+
+    // Up to our share we may take what's free; past it, only what no one's short of
+    int mine = _share(me, weights) - me.held;
+    int got  = avail - reserved;
+    if ((mine > 0) && (got < mine)) got = (mine < avail) ? mine : avail;
+    if (got > n) got = n;
+    if (got < 0) got = 0;
+    me.held += got;
+    me.want  = me.want - got;
+    _unlock();
+    return got;
+}
+
+std::string job::slots::give(const int n) {
+    if ((_me < 0) || (n <= 0)) return "";
+    if (!_lock()) return "";
+    slotpage::holder & me = _pg->holders[_me];
+    me.held -= n;
+    if (me.held < 0) me.held = 0;
+
+    // Who wants them the most: the one furthest short of its share
+    int weights = _weights();
+    int best    = -1;
+    int most    = 0;
+    for (int i = 0; i < SLOTS_HOLDERS; i++) {
+        const slotpage::holder & h = _pg->holders[i];
+        if (!h.pid || (h.want <= 0)) continue;
+        int shy = _share(h, weights) - h.held;
+        if ((best < 0) || (shy > most)) {
+            best = i;
+            most = shy;
+        }
+    }
+    std::string needy;
+    if (best >= 0) needy.assign(_pg->holders[best].queue, strnlen(_pg->holders[best].queue, sizeof(_pg->holders[best].queue)));
+    _unlock();
+    return needy;
+}
+
+void job::slots::adopt(const int n) {
+    if ((_me < 0) || (n <= 0) || !_lock()) return;
+    _pg->holders[_me].held += n;
+    _unlock();
+}
+
+int job::slots::held() const {
+    return (_me < 0) ? 0 : _pg->holders[_me].held;
+}
+
+bool job::slots::read(slotpage & snap) {
+    if (!_pg) {
+        if (fnam.empty()) return false;
+        _fd = job::open_page(fnam, O_RDONLY);
+        if (_fd < 0) {
+            error.set("Cannot open " + fnam, SYS_status);
+            return false;
+        }
+        struct stat sb;
+        void* m = MAP_FAILED;
+        if (!fstat(_fd, &sb) && (sb.st_size >= (off_t)sizeof(slotpage)))
+            m = mmap(NULL, sizeof(slotpage), PROT_READ, MAP_SHARED, _fd, 0);
+        if (m == MAP_FAILED) {
+            error.set("Not a run slot pool: " + fnam);
+            _unmap();
+            return false;
+        }
+        _pg = (slotpage*)m;
+    }
+    if (!_lock()) return false;
+    memcpy(&snap, _pg, sizeof(snap));
+    _unlock();
+    return (snap.magic == SLOTS_MAGIC)
+        && (snap.version == SLOTS_VERSION)
+        && (snap.size == sizeof(slotpage));
+}
@@ -0,0 +1,144 @@
+#ifndef _JOB_SLOTS_HXX_
+#define _JOB_SLOTS_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/status.hxx"
+#include <stdint.h>
+#include <string>
+
+namespace job {
+
+#define SLOTS_HOLDERS 256       // Queues on a node that may share its run slots
+
+// The node's run slots, and who holds them; shared by all its jobmen
+struct slotpage {
+    struct holder {             // A queue, in the jobman managing it
+        int32_t     pid;        // The jobman's, 0 if this holder's free
+        int32_t     weight;     // The queue's share, relative to the others
+        int32_t     held;       // Slots it holds: its jobs running
+        int32_t     want;       // More it could use now, but wasn't given
+        uint64_t    born;       // When the jobman started, to tell a reused PID
+        char        queue[64];
+    };
+
+    uint64_t    magic;
+    uint32_t    version;        // Of this layout
+    uint32_t    size;           // ...and its size
+    int32_t     total;          // Run slots on the node
+    int32_t     spare;
+    int64_t     swept;          // When holders that died were last cleared
+    holder      holders[SLOTS_HOLDERS];
+};
+
+class slots {
+  public:
+    status      error;
+    std::string fnam;           // The segment, in /dev/shm
+
+                slots();
+                ~slots();
+
+    status      join(const std::string & queue, const int total, const int weight);
+    void        leave();
+    int         take(const int n);
+    std::string give(const int n);
+    void        adopt(const int n);
+    int         held() const;
+    bool        read(slotpage & snap);
+
+  private:
+    slotpage*   _pg;
+    int         _fd;
+    int         _me;            // Our holder, or -1
+    bool        _writer;        // Mapped to change, not just read
+
+    void        _unmap();
+    bool        _lock();
+    void        _unlock();
+    void        _sweep();
+    int         _weights() const;
+    int         _share(const slotpage::holder & h, const int weights) const;
+
+    slots(const slots &);               // not copyable
+    slots & operator=(const slots &);
+};
+}
+
+/*! @file
+@class job::slots
+  @brief The node's run slots, shared by the queues on it
+
+  Each jobman keeps its queue's run-limit, but nothing else stops ten queues
+  with a limit of ten each from starting a hundred jobs at once.  With
+  node-slots set in job.conf, the node has that many run slots in all, and
+  each jobman takes one from this pool for each job it starts, and gives it
+  back when the job's done.  The pool is a small segment in /dev/shm, named
+  for the spool directory's inode (so test roots don't mix), with a holder
+  for each queue: what it holds, and what more it could use now.  It's
+  opened with job::open_page(), so one made ahead of us by someone else,
+  that they could change, isn't used.
+
+  Slots are shared by weight (slot-weight, in the queue's config), among
+  the queues that hold or want any; an idle queue's share is lent to the
+  busy ones.  A queue may always take free slots up to its share.  Past
+  that, it takes only those not needed by queues still short of theirs;
+  so as lent slots come back, they go to the queues that lent them.  Jobs
+  are never stopped to take slots back.  When slots are given back, give()
+  names the queue most in need of them, to be nudged.
+
+  Changes are made under an flock() on the segment, which the kernel lets
+  go of if a jobman dies holding it.  A jobman that dies holding slots is
+  found by its PID and start time, and its slots put back, by whichever
+  jobman next takes slots (at most once a second).
+
+  @code
+    job::slots pool;
+    pool.join("batch", 16, 1);
+    int n = pool.take(4);                   // up to 4 jobs may start
+    ...
+    std::string needy = pool.give(1);       // a job's done
+  @endcode
+
+@fn job::status job::slots::join(const std::string & queue, const int total, const int weight)
+  @brief Take a holder in the pool for the queue, making the pool if it's new.
+  The pool's total is set to this one, so the last jobman started has its say.
+
+@fn void job::slots::leave()
+  @brief Give back all our slots, and our holder.  The destructor does this.
+
+@fn int job::slots::take(const int n)
+  @brief Take up to n slots; returns how many we got.  What we don't get, we want.
+  Take 0 to say we want no more.  With no pool, n is always had.
+
+@fn std::string job::slots::give(const int n)
+  @brief Give back n slots.  Returns the queue that most wants slots, if any does.
+
+@fn void job::slots::adopt(const int n)
+  @brief Count n slots as ours, no questions asked: jobs that were already running.
+
+@fn bool job::slots::read(slotpage & snap)
+  @brief Take a copy of the pool.  False if there's none.
+*/
+
+#endif
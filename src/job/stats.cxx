@@ -0,0 +1,237 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/isafe.hxx"
+#include "job/path.hxx"
+#include "job/shmpage.hxx"
+#include "job/stats.hxx"
+#include <stddef.h>             // offsetof()
+#include <stdio.h>              // snprintf()
+#include <string.h>             // memcpy(), memset()
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STATS_DIR     "/dev/shm/"
+#define STATS_MAGIC   0x7374617473626f6aULL     // "jobstats"
+#define STATS_VERSION 2
+#define STATS_TRIES   1000                      // copies read() tries before giving up
+
+using job::ERR_OK;
+
+static const char* phase_names[job::statpage::NPHASES] = {
+    "poll", "sync", "dead", "kill", "group", "split", "clean", "change", "reap"
+};
+
+static const char* lat_names[job::statpage::NLATS] = {
+    "submitted", "waited", "starting", "running", "reaping"
+};
+
+job::stats::stats(const std::string & queue)
+    : _pg(NULL)
+    , _writer(false) {
+    std::string qdir = path.jobdir + queue;
+    struct stat sb;
+    if (stat(qdir.c_str(), &sb)) {
+        error.set("Cannot find queue " + qdir, SYS_status);
+        return;
+    }
+    char nam[sizeof(STATS_DIR) + 48];
+    snprintf(nam, sizeof(nam), STATS_DIR "job-stats.%lx.%lx",
+             (unsigned long)sb.st_dev, (unsigned long)sb.st_ino);
+    fnam = nam;
+}
+
+job::stats::~stats() {
+    if (_pg) munmap(_pg, sizeof(statpage));
+    _pg = NULL;
+}
+
+const char* job::stats::phase2str(const int ph) {
+    return ((ph >= 0) && (ph < statpage::NPHASES)) ? phase_names[ph] : "???";
+}
+
+const char* job::stats::lat2str(const int lat) {
+    return ((lat >= 0) && (lat < statpage::NLATS)) ? lat_names[lat] : "???";
+}
+
+uint64_t job::stats::wall_usecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64_t job::stats::usecs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Make it new; only the jobman for the queue does this
+job::status job::stats::create() {
+    if (fnam.empty()) return error;
+    int fd = job::open_page(fnam, O_RDWR | O_CREAT);
+    if (fd < 0) return error.set("Cannot create " + fnam, SYS_status);
+    if (ftruncate(fd, sizeof(statpage))) {
+        isafe::close(fd);
+        return error.set("Cannot size " + fnam, SYS_status);
+    }
+    void* m = mmap(NULL, sizeof(statpage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    isafe::close(fd);
+    if (m == MAP_FAILED) return error.set("Cannot map " + fnam, SYS_status);
+    _pg     = (statpage*)m;
+    _writer = true;
+
+    // Fresh counts; readers see it's changing until it's all set
+    uint64_t g = _pg->gen | 1;
+    _pg->gen = g;
+    __sync_synchronize();
+    memset((char*)_pg + offsetof(statpage, pid), 0, sizeof(statpage) - offsetof(statpage, pid));
+    _pg->magic   = STATS_MAGIC;
+    _pg->version = STATS_VERSION;
+    _pg->size    = sizeof(statpage);
+    _pg->pid     = getpid();
+    _pg->started = _pg->updated = _pg->lat_since = time(NULL);
+    __sync_synchronize();
+    _pg->gen = g + 1;
+    return error = ERR_OK;
+}
+
+// Look at it; for readers
+job::status job::stats::open() {
+    if (fnam.empty()) return error;
+    int fd = job::open_page(fnam, O_RDONLY);
+    if (fd < 0) return error.set("Cannot open " + fnam, SYS_status);
+    struct stat sb;
+    if (fstat(fd, &sb) || (sb.st_size < (off_t)sizeof(statpage))) {
+        isafe::close(fd);
+        return error.set("Not a statistics segment: " + fnam);
+    }
+    void* m = mmap(NULL, sizeof(statpage), PROT_READ, MAP_SHARED, fd, 0);
+    isafe::close(fd);
+    if (m == MAP_FAILED) return error.set("Cannot map " + fnam, SYS_status);
+    _pg     = (statpage*)m;
+    _writer = false;
+    return error = ERR_OK;
+}
+
+// A copy made while no change was under way
+bool job::stats::read(statpage & snap) const {
+    if (!_pg) return false;
+    volatile uint64_t* gen = &_pg->gen;
+    for (int t = 0; t < STATS_TRIES; t++) {
+        uint64_t g = *gen;
+        if (g & 1) {
+            usleep(10);
+            continue;
+        }
+        __sync_synchronize();
+        memcpy(&snap, _pg, sizeof(snap));
+        __sync_synchronize();
+        if (*gen != g) continue;
+        return (snap.magic == STATS_MAGIC)
+            && (snap.version == STATS_VERSION)
+            && (snap.size == sizeof(statpage));
+    }
+    return false;
+}
+
+void job::stats::_begin() {
+    ++_pg->gen;
+    __sync_synchronize();
+}
+
+void job::stats::_end() {
+    __sync_synchronize();
+    ++_pg->gen;
+}
+
+void job::stats::add(uint64_t statpage::* c, const uint64_t n) {
+    if (!_writer) return;
+    _begin();
+    _pg->*c += n;
+    _pg->updated = time(NULL);
+    _end();
+}
+
+void job::stats::set(int64_t statpage::* c, const int64_t v) {
+    if (!_writer) return;
+    _begin();
+    _pg->*c = v;
+    _pg->updated = time(NULL);
+    _end();
+}
+
+void job::stats::set_jobs(const int state, const int64_t n) {
+    if (!_writer || (state < 0) || (state >= 8)) return;
+    _begin();
+    _pg->jobs[state] = n;
+    _pg->updated = time(NULL);
+    _end();
+}
+
+void job::stats::timed(const statpage::phase_t ph, const uint64_t usecs) {
+    if (!_writer || (ph < 0) || (ph >= statpage::NPHASES)) return;
+    statpage::phase & p = _pg->phases[ph];
+    _begin();
+    p.runs++;
+    p.total_us += usecs;
+    p.last_us   = usecs;
+    if (usecs > p.max_us) p.max_us = usecs;
+    _end();
+}
+
+// The type's slot, taking a free one if it's new; the last is for all the rest.
+//  Called while changing the page.
+int job::stats::_type_slot(const std::string & type) {
+    if (type.empty()) return 0;
+    for (int i = 1; i < STATS_TYPES - 1; i++) {
+        char* t = _pg->types[i];
+        if (!t[0]) {
+            snprintf(t, sizeof(_pg->types[i]), "%s", type.c_str());
+            return i;
+        }
+        if (!strncmp(t, type.c_str(), sizeof(_pg->types[i]) - 1)) return i;
+    }
+    return STATS_TYPES - 1;
+}
+
+void job::stats::latency(const statpage::lat_t lat, const int priority,
+                         const std::string & type, const uint64_t usecs) {
+    if (!_writer || (lat < 0) || (lat >= statpage::NLATS)) return;
+    int p = (priority < 1) ? 1 : (priority > 9) ? 9 : priority;
+    _begin();
+    _pg->by_prio[lat][p-1].record(usecs);
+    _pg->by_type[lat][_type_slot(type)].record(usecs);
+    _pg->updated = time(NULL);
+    _end();
+}
+
+void job::stats::reset_latency() {
+    if (!_writer) return;
+    _begin();
+    memset(_pg->by_prio, 0, sizeof(_pg->by_prio));
+    memset(_pg->by_type, 0, sizeof(_pg->by_type));
+    _pg->lat_since = _pg->updated = time(NULL);
+    _end();
+}
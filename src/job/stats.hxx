@@ -0,0 +1,176 @@
+#ifndef _JOB_STATS_HXX_
+#define _JOB_STATS_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/histogram.hxx"
+#include "job/status.hxx"
+#include <stdint.h>
+#include <string>
+
+namespace job {
+
+#define STATS_TYPES 16         // Job types we keep latencies of; the rest are lumped together
+
+// What a jobman publishes; all 64-bit fields, so the layout is the same everywhere
+struct statpage {
+    enum phase_t {POLL = 0, SYNC, DEAD, KILL, GROUP, SPLIT, CLEAN, CHANGE, REAP, NPHASES};
+    enum lat_t   {SUBMITTED = 0, WAITED, STARTING, RUNNING, REAPING, NLATS};
+    struct phase {              // One kind of work the main loop does
+        uint64_t    runs;       // How many times it's been done
+        uint64_t    total_us;   // ...taking this long in all
+        uint64_t    max_us;     // ...and this long at the most
+        uint64_t    last_us;    // ...and this long the last time
+    };
+
+    uint64_t    magic;
+    uint32_t    version;        // Of this layout
+    uint32_t    size;           // ...and its size
+    uint64_t    gen;            // Odd while being changed
+    int64_t     pid;            // The jobman's
+    int64_t     started;        // When it started
+    int64_t     updated;        // When anything last changed
+    int64_t     run_limit;      // Run slots
+    int64_t     running;        // ...in use
+    int64_t     jobs[8];        // Jobs in each state, by state_t
+    uint64_t    launches;       // Tries (and array elements) started
+    uint64_t    completions;    // ...that ended well
+    uint64_t    failures;       // ...that failed for good
+    uint64_t    retries;        // ...that failed and were put back to pending
+    uint64_t    locked;         // Jobs passed over, locked by another jobman (ERR_LOCKED)
+    uint64_t    moved;          // ...or taken by another jobman (ERR_MOVED)
+    phase       phases[NPHASES];
+
+    // Latencies, in microseconds, by job priority (1-9) and by job type
+    int64_t     lat_since;                      // When they were last reset
+    char        types[STATS_TYPES][32];         // Job types, by slot; 0 is for plain commands
+    histogram   by_prio[NLATS][9];
+    histogram   by_type[NLATS][STATS_TYPES];
+};
+
+class stats {
+  public:
+    status      error;
+    std::string fnam;           // The segment, in /dev/shm
+
+                stats(const std::string & queue);
+                ~stats();
+
+    status      create();
+    status      open();
+    bool        read(statpage & snap) const;
+
+    // For the jobman, to change what's published; none do anything if there's no segment
+    void        add(uint64_t statpage::* c, const uint64_t n = 1);
+    void        set(int64_t statpage::* c, const int64_t v);
+    void        set_jobs(const int state, const int64_t n);
+    void        timed(const statpage::phase_t ph, const uint64_t usecs);
+    void        latency(const statpage::lat_t lat, const int priority,
+                        const std::string & type, const uint64_t usecs);
+    void        reset_latency();
+
+    static uint64_t     usecs();
+    static uint64_t     wall_usecs();
+    static const char*  phase2str(const int ph);
+    static const char*  lat2str(const int lat);
+
+  private:
+    statpage*   _pg;
+    bool        _writer;
+
+    void        _begin();
+    void        _end();
+    int         _type_slot(const std::string & type);
+
+    stats(const stats &);               // not copyable
+    stats & operator=(const stats &);
+};
+}
+
+/*! @file
+@class job::stats
+  @brief A jobman's live statistics, published in shared memory
+
+  Each jobman keeps its counters -- jobs in each state, run slots in use,
+  tries started and how they ended, jobs passed over because another
+  jobman had them, and how long each kind of work in its main loop takes --
+  in a small segment in /dev/shm, named for its queue directory's inode (so
+  test roots don't mix).  Changing a counter is a couple of stores to memory,
+  with no system call, so the jobman can keep them all the time; reading
+  them costs the jobman nothing at all.  See jobstat(8).
+
+  It also keeps latency histograms (see job::histogram), each broken out
+  by job priority and by job type: from submission to the job's first start
+  (SUBMITTED), from when a try could run -- its run time, or when it was
+  put in pend if later -- to its start (WAITED), from taking the job to
+  launching it (STARTING), how long the try ran (RUNNING), and how long it
+  took to record the try's result (REAPING).  The first STATS_TYPES-1 job
+  types seen get a slot of their own; the rest share the last.  The
+  latencies can be reset without a restart; see reset_latency().
+
+  The jobman is the only writer.  The segment is guarded by a sequence
+  lock: gen is made odd before a change and even after, and read() copies
+  the page until it gets a copy with the same even gen before and after.
+  The page starts with a magic number, layout version and size, so a reader
+  can tell a page it doesn't understand.  The segment is left in place when
+  the jobman exits, showing its final counts; the jobman's PID tells if
+  it's still running.  If there's no /dev/shm, the jobman runs without.
+  A segment that someone else could have made or changed isn't used; see
+  job::open_page().
+
+  @code
+    job::stats st("batch");
+    st.create();                            // the jobman
+    st.add(&job::statpage::launches);
+
+    job::stats rd("batch");
+    job::statpage snap;
+    if (!rd.open() && rd.read(snap)) ...    // a reader
+  @endcode
+
+@fn job::status job::stats::create()
+  @brief Make the segment afresh, for the jobman; the counts start at zero.
+
+@fn job::status job::stats::open()
+  @brief Map an existing segment, read-only, for a reader.
+
+@fn bool job::stats::read(statpage & snap) const
+  @brief Take a consistent copy of the page.  False if there's none, or it's not one we know.
+
+@fn void job::stats::timed(const statpage::phase_t ph, const uint64_t usecs)
+  @brief Count a run of that phase of work, which took so many microseconds.
+
+@fn void job::stats::latency(const statpage::lat_t lat, const int priority, const std::string & type, const uint64_t usecs)
+  @brief Record a latency in its priority's histogram and its type's.
+
+@fn void job::stats::reset_latency()
+  @brief Clear the latency histograms, and start lat_since over.  The jobman does this on SIGUSR1.
+
+@fn uint64_t job::stats::usecs()
+  @brief Microseconds on the monotonic clock, for timing phases.
+
+@fn uint64_t job::stats::wall_usecs()
+  @brief Microseconds since the epoch, for latencies from file times.
+*/
+
+#endif
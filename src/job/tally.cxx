@@ -0,0 +1,129 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/isafe.hxx"
+#include "job/path.hxx"
+#include "job/tally.hxx"
+#define __STDC_FORMAT_MACROS    // Enable PRI macros
+#include <inttypes.h>           // PRI macros
+#include <limits.h>             // PATH_MAX
+#include <set>
+#include <stdio.h>              // snprintf()
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#define TALLY_MAGIC 0x796c6174  // "taly"
+
+using job::ERR_OK;
+
+job::tally::tally(const std::string & queue, const id_t mid)
+    : total(0)
+    , done(0)
+    , ok(0)
+    , failed(0) {
+    char nam[PATH_MAX+1];
+    snprintf(nam, sizeof(nam), "%s%s/.tally/j%7.7" PRIu64,
+                path.jobdir.c_str(),
+                queue.c_str(),
+                (uint64_t)mid);
+    fnam = nam;
+}
+
+// Start the tally for a group of this many children
+job::status job::tally::create(const int total) {
+    mkdir(fnam.substr(0, fnam.rfind('/')).c_str(), 0755);   // if not there yet
+    int fd = isafe::open(fnam.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return error.set("Cannot create " + fnam, SYS_status);
+    rec h;
+    h.id    = 0;
+    h.val   = total;
+    h.magic = TALLY_MAGIC;
+    ssize_t amt = isafe::write(fd, &h, sizeof(h));
+    isafe::close(fd);
+    if (amt != (ssize_t)sizeof(h)) return error.set("Cannot write " + fnam, SYS_status);
+    this->total = total;
+    done = ok = failed = 0;
+    return error = ERR_OK;
+}
+
+// Add a finished child; only if it looks like the last do we read it all
+job::status job::tally::count(const id_t kid, const bool success) {
+    int fd = isafe::open(fnam.c_str(), O_RDWR | O_APPEND);
+    if (fd < 0) {
+        if (SYS_errno == ENOENT) return error = ERR_OK;     // no tally for this group
+        return error.set("Cannot open " + fnam, SYS_status);
+    }
+    rec r;
+    r.id    = kid;
+    r.val   = success;
+    r.magic = TALLY_MAGIC;
+    struct stat sb;
+    rec h;
+    if ((isafe::write(fd, &r, sizeof(r)) != (ssize_t)sizeof(r))
+            || (fstat(fd, &sb) < 0)
+            || (isafe::pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h))) {
+        isafe::close(fd);
+        return error.set("Cannot update " + fnam, SYS_status);
+    }
+    isafe::close(fd);
+    if ((h.id != 0) || (h.magic != TALLY_MAGIC)) return error.set("Bad tally " + fnam);
+    total = h.val;
+    done  = sb.st_size / sizeof(rec) - 1;   // maybe with duplicates
+    if (done >= total) return load();
+    return error = ERR_OK;
+}
+
+// Read the whole tally, each child counted once
+job::status job::tally::load() {
+    total = done = ok = failed = 0;
+    int fd = isafe::open(fnam.c_str(), O_RDONLY);
+    if (fd < 0) return error.set("Cannot open " + fnam, SYS_status);
+    struct stat sb;
+    if (fstat(fd, &sb) < 0) {
+        isafe::close(fd);
+        return error.set("Cannot stat " + fnam, SYS_status);
+    }
+    std::vector<rec> recs(sb.st_size / sizeof(rec));
+    ssize_t want = recs.size() * sizeof(rec);
+    ssize_t amt  = want ? isafe::pread(fd, &recs[0], want, 0) : 0;
+    isafe::close(fd);
+    if (amt != want) return error.set("Cannot read " + fnam, SYS_status);
+    if (recs.empty() || recs[0].id || (recs[0].magic != TALLY_MAGIC))
+        return error.set("Bad tally " + fnam);
+
+    total = recs[0].val;
+    std::set<id_t> seen;
+    for (size_t i = 1; i < recs.size(); i++) {
+        if ((recs[i].magic != TALLY_MAGIC) || !seen.insert(recs[i].id).second) continue;
+        ++done;
+        if (recs[i].val) ++ok;
+        else             ++failed;
+    }
+    return error = ERR_OK;
+}
+
+job::status job::tally::remove() {
+    if (isafe::unlink(fnam.c_str()) && (SYS_errno != ENOENT))
+        return error.set("Cannot remove " + fnam, SYS_status);
+    return error = ERR_OK;
+}
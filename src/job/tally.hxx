@@ -0,0 +1,81 @@
+#ifndef _JOB_TALLY_HXX_
+#define _JOB_TALLY_HXX_ 1
+
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/jobkey.hxx"       // id_t
+#include "job/status.hxx"
+#include <stdint.h>
+#include <string>
+
+namespace job {
+
+class tally {
+  public:
+    status      error;
+    std::string fnam;           // The tally file
+    int         total;          // How many child jobs the group has
+    int         done;           // How many have finished (with 'total', once complete())
+    int         ok;             // ...of those, how many succeeded
+    int         failed;         // ...and how many did not
+
+                tally(const std::string & queue, const id_t mid);
+
+    status      create(const int total);
+    status      count(const id_t kid, const bool success);
+    status      load();
+    status      remove();
+    bool        complete() const { return total && (done >= total); }
+
+  private:
+    struct rec {                // 16 bytes on disk; the first one is the header
+        uint64_t    id;         // Child job ID; 0 in the header
+        int32_t     val;        // 1 if the child succeeded, else 0; the total in the header
+        int32_t     magic;
+    };
+};
+}
+
+/*! @file
+@class job::tally
+  @brief Running count of a group job's finished children, kept on disk
+
+  When a group job is split, its tally is created with the number of
+  children.  As each child finishes for good, a record of it is appended;
+  the append is one small write, so it's atomic, and there's no lock.
+  The count of records so far is just the file's size, so each child's
+  count() costs a write and an fstat, however big the group.  When that
+  reaches the total, the records are read once and duplicates dropped
+  (a child that was counted, then re-run after a crash), so complete()
+  is exact.
+
+  The tally is kept in the queue's .tally directory, named by the group
+  job's ID.  If a group has no tally (split before there were tallies),
+  count() does nothing and complete() stays false; the group is found
+  done by the periodic check instead.
+
+@fn job::status job::tally::count(const id_t kid, const bool success)
+  @brief Count a child as finished.  Afterwards, complete() tells if the group is.
+*/
+
+#endif
@@ -19,29 +19,43 @@
     USA
 */
 
+#include "job/array.hxx"
 #include "job/base.hxx"
 #include "job/config.hxx"
 #include "job/daemon.hxx"
+#include "job/fanout.hxx"
 #include "job/file.hxx"
 #include "job/getopt.hxx"
 #include "job/isafe.hxx"
 #include "job/launch.hxx"
 #include "job/log.hxx"
+#include "job/notice.hxx"
 #include "job/path.hxx"
+#include "job/poller.hxx"
 #include "job/queue.hxx"
+#include "job/readyset.hxx"
+#include "job/slots.hxx"
+#include "job/stats.hxx"
 #include "job/status.hxx"
 #include "job/string.hxx"
-#include <algorithm>        // std::sort
+#include "job/tally.hxx"
 #include <errno.h>          // EAGAIN etc
 #include <fcntl.h>          // open(2), close(2), etc
+#include <list>
+#include <map>
 #include <pwd.h>            // getpwuid()
 #include <signal.h>         // SIGCONT, kill(), sig_atomic_t, etc
 #include <stdio.h>          // snprintf(), etc
 #include <stdlib.h>         // setenv()
+#include <string.h>         // memset()
+#include <sys/epoll.h>      // EPOLLIN
+#include <sys/inotify.h>    // IN_* event masks
+#include <sys/resource.h>   // setrlimit()
 #include <sys/stat.h>       // open(2), close(2), etc
 #include <sys/types.h>      // types for kill(), open() etc
 #include <unistd.h>         // sleep()
 #include <utmp.h>           // getutent() etc
+#include <vector>
 
 
 using job::ERR_OK;
@@ -57,17 +71,19 @@ using job::qqif;
 using job::trim;
 
 // CLI options and usage help
-enum  {opNONE, opDMN,  opHELP, opLOG,  opNOLK, 
+enum  {opNONE, opDMN,  opHELP, opLOG,  opMULT, opNOLK, 
        opQUE,  opMAXR, opPOLL, opROOT, opTPFX, opTTIM, opVERB };
 const option::Descriptor usage[] = {
     {opNONE, 0, "",  "",             Arg::None, 
-        "Daemon to manage the jobs in one queue.\n"
+        "Daemon to manage the jobs in one queue, or in many.\n"
         "This jobman daemon is typically launched by the queman daemon.\n\n"
-        "Usage: jobman [options] queue-name\n\n"
+        "Usage: jobman [options] queue-name\n"
+        "       jobman [options] --multi [queue-name...]\n\n"
         "Options:" },
     {opDMN,  0, "D", "no-daemonize", Arg::None, "  -D  --no-daemonize Run immediate; do not become a daemon"},
     {opHELP, 0, "h", "help",         Arg::None, "  -h  --help         Show this help message and exit"},
     {opLOG,  0, "l", "log-level",    Arg::Reqd, "  -l  --log-level    Debugging log level (info, verbose, debug...)"},
+    {opMULT, 0, "m", "multi",        Arg::None, "  -m  --multi        Manage many queues; queman adds and drops them"},
     {opNOLK, 0, "L", "no-locks",     Arg::None, "  -L  --no-locks     Do not use job file locking ***NYI***"},
     {opQUE,  0, "q", "queue",        Arg::Reqd, "  -q  --queue        Queue to manage"},
     {opMAXR, 0, "r", "run-limit",    Arg::Reqd, "  -r  --run-limit    Max jobs to run in this queue"},
@@ -81,67 +97,189 @@ const option::Descriptor usage[] = {
         "  There is one jobman daemon for each queue you have defined on your system.\n"
         "  Each jobman daemon manages the jobs in a queue, moving the jobs thru\n"
         "  their states, launching the job's process when they run, and so on.\n"
+        "  With --multi, one jobman daemon manages all the queues, each with its own\n"
+        "  run limit and timers; queman tells it as queues come and go.\n"
         "\n"
         },
     {0,0,0,0,0,0}
 };
 
-// Eligible job comparison function for sorting jobs to run or clean
-static size_t jobcmpofs = 0;    // string offset to the start of the filename part
-static bool   jobcompare(std::string a, std::string b) {
-    time_t a_time = 0;
-    int    a_prio = 0;
-    int    amt;
-    amt = sscanf(a.c_str()+jobcmpofs, "t%lu.p%d.", &a_time, &a_prio);
-    if (amt != 2) return false;
-    time_t b_time = 0;
-    int    b_prio = 0;
-    amt = sscanf(b.c_str()+jobcmpofs, "t%lu.p%d.", &b_time, &b_prio);
-    if (amt != 2) return false;
-    return ((a_prio == b_prio) && (a_time < b_time))
-        ||  (a_prio <  b_prio);
-}
-
-// Signal handler flags
+// Event flags
 static volatile sig_atomic_t run_jobs   = false;    // Run the jobs in queues
-static volatile sig_atomic_t check_soon = false;    // Something changed, check again soon
+static volatile sig_atomic_t check_soon = false;    // Signalled, check all queues again soon
 
 // Misc globals
 static std::string     test_prefix;     // Test prefix for process names
+static job::config*    jobcfg = NULL;   // The overall config
+static int             cli_maxjobs = -1;    // Run limit from the command line, for every queue
+static int             cli_poll    = -1;    // Poll time from the command line, ditto
+
+// Group jobs being split into their child jobs, a few at a time
+#define SPLIT_STEP 250              // child jobs made per turn of the loop
+struct split {
+    job::file*   jf;                // the group job, locked while we're at it
+    job::fanout* fo;
+};
+static std::list<split> splits;
+
+// Array jobs whose elements we're running, as run slots free up
+struct element {
+    size_t  k;                      // which element, from 0
+    time_t  start;
+};
+struct array_run {
+    job::file*        jf;           // the array job, locked while we're at it
+    job::array        ar;
+    std::string       cmd;
+    std::vector<bool> done;         // which elements are done
+    size_t            next;         // the next element to start, if not done
+    size_t            to_start;     // elements still to start (not done before, nor started)
+    std::map<pid_t, element> pids;  // elements running, by PID
+    int               ok;
+    int               failed;
+    bool              cancelled;
+};
+static std::map<job::id_t, array_run*> arrays;
+
+// A file's stat, or all zeroes if it's not there
+static struct stat stat_of(const std::string & fnam) {
+    struct stat sb;
+    if (stat(fnam.c_str(), &sb)) memset(&sb, 0, sizeof(sb));
+    return sb;
+}
+
+// A queue we work, and what the event handlers need to work it
+struct workplace {
+    job::queue      q;
+    struct stat     cfg_sb;             // The config file as we read it, to see if it's changed
+    job::config     quecfg;
+    job::readyset   pending;            // Index of pending jobs
+    job::notice     inbox;              // Where submitters tell us of new jobs
+    job::stats      board;              // Our live statistics, for jobstat(8)
+    job::stats*     scoreboard;         //  ...none if there's no /dev/shm
+    job::slots      pool;               // The node's run slots, if it shares them
+    job::launch::method_t method;       // How we start its jobs
+    int             maxjobs;
+    int             running;            // Run slots in use
+    int             age_clean;
+    bool            check_soon;         // Something changed, check again soon
+    bool            starved;            // Jobs could run, but the node has no slots for them
+    int             t_poll;             // Timers for the periodic tasks
+    int             t_sync;
+    int             t_dead;
+    int             t_kill;
+    int             t_group;
+    int             t_split;
+    int             t_clean;
+    int             w_pend;             // Watches on the pend and kill directories
+    int             w_kill;
+    int             s_note;             // The notice socket
+
+    workplace(const std::string & qname)
+        : q(qname)
+        , cfg_sb(stat_of(path.qcfdir + qname + ".conf"))
+        , quecfg(path.qcfdir + qname + ".conf")
+        , pending(q.dir_path(job::pend))
+        , inbox(qname)
+        , board(qname)
+        , scoreboard(NULL)
+        , method(job::launch::FORK)
+        , maxjobs(0)
+        , running(0)
+        , age_clean(30*86400)           // max thirty days old
+        , check_soon(false)
+        , starved(false)
+        , t_poll(-1), t_sync(-1), t_dead(-1), t_kill(-1), t_group(-1), t_split(-1), t_clean(-1)
+        , w_pend(-1), w_kill(-1), s_note(-1) {
+    }
+};
+
+// The queues we work, by name
+static std::map<std::string, workplace*> workplaces;
+
+// The queue's workplace, if we're working it
+static workplace* shop(const std::string & qname) {
+    std::map<std::string, workplace*>::iterator it = workplaces.find(qname);
+    return (it == workplaces.end()) ? NULL : it->second;
+}
+
+static void score(const std::string & qname, uint64_t job::statpage::* c) {
+    workplace* wp = shop(qname);
+    if (wp && wp->scoreboard) wp->scoreboard->add(c);
+}
+
+// When each running try (or array element) was launched, for its run time
+static std::map<pid_t, uint64_t> launched;
+
+// Record how long something took, for the job's priority and type
+static void clock_it(job::statpage::lat_t lat, const job::file & jf, const uint64_t usecs) {
+    workplace* wp = shop(jf.queue);
+    if (wp && wp->scoreboard) wp->scoreboard->latency(lat, jf.priority, jf.type, usecs);
+}
+
+// Run slots came free on the node: nudge the queue that most wants them.
+//  If it's one of ours, it's checked soon; else its jobman is told.
+static void spare_a_slot(const std::string & needy) {
+    if (needy.empty()) return;
+    workplace* wp = shop(needy);
+    if (wp) wp->check_soon = true;
+    else    job::notice(needy).send(job::stringlist(1, "."));
+}
 
 // Forward declarations
 void notify_user(const std::string & user, const std::string & msg);
-
-// Signal handler to re-check queues
-static void signal_handler(int sig) {
-    logverbose("Got signal %d...", sig);
+static void child_done(const job::file & kid, const bool success);
+static void reload_changed(job::poller & pol, const bool multi);
+
+// Signal event handler
+static int on_signal(job::poller & pol, int fd, uint32_t sig, void* ua) {
+    if (sig == SIGCHLD) {
+        job::launch::reap_zombies(true);    // fallback for children without a pidfd
+        return 0;
+    }
+    logverbose("Got signal %d...", (int)sig);
     if (sig == SIGHUP) {
         check_soon = true;
         logverbose("  ...Reset check timers");
+        reload_changed(pol, *(bool*)ua);
     }
     else if (sig == SIGTERM) {
         run_jobs = false;
         logverbose("  ...Preparing to exit");
     }
+    else if (sig == SIGUSR1) {
+        for (std::map<std::string, workplace*>::iterator it = workplaces.begin(); it != workplaces.end(); ++it) {
+            if (it->second->scoreboard) it->second->scoreboard->reset_latency();
+        }
+        loginfo("Latency statistics reset");
+    }
     else {
         logverbose("  ...No special handling for this signal");
     }
+    return 0;
 }
 
 // Job completion callback
 static int try_done(job::launch & pad, void* ua, pid_t cpid, int cstat) {
-
-    // Since a job slot just freed-up, we should look sooner for more pending jobs.
-    check_soon = true;
+    uint64_t t0 = job::stats::usecs();
 
     // Access the job file
     job::file* jf = (job::file*)ua;  // Pointer to job file passed in
+
+    // Since a job slot just freed-up, we should look sooner for more pending jobs.
+    //  (Unless we've let go of its queue.)
+    workplace* wp = shop(jf->queue);
+    if (wp) {
+        wp->check_soon = true;
+        if (wp->running > 0) --wp->running;
+        spare_a_slot(wp->pool.give(1));
+    }
+    //  Its section 0 is still in memory from when we started it, which is all we need.
     logverbose("Job %d: try done, PID %d, sig:stat=%d:%d", jf->id, cpid, pad.xsig, pad.xstat);
-    jf->load();
-    if (jf->error) {
-        delete &pad;
-        logerror("Job %d, cannot load: %s", jf->id, jf->error);
-        return EIDRM;  // see below for why this value
+    std::map<pid_t, uint64_t>::iterator lit = launched.find(cpid);
+    if (lit != launched.end()) {
+        clock_it(job::statpage::RUNNING, *jf, t0 - lit->second);
+        launched.erase(lit);
     }
 
     // Do we re-try, or be tied?
@@ -169,13 +307,18 @@ static int try_done(job::launch & pad, void* ua, pid_t cpid, int cstat) {
               : /*-*/   job::done;
     (*jf)[n]["State"] = job::state2str(jf->state);
     if (jf->state == job::done) jf->run_time = time(NULL);  // Easy for housekeeper to find
-    jf->store();
+    jf->store_section(n);                   // append it, don't rewrite the job's output
+    if (!jf->error) jf->store_headers();    // ...and this does the repath()
     if (jf->error) {
         logerror("Job %d: Cannot update job: %s", jf->id, jf->error);
         // XXX what can we do here???
     }
 
     // Show what happened
+    score(jf->queue,
+          retry ? &job::statpage::retries
+        : ((pad.xsig == 0) && (pad.xstat == 0)) ? &job::statpage::completions
+        : &job::statpage::failures);
     if (retry)
         loginfo("Job %d: Re-queued on %d:%d.  %d/%d tries.", 
                 jf->id, pad.xsig, pad.xstat, jf->try_count, jf->try_limit);
@@ -191,10 +334,16 @@ static int try_done(job::launch & pad, void* ua, pid_t cpid, int cstat) {
         notify_user(jf->submitter, msg);
     }
 
+    // The last child of a group job finishes the group
+    if (!jf->error && (jf->state == job::done) && jf->mid && jf->mnode.empty())
+        child_done(*jf, (pad.xsig == 0) && (pad.xstat == 0));
+
     // Delete objects
+    clock_it(job::statpage::REAPING, *jf, job::stats::usecs() - t0);
     delete jf;
     jf = NULL;
     delete &pad;
+    if (wp && wp->scoreboard) wp->scoreboard->timed(job::statpage::REAP, job::stats::usecs() - t0);
 
     // Return "Identifier removed" (43) because *we* deleted the pad.
     //  To not do so would cause the job::launch code to zero the
@@ -202,57 +351,41 @@ static int try_done(job::launch & pad, void* ua, pid_t cpid, int cstat) {
     return EIDRM;
 }
 
-// Break a group job into individual jobs
+// Break a group job into individual jobs.  This starts it: the children's
+//  IDs are reserved and the group job is stored as tied to them; they're
+//  made by be_fruitful_and_multiply(), a few each turn of the loop.
 job::status breaking_up_is_hard_to_do(job::file* jf) {
 
     // TODO:  check if tied list has duplicates... (do we already handle this in the jobfile?)
-    // TODO:  figure out what to do if we can't create all the child jobs,
-    //          and if we fail to create any!
-
-    logverbose("Job %d: (Group) Splitting into child jobs", jf->id);
-    for (job::ties_t::iterator it = jf->ties.begin(); it != jf->ties.end(); ++it) {
 
-        // Create new jobs
-        job::file kidjob;
-        if (kidjob.error) {
-            logerror("  Fail creating local child job: %s", kidjob.error);
-            // TODO: what else???
-            continue;
-        }
-        kidjob.copy(*jf);
-        kidjob.mid   = jf->id;
-        kidjob.uid   = jf->uid;
-        kidjob.gid   = jf->gid;
-        kidjob.mnode = "";
-        kidjob.tie_to(it->first);
-        kidjob.state = job::hold;       // always start in hold state
-        kidjob.store();
-        if (!kidjob.error) {
-            kidjob.state = job::pend;   // ...then move into pending
-            kidjob.repath();
-        }
-        if (kidjob.error) {
-            logerror("  Fail to create local child job: %s", kidjob.error);
-            kidjob.remove();            // If it fails, too bad, above error covers it
-            continue;
-        }
-        else {
-            jf->ties[it->first] = kidjob.id;
-            logverbose("  Tied '%s' to local child job %d", it->first, kidjob.id);
-        }
+    logverbose("Job %d: (Group) Splitting into %d child jobs", jf->id, jf->ties.size());
+    job::fanout* fo = new job::fanout(*jf);     // this fills in the ties
+    if (fo->error) {
+        logerror("Job %d: (Group) Cannot split: %s", jf->id, fo->error);
+        // TODO: add error completion to job
+        delete fo;
+        jf->state = job::done;
+        jf->repath();    // XXX but can we even do this here???
+        delete jf;
+        jf = NULL;
+        return ERR_ABORT;
     }
 
-    loginfo("Job %d: (Group) Split into %d child jobs", jf->id, jf->ties.size());
-    if (jf->notify) {
-        std::string msg = "\n" + logmsg + "\n";
-        notify_user(jf->submitter, msg);
-    }
+    // The children count themselves done here; none can be yet, they've not been made
+    job::tally t(jf->queue, jf->id);
+    t.create(jf->ties.size());
+    if (t.error) logwarn("Job %d: (Group) No tally, completion found by checks only: %s", jf->id, t.error);
+
+    // Store it now, so if we die partway, the split can be finished (see group_hug())
+    (*jf)[0]["Group-Fanout"] = "open";
     jf->state  = job::tied;
     jf->closed = true;
     jf->store();
+    if (!jf->error) jf->lock();     // store() let go of it
     if (jf->error) {
         logerror("Job %d: (Group) Cannot write job file: %s", jf->id, jf->error);
         // TODO: add error completion to job
+        delete fo;
         jf->state = job::done;
         jf->repath();    // XXX but can we even do this here???
         delete jf;
@@ -260,15 +393,77 @@ job::status breaking_up_is_hard_to_do(job::file* jf) {
         return ERR_ABORT;
     }
 
-    // We have jobs to do, perhaps there's some available slots?
-    check_soon = true;
-
-    // Done with group job
-    delete jf;
-    jf = NULL;
+    split sp = {jf, fo};
+    splits.push_back(sp);
     return ERR_OK;
 }
 
+// Make more child jobs of the queue's groups being split.  Each group gets a turn,
+//  then we go back to the loop so jobs keep launching, including these.
+void be_fruitful_and_multiply(const std::string & qname) {
+    for (std::list<split>::iterator it = splits.begin(); it != splits.end(); ) {
+        job::file*   jf = it->jf;
+        job::fanout* fo = it->fo;
+        if (jf->queue != qname) {
+            ++it;
+            continue;
+        }
+        fo->step(SPLIT_STEP);
+        if (fo->error) logerror("Job %d: (Group) Cannot make child job: %s", jf->id, fo->error);
+        logdebug("Job %d: (Group) %d child jobs made, %d to go", jf->id, fo->made, fo->todo.size());
+        if (!fo->done()) {
+            ++it;
+            continue;
+        }
+
+        // Split done; if some failed, the check will try them again
+        if (fo->failed) {
+            loginfo("Job %d: (Group) Split into %d child jobs, %d failed",
+                    jf->id, fo->made, fo->failed);
+        }
+        else {
+            (*jf)[0].erase("Group-Fanout");
+            loginfo("Job %d: (Group) Split into %d child jobs", jf->id, fo->made);
+        }
+        if (jf->notify) {
+            std::string msg = "\n" + logmsg + "\n";
+            notify_user(jf->submitter, msg);
+        }
+        jf->store_headers();
+        if (jf->error) logerror("Job %d: (Group) Cannot update job file: %s", jf->id, jf->error);
+
+        delete fo;
+        delete jf;
+        it = splits.erase(it);
+    }
+}
+
+// Finish the split of a group job that didn't: the ones we were making
+//  when we died, or whose children could not all be made.
+//  smap has the states of its children.
+static void mend_split(const std::string & jobfilename, job::queue::statemap_t & smap) {
+    job::file* jf = new job::file(jobfilename);
+    if (!jf->error) jf->lock();         // if someone has it, they're at it
+    if (!jf->error) jf->load(true);
+    if (jf->error) {
+        delete jf;
+        return;
+    }
+    job::fanout* fo = new job::fanout(*jf);
+    if (fo->error) {
+        logerror("Job %d: (Group) Cannot split: %s", jf->id, fo->error);
+        delete fo;
+        delete jf;
+        return;
+    }
+    for (job::ties_t::iterator it = jf->ties.begin(); it != jf->ties.end(); ++it) {
+        if (smap[it->second] != job::unk) fo->todo.erase(it->first);    // already made
+    }
+    loginfo("Job %d: (Group) Resuming split, %d child jobs to make", jf->id, fo->todo.size());
+    split sp = {jf, fo};
+    splits.push_back(sp);
+}
+
 // Check for dead or abandoned (orphan) jobs.  If any found, move them to pending.
 //  They may have been left here because we were killed off,
 //  or the system rebooted, or another jobman on another node died, etc.
@@ -308,10 +503,12 @@ void bring_out_yer_dead(job::queue & q) {
         if (jf.error) {
             if (jf.error == ERR_MOVED) {
                 logverbose("Skip locked job %d; grabbed by another job manager", jf.id);
+                score(q.qname, &job::statpage::moved);
                 continue;
             }
             if (jf.error == ERR_LOCKED) {
                 logverbose("Skip locked job %d; locked by another job manager", jf.id);
+                score(q.qname, &job::statpage::locked);
                 continue;
             }
             logerror("Job %s: stuck, cannot repath: %s", jf.id, jf.error);
@@ -331,30 +528,69 @@ void bring_out_yer_dead(job::queue & q) {
     logverbose("  ...%d dead jobs resurrected", n);
 }
 
-// Check group job completion
+// A group job's children are all done, so it is too.
+//  Its section 0 must be loaded.
+static bool group_done(job::file & jf, job::tally & t) {
+    if (t.total) {
+        jf[0]["Group-OK"]     = int2str(t.ok);
+        jf[0]["Group-Failed"] = int2str(t.failed);
+    }
+    jf.state = job::done;
+    jf.run_time = time(NULL);
+    jf.store_headers();     // ...and the repath()
+    if (jf.error && (jf.error != ERR_MOVED)) {
+        logerror("Job %d: (Group) Cannot move to done: %s", jf.id, jf.error);
+        return false;
+    }
+    if (t.total) loginfo("Job %d: (Group) Done (all child jobs done: %d ok, %d failed)",
+                         jf.id, t.ok, t.failed);
+    else         loginfo("Job %d: (Group) Done (all child jobs done)", jf.id);
+    if (jf.notify) {
+        std::string msg = "\n" + logmsg + "\n";
+        notify_user(jf.submitter, msg);
+    }
+    t.remove();
+    return true;
+}
+
+// A child of a group job is done for good; count it, and if it's the last,
+//  the group job is done now.
+static void child_done(const job::file & kid, const bool success) {
+    job::tally t(kid.queue, kid.mid);
+    t.count(kid.id, success);
+    if (t.error) {
+        logwarn("Job %d: (Group) Cannot count child job %d: %s", kid.mid, kid.id, t.error);
+        return;
+    }
+    logdebug("Job %d: (Group) %d/%d child jobs done", kid.mid, t.done, t.total);
+    if (!t.complete()) return;
+
+    job::file jf(kid.mid);
+    if (!jf.error) jf.load(true);
+    if (jf.error) {
+        logerror("Job %d: (Group) Cannot load: %s", kid.mid, jf.error);
+        return;
+    }
+    if (jf.state != job::tied) return;      // not ours to finish
+    group_done(jf, t);
+}
+
+// Check group job completion.  Groups are normally finished by their last
+//  child (see child_done()); this catches any that weren't, such as when
+//  we died at the wrong moment, or a group has no tally.  The states of all
+//  the children, of all groups, are looked up in one pass over the queue.
 void group_hug(job::queue & q) {
     logverbose("Checking tied jobs for completion...");
 
-    // Find tied jobs
+    // Find tied jobs and their children
     int ndone  = 0;
     int ngroup = 0;
     job::stringlist tied_jobs = q.get_jobs_by_state(job::tied);
-
-    // Build map to hold job states
+    job::queue::statemap_t smap;
     for (size_t i=0; i<tied_jobs.size(); ++i) {
-
-        // Parse out the job ID from the file name
         job::file jf(tied_jobs[i]);
-        if (!jf.error) jf.load();   // load it to get ties
-        if (jf.error) {
-            logverbose("Job %d: load: %s", jf.id, jf.error);
-            continue;
-        }
-        ++ngroup;
-        logdebug("Job %d: (Group) Has %d child jobs", jf.id, jf.ties.size());
-
-        // Build statemap for tied jobs
-        job::queue::statemap_t smap;
+        if (!jf.error) jf.load(true);   // load it to get ties
+        if (jf.error) continue;
         for (job::ties_t::iterator it = jf.ties.begin();
                                    it != jf.ties.end();
                                    ++it) {
@@ -363,22 +599,43 @@ void group_hug(job::queue & q) {
             ////if (!it->second) continue;  // Job not tied yet
             smap[it->second] = job::unk;
         }
+    }
+    if (smap.empty()) {
+        logverbose("  ...no tied jobs");
+        return;
+    }
+
+    // Lookup job child job states
+    q.get_states_of_jobs(smap);
+    if (q.error) {
+        logerror("get_states_of_jobs: %s", q.error);
+        return;
+    }
+
+    for (size_t i=0; i<tied_jobs.size(); ++i) {
+        job::file jf(tied_jobs[i]);
+        if (!jf.error) jf.load(true);
+        if (jf.error) {
+            logverbose("Job %d: load: %s", jf.id, jf.error);
+            continue;
+        }
+        ++ngroup;
+        logdebug("Job %d: (Group) Has %d child jobs", jf.id, jf.ties.size());
 
-        // Lookup job child job states
-        q.get_states_of_jobs(smap);
-        if (q.error) {
-            logerror("get_states_of_jobs: %s", q.error);
-            return;
+        // Not all made yet?
+        if (jf.exists(0, "Group-Fanout")) {
+            mend_split(tied_jobs[i], smap);
+            continue;
         }
 
         // If all are done, then the tied job is also done
         //  Note: a child job on hold also holds-up the group job
         //     (the group job stays tied while the child is held)
         bool all_done = true;
-        for (job::queue::statemap_t::iterator it = smap.begin();
-                                              it != smap.end();
-                                              ++it) {
-            if (it->second != job::done) {
+        for (job::ties_t::iterator it = jf.ties.begin();
+                                   it != jf.ties.end();
+                                   ++it) {
+            if (smap[it->second] != job::done) {
                 all_done = false;
                 break;
             }
@@ -388,25 +645,15 @@ void group_hug(job::queue & q) {
             continue;
         }
 
-        jf.state = job::done;
-        jf.run_time = time(NULL);
-        jf.repath();
-        if (jf.error && (jf.error != ERR_MOVED)) {
-            logerror("Job %d: (Group) Cannot move to done: %s", jf.id, jf.error);
-            continue;
-        }
-        ++ndone;
-        loginfo("Job %d: (Group) Done (all child jobs done)", jf.id);
-        if (jf.notify) {
-            std::string msg = "\n" + logmsg + "\n";
-            notify_user(jf.submitter, msg);
-        }
+        job::tally t(jf.queue, jf.id);
+        if (t.load()) t.total = 0;      // no tally; we can't say how they did
+        if (group_done(jf, t)) ++ndone;
     }
     logverbose("  ...%d/%d tied jobs now complete", ndone, ngroup);
 }
 
-// Housekeeping by Kelly
-void kellys_kleaning_kompany(job::queue & q, const int age_clean) {
+// Housekeeping by Kelly.  Returns true if she ran out of time, with more to do.
+bool kellys_kleaning_kompany(job::queue & q, const int age_clean) {
 
     loginfo("Begin housekeeping: max age %d secs...", age_clean);
     int n = 0;
@@ -414,7 +661,7 @@ void kellys_kleaning_kompany(job::queue & q, const int age_clean) {
     DIR* dirp = opendir(donedir.c_str());
     if (!dirp) {
         logerror("opendir: %s", SYS_status);
-        return;
+        return false;
     }
 
     bool timed_out = false;
@@ -432,32 +679,30 @@ void kellys_kleaning_kompany(job::queue & q, const int age_clean) {
         }
 
         // Is it a job file?
-        time_t      run_time;
-        int         priority;
-        job::id_t   id;
-        std::string submitter;
-        status e = job::file::parse(d->d_name, run_time, priority, id, submitter);
-        if (e) {
-            logdump("    not a job file: %s", e);
+        job::jobkey k;
+        if (!k.parse(d->d_name)) {
+            logdump("    not a job file");
             continue;
         }
 
         // Old enough to purge?
-        string path = donedir + d->d_name;
-        if ((run_time + age_clean) < now) {
+        if ((k.run_time + age_clean) < now) {
+            string path = donedir + d->d_name;
             int err = isafe::unlink(path.c_str());
             if (err) {
                 logerror("Cannot cleanup job file %s: %s", path, IO_status);
             }
             else {
                 ++n;
+                isafe::unlink(job::file::index_name(q.qname, k.id).c_str());   // if any
+                isafe::unlink(job::file::id_name(k.id).c_str());
                 logverbose("Purged old jobfile %s", path);
             }
         }
     }
     if (closedir(dirp)) logerror("Cannot close dir %s: %s", donedir, IO_status);
-    if (timed_out) check_soon = true;  // Come back sooner!
     loginfo("  ...%d old job files purged%s", n, timed_out? " (maybe more to do later)" : "");
+    return timed_out;
 }
 
 // Notify a user
@@ -492,8 +737,310 @@ void notify_user(const std::string & user, const std::string & msg) {
     endutent(); // close the utmp file
 }
 
+// Setup a job's environment
+//  Note: we do it here, instead of in the envp, so the command expansion (wordexp())
+//  also has the environment available.  It's ok to do it here b/c we replace this 
+//  whole set every time thru.
+// Note also that we (jobman) *should* be launched as a daemon,
+//  so we'll already have a reduced set of envvars.
+static void set_job_env(const job::file & jf) {
+    setenv("JOB_FILE",      jf.name().c_str(), 1);
+    setenv("JOB_ID",        int2str(jf.id).c_str(), 1);
+    setenv("JOB_MASTER_ID", jf.mid ? int2str(jf.mid).c_str() : "", 1);
+    setenv("JOB_PRIORITY",  int2str(jf.priority).c_str(), 1);
+    setenv("JOB_QUEUE",     jf.queue.c_str(), 1);
+    setenv("JOB_RUN_AT",    tim2str(jf.run_time).c_str(), 1);
+    setenv("JOB_STATE",     state2str(jf.state).c_str(), 1);    // will always be "run" here!
+    setenv("JOB_SUBMITTER", jf.submitter.c_str(), 1);
+    setenv("JOB_SUBSTATUS", jf.substatus.c_str(), 1);
+    setenv("JOB_TRY_COUNT", int2str(jf.try_count).c_str(), 1);
+    setenv("JOB_TRY_LIMIT", int2str(jf.try_limit).c_str(), 1);
+    setenv("JOB_TYPE",      jf.type.c_str(), 1);
+    unsetenv("JOB_ARRAY_INDEX");                                    // only for array jobs
+        // TODO: lots more, such as:
+        // JOB_ARG_n (is it sufficient that it's passed in the argv[] array??)
+        // JOB_COMMAND (see above, it would be argv[0], but does set process name bork this? TODO)
+
+    // Additional environment stuff, based on the user who submitted this job
+    struct passwd* pwinfo = getpwuid(jf.uid);
+SUPPRESS_DIAGNOSTIC_START(-Wunused-result)
+    if (pwinfo) {
+        chdir(pwinfo->pw_dir);
+        setenv("HOME",  pwinfo->pw_dir, 1);
+        setenv("PWD",   pwinfo->pw_dir, 1);
+        setenv("SHELL", pwinfo->pw_shell, 1);
+        setenv("USER",  pwinfo->pw_name, 1);
+    }
+    else {
+        chdir("/tmp");
+        setenv("HOME",  "/tmp", 1);
+        setenv("PWD",   "/tmp", 1);
+        setenv("SHELL", "", 1);
+        setenv("USER",  "", 1);
+    }
+SUPPRESS_DIAGNOSTIC_END
+}
+
+// Is this one of the array jobs we're running?
+static array_run* our_array(const std::string & jobfilename) {
+    for (std::map<job::id_t, array_run*>::iterator it = arrays.begin(); it != arrays.end(); ++it) {
+        if (it->second->jf->name() == jobfilename) return it->second;
+    }
+    return NULL;
+}
+
+// Are there more elements of the array to start?
+static bool more_to_start(array_run* ar) {
+    while ((ar->next < ar->done.size()) && ar->done[ar->next]) ++ar->next;
+    return !ar->cancelled && (ar->next < ar->done.size());
+}
+
+// An array job's elements are all done (or it's cancelled, and none are running)
+static void array_done(array_run* ar) {
+    job::file* jf = ar->jf;
+    int skipped = 0;
+    for (size_t k = 0; k < ar->done.size(); k++) skipped += !ar->done[k];
+    (*jf)[0]["Array-OK"]     = int2str(ar->ok);
+    (*jf)[0]["Array-Failed"] = int2str(ar->failed);
+    if (skipped) (*jf)[0]["Array-Skipped"] = int2str(skipped);
+    jf->state    = job::done;
+    jf->run_time = time(NULL);  // Easy for housekeeper to find
+    jf->store_headers();
+    if (jf->error) logerror("Job %d: Cannot update job: %s", jf->id, jf->error);
+    loginfo("Job %d: (Array) Done (%d elements: %d ok, %d failed, %d not run)",
+            jf->id, (int)ar->done.size(), ar->ok, ar->failed, skipped);
+    if (jf->notify) {
+        std::string msg = "\n" + logmsg + "\n";
+        notify_user(jf->submitter, msg);
+    }
+    arrays.erase(jf->id);
+    delete jf;
+    delete ar;
+}
+
+// Add an element's output and result to the array's job file.
+//  If it's the last element, the array is done.
+static void element_result(array_run* ar, const element & el, const int xsig, const int xstat,
+                           const std::string & note = "") {
+    job::file* jf = ar->jf;
+    uint64_t index = ar->ar.at(el.k);
+    ar->done[el.k] = true;
+    ((xsig == 0) && (xstat == 0)) ? ++ar->ok : ++ar->failed;
+    score(jf->queue, ((xsig == 0) && (xstat == 0)) ? &job::statpage::completions : &job::statpage::failures);
+    bool last = ar->pids.empty() && !more_to_start(ar);
+
+    // Its output is in a file of its own, until now; it's copied across, not read in
+    std::string out = job::array::output_name(jf->queue, jf->id, index);
+    int fd = isafe::open(out.c_str(), O_RDONLY | O_NOFOLLOW | O_NONBLOCK);
+
+    size_t n = jf->size();
+    jf->resize(n+2);
+    (*jf)[n]["Section"]       = "output";
+    (*jf)[n]["Array-Index"]   = int2str(index);
+    (*jf)[n]["Start-Time"]    = tim2str(el.start);
+    (*jf)[n]["__BODY__"]      = "\n";  // then the output file's
+    (*jf)[n+1]["Section"]     = "result";
+    (*jf)[n+1]["Array-Index"] = int2str(index);
+    (*jf)[n+1]["End-Time"]    = tim2str(time(NULL));
+    if (note.size()) (*jf)[n+1]["Exit-Note"] = note;
+    (*jf)[n+1]["Exit-Signal"] = int2str(xsig);
+    (*jf)[n+1]["Exit-Status"] = int2str(xstat);
+    (*jf)[n+1]["__BODY__"]    = "";    // none
+    jf->closed = last;
+    jf->store_section(n, fd);               // append them, don't rewrite the array's output
+    if (!jf->error) jf->store_section(n+1);
+    if (jf->error) logerror("Job %d[%d]: Cannot update job: %s", jf->id, (int)index, jf->error);
+    if (fd >= 0) isafe::close(fd);
+    jf->resize(1);
+    isafe::unlink(out.c_str());
+
+    if (last) array_done(ar);
+}
+
+// Array element completion callback
+static int element_done(job::launch & pad, void* ua, pid_t cpid, int cstat) {
+    job::file* jf = (job::file*)ua;     // The array job, shared by its running elements
+
+    // A run slot just freed-up
+    workplace* wp = shop(jf->queue);
+    if (wp) {
+        wp->check_soon = true;
+        if (wp->running > 0) --wp->running;
+        spare_a_slot(wp->pool.give(1));
+    }
+    std::map<job::id_t, array_run*>::iterator it = arrays.find(jf->id);
+    std::map<pid_t, element>::iterator e;
+    if ((it == arrays.end()) || ((e = it->second->pids.find(cpid)) == it->second->pids.end())) {
+        logerror("Job %d: Unknown array element done, PID %d", jf->id, cpid);
+        delete &pad;
+        return EIDRM;
+    }
+    array_run* ar = it->second;
+    element el = e->second;
+    ar->pids.erase(e);
+
+    if (pad.xsig == 0 && pad.xstat == 0)
+        loginfo("Job %d[%d]: Complete, success.", jf->id, (int)ar->ar.at(el.k));
+    else
+        loginfo("Job %d[%d]: Failed %d:%d.", jf->id, (int)ar->ar.at(el.k), pad.xsig, pad.xstat);
+    uint64_t t0 = job::stats::usecs();
+    std::map<pid_t, uint64_t>::iterator lit = launched.find(cpid);
+    if (lit != launched.end()) {
+        clock_it(job::statpage::RUNNING, *jf, t0 - lit->second);
+        launched.erase(lit);
+    }
+    int prio = jf->priority;
+    std::string type = jf->type;            // the array may be done, and gone, after this
+    element_result(ar, el, pad.xsig, pad.xstat);
+    uint64_t took = job::stats::usecs() - t0;
+    if (wp && wp->scoreboard) {
+        wp->scoreboard->latency(job::statpage::REAPING, prio, type, took);
+        wp->scoreboard->timed(job::statpage::REAP, took);
+    }
+
+    // Delete the pad; see try_done() as to why EIDRM
+    delete &pad;
+    return EIDRM;
+}
+
+// Start the next element of an array job.  Once they're all started,
+//  the array job moves from pending to run.
+static job::status run_an_element(array_run* ar) {
+    if (!more_to_start(ar)) return ERR_AGAIN;
+    uint64_t t0 = job::stats::usecs();
+    job::file* jf = ar->jf;
+    workplace* wp = shop(jf->queue);
+    if (!wp) return ERR_AGAIN;          // we've let go of its queue
+    element el;
+    el.k     = ar->next++;
+    el.start = time(NULL);
+    --ar->to_start;
+    uint64_t index = ar->ar.at(el.k);
+
+    // Its output goes to a file of its own, owned by the job's user
+    std::string out = job::array::output_name(jf->queue, jf->id, index);
+    int fd = isafe::open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0660);
+    if ((fd < 0) && (SYS_errno == ENOENT)) {
+        mkdir(out.substr(0, out.rfind('/')).c_str(), 0755);     // first one here
+        fd = isafe::open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0660);
+    }
+    if ((fd < 0) || (jf->uid && jf->gid && fchown(fd, jf->uid, jf->gid))) {
+        std::string note = "Cannot create " + out + ": " + std::string(SYS_status);
+        logerror("Job %d[%d]: %s", jf->id, (int)index, note);
+        if (fd >= 0) isafe::close(fd);
+        element_result(ar, el, 0, EACCES, note);
+        return ERR_AGAIN;
+    }
+    isafe::close(fd);
+
+    set_job_env(*jf);
+    setenv("JOB_STATE",       state2str(job::run).c_str(), 1);
+    setenv("JOB_ARRAY_INDEX", int2str(index).c_str(), 1);
+
+    // Launch it
+    job::launch* pad = new job::launch; // deleted in element completion handler
+    pad->command   = ar->cmd;
+    pad->niceness  = jf->priority;
+    pad->logfile   = out;
+    pad->procname  = "job " + int2str(jf->id) + "[" + int2str(index) + "]";
+    pad->append    = true;
+    pad->kill_kids = true;
+    pad->method    = wp->method;
+    pad->term_cb   = element_done;
+    pad->term_ua   = jf;                // the array's, not deleted by the handler
+    pad->uid       = jf->uid;
+    pad->gid       = jf->gid;
+
+    pad->start();
+    if (pad->error) {
+        std::string note = "Cannot launch: " + std::string(pad->error);
+        logerror("Job %d[%d]: %s\n\tCommand: %s", jf->id, (int)index, note, ar->cmd);
+        delete pad;
+        element_result(ar, el, 0, ENOEXEC, note);
+        return ERR_ABORT;
+    }
+    ar->pids[pad->pid] = el;
+    ++wp->running;
+    score(jf->queue, &job::statpage::launches);
+    launched[pad->pid] = job::stats::usecs();
+    clock_it(job::statpage::STARTING, *jf, launched[pad->pid] - t0);
+    loginfo("Job %d[%d]: Started as PID %d", jf->id, (int)index, pad->pid);
+
+    // All started?  Then the array's running, not pending
+    if (!more_to_start(ar) && (jf->state != job::run)) {
+        jf->state = job::run;
+        jf->store_headers();
+        if (jf->error) logerror("Job %d: Cannot update job: %s", jf->id, jf->error);
+    }
+    return ERR_OK;
+}
+
+// Take on an array job: find which of its elements are done already (we may
+//  be picking up after a restart), then start the first of the rest.  The
+//  array stays in pending, and locked by us, while there are more to start.
+static job::status take_up_array(job::file* jf, const std::string & cmd) {
+    array_run* ar = new array_run;
+    ar->jf        = jf;
+    ar->cmd       = cmd;
+    ar->next      = 0;
+    ar->to_start  = 0;
+    ar->ok        = 0;
+    ar->failed    = 0;
+    ar->cancelled = false;
+    ar->ar.parse(jf->get(0, "Job-Array"));
+    if (ar->ar.error) {
+        logerror("Job %d: %s", jf->id, ar->ar.error);
+        jf->state = job::done;
+        jf->repath();
+        delete jf;
+        delete ar;
+        return ERR_AGAIN;
+    }
+    ar->done.assign(ar->ar.size(), false);
+
+    jf->load_headers();
+    for (size_t s = 1; s < jf->size(); s++) {
+        if ((jf->get(s, "Section") != "result") || !jf->exists(s, "Array-Index")) continue;
+        uint64_t index = strtoull(jf->get(s, "Array-Index").c_str(), NULL, 10);
+        if ((index < ar->ar.first) || (index > ar->ar.last)) continue;
+        if ((index - ar->ar.first) % ar->ar.step) continue;
+        size_t k = (index - ar->ar.first) / ar->ar.step;
+        if (ar->done[k]) continue;
+        ar->done[k] = true;
+        (jf->geti(s, "Exit-Signal", 0) || jf->geti(s, "Exit-Status", 0)) ? ++ar->failed : ++ar->ok;
+    }
+    jf->resize(1);
+    ar->to_start = ar->done.size() - (ar->ok + ar->failed);
+    arrays[jf->id] = ar;
+
+    loginfo("Job %d: (Array) Running %d elements, %d done before",
+            jf->id, (int)ar->done.size(), ar->ok + ar->failed);
+    if (!more_to_start(ar)) {
+        array_done(ar);         // all were
+        return ERR_AGAIN;
+    }
+    return run_an_element(ar);
+}
+
+// Cancel an array job: start no more of its elements, and kill those running
+static void cancel_array(array_run* ar) {
+    ar->cancelled = true;
+    loginfo("Job %d: (Array) Cancelled, killing %d running elements", ar->jf->id, (int)ar->pids.size());
+    for (std::map<pid_t, element>::iterator it = ar->pids.begin(); it != ar->pids.end(); ++it) {
+        if (kill(it->first, SIGTERM))
+            logerror("Job %d[%d]: Cannot kill PID %d: %s",
+                     ar->jf->id, (int)ar->ar.at(it->second.k), it->first, SYS_status);
+    }
+    if (ar->pids.empty()) array_done(ar);
+}
+
 // Run a job - a single one or a group
-job::status run_a_job(const std::string & jobfilename, job::config & quecfg) {
+job::status run_a_job(const std::string & jobfilename, workplace & wp) {
+
+    // One of our array jobs?  Then it's time for its next element
+    array_run* ar = our_array(jobfilename);
+    if (ar) return run_an_element(ar);
+    uint64_t t0 = job::stats::usecs();
 
     // Load job
     logverbose("Grabbed pending job '%s'", jobfilename);
@@ -530,8 +1077,8 @@ job::status run_a_job(const std::string & jobfilename, job::config & quecfg) {
         return ERR_AGAIN;
     }
 
-    // Slurp-in the job file
-    jf->load();
+    // Load the job file's attributes; its output from earlier tries stays on disk
+    jf->load(true);
     if (jf->error) {
         logerror("Job %d: Cannot load: %s", jf->id, jf->error); // TODO: really a warning
         // TODO: add error completion to job
@@ -543,16 +1090,26 @@ job::status run_a_job(const std::string & jobfilename, job::config & quecfg) {
         return ERR_AGAIN;
     }
 
+    if (jf->try_count) jf->load_headers();  // for the sub-status from earlier tries' output
+
+    // It's been pending since it was last moved, which changed its ctime; it could run
+    //  from then, or from its run time if later.  The first time, that's since it was submitted.
+    uint64_t pended   = (uint64_t)jf->statbuf.st_ctim.tv_sec * 1000000 + jf->statbuf.st_ctim.tv_nsec / 1000;
+    uint64_t eligible = (jf->run_time > 0) ? (uint64_t)jf->run_time * 1000000 : 0;
+    if (eligible < pended) eligible = pended;
+    bool first_try = !jf->try_count;
+    size_t fresh = jf->size();              // sections from here on are new, to be appended
+
     // Group job?  Break it out here and return...
     if (jf->ties.size() >= 2) {
         return breaking_up_is_hard_to_do(jf);
     }
 
-    // If the last section was 'output', not 'result', then it
-    //  must have been a killed job, or the job manager died.
+    // If the job file says it was still running (its last section is 'output',
+    //  not 'result'), then it must have been a killed job, or the job manager died.
     //  So, insert a result section.
     size_t m = jf->size();
-    if ((m > 1) && ((*jf)[m-1]["Section"] == "output")) {
+    if (jf->get(0, "job-state") == "run") {
         jf->resize(m+1);
         (*jf)[m]["Section"]     = "result";
         (*jf)[m]["State"]       = job::state2str(jf->state);    // Should always be run!
@@ -578,7 +1135,7 @@ job::status run_a_job(const std::string & jobfilename, job::config & quecfg) {
     }
     else {
         // Look up the command from the type
-        cmd = quecfg.get("type:" + jf->type, "command");
+        cmd = wp.quecfg.get("type:" + jf->type, "command");
         trim(cmd);
         if (cmd.empty()) {
             logerror("Job %d: type '%s' undefined", jf->id, jf->type);
@@ -611,9 +1168,11 @@ job::status run_a_job(const std::string & jobfilename, job::config & quecfg) {
         return ERR_AGAIN;
     }
 
+    // Array job?  Its elements run from here on, as run slots free up
+    if (jf->exists(0, "Job-Array")) return take_up_array(jf, cmd);
+
     // Start next header section in job file
     //  so it's ready to have output appended to it.
-    // TODO: make this a func in job::file, so it appends to the file, not rewrites the whole thing
     size_t n = jf->size();
     jf->resize(n+1);
     (*jf)[n]["Section"]    = "output";
@@ -623,49 +1182,12 @@ job::status run_a_job(const std::string & jobfilename, job::config & quecfg) {
     jf->closed = false;
 
     // Setup job environment
-    //  Note: we do it here, instead of in the envp, so the command expansion (wordexp())
-    //  also has the environment available.  It's ok to do it here b/c we replace this 
-    //  whole set every time thru.
-    // Note also that we (jobman) *should* be launched as a daemon,
-    //  so we'll already have a reduced set of envvars.
-    setenv("JOB_FILE",      jf->name().c_str(), 1);
-    setenv("JOB_ID",        int2str(jf->id).c_str(), 1);
-    setenv("JOB_MASTER_ID", jf->mid ? int2str(jf->mid).c_str() : "", 1);
-    setenv("JOB_PRIORITY",  int2str(jf->priority).c_str(), 1);
-    setenv("JOB_QUEUE",     jf->queue.c_str(), 1);
-    setenv("JOB_RUN_AT",    tim2str(jf->run_time).c_str(), 1);
-    setenv("JOB_STATE",     state2str(jf->state).c_str(), 1);    // will always be "run" here!
-    setenv("JOB_SUBMITTER", jf->submitter.c_str(), 1);
-    setenv("JOB_SUBSTATUS", jf->substatus.c_str(), 1);
-    setenv("JOB_TRY_COUNT", int2str(jf->try_count).c_str(), 1);
-    setenv("JOB_TRY_LIMIT", int2str(jf->try_limit).c_str(), 1);
-    setenv("JOB_TYPE",      jf->type.c_str(), 1);
-        // TODO: lots more, such as:
-        // JOB_ARG_n (is it sufficient that it's passed in the argv[] array??)
-        // JOB_COMMAND (see above, it would be argv[0], but does set process name bork this? TODO)
+    set_job_env(*jf);
 
-    // Additional environment stuff, based on the user who submitted this job
-    struct passwd* pwinfo = getpwuid(jf->uid);
-SUPPRESS_DIAGNOSTIC_START(-Wunused-result)
-    if (pwinfo) {
-        chdir(pwinfo->pw_dir);
-        setenv("HOME",  pwinfo->pw_dir, 1);
-        setenv("PWD",   pwinfo->pw_dir, 1);
-        setenv("SHELL", pwinfo->pw_shell, 1);
-        setenv("USER",  pwinfo->pw_name, 1);
-    }
-    else {
-        chdir("/tmp");
-        setenv("HOME",  "/tmp", 1);
-        setenv("PWD",   "/tmp", 1);
-        setenv("SHELL", "", 1);
-        setenv("USER",  "", 1);
-    }
-SUPPRESS_DIAGNOSTIC_END
-
-    // Move to RUN state
+    // Move to RUN state: append the new sections, then update the headers in place
     jf->state = job::run;
-    jf->store();    // remember, store() does a repath() too if needed
+    for (size_t s = fresh; !jf->error && (s < jf->size()); ++s) jf->store_section(s);
+    if (!jf->error) jf->store_headers();    // remember, this does a repath() too
     if (jf->error) {
         logerror("Job %d: Cannot write job file: %s", jf->id, jf->error);
         // TODO: add error completion to job
@@ -679,8 +1201,9 @@ SUPPRESS_DIAGNOSTIC_END
     // Now that the jobfile is written, we no longer need to keep
     //  the loaded part of the file in memory.  But we do want to 
     //  keep the job::file object since it has fd's and such that
-    //  _do_ matter.  It's the vector of maps we don't need anymore.
-    jf->clear();
+    //  _do_ matter, and section 0 for when the job is done.
+    //  It's the rest of the vector of maps we don't need anymore.
+    jf->resize(1);
 
     // Launch it
     job::launch* pad = new job::launch; // deleted in child completion handler
@@ -690,6 +1213,7 @@ SUPPRESS_DIAGNOSTIC_END
     pad->procname  = "job " + int2str(jf->id);
     pad->append    = true;
     pad->kill_kids = true;
+    pad->method    = wp.method;
     pad->term_cb   = try_done;
     pad->term_ua   = jf;                // deleted in child handler
     pad->uid       = jf->uid;
@@ -713,6 +1237,13 @@ SUPPRESS_DIAGNOSTIC_END
         return ERR_ABORT;
     }
     jf->pid = pad->pid;
+    ++wp.running;
+    score(jf->queue, &job::statpage::launches);
+    launched[pad->pid] = job::stats::usecs();
+    clock_it(job::statpage::STARTING, *jf, launched[pad->pid] - t0);
+    uint64_t now = job::stats::wall_usecs();
+    if (now > eligible) clock_it(job::statpage::WAITED, *jf, now - eligible);
+    if (first_try && (now > pended)) clock_it(job::statpage::SUBMITTED, *jf, now - pended);
     loginfo("Job %d: Started as PID %d", jf->id, pad->pid);
     if (jf->notify) {
         std::string msg = "\n" + logmsg + "\n";
@@ -723,37 +1254,65 @@ SUPPRESS_DIAGNOSTIC_END
 }
 
 // Look for jobs to run
-void solicit_on_the_street(job::queue & q, const size_t maxjobs, job::config & quecfg) {
+void solicit_on_the_street(workplace & wp) {
+    job::queue    & q       = wp.q;
+    job::readyset & pending = wp.pending;
+    const int       maxjobs = wp.maxjobs;
     logverbose("Soliciting queue %s for work...", q.qname);
 
     // Do we have room to take on work?
-    int nrun = job::launch::running();
-    size_t need = maxjobs - nrun;
+    int nrun = wp.running;
+    int need = maxjobs - nrun;
     if (need <= 0) {
         logverbose("  Queue %s: %d/%d running jobs", q.qname, nrun, maxjobs);
+        wp.pool.take(0);                // we want no more of the node's slots, for now
+        wp.starved = false;
         return;
     }
 
-    // Job selection - go thru pending jobs, find most eligible
-    job::stringlist pendjobs = q.get_jobs_by_state(job::pend, time(0));
+    // ...and does the node?  Ask for what we could start now: the eligible jobs,
+    //  and the rest of the array jobs we're running.
+    time_t now = time(NULL);
+    int ready = pending.eligible(now);
     logverbose("  Queue %s: %d/%d slots running, %d waiting to run", 
-                q.qname, nrun, maxjobs, pendjobs.size());
-    if (pendjobs.empty()) return;
-
-    // Sort by priority, then take what we need off the top
-    jobcmpofs = q.dir_path(job::pend).size();
-    std::sort(pendjobs.begin(), pendjobs.end(), jobcompare);
-    for (size_t i=0; (i < pendjobs.size()) && (i < need); i++) {
-
-        // Let's go to work...
-        int err = run_a_job(pendjobs[i], quecfg);
-        if ((err == ERR_MOVED) ||
-            (err == ERR_LOCKED) ||
-            (err == ERR_AGAIN)) {
-            // grabbed by another jobman, so we can take another job
-            need++;
+                q.qname, nrun, maxjobs, ready);
+    for (std::map<job::id_t, array_run*>::iterator it = arrays.begin(); it != arrays.end(); ++it) {
+        array_run* ar = it->second;
+        if ((ar->jf->queue == q.qname) && !ar->cancelled) ready += ar->to_start;
+    }
+    int asked   = (ready < need) ? ready : need;
+    int granted = wp.pool.take(asked);
+    wp.starved  = (granted < asked);
+    if (wp.starved) logverbose("  Queue %s: %d/%d node run slots to be had", q.qname, granted, asked);
+    need = granted;
+
+    // Job selection - take the most eligible off the top of the pending index
+    while (need > 0) {
+        job::stringlist pendjobs;
+        if (!pending.next(now, need, pendjobs)) break;
+        for (size_t i=0; i < pendjobs.size(); i++) {
+
+            // Let's go to work...
+            int err = run_a_job(pendjobs[i], wp);
+
+            // An array job gets back in line for its next element
+            array_run* ar = our_array(pendjobs[i]);
+            if (ar && more_to_start(ar)) pending.add(pendjobs[i].substr(pendjobs[i].rfind('/') + 1));
+            if (err == ERR_MOVED)  score(q.qname, &job::statpage::moved);
+            if (err == ERR_LOCKED) score(q.qname, &job::statpage::locked);
+            if ((err == ERR_MOVED) ||
+                (err == ERR_LOCKED) ||
+                (err == ERR_AGAIN)) {
+                // grabbed by another jobman, so we can take another job
+                continue;
+            }
+            --need;
         }
     }
+
+    // Give back the node's slots we didn't use
+    int used = wp.running - nrun;
+    if (granted > used) spare_a_slot(wp.pool.give(granted - used));
 }
 
 // Killing-off (cancel) our own jobs marked with a kill file.
@@ -786,6 +1345,17 @@ void terminate_with_predjudice(job::queue & q) {
         if (!jid) continue;
         logdump("  Found kill order for job %d", jid);
 
+        // One of our array jobs?  Start no more of it, and kill what's running
+        std::map<job::id_t, array_run*>::iterator ait = arrays.find(jid);
+        if (ait != arrays.end()) {
+            std::string fullpath = killdir + d->d_name;
+            if (isafe::unlink(fullpath.c_str()))
+                logerror("  Cannot cleanup kill file %s: %s", fullpath, IO_status);
+            cancel_array(ait->second);
+            ++n;
+            continue;
+        }
+
         // It must be one of ours, if not, then skip
         //(go thru job::launch::finmap, (job::file*)second->term_ua is jf, check jf.id)
         pid_t pid = 0;
@@ -831,83 +1401,415 @@ void terminate_with_predjudice(job::queue & q) {
 }
 
 
-// Main work loop - periodically do various tasks
-void will_work_for_food(job::queue  & q, 
-                        job::config & quecfg,
-                        int maxjobs,
-                        int next_poll,
-                        int test_end) {
+// Count the queue's jobs in each state, for the scoreboard
+    static int _census_cb(const job::queue & q, const job::jobkey & k, job::state_t s, void* ua) {
+        ++((int64_t*)ua)[s];
+        return 1;
+    }
 
-    // Setup intervals for time-based things, and some limits
-    time_t now = time(NULL);
-    int age_clean  = 30*86400;      // max thirty days old
-    int next_reap  = 1;             // every second
-    int next_group = 15;            // four times a minute
-    int next_dead  = 180;           // check for dead jobs every 3 mins
-    int next_kill  = 30;            // twice a minute
-    int next_clean = 12*3600;       // twice a day
-    time_t when_reap  = 0;
-    time_t when_dead  = now + 1;
-    time_t when_poll  = now + 3;
-    time_t when_group = now + 4;
-    time_t when_kill  = now + 6;
-    time_t when_clean = now + 13;
+void take_census(workplace & wp) {
+    if (!wp.scoreboard) return;
+    job::queue & q = wp.q;
+    int64_t n[8] = {0};
+    q.scan_keys(_census_cb, n, ~(1 << job::pend));  // pending ones are in the index
+    if (q.error) {
+        logwarn("Cannot count jobs: %s", q.error);
+        return;
+    }
+    for (int s = job::hold; s <= job::done; ++s) {
+        if ((s != job::pend) && (s != job::kill)) wp.scoreboard->set_jobs(s, n[s]);
+    }
+}
 
-    // Run the work loop - stay in here unless we're signalled to die
-    run_jobs = true;
-    do {
+// Timer event handler - do the periodic tasks
+static int on_timer(job::poller & pol, int fd, uint32_t n, void* ua) {
+    workplace* wp = (workplace*)ua;
+    uint64_t t0 = job::stats::usecs();
+    job::statpage::phase_t ph = job::statpage::NPHASES;
+    if (fd == wp->t_poll) {
+        ph = job::statpage::POLL;
+        if (wp->w_pend < 0) wp->pending.reconcile();    // not watching, so look every time
+        solicit_on_the_street(*wp);
+
+        // Come back when the next future job becomes eligible.  One that already is
+        //  waits for a run slot; a job finishing brings us back for it.
+        time_t due = wp->pending.due();
         time_t now = time(NULL);
-        if (test_end && (now > test_end)) break;
+        if (due > now) pol.soon(fd, (due - now) * 1000);
+        else if (due && !wp->starved && (wp->running < wp->maxjobs)) pol.soon(fd, 0);
 
-        // If we're signalled, then make 'em fire sooner than they normally would
-        if (check_soon) {
-            check_soon = false;
-            when_reap  = now;
-            if (when_poll  > (now +    3)) when_poll  = now +    3;
-            if (when_group > (now +   10)) when_group = now +   10;
-            if (when_kill  > (now +   15)) when_kill  = now +   15;
-            if (when_dead  > (now +   59)) when_dead  = now +   59;
-            if (when_clean > (now + 1800)) when_clean = now + 1800;
-        }
+        // Short of the node's slots, we're nudged as they come free; this is in case we're not
+        if (wp->starved) pol.soon(fd, 1000);
+    }
+    else if (fd == wp->t_sync) {
+        ph = job::statpage::SYNC;
+        size_t had = wp->pending.size();
+        wp->pending.reconcile();
+        if (wp->pending.error) logerror("Cannot check pending jobs: %s", wp->pending.error);
+        if (wp->pending.size() > had) pol.soon(wp->t_poll, 0);
+        take_census(*wp);
+    }
+    else if (fd == wp->t_dead)  {ph = job::statpage::DEAD;  bring_out_yer_dead(wp->q);}
+    else if (fd == wp->t_kill)  {ph = job::statpage::KILL;  terminate_with_predjudice(wp->q);}
+    else if (fd == wp->t_group) {ph = job::statpage::GROUP; group_hug(wp->q);}
+    else if (fd == wp->t_split) {ph = job::statpage::SPLIT; be_fruitful_and_multiply(wp->q.qname);}
+    else if (fd == wp->t_clean) {
+        ph = job::statpage::CLEAN;
+        if (kellys_kleaning_kompany(wp->q, wp->age_clean)) wp->check_soon = true;  // Come back sooner!
+    }
+    if (wp->scoreboard && (ph != job::statpage::NPHASES))
+        wp->scoreboard->timed(ph, job::stats::usecs() - t0);
+    return 0;
+}
+
+// Test mode timeout
+static int on_deadline(job::poller & pol, int fd, uint32_t n, void* ua) {
+    loginfo("Terminating due to test mode timeout");
+    run_jobs = false;
+    return 0;
+}
+
+// Directory change handler - a job arrived in (or left) pend, or a kill file was dropped
+static int on_change(job::poller & pol, int fd, uint32_t what, void* ua) {
+    workplace* wp = (workplace*)ua;
+    uint64_t t0 = job::stats::usecs();
+    job::poller::changes_t chg;
+    job::status e = job::poller::changes(fd, chg);
+    if (e) logwarn("Reading directory changes: %s", e);
+    if (chg.empty()) return 0;
+    logdebug("%d changes seen on fd %d", chg.size(), fd);
+
+    // Kill orders - the assassin rescans the kill dir anyway
+    if (fd == wp->w_kill) {
+        pol.soon(wp->t_kill, 0);
+        return 0;
+    }
 
-        // Reaper
-        if (now >= when_reap) {
-            when_reap = now + next_reap;
-            job::launch::reap_zombies();
+    // Keep the pending index current.  A burst of changes lands within
+    //  the same millisecond, so they'll be handled together.
+    bool arrived = false;
+    for (size_t i = 0; i < chg.size(); i++) {
+        uint32_t mask = chg[i].first;
+        if (mask & IN_Q_OVERFLOW) {
+            logverbose("Change events overflowed, re-indexing pending jobs");
+            wp->pending.seed();
+            arrived = true;
         }
+        else if (mask & (IN_MOVED_TO | IN_CREATE)) {
+            arrived |= wp->pending.add(chg[i].second);
+        }
+        else if (mask & (IN_MOVED_FROM | IN_DELETE)) {
+            wp->pending.drop(chg[i].second);
+        }
+    }
+    if (arrived) pol.soon(wp->t_poll, 0);
+    if (wp->scoreboard) wp->scoreboard->timed(job::statpage::CHANGE, job::stats::usecs() - t0);
+    return 0;
+}
 
-        // Check for dead/abandoned jobs (skipping ours of course).
-        if (now >= when_dead) {
-            when_dead = now + next_dead;
-            bring_out_yer_dead(q);
+// Notice handler - submitters telling us which jobs they just put in pend.
+//  The spool has the last word: a name counts only if it's there.
+static int on_notice(job::poller & pol, int fd, uint32_t what, void* ua) {
+    workplace* wp = (workplace*)ua;
+    job::stringlist names;
+    if (wp->inbox.receive(names)) logwarn("Reading notices: %s", wp->inbox.error);
+    std::string pdir = wp->q.dir_path(job::pend);
+    bool arrived = false;
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == ".") {              // a nudge: the node's run slots came free
+            arrived = true;
+            continue;
         }
+        struct stat sb;
+        if ((names[i].find('/') != std::string::npos) || stat((pdir + names[i]).c_str(), &sb)) {
+            logdebug("Notice of %s, but it's not pending", names[i]);
+            continue;
+        }
+        arrived |= wp->pending.add(names[i]);
+    }
+    logdebug("%d notices, %s", names.size(), arrived ? "new work" : "nothing new");
+    if (arrived) pol.soon(wp->t_poll, 0);
+    return 0;
+}
+
+static void close_shop(job::poller & pol, workplace* wp, const bool closed);
+static workplace* reload_shop(job::poller & pol, workplace* wp);
+
+// Take on a queue: its timers, its watches, its notices and its scoreboard.
+//  Its settings come from the command line, else its own config, else the overall config.
+static workplace* open_shop(job::poller & pol, const std::string & qname) {
+    workplace* wp = new workplace(qname);
+    if (!wp->q.exists()) {
+        logerror("Queue %s: No such queue%s", qname, wp->q.error ? ": " + std::string(wp->q.error) : "");
+        delete wp;
+        return NULL;
+    }
+    if (wp->quecfg.error) {
+        logerror("Queue %s: Cannot open queue config: %s", qname, wp->quecfg.error);
+        delete wp;
+        return NULL;
+    }
+
+    // Get CLI values or defaults
+    job::config & quecfg = wp->quecfg;
+    wp->maxjobs = (cli_maxjobs >= 0)
+                        ? cli_maxjobs
+                        : quecfg.geti("queue", "run-limit", 
+                          jobcfg->geti("job",  "run-limit", 
+                          10));
+    int next_poll = (cli_poll >= 0)
+                        ? cli_poll
+                        : quecfg.geti("queue", "poll-secs", 
+                          jobcfg->geti("job",  "poll-secs", 
+                          60));
+    if (next_poll < 1) next_poll = 1; // don't let it be zero or less
+    int next_sync = quecfg.geti("queue", "sync-secs",
+                    jobcfg->geti("job",  "sync-secs",
+                    300));
+    if (next_sync < 1) next_sync = 1;
+    wp->method = job::launch::str2method(quecfg.get("queue", "launch-method",
+                                         jobcfg->get("job",  "launch-method",
+                                         "fork")));
+
+    // Share the node's run slots with its other queues, if it has a limit
+    std::string node_slots = jobcfg->get("job", "node-slots", "0");
+    int total = (node_slots == "cpus") ? (int)sysconf(_SC_NPROCESSORS_ONLN) : str2int(node_slots);
+    if (total > 0) {
+        int weight = quecfg.geti("queue", "slot-weight",
+                     jobcfg->geti("job",  "slot-weight",
+                     1));
+        wp->pool.join(qname, total, weight);
+        if (wp->pool.error) logwarn("Queue %s: Not sharing the node's run slots: %s", qname, wp->pool.error);
+        else logverbose("Queue %s: Sharing %d node run slots, weight %d", qname, total, weight);
+    }
+
+    // Intervals for time-based things, in seconds
+    int next_group = 300;           // groups finish as their last child does; this just checks
+    int next_dead  = 180;           // check for dead jobs every 3 mins
+    int next_kill  = 30;            // twice a minute
+    int next_clean = 12*3600;       // twice a day
+
+    // Timers for the periodic tasks, staggered at startup
+    wp->t_poll  = pol.timer(on_timer, wp);
+    wp->t_sync  = pol.timer(on_timer, wp);
+    wp->t_dead  = pol.timer(on_timer, wp);
+    wp->t_kill  = pol.timer(on_timer, wp);
+    wp->t_group = pol.timer(on_timer, wp);
+    wp->t_split = pol.timer(on_timer, wp);      // only armed while splitting group jobs
+    wp->t_clean = pol.timer(on_timer, wp);
+    if (pol.error) {
+        logerror("Queue %s: Cannot create timers: %s", qname, pol.error);
+        workplaces[qname] = wp;
+        close_shop(pol, wp, false);
+        return NULL;
+    }
+    pol.arm(wp->t_dead,   1000, next_dead  * 1000);
+    pol.arm(wp->t_poll,   3000, next_poll  * 1000);
+    pol.arm(wp->t_sync,   next_sync * 1000, next_sync * 1000);
+    pol.arm(wp->t_group,  4000, next_group * 1000);
+    pol.arm(wp->t_kill,   6000, next_kill  * 1000);
+    pol.arm(wp->t_clean, 13000, next_clean * 1000U);
+
+    // Watch for new pending jobs and kill orders.  If we can't, the timers still do the work.
+    //  The watch goes first so no job slips in between indexing and watching.
+    wp->w_pend = pol.watch(wp->q.dir_path(job::pend),
+                           IN_MOVED_TO | IN_CREATE | IN_MOVED_FROM | IN_DELETE, on_change, wp);
+    if (wp->w_pend < 0)
+        logwarn("Queue %s: Cannot watch for pending jobs, will poll: %s", qname, pol.error);
+    wp->pending.seed();
+    if (wp->pending.error) logerror("Queue %s: Cannot index pending jobs: %s", qname, wp->pending.error);
+    wp->w_kill = pol.watch(wp->q.dir_path(job::kill), IN_MOVED_TO | IN_CLOSE_WRITE, on_change, wp);
+    if (wp->w_kill < 0)
+        logwarn("Queue %s: Cannot watch for kill orders, will poll: %s", qname, pol.error);
+
+    // Take notices of new jobs; without, submitters fall back to signalling us
+    wp->s_note = wp->inbox.listen();
+    if ((wp->s_note < 0) || pol.add(wp->s_note, EPOLLIN, on_notice, wp)) {
+        logwarn("Queue %s: Cannot take job notices: %s", qname, (wp->s_note < 0) ? wp->inbox.error : pol.error);
+        wp->s_note = -1;
+    }
+
+    // Publish our statistics
+    workplaces[qname] = wp;
+    if (!wp->board.error) wp->board.create();
+    if (wp->board.error) logwarn("Queue %s: No live statistics: %s", qname, wp->board.error);
+    else {
+        wp->scoreboard = &wp->board;
+        wp->scoreboard->set(&job::statpage::run_limit, wp->maxjobs);
+        take_census(*wp);
+    }
+    loginfo("Queue %s: Managing its jobs, run limit %d", qname, wp->maxjobs);
+    return wp;
+}
+
+// Let go of a queue.  If it's been closed on us, its running jobs are killed,
+//  and its splits and arrays dropped; else they're left for the next jobman.
+static void close_shop(job::poller & pol, workplace* wp, const bool closed) {
+    std::string qname = wp->q.qname;
+    int fds[] = {wp->t_poll, wp->t_sync, wp->t_dead, wp->t_kill, wp->t_group, wp->t_split,
+                 wp->t_clean, wp->w_pend, wp->w_kill, wp->s_note};
+    for (size_t i = 0; i < sizeof(fds)/sizeof(fds[0]); i++) {
+        if (fds[i] >= 0) pol.remove(fds[i]);    // the notice socket is closed by its notice
+    }
 
-        // Kill-off cancelled jobs
-        if (now >= when_kill) {
-            when_kill = now + next_kill;
-            terminate_with_predjudice(q);
+    if (closed) {
+        std::vector<array_run*> ars;
+        for (std::map<job::id_t, array_run*>::iterator it = arrays.begin(); it != arrays.end(); ++it) {
+            if (it->second->jf->queue == qname) ars.push_back(it->second);
         }
+        for (size_t i = 0; i < ars.size(); i++) cancel_array(ars[i]);
+        for (job::launch::finmap_t::iterator it =  job::launch::finmap.begin();
+                                             it != job::launch::finmap.end();
+                                             ++it) {
+            if (!it->second || (it->second->term_cb != try_done)) continue;
+            job::file* pj = (job::file*)it->second->term_ua;
+            if (!pj || (pj->queue != qname)) continue;
+            loginfo("Job %d: Killing (PID %d), its queue is gone", pj->id, it->first);
+            if (kill(it->first, SIGTERM)) logerror("Job %d: Cannot kill PID %d: %s", pj->id, it->first, SYS_status);
+        }
+        for (std::list<split>::iterator it = splits.begin(); it != splits.end(); ) {
+            if (it->jf->queue != qname) {
+                ++it;
+                continue;
+            }
+            delete it->fo;
+            delete it->jf;
+            it = splits.erase(it);
+        }
+    }
+    workplaces.erase(qname);
+    delete wp;
+    loginfo("Queue %s: No longer managing its jobs", qname);
+}
+
+// Orders from queman, for a jobman managing many queues: "+queue" to take
+//  one on, "-queue" to let it go, "=queue" to take up its changed config.
+//  Only from our own user, or root.
+static int on_orders(job::poller & pol, int fd, uint32_t what, void* ua) {
+    job::notice* orders = (job::notice*)ua;
+    job::stringlist names;
+    if (orders->receive(names, true)) logwarn("Reading orders: %s", orders->error);
+    for (size_t i = 0; i < names.size(); i++) {
+        std::string qname = names[i].substr(1);
+        if (qname.empty() || (qname.find('/') != std::string::npos)) continue;
+        workplace* wp = shop(qname);
+        if ((names[i][0] == '+') && !wp) open_shop(pol, qname);
+        else if ((names[i][0] == '-') && wp) close_shop(pol, wp, true);
+        else if ((names[i][0] == '=') && wp) reload_shop(pol, wp);
+    }
+    return 0;
+}
+
+// Take up a queue's changed config, in place.  Its running jobs run on, in its slots.
+static workplace* reload_shop(job::poller & pol, workplace* wp) {
+    std::string qname = wp->q.qname;
+    int running = wp->running;
+    close_shop(pol, wp, false);
+    wp = open_shop(pol, qname);
+    if (wp) {
+        wp->running = running;
+        wp->pool.adopt(running);
+    }
+    return wp;
+}
 
-        // Housekeeper - check every day for done jobs X days old (30?)
-        if (now >= when_clean) {
-            when_clean = now + next_clean;
-            kellys_kleaning_kompany(q, age_clean);
+// Reload the queues whose config has changed since we read it; queman
+//  signals us when it sees that, so we needn't be stopped to take it up
+static void reload_changed(job::poller & pol, const bool multi) {
+    job::stringlist changed;
+    for (std::map<std::string, workplace*>::iterator it = workplaces.begin(); it != workplaces.end(); ++it) {
+        struct stat sb = stat_of(path.qcfdir + it->first + ".conf");
+        const struct stat & was = it->second->cfg_sb;
+        if ((sb.st_ino != was.st_ino) || (sb.st_size != was.st_size)
+            || (sb.st_mtim.tv_sec != was.st_mtim.tv_sec) || (sb.st_mtim.tv_nsec != was.st_mtim.tv_nsec))
+            changed.push_back(it->first);
+    }
+    for (size_t i = 0; i < changed.size(); i++) {
+        loginfo("Queue %s: Config changed, reloading", changed[i]);
+        if (!reload_shop(pol, workplaces[changed[i]]) && !multi) {
+            logerror("Queue %s: Cannot take up its changed config, stopping", changed[i]);
+            run_jobs = false;
         }
+    }
+}
 
-        // Check-up on group jobs - have all child jobs finished?
-        if (now >= when_group) {
-            when_group = now + next_group;
-            group_hug(q);
+// Main work loop - wait for events and do the various tasks they call for.
+//  Pending jobs and kill files are seen via inotify as soon as they arrive,
+//  and submitters send us notices of the jobs they've put in pend;
+//  the periodic polls remain as a safety net, such as for a spool on a
+//  network filesystem where changes made on other nodes are not seen.
+//  An idle jobman sleeps until its next periodic task comes due.
+//  With many queues, they all share the loop; each has its own run limit and timers.
+void will_work_for_food(const job::stringlist & qnames, const bool multi, int test_end) {
+
+    job::poller pol;
+    if (pol.error) die("Cannot create event poller: %s", pol.error);
+
+    // Our jobs are reaped thru their pidfds as they exit; SIGCHLD catches the rest.
+    //  Signals are taken as events.
+    job::launch::events = &pol;
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGCHLD);
+    sigaddset(&sigs, SIGHUP);
+    sigaddset(&sigs, SIGTERM);
+    sigaddset(&sigs, SIGUSR1);
+    if (pol.signals(sigs, on_signal, (void*)&multi) < 0)
+        die("*** Cannot take signals: %s", pol.error);
+    if (test_end) {
+        int t_end = pol.timer(on_deadline);
+        if (t_end < 0) die("*** Cannot create timers: %s", pol.error);
+        time_t left = test_end - time(NULL);
+        pol.arm(t_end, (left > 0) ? left * 1000 : 1);   // already past, end at once
+    }
+
+    // Our queues; a lone one we can't work is the end of us
+    for (size_t i = 0; i < qnames.size(); i++) {
+        if (!open_shop(pol, qnames[i]) && !multi) die("*** Cannot manage queue %s", qnames[i]);
+    }
+
+    // Take orders from queman, as queues come and go
+    job::notice orders;
+    if (multi) {
+        int s_ord = orders.listen();
+        if ((s_ord < 0) || pol.add(s_ord, EPOLLIN, on_orders, &orders))
+            logwarn("Cannot take orders, only the queues we started with are managed: %s",
+                    (s_ord < 0) ? orders.error : pol.error);
+    }
+
+    // Run the work loop - stay in here unless we're signalled to die
+    run_jobs = true;
+    while (run_jobs) {
+        if (pol.wait() < 0) {
+            logerror("Event wait failed: %s", pol.error);
+            sleep(1);   // don't spin
         }
+        for (std::map<std::string, workplace*>::iterator it = workplaces.begin(); it != workplaces.end(); ++it) {
+            workplace* wp = it->second;
+            if (wp->scoreboard) {
+                wp->scoreboard->set(&job::statpage::running, wp->running);
+                wp->scoreboard->set_jobs(job::pend, wp->pending.size());
+            }
 
-        // Any room for more jobs?
-        if (now >= when_poll) {
-            when_poll = now + next_poll;
-            solicit_on_the_street(q, maxjobs, quecfg);
+            // If we're signalled, then make 'em fire sooner than they normally would
+            if (check_soon || wp->check_soon) {
+                wp->check_soon = false;
+                pol.soon(wp->t_poll,        0);
+                pol.soon(wp->t_kill,    15000);
+                pol.soon(wp->t_dead,    59000);
+                pol.soon(wp->t_clean, 1800000);
+            }
         }
+        check_soon = false;
 
-    } while (sleep(1) || run_jobs);
-    if (test_end) loginfo("Terminating due to test mode timeout");
+        // Group jobs still being split get another turn, after whatever else came up
+        for (std::list<split>::iterator it = splits.begin(); it != splits.end(); ++it) {
+            workplace* wp = shop(it->jf->queue);
+            if (wp) pol.soon(wp->t_split, 0);
+        }
+    }
+    while (!workplaces.empty()) close_shop(pol, workplaces.begin()->second, false);
+    job::launch::events = NULL;
 }
 
 //
@@ -933,7 +1835,8 @@ int main(int argc, const char* argv[]) {
     int pstat = cli.parse(argc, argv);
     if (pstat != ERR_OK)  return pstat;
     if (cli.opts[opHELP]) return ERR_OK;
-    logassert(cli.args.size() == 1, "*** Missing QUEUE, please provide one queue name");
+    bool multi = cli.opts[opMULT];
+    logassert(multi || (cli.args.size() == 1), "*** Missing QUEUE, please provide one queue name");
 
     // Check test prefix
     test_prefix = cli.opts[opTPFX] ? cli.opts[opTPFX].arg : "";
@@ -946,9 +1849,11 @@ int main(int argc, const char* argv[]) {
     if (test_prefix.size()) test_prefix += '-';
 
     // Announce ourselves
-    std::string qname = cli.args[0];
-    logall("Starting job manager for queue %s as u%d:g%d%s", 
-            qname,
+    job::stringlist qnames(cli.args.begin(), cli.args.end());
+    std::string who = multi ? "--multi" : qnames[0];
+    logall("Starting job manager for %s%s as u%d:g%d%s", 
+            multi ? "queues " : "queue ",
+            multi ? job::join(qnames, " ") : qnames[0],
             (int)getuid(), (int)getgid(),
             test_prefix.size()? " prefix " + test_prefix : ""
           );
@@ -961,57 +1866,42 @@ int main(int argc, const char* argv[]) {
     if (cli.opts[opROOT]) path.set_root(cli.opts[opROOT].arg);
 
     // Load the overall config file
-    job::config jobcfg(path.cfgfile);
-    if (jobcfg.error) die("Cannot open job config: %s", jobcfg.error);
+    jobcfg = new job::config(path.cfgfile);
+    if (jobcfg->error) die("Cannot open job config: %s", jobcfg->error);
 
     // Get & check initial values (from config first, CLI overrides)
-    if (!cli.opts[opLOG] && !cli.opts[opVERB] && jobcfg.exists("jobs", "log-level"))
-        job::logger::set_level(jobcfg.get("jobs", "log-level", "info"));
-
-    // Setup the SIGHUP handler
-    struct sigaction sa;
-    sa.sa_flags = 0;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_handler = signal_handler;
-    if (sigaction(SIGHUP, &sa, NULL) == -1)
-        die("*** Cannot set SIGHUP signal handler: %s", SYS_status);
-    if (sigaction(SIGTERM, &sa, NULL) == -1)
-        die("*** Cannot set SIGTERM signal handler: %s", SYS_status);
-
+    if (!cli.opts[opLOG] && !cli.opts[opVERB] && jobcfg->exists("jobs", "log-level"))
+        job::logger::set_level(jobcfg->get("jobs", "log-level", "info"));
 
-    // Verify this queue exists
-    //  ***TODO***
+    // The child jobs we make are in our zone
+    job::file::zone = jobcfg->geti("job", "zone");
 
-    // Per-queue inits
-    std::string qcf = path.qcfdir + qname + ".conf";    // qcf = queue config file
-    job::config quecfg(qcf);
-    if (quecfg.error) die("Cannot open queue config: %s", quecfg.error);
-    job::queue q(qname);
-
-    // Get CLI values or defaults
+    // Settings from the CLI hold for every queue; the rest are per-queue
+    if (cli.opts[opMAXR]) cli_maxjobs = str2int(cli.opts[opMAXR].arg);
+    if (cli.opts[opPOLL]) cli_poll    = str2int(cli.opts[opPOLL].arg);
     time_t now = time(NULL);
-    int maxjobs = cli.opts[opMAXR]
-                        ? str2int(cli.opts[opMAXR].arg)
-                        : quecfg.geti("queue", "run-limit", 
-                          jobcfg.geti("job",   "run-limit", 
-                          10));
-    int next_poll = cli.opts[opPOLL]
-                        ? str2int(cli.opts[opPOLL].arg)
-                        : quecfg.geti("queue", "poll-secs", 
-                          jobcfg.geti("job",   "poll-secs", 
-                          60));
-    if (next_poll < 1) next_poll = 1; // don't let it be zero or less
     int test_end = cli.opts[opTTIM]
                         ? now + str2int(cli.opts[opTTIM].arg)
                         : 0;
 
+    // Each queue takes a dozen or so descriptors; let a busy node have them all
+    if (multi) {
+        struct rlimit rl;
+        if (!getrlimit(RLIMIT_NOFILE, &rl) && (rl.rlim_cur < rl.rlim_max)) {
+            rl.rlim_cur = rl.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &rl);
+        }
+    }
+
     // Make us easy to find - NOTE: Cannot use cli after this point!
-    job::launch::set_process_name(test_prefix + "jobman " + qname);
+    job::launch::set_process_name(test_prefix + "jobman " + who);
 
     // Run the work loop
-    will_work_for_food(q, quecfg, maxjobs, next_poll, test_end);
+    will_work_for_food(qnames, multi, test_end);
 
     // Ciao!
-    loginfo("Jobman %s normal exit", qname);
+    loginfo("Jobman %s normal exit", who);
+    delete jobcfg;
+    jobcfg = NULL;
     return ERR_OK;
 }
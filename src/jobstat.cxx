@@ -0,0 +1,288 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/config.hxx"
+#include "job/file.hxx"
+#include "job/getopt.hxx"
+#include "job/log.hxx"
+#include "job/path.hxx"
+#include "job/queue.hxx"
+#include "job/slots.hxx"
+#include "job/stats.hxx"
+#include "job/status.hxx"
+#include "job/string.hxx"
+#define __STDC_FORMAT_MACROS    // Enable PRI macros
+#include <inttypes.h>           // PRI macros
+#include <signal.h>             // kill()
+#include <stdio.h>
+#include <string.h>             // strnlen()
+#include <string>
+#include <time.h>
+#include <unistd.h>             // sleep()
+
+// CLI options and usage help
+enum  {opNONE, opFMT,  opHELP, opLOG,  opLAT,  opRSET, opROOT, opWTCH };
+const option::Descriptor usage[] = {
+    {opNONE, 0, "",  "",          Arg::None,
+        "Show the live statistics of job managers.\n\n"
+        "Usage: jobstat [options] [queue...]\n\n"
+        "Options:" },
+    {opFMT,  0, "f", "format",    Arg::Reqd, "  -f  --format       Output format: text (default) or json"},
+    {opHELP, 0, "h", "help",      Arg::None, "  -h  --help         Show this help message and exit"},
+    {opLOG,  0, "l", "log-level", Arg::Reqd, "  -l  --log-level    Debugging log level (info, verbose, debug...)"},
+    {opLAT,  0, "L", "latency",   Arg::None, "  -L  --latency      Show latencies by job priority and type"},
+    {opRSET, 0, "r", "reset",     Arg::None, "  -r  --reset        Have the job managers reset their latencies"},
+    {opROOT, 0, "R", "root",      Arg::Reqd, "  -R  --root         Set file system root"},
+    {opWTCH, 0, "w", "watch",     Arg::Reqd, "  -w  --watch        Show them again every this many seconds"},
+    {opNONE, 0, "",  "",          Arg::None,
+        "\n"
+        "  Each job manager keeps counts of its jobs and of the work it does in\n"
+        "  shared memory; jobstat reads them, at no cost to the job manager.\n"
+        "  Without any queues named, all queues are shown.\n"
+        },
+    {0,0,0,0,0,0}
+};
+
+// How long ago, or for how long; like 3d04h or 12m05s
+static std::string span(const int64_t secs) {
+    char buf[32];
+    int64_t s = secs < 0 ? 0 : secs;
+    if      (s >= 86400) snprintf(buf, sizeof(buf), "%dd%2.2dh", (int)(s / 86400), (int)(s % 86400 / 3600));
+    else if (s >= 3600)  snprintf(buf, sizeof(buf), "%dh%2.2dm", (int)(s / 3600), (int)(s % 3600 / 60));
+    else if (s >= 60)    snprintf(buf, sizeof(buf), "%dm%2.2ds", (int)(s / 60), (int)(s % 60));
+    else                 snprintf(buf, sizeof(buf), "%ds", (int)s);
+    return buf;
+}
+
+// A latency, to three figures; like 850us, 12.3ms, 4.51s, 2.50m, 1.20h
+static std::string dur(const uint64_t us) {
+    char buf[32];
+    if      (us < 1000)         snprintf(buf, sizeof(buf), "%dus", (int)us);
+    else if (us < 1000000)      snprintf(buf, sizeof(buf), "%.3gms", us / 1e3);
+    else if (us < 60000000)     snprintf(buf, sizeof(buf), "%.3gs", us / 1e6);
+    else if (us < 3600000000ULL) snprintf(buf, sizeof(buf), "%.3gm", us / 6e7);
+    else                        snprintf(buf, sizeof(buf), "%.3gh", us / 3.6e9);
+    return buf;
+}
+
+static bool alive(const int64_t pid) {
+    return pid && (!kill(pid, 0) || (errno == EPERM));
+}
+
+static void show_text(const std::string & qnam, const job::statpage & p, const job::slotpage* sp) {
+    time_t now = time(NULL);
+    say("Queue %s: jobman PID %d %s, started %s ago, last changed %s ago", qnam,
+        (int)p.pid, alive(p.pid) ? "running" : "(not running)",
+        span(now - p.started), span(now - p.updated));
+    say("  Jobs:       hold %" PRId64 ", pend %" PRId64 ", run %" PRId64 ", tied %" PRId64 ", done %" PRId64,
+        p.jobs[job::hold], p.jobs[job::pend], p.jobs[job::run], p.jobs[job::tied], p.jobs[job::done]);
+    say("  Run slots:  %" PRId64 "/%" PRId64 " in use", p.running, p.run_limit);
+    for (int i = 0; sp && (i < SLOTS_HOLDERS); i++) {
+        const job::slotpage::holder & h = sp->holders[i];
+        if (!h.pid || (h.pid != p.pid) || (qnam != std::string(h.queue, strnlen(h.queue, sizeof(h.queue))))) continue;
+        int inuse = 0;
+        for (int j = 0; j < SLOTS_HOLDERS; j++) inuse += sp->holders[j].pid ? sp->holders[j].held : 0;
+        say("  Node slots: %d held, %d wanted, weight %d; %d/%d in use on the node",
+            h.held, h.want, h.weight, inuse, sp->total);
+    }
+    say("  Tries:      %" PRIu64 " started, %" PRIu64 " ok, %" PRIu64 " failed, %" PRIu64 " retried",
+        p.launches, p.completions, p.failures, p.retries);
+    say("  Conflicts:  %" PRIu64 " locked, %" PRIu64 " moved (by other job managers)",
+        p.locked, p.moved);
+    say("  Phase          runs      total ms    avg us    max us   last us");
+    for (int i = 0; i < job::statpage::NPHASES; i++) {
+        const job::statpage::phase & ph = p.phases[i];
+        say("  %-8s %10" PRIu64 "  %12.1f  %8" PRIu64 "  %8" PRIu64 "  %8" PRIu64,
+            job::stats::phase2str(i), ph.runs, ph.total_us / 1000.0,
+            ph.runs ? ph.total_us / ph.runs : 0, ph.max_us, ph.last_us);
+    }
+}
+
+// Latencies, a line for each priority and type that has some
+static void show_latency(const job::statpage & p) {
+    say("  Latencies since %s ago:", span(time(NULL) - p.lat_since));
+    for (int l = 0; l < job::statpage::NLATS; l++) {
+        say("    %-10s  %9s  %7s  %7s  %7s  %7s  %7s", job::stats::lat2str(l),
+            "count", "mean", "p50", "p90", "p99", "max");
+        for (int k = 0; k < 9 + STATS_TYPES; k++) {
+            const job::histogram & h = (k < 9) ? p.by_prio[l][k] : p.by_type[l][k-9];
+            if (!h.count) continue;
+            std::string who = (k < 9)                     ? "prio " + job::int2str(k+1)
+                            : (k == 9)                    ? "(command)"
+                            : (k == 9 + STATS_TYPES - 1)  ? "(other)"
+                            :                               std::string(p.types[k-9], strnlen(p.types[k-9], 31));
+            say("      %-10s%9" PRIu64 "  %7s  %7s  %7s  %7s  %7s", who, h.count, dur(h.mean()),
+                dur(h.percentile(50)), dur(h.percentile(90)), dur(h.percentile(99)), dur(h.max));
+        }
+    }
+}
+
+static std::string json_hist(const job::histogram & h) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"count\": %" PRIu64 ", \"mean\": %" PRIu64 ", \"p50\": %" PRIu64
+                               ", \"p90\": %" PRIu64 ", \"p99\": %" PRIu64 ", \"max\": %" PRIu64 "}",
+             h.count, h.mean(), h.percentile(50), h.percentile(90), h.percentile(99), h.max);
+    return buf;
+}
+
+// Latencies in microseconds, as JSON members
+static std::string json_latency(const job::statpage & p) {
+    std::string j = ",\n \"latency_since\": " + job::int2str(p.lat_since) + ", \"latency\": {";
+    for (int l = 0; l < job::statpage::NLATS; l++) {
+        j += std::string(l ? ",\n   " : "\n   ") + "\"" + job::stats::lat2str(l) + "\": {\"by_priority\": {";
+        bool any = false;
+        for (int k = 0; k < 9; k++) {
+            if (!p.by_prio[l][k].count) continue;
+            j += std::string(any ? ", " : "") + "\"" + job::int2str(k+1) + "\": " + json_hist(p.by_prio[l][k]);
+            any = true;
+        }
+        j += "}, \"by_type\": {";
+        any = false;
+        for (int k = 0; k < STATS_TYPES; k++) {
+            if (!p.by_type[l][k].count) continue;
+            std::string t = (k == 0)               ? "(command)"
+                          : (k == STATS_TYPES - 1) ? "(other)"
+                          :                          std::string(p.types[k], strnlen(p.types[k], 31));
+            j += std::string(any ? ", " : "") + "\"" + t + "\": " + json_hist(p.by_type[l][k]);
+            any = true;
+        }
+        j += "}}";
+    }
+    return j + "}";
+}
+
+static void show_json(const std::string & qnam, const job::statpage & p, const bool first, const bool lat) {
+    std::string phases;
+    char buf[256];
+    for (int i = 0; i < job::statpage::NPHASES; i++) {
+        const job::statpage::phase & ph = p.phases[i];
+        snprintf(buf, sizeof(buf), "%s\"%s\": {\"runs\": %" PRIu64 ", \"total_us\": %" PRIu64
+                                   ", \"max_us\": %" PRIu64 ", \"last_us\": %" PRIu64 "}",
+                 i ? ", " : "", job::stats::phase2str(i), ph.runs, ph.total_us, ph.max_us, ph.last_us);
+        phases += buf;
+    }
+    printf("%s{\"queue\": \"%s\", \"pid\": %d, \"alive\": %s, \"started\": %" PRId64 ", \"updated\": %" PRId64 ",\n"
+           " \"jobs\": {\"hold\": %" PRId64 ", \"pend\": %" PRId64 ", \"run\": %" PRId64
+           ", \"tied\": %" PRId64 ", \"done\": %" PRId64 "},\n"
+           " \"running\": %" PRId64 ", \"run_limit\": %" PRId64 ", \"launches\": %" PRIu64
+           ", \"completions\": %" PRIu64 ", \"failures\": %" PRIu64 ", \"retries\": %" PRIu64
+           ", \"locked\": %" PRIu64 ", \"moved\": %" PRIu64 ",\n"
+           " \"phases\": {%s}%s}",
+           first ? "" : ",\n", qnam.c_str(), (int)p.pid, alive(p.pid) ? "true" : "false",
+           p.started, p.updated,
+           p.jobs[job::hold], p.jobs[job::pend], p.jobs[job::run], p.jobs[job::tied], p.jobs[job::done],
+           p.running, p.run_limit, p.launches, p.completions, p.failures, p.retries,
+           p.locked, p.moved, phases.c_str(), lat ? json_latency(p).c_str() : "");
+}
+
+//
+// Main entry point
+//
+using job::ERR_OK;
+using job::path;
+int main(int argc, const char* argv[]) {
+
+    // Inits
+    job::logger::set_level();
+
+    // Parse CLI options
+    job::getopt cli(usage, opNONE, opHELP);
+    argc -= (argc>0); argv += (argc>0);         // skip prog name argv[0] if present
+    int pstat = cli.parse(argc, argv);
+    if (pstat != ERR_OK)  return pstat;
+    if (cli.opts[opHELP]) return ERR_OK;
+    if (cli.opts[opLOG]) job::logger::set_level(cli.opts[opLOG].arg);
+    if (cli.opts[opROOT]) path.set_root(cli.opts[opROOT].arg);
+
+    std::string fmt = cli.opts[opFMT] ? job::lc(std::string(cli.opts[opFMT].arg)) : "text";
+    bool json = (fmt == "json");
+    if (!json && (fmt != "text")) quit("*** Bad --format %s; use text or json", fmt);
+    int watch = cli.opts[opWTCH] ? job::str2int(cli.opts[opWTCH].arg) : 0;
+    bool lat  = cli.opts[opLAT];
+
+    // Which queues
+    job::stringlist qlist = cli.args;
+    if (qlist.empty()) {
+        job::status e = job::queue::get_queues(qlist);
+        if (e) quit("*** Cannot list queues: %s", e);
+    }
+    for (size_t i = 0; i < qlist.size(); i++) {
+        job::queue q(qlist[i]);
+        if (!q.exists()) quit("*** No such queue %s", qlist[i]);
+    }
+
+    // Reset the latencies?  The job manager does it; we only look.
+    int rc = ERR_OK;
+    if (cli.opts[opRSET]) {
+        for (size_t i = 0; i < qlist.size(); i++) {
+            job::stats st(qlist[i]);
+            job::statpage p;
+            if (!st.error) st.open();
+            if (st.error || !st.read(p) || !alive(p.pid)) {
+                sayerror("*** Queue %s: no job manager running", qlist[i]);
+                rc = ESRCH;
+                continue;
+            }
+            if (kill(p.pid, SIGUSR1)) {
+                sayerror("*** Queue %s: cannot signal job manager: %s", qlist[i], SYS_status);
+                rc = SYS_errno;
+                continue;
+            }
+            if (!json) say("Queue %s: latencies reset", qlist[i]);
+        }
+        exit(rc);
+    }
+
+    do {
+        if (json) printf("[\n");
+        bool first = true;
+        job::slots pool;                // the node's run slots, if the queues share them
+        job::slotpage sp;
+        bool pooled = !json && pool.read(sp);
+        for (size_t i = 0; i < qlist.size(); i++) {
+            job::stats st(qlist[i]);
+            job::statpage p;
+            if (!st.error) st.open();
+            if (st.error || !st.read(p)) {
+                if (!json) say("Queue %s: no statistics%s%s", qlist[i],
+                               st.error ? "; " : "", st.error ? std::string(st.error) : "");
+                rc = ENOENT;
+                continue;
+            }
+            if (json) show_json(qlist[i], p, first, lat);
+            else {
+                if (!first) say("");
+                show_text(qlist[i], p, pooled ? &sp : NULL);
+                if (lat) show_latency(p);
+            }
+            first = false;
+        }
+        if (json) printf("%s]\n", first ? "" : "\n");
+        fflush(stdout);
+        if (watch > 0) {
+            sleep(watch);
+            if (!json) say("");
+        }
+    } while (watch > 0);
+
+    exit(rc);
+}
@@ -0,0 +1,415 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/config.hxx"
+#include "job/file.hxx"
+#include "job/getopt.hxx"
+#include "job/jobkey.hxx"
+#include "job/log.hxx"
+#include "job/path.hxx"
+#include "job/pool.hxx"
+#include "job/queue.hxx"
+#include "job/status.hxx"
+#include "job/string.hxx"
+#include <algorithm>            // std::min
+#define __STDC_FORMAT_MACROS    // Enable PRI macros
+#include <inttypes.h>           // PRI macros
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>             // getenv(), strtoull()
+#include <string>
+#include <time.h>
+#include <vector>
+
+// CLI options and usage help
+enum  {opNONE, opALL,  opFMT,  opHELP, opNOHD, opTHRD, opLOG,  opQUE,
+       opROOT, opSUB,  opSTAT, opVERB };
+const option::Descriptor usage[] = {
+    {opNONE, 0, "",  "",          Arg::None,
+        "List jobs.\n\n"
+        "Usage: lsjob [options] [job-id...]\n\n"
+        "Options:" },
+    {opALL,  0, "a", "all",       Arg::None, "  -a  --all          Show all jobs everywhere; same as\n"
+                                             "                       --queues '*' --states '*' --submitter '*'"},
+    {opFMT,  0, "f", "format",    Arg::Reqd, "  -f  --format       Output format: text (default), tsv, or json"},
+    {opHELP, 0, "h", "help",      Arg::None, "  -h  --help         Show this help message and exit"},
+    {opNOHD, 0, "H", "noheader",  Arg::None, "  -H  --noheader     Do not show header lines"},
+    {opTHRD, 0, "j", "threads",   Arg::Reqd, "  -j  --threads      Scan with this many threads; default is 2 per CPU"},
+    {opLOG,  0, "l", "log-level", Arg::Reqd, "  -l  --log-level    Debugging log level (info, verbose, debug...)"},
+    {opQUE,  0, "q", "queues",    Arg::Reqd, "  -q  --queues       Show jobs from these queues, use * for all,\n"
+                                             "                       commas to list"},
+    {opROOT, 0, "R", "root",      Arg::Reqd, "  -R  --root         Set file system root"},
+    {opSUB,  0, "s", "submitter", Arg::Reqd, "  -s  --submitter    Show jobs submitted by these, use * for all,\n"
+                                             "                       commas to list"},
+    {opSTAT, 0, "t", "states",    Arg::Reqd, "  -t  --states       Show only jobs in these states, use * for all,\n"
+                                             "                       commas to list; hold,pend,run,tied,done"},
+    {opVERB, 0, "v", "verbose",   Arg::None, "  -v  --verbose      Show more, such as job attributes"},
+    {opNONE, 0, "",  "",          Arg::None,
+        "\n"
+        "  If no job IDs are given, then by default only your incomplete jobs\n"
+        "  in the default queue are shown; as if you gave:\n"
+        "    --queues=DEFAULT_QUEUE --submitter=$USER --states=hold,pend,run,tied\n"
+        "  If you give any job IDs, then --states and --submitter are ignored.\n"
+        "  Job IDs may be given with space or comma delimiters.\n"
+        "  Seeing job details (--verbose) depends on your permissions, which\n"
+        "  are based on user and group ID just like file permissions.\n"
+        },
+    {0,0,0,0,0,0}
+};
+
+enum format_t {TEXT, TSV, JSON};
+
+// What we're looking for, and how to show it
+struct filter {
+    std::set<job::id_t>     ids;        // Just these jobs, if any
+    std::set<uint32_t>      who;        // ...by these submitters (interned), if any
+    format_t                fmt;
+    bool                    verbose;    // Load and show job attributes
+};
+static filter want;
+
+// One state directory of one queue, and the keys of the jobs we want from it
+struct qdir {
+    std::string             qnam;
+    job::state_t            state;
+    std::string             dir;
+    job::keylist_t          keys;
+    job::status             error;
+};
+static std::vector<qdir> dirs;
+
+// A run of jobs from one directory, and their rows once they're made
+struct chunk {
+    size_t                  d;          // Which directory
+    size_t                  first;      // ...which of its keys
+    size_t                  n;          // ...and how many
+    std::string             rows;
+};
+static std::vector<chunk> chunks;
+static size_t             nrows = 0;    // How many put out so far
+
+// Read a directory for the jobs we want, in file name order
+//  (Called from the pool's threads)
+static void list_dir(const size_t i, void* ua) {
+    qdir & qd = dirs[i];
+    DIR* dirp = opendir(qd.dir.c_str());
+    if (!dirp) {
+        qd.error.set("opendir: " + qd.dir, SYS_errno);
+        return;
+    }
+    struct dirent* d = NULL;
+    job::jobkey k;
+    while ((d = readdir(dirp))) {
+        if (!k.parse(d->d_name)) continue;
+        if (want.ids.size() && !want.ids.count(k.id)) continue;
+        if (want.who.size() && !want.who.count(k.who)) continue;
+        qd.keys.push_back(k);
+    }
+    closedir(dirp);
+    job::jobkey::sort(qd.keys);
+}
+
+// Quote for JSON
+static std::string json(const std::string & s) {
+    std::string q = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char c = s[i];
+        if      (c == '"')  q += "\\\"";
+        else if (c == '\\') q += "\\\\";
+        else if (c == '\n') q += "\\n";
+        else if (c == '\t') q += "\\t";
+        else if (c < 0x20) {
+            char u[8];
+            snprintf(u, sizeof(u), "\\u%4.4x", c);
+            q += u;
+        }
+        else q += c;
+    }
+    return q + "\"";
+}
+
+// Escape for a TSV field
+static std::string tsv(const std::string & s) {
+    std::string q;
+    for (size_t i = 0; i < s.size(); i++) {
+        if      (s[i] == '\\') q += "\\\\";
+        else if (s[i] == '\n') q += "\\n";
+        else if (s[i] == '\t') q += "\\t";
+        else if (s[i] == '\r') q += "\\r";
+        else q += s[i];
+    }
+    return q;
+}
+
+// Make the rows of a run of jobs; when verbose, this is where the job files are read
+//  (Called from the pool's threads)
+static void make_rows(const size_t c, void* ua) {
+    chunk & ch = chunks[c];
+    const qdir & qd = dirs[ch.d];
+    std::string st = job::state2str(qd.state);
+    char buf[256];
+    for (size_t i = ch.first; i < ch.first + ch.n; i++) {
+        const job::jobkey & k = qd.keys[i];
+        const std::string & who = k.submitter();
+        bool asap = k.run_time <= JOB_ASAP;
+        char rtim[32] = "--asap--";
+        if (!asap) {
+            struct tm tmb;
+            strftime(rtim, sizeof(rtim), "%F:%T", localtime_r(&k.run_time, &tmb));
+        }
+
+        // Just the header section (0) of the job file, and only if we'll show it
+        job::file* jfp = NULL;
+        bool got = false;
+        if (want.verbose) {
+            jfp = new job::file(qd.dir + k.name());
+            if (!jfp->error) jfp->load(true);
+            got = !jfp->error && jfp->command.size();
+        }
+
+        if (want.fmt == TEXT && !want.verbose) {
+            snprintf(buf, sizeof(buf), "%8" PRIu64 "  %-14s  %5s     %d   %-19s  ",
+                     (uint64_t)k.id, qd.qnam.c_str(), st.c_str(), (int)k.priority, rtim);
+            ch.rows += buf + who + "\n";
+        }
+        else if (want.fmt == TEXT) {
+            snprintf(buf, sizeof(buf), "Job ID:    %" PRIu64 "\n", (uint64_t)k.id);
+            ch.rows += buf;
+            ch.rows += "Queue:     " + qd.qnam + "\n"
+                     + "State:     " + st + "\n"
+                     + "Priority:  " + job::int2str(k.priority) + "\n"
+                     + "Run Time:  " + rtim + "\n"
+                     + "Submitter: " + who + "\n";
+            if (got) {
+                ch.rows += "Job File:  " + jfp->name() + "\n"
+                         + "Command:   " + jfp->command + "\n"
+                         + "Job Type:  " + jfp->type + "\n"
+                         + "Tries:     " + job::int2str(jfp->try_count) + "/" + job::int2str(jfp->try_limit) + "\n"
+                         + "Job PID:   " + (jfp->pid ? job::int2str(jfp->pid) : "") + "\n";
+            }
+            else ch.rows += "*** No more information visible\n";
+            ch.rows += "---\n";
+        }
+        else if (want.fmt == TSV) {
+            snprintf(buf, sizeof(buf), "%" PRIu64 "\t", (uint64_t)k.id);
+            ch.rows += buf + tsv(qd.qnam) + "\t" + st + "\t" + job::int2str(k.priority) + "\t"
+                     + (asap ? "" : job::int2str(k.run_time)) + "\t" + tsv(who);
+            if (want.verbose) {
+                if (got) ch.rows += "\t" + tsv(jfp->command) + "\t" + tsv(jfp->type)
+                                  + "\t" + job::int2str(jfp->try_count)
+                                  + "\t" + job::int2str(jfp->try_limit)
+                                  + "\t" + (jfp->pid ? job::int2str(jfp->pid) : "");
+                else     ch.rows += "\t\t\t\t\t";
+            }
+            ch.rows += "\n";
+        }
+        else {
+            if (i > ch.first) ch.rows += ",\n";
+            snprintf(buf, sizeof(buf), "{\"id\": %" PRIu64 ", ", (uint64_t)k.id);
+            ch.rows += buf;
+            ch.rows += "\"queue\": " + json(qd.qnam)
+                     + ", \"state\": \"" + st + "\""
+                     + ", \"priority\": " + job::int2str(k.priority)
+                     + ", \"run_time\": " + (asap ? "null" : job::int2str(k.run_time))
+                     + ", \"submitter\": " + json(who);
+            if (got) {
+                ch.rows += ", \"command\": " + json(jfp->command)
+                         + ", \"type\": " + json(jfp->type)
+                         + ", \"tries\": " + job::int2str(jfp->try_count)
+                         + ", \"try_limit\": " + job::int2str(jfp->try_limit)
+                         + ", \"pid\": " + (jfp->pid ? job::int2str(jfp->pid) : "null");
+            }
+            ch.rows += "}";
+        }
+        delete jfp;
+    }
+}
+
+// Put out a run's rows, in turn
+static void put_rows(const size_t c, void* ua) {
+    chunk & ch = chunks[c];
+    if (ch.rows.empty()) return;
+    if ((want.fmt == JSON) && nrows) fputs(",\n", stdout);
+    fwrite(ch.rows.data(), 1, ch.rows.size(), stdout);
+    nrows += ch.n;
+    std::string().swap(ch.rows);    // done with it
+}
+
+//
+// Main entry point
+//
+using job::ERR_OK;
+using job::path;
+using job::split;
+int main(int argc, const char* argv[]) {
+
+    // Inits
+    job::logger::set_level();
+
+    // Parse CLI options
+    job::getopt cli(usage, opNONE, opHELP);
+    argc -= (argc>0); argv += (argc>0);         // skip prog name argv[0] if present
+    int pstat = cli.parse(argc, argv);
+    if (pstat != ERR_OK)  return pstat;
+    if (cli.opts[opHELP]) return ERR_OK;
+
+    // Set the log level from the CLI as soon as possible, do it again from the config later.
+    if (cli.opts[opLOG]) job::logger::set_level(cli.opts[opLOG].arg);
+
+    // Set our filesystem root
+    if (cli.opts[opROOT]) path.set_root(cli.opts[opROOT].arg);
+
+    // Load the config file
+    job::config cfg(path.cfgfile);
+    if (cfg.error) quit("*** Cannot load config: %s", cfg.error);
+    if (!cli.opts[opLOG] && cfg.exists("jobs", "log-level"))
+        job::logger::set_level(cfg.get("jobs", "log-level", "info"));
+
+    // What to show, and how
+    want.verbose = cli.opts[opVERB];
+    std::string fmt = cli.opts[opFMT] ? job::lc(std::string(cli.opts[opFMT].arg)) : "text";
+    if      (fmt == "text") want.fmt = TEXT;
+    else if (fmt == "tsv")  want.fmt = TSV;
+    else if (fmt == "json") want.fmt = JSON;
+    else quit("*** Bad --format %s; use text, tsv, or json", fmt);
+
+    // Which jobs: by ID...
+    std::string all = cli.opts[opALL] ? "*" : "";
+    job::stringlist ids;
+    for (size_t i = 0; i < cli.args.size(); i++) {
+        job::stringlist parts = split(cli.args[i], ",");
+        ids.insert(ids.end(), parts.begin(), parts.end());
+    }
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (ids[i].empty() || (ids[i] == "*")) continue;
+        char* end = NULL;
+        job::id_t id = strtoull(ids[i].c_str(), &end, 10);
+        if (*end) quit("*** Bad job ID %s", ids[i]);
+        want.ids.insert(id);
+    }
+
+    // ...in these states
+    std::string states = cli.opts[opSTAT] ? cli.opts[opSTAT].arg
+                       : all.size()       ? all
+                       :                    "hold,pend,run,tied";
+    if ((states == "*") || want.ids.size()) states = "hold,pend,run,tied,done";
+    job::stringlist slist = split(job::lc(states), ",");
+    std::vector<job::state_t> stlist;
+    for (size_t i = 0; i < slist.size(); i++) {
+        job::state_t s = job::str2state(slist[i]);
+        if ((s == job::unk) || (s == job::kill)) quit("*** Bad state %s", slist[i]);
+        stlist.push_back(s);
+    }
+
+    // ...of these queues
+    std::string queues = cli.opts[opQUE] ? cli.opts[opQUE].arg
+                       : all.size()      ? all
+                       :                   cfg.get("job", "default-queue", "");
+    if (queues.empty())
+        quit("*** No queues given, and no default queue defined.  Use --queues to specify the queues.");
+    job::stringlist qlist;
+    if (queues == "*") {
+        job::status e = job::queue::get_queues(qlist);
+        if (e) quit("*** Cannot list queues: %s", e);
+    }
+    else qlist = split(queues, ",");
+    for (size_t i = 0; i < qlist.size(); i++) {
+        job::queue q(qlist[i]);
+        if (!q.exists()) quit("*** No such queue %s", qlist[i]);
+    }
+    if (qlist.empty()) quit("*** No queues found");
+
+    // ...and by these submitters
+    std::string whos = cli.opts[opSUB] ? cli.opts[opSUB].arg
+                     : all.size()      ? all
+                     : (getenv("USER") ? getenv("USER") : "");
+    if (want.ids.size()) whos = "*";
+    job::stringlist wlist = split(whos, ",");
+    for (size_t i = 0; i < wlist.size(); i++) {
+        if (wlist[i] == "*") {
+            want.who.clear();
+            break;
+        }
+        want.who.insert(job::jobkey::intern(wlist[i].data(), wlist[i].size()));
+    }
+
+    // Show what's up
+    if (want.verbose && (want.fmt == TEXT)) {
+        say("Filtering on");
+        say("  Queues: %s", job::join(qlist));
+        say("  States: %s", job::join(slist));
+        say("  Owners: %s", want.who.size() ? job::join(wlist) : "-(all)-");
+        say(" Job IDs: %s", want.ids.size() ? job::join(ids)   : "-(all)-");
+        say("---");
+    }
+
+    // Read the directories, all at once
+    for (size_t q = 0; q < qlist.size(); q++) {
+        for (size_t s = 0; s < stlist.size(); s++) {
+            qdir qd;
+            qd.qnam  = qlist[q];
+            qd.state = stlist[s];
+            qd.dir   = job::queue(qlist[q]).dir_path(stlist[s]);
+            dirs.push_back(qd);
+        }
+    }
+    size_t nthreads = cli.opts[opTHRD] ? job::str2siz(cli.opts[opTHRD].arg)
+                                       : 2 * job::pool::ncpus();
+    job::pool workers(nthreads);
+    workers.run(dirs.size(), list_dir);
+    if (workers.error) quit("*** %s", workers.error);
+    for (size_t d = 0; d < dirs.size(); d++) {
+        if (dirs[d].error) quit("*** %s", dirs[d].error);
+    }
+
+    // Cut them into runs; small ones if we'll read each job file
+    size_t run = want.verbose ? 64 : 1024;
+    for (size_t d = 0; d < dirs.size(); d++) {
+        for (size_t first = 0; first < dirs[d].keys.size(); first += run) {
+            chunk ch;
+            ch.d     = d;
+            ch.first = first;
+            ch.n     = std::min(run, dirs[d].keys.size() - first);
+            chunks.push_back(ch);
+        }
+    }
+
+    // Header
+    bool header = !cli.opts[opNOHD];
+    if (header && (want.fmt == TEXT) && !want.verbose) {
+        say("job ID    queue           state   prio  run time             submitter");
+        say("--------  -------------   -----   ----  -------------------  ---------");
+    }
+    if (header && (want.fmt == TSV)) {
+        say("id\tqueue\tstate\tpriority\trun_time\tsubmitter%s",
+            want.verbose ? "\tcommand\ttype\ttries\ttry_limit\tpid" : "");
+    }
+    if (want.fmt == JSON) fputs("[\n", stdout);
+
+    // Make the rows in parallel, and put them out in order as they're ready
+    workers.run(chunks.size(), make_rows, put_rows, NULL, 4 * workers.nthreads);
+    if (workers.error) quit("*** %s", workers.error);
+    if (want.fmt == JSON) fputs(nrows ? "\n]\n" : "]\n", stdout);
+    fflush(stdout);
+
+    exit(ERR_OK);
+}
@@ -20,15 +20,20 @@
     USA
 */
 
+#include "job/array.hxx"
+#include "job/batch.hxx"
 #include "job/config.hxx"
 #include "job/file.hxx"
 #include "job/getopt.hxx"
+#include "job/isafe.hxx"
 #include "job/log.hxx"
+#include "job/notice.hxx"
 #include "job/path.hxx"
 #include "job/queue.hxx"
 #include "job/status.hxx"
 #include "job/string.hxx"
 #include <dirent.h>
+#include <fcntl.h>
 #include <linux/limits.h>   // PATH_MAX
 #include <signal.h>
 #include <stdio.h>
@@ -36,17 +41,23 @@
 #include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
 
 // CLI options and usage help
-enum  {opNONE, opTIME, opGRP,  opHELP, opAFF,  opLOG,  opNTFY, opPRIO,
+enum  {opNONE, opTIME, opARRY, opBTCH, opGRP,  opHELP, opAFF,  opLOG,  opNTFY, opPRIO,
        opQUE,  opTRY,  opROOT, opSID,  opSUB,  opTYPE, opTPFX, opVERB };
 const option::Descriptor usage[] = {
     {opNONE, 0, "",  "",             Arg::None, 
         "Make a new job; i.e. enter a job into a batch queue.\n\n"
-        "Usage: mkjob [options] [command [args...]]\n\n"
+        "Usage: mkjob [options] [command [args...]]\n"
+        "       mkjob [options] --batch FILE|-\n\n"
         "Options:" },
     {opTIME, 0, "a", "at-time",     Arg::Reqd, "  -a  --at-time      Schedule time to run the job;\n"
                                                 "                       default is the next minute"},
+    {opARRY, 0, "A", "array",       Arg::Reqd, "  -A  --array        Array job - run the command once for each\n"
+                                                "                       index in first-last[:step]"},
+    {opBTCH, 0, "b", "batch",       Arg::Reqd, "  -b  --batch        Submit many jobs, one per line of FILE\n"
+                                                "                       (or of stdin, if -)"},
     {opGRP,  0, "g", "group",       Arg::Reqd, "  -g  --group        Group job - provide comma-separated\n"
                                                 "                       list (no spaces) of stations"},
     {opHELP, 0, "h", "help",        Arg::None, "  -h  --help         Show this help message and exit"},
@@ -72,6 +83,12 @@ const option::Descriptor usage[] = {
         "  With --type, arguments are optional and passed as-is.\n"
         "  Job types must be defined in the queue's configuration before they can\n"
         "  be used.\n"
+        "  With --batch, the jobs' commands and arguments are read from FILE\n"
+        "  instead, one job per line, words split on whitespace; or if FILE has\n"
+        "  NULs in it, one job per NUL-ended record, one word per line of it.\n"
+        "  All the jobs get the other options given.\n"
+        "  With --array, the one job is run once per index, each told its index\n"
+        "  in JOB_ARRAY_INDEX; they all run as the one array job.\n"
 //        "\n"
 //        "  Job affinity can be used to give a scheduling boost when a job is eligible\n"
 //        "  to run in a preferred location, so that the job is more\n"
@@ -84,7 +101,7 @@ const option::Descriptor usage[] = {
 static std::string     test_prefix;     // Test prefix for process names
 
 // Get the PID of a particular queue's jobman
-//  Returns the PID, else 0 if not found
+//  Returns the PID, else 0 if not found.  Only for a jobman that won't take notices.
 //  TODO: make this a utility function in the C and C++ API
 pid_t find_jobman(const std::string & qnam) {
 
@@ -96,6 +113,7 @@ pid_t find_jobman(const std::string & qnam) {
     }
 
     std::string wanted = test_prefix + "jobman " + qnam;
+    std::string multi  = test_prefix + "jobman --multi";      // the one for all queues
     struct dirent* ent;
     while ((ent = readdir(dir))) {
 
@@ -109,7 +127,7 @@ pid_t find_jobman(const std::string & qnam) {
         snprintf(buf, sizeof(buf), "/proc/%ld/cmdline", pid);
         FILE* fp = fopen(buf, "r");
         if (!fp) continue;
-        if (fgets(buf, sizeof(buf), fp) && (buf == wanted)) {
+        if (fgets(buf, sizeof(buf), fp) && ((buf == wanted) || (buf == multi))) {
 
             // Found it
             fclose(fp);
@@ -124,6 +142,89 @@ pid_t find_jobman(const std::string & qnam) {
     return 0;
 }
 
+// Split a batch into jobs, each a list of words.  Normally it's a job per
+//  line, its words split on whitespace.  If there are NULs, it's a job per
+//  NUL-ended record, and a word per line in it, so words may have spaces.
+//  Empty jobs, and lines starting with #, are skipped.
+std::vector<job::stringlist> parse_batch(const std::string & text) {
+    bool nuls = (text.find('\0') != std::string::npos);
+    char eor  = nuls ? '\0' : '\n';
+    const char* seps = nuls ? "\n" : " \t\r\n";
+    std::vector<job::stringlist> jobs;
+    size_t at = 0;
+    while (at < text.size()) {
+        size_t end = text.find(eor, at);
+        if (end == std::string::npos) end = text.size();
+        if (nuls || (text[at] != '#')) {
+            job::stringlist words;
+            size_t w = text.find_first_not_of(seps, at);
+            while ((w != std::string::npos) && (w < end)) {
+                size_t e = text.find_first_of(seps, w);
+                if ((e == std::string::npos) || (e > end)) e = end;
+                words.push_back(text.substr(w, e - w));
+                w = text.find_first_not_of(seps, e);
+            }
+            if (words.size()) jobs.push_back(words);
+        }
+        at = end + 1;
+    }
+    return jobs;
+}
+
+// Tell the job manager of the jobs we put in pend.  If it's not listening,
+//  signal it to check its queue again.
+void wake_jobman(const std::string & qnam, const job::stringlist & jobfiles) {
+    job::notice nt(qnam);
+    if (!nt.send(jobfiles)) {
+        saydebug("Sent notice of %d jobs to %s", (int)jobfiles.size(), nt.addr);
+        return;
+    }
+    saydebug("Cannot notify jobman, will signal it: %s", nt.error);
+    pid_t pid = find_jobman(qnam);
+    if (pid) {
+        int err = kill(pid, SIGHUP);
+        err ? sayerror("*** Cannot signal jobman: %s", SYS_status)
+            : saydebug("Sent SIGHUP to jobman at PID %d", pid);
+    }
+}
+
+// Submit a batch of jobs like jf, but for their commands and arguments.
+//  They're all made in one go, then jobman is told just the once.
+int submit_batch(job::file & jf, const std::string & fnam, const bool typed) {
+    std::string text;
+    job::status err = job::batch::read(fnam, text);
+    if (err) quit("*** Batch: %s", err);
+    std::vector<job::stringlist> specs = parse_batch(text);
+    if (specs.empty()) quit("*** No jobs in batch %s", fnam);
+
+    jf.state = job::pend;
+    job::batch bt(jf, specs.size());
+    if (bt.error) quit("*** Batch: %s", bt.error);
+    for (size_t i = 0; i < specs.size(); i++) {
+        std::string command;
+        if (!typed) {
+            command = specs[i][0];
+            specs[i].erase(specs[i].begin());
+        }
+        if (!bt.make(command, specs[i]))
+            sayerror("*** Batch job %d not submitted: %s", (int)(i+1), bt.error);
+    }
+    if (bt.made.size()) {
+        job::stringlist names;
+        for (size_t i = 0; i < bt.made.size(); i++) {
+            jf.id = bt.made[i];
+            names.push_back(jf.name());
+        }
+        wake_jobman(jf.queue, names);
+    }
+
+    // Ciao!
+    for (size_t i = 0; i < bt.made.size(); i++) say("Job %u: Submitted", bt.made[i]);
+    sayverbose("   Queue: %s", jf.queue);
+    if (bt.failed) quit("*** %d of %d batch jobs not submitted", (int)bt.failed, (int)specs.size());
+    return job::ERR_OK;
+}
+
 //
 // Main entry point
 //
@@ -177,10 +278,18 @@ int main(int argc, const char* argv[]) {
                     ;
     if ((prio < job::PRIORITY_MIN) || (prio > job::PRIORITY_MAX))
         quit("*** Bad --priority, must be %d to %d", job::PRIORITY_MIN, job::PRIORITY_MAX);
-    if (!cli.opts[opTYPE] && (cli.args.size() == 0))
+    if (cli.opts[opBTCH] && cli.args.size())
+        quit("*** With --batch, commands and arguments come from the batch");
+    if (cli.opts[opBTCH] && cli.opts[opGRP])
+        quit("*** Cannot use --group with --batch");
+    if (cli.opts[opARRY] && (cli.opts[opBTCH] || cli.opts[opGRP]))
+        quit("*** Cannot use --array with --batch or --group");
+    job::array ar(cli.opts[opARRY] ? cli.opts[opARRY].arg : "");
+    if (ar.error) quit("*** %s", ar.error);
+    if (!cli.opts[opBTCH] && !cli.opts[opTYPE] && (cli.args.size() == 0))
         quit("*** Provide a command or use --type");
     string command;
-    if (!cli.opts[opTYPE]) {
+    if (!cli.opts[opBTCH] && !cli.opts[opTYPE]) {
         command = cli.args[0];
         cli.args.erase(cli.args.begin());
     }
@@ -197,8 +306,9 @@ int main(int argc, const char* argv[]) {
     if (try_limit < 1)
         quit("*** Bad try limit");
 
-    // Set our job zone
-    job::file::zone = cfg.geti("job", "zone"); 
+    // Set our job zone, and how we get job IDs
+    job::file::zone  = cfg.geti("job", "zone"); 
+    job::file::lease = cfg.geti("job", "lease");
 
     // Create the job
     job::file jf;
@@ -213,9 +323,11 @@ int main(int argc, const char* argv[]) {
     jf.args      = cli.args;
     jf.notify    = cli.opts[opNTFY];
     if (cli.opts[opGRP]) jf.tie_to(job::split(cli.opts[opGRP].arg, ","));
+    if (cli.opts[opARRY]) jf[0]["Job-Array"] = ar.to_string();
     jf.closed    = true;
     jf.uid       = getuid();    // Use caller's read UID
     jf.gid       = getgid();    // Use caller's read GID
+    if (cli.opts[opBTCH]) return submit_batch(jf, cli.opts[opBTCH].arg, cli.opts[opTYPE]);
     jf.state     = job::hold;   // Start in hold
     jf.store();                 // Create the file
     if (jf.error) die(jf.error);
@@ -238,18 +350,14 @@ int main(int argc, const char* argv[]) {
         quit("Failed to move job into queue: %s\n%s", moverr, second);
     }
 
-    // Signal the job manager to check its queue again
-    pid_t pid = find_jobman(qnam);
-    if (pid) {
-        int err = kill(pid, SIGHUP);
-        err ? sayerror("*** Cannot signal jobman: %s", SYS_status)
-            : saydebug("Sent SIGHUP to jobman at PID %d", pid);
-    }
+    // Tell the job manager it's there
+    wake_jobman(qnam, job::stringlist(1, jf.name()));
 
     // Ciao!
     say("Job %u: Submitted", jf.id);
     sayverbose("Run Time: %s", cli.opts[opTIME] ? job::tim2str(jf.run_time, true) : "-(soon)-");
     sayverbose("   Queue: %s", qnam);
+    if (cli.opts[opARRY]) sayverbose("   Array: %s (%d elements)", ar.to_string(), (int)ar.size());
     sayverbose("Job File: %s", jf.name());
     if (cli.opts[opTYPE])  sayverbose("Job Type: %s", jf.type);
     if (!cli.opts[opTYPE]) sayverbose(" Command: %s", jf.command);
@@ -27,7 +27,9 @@
 #include "job/isafe.hxx"
 #include "job/launch.hxx"
 #include "job/log.hxx"
+#include "job/notice.hxx"
 #include "job/path.hxx"
+#include "job/poller.hxx"
 #include "job/queue.hxx"
 #include "job/status.hxx"
 #include "job/string.hxx"
@@ -35,9 +37,11 @@
 #include <errno.h>          // EAGAIN etc
 #include <fcntl.h>          // open(2), close(2), etc
 #include <pwd.h>            // getpwuid()
+#include <set>
 #include <signal.h>         // SIGCONT, kill(), sig_atomic_t, etc
 #include <stdio.h>          // snprintf(), etc
 #include <stdlib.h>         // setenv()
+#include <sys/inotify.h>    // IN_* event masks
 #include <sys/stat.h>       // open(2), close(2), etc
 #include <sys/types.h>      // types for kill(), open() etc
 #include <unistd.h>         // sleep()
@@ -55,7 +59,7 @@ using job::qqif;
 using job::trim;
 
 // CLI options and usage help
-enum  {opNONE, opDMN,  opHELP, opLOG, 
+enum  {opNONE, opDMN,  opHELP, opLOG,  opMULT,
        opPOLL, opROOT, opTPFX, opTTIM, opVERB };
 const option::Descriptor usage[] = {
     {opNONE, 0, "",  "",             Arg::None, 
@@ -66,8 +70,9 @@ const option::Descriptor usage[] = {
     {opDMN,  0, "D", "no-daemonize", Arg::None, "  -D  --no-daemonize Run immediate; do not become a daemon"},
     {opHELP, 0, "h", "help",         Arg::None, "  -h  --help         Show this help message and exit"},
     {opLOG,  0, "l", "log-level",    Arg::Reqd, "  -l  --log-level    Debugging log level (info, verbose, debug...)"},
+    {opMULT, 0, "m", "multi",        Arg::None, "  -m  --multi        One jobman for all queues (jobmen: one)"},
     {opROOT, 0, "R", "root",         Arg::Reqd, "  -R  --root         Set file system root"},
-    {opPOLL, 0, "s", "sleep",        Arg::Reqd, "  -s  --sleep        Sleep (poll) time, seconds"},
+    {opPOLL, 0, "s", "sleep",        Arg::Reqd, "  -s  --sleep        Time between full rescans of queues, seconds"},
     {opTTIM, 0, "t", "test-time",    Arg::Reqd, "  -t  --test-time    For testing, exit after time, seconds"},
     {opTPFX, 0, "T", "test-prefix",  Arg::Reqd, "  -T  --test-prefix  For testing, process name prefix"},
     {opVERB, 0, "v", "verbose",      Arg::None, "  -v  --verbose      Show more info"},
@@ -76,7 +81,7 @@ const option::Descriptor usage[] = {
         "  This daemon manages the set of batch queues on your system.\n"
         "  When new queues appear, it launches a jobman daemon for that queue.\n"
         "  When a queue is deleted, it kills off the jobman that was handling\n"
-        "  that queue.\n"
+        "  that queue; when its config changes, its jobman reloads it.\n"
         "\n"
         "        init (PID 1) ---> queman\n"
         "                             |\n"
@@ -86,6 +91,9 @@ const option::Descriptor usage[] = {
         "                             :\n"
         "                       (and so on...)\n"
         "\n"
+        "  Or, with --multi, it launches one jobman for all the queues,\n"
+        "  and tells it as queues come and go.\n"
+        "\n"
         },
     {0,0,0,0,0,0}
 };
@@ -98,6 +106,12 @@ static volatile sig_atomic_t check_soon = false;    // Something changed, check
 static std::string     test_prefix;     // Test prefix for process names
 static job::stringlist known_queues;    // Queues known to be running
 static job::stringlist failed_queues;   // Queues we tried to start but that failed; ignoring these
+static pid_t           multi_pid = 0;   // The jobman for all queues, if that's how we run them
+static std::set<std::string> changed_queues;    // Queues whose config changed since the last check
+
+// A burst of changes, such as mkjobq making a queue's directories then its
+//  config, is let settle this long before we look
+#define SETTLE_MSECS 100
 
 // Signal handler to re-check queues
 static void signal_handler(int sig) {
@@ -137,123 +151,288 @@ static int q_done(job::launch & pad, void* ua, pid_t cpid, int cstat) {
     return EIDRM;
 }
 
+// Completion callback for the jobman of all queues; we'll start another at the next check
+static int multi_done(job::launch & pad, void* ua, pid_t cpid, int cstat) {
+    loginfo("Manager for all queues terminated with %d:%d", pad.xsig, pad.xstat);
+    known_queues.clear();
+    multi_pid = 0;
+    delete &pad;
+    return EIDRM;   // see q_done()
+}
+
+// Keep the one jobman for all queues up to date: start it with the queues
+//  there are, then tell it as they come, go, or change.  If it can't be told,
+//  the changes are tried again at the next check.
+static void one_for_all(const std::string & jobmancmd, const job::stringlist & curr_queues) {
+    if (!multi_pid) {
+        std::string qcmd = jobmancmd + " --multi";
+        for (size_t i=0; i < curr_queues.size(); i++) qcmd += " " + qqif(curr_queues[i]);
+
+        // Launch it
+        job::launch* pad = new job::launch;         // deleted in completion handler
+        pad->command   = qcmd;
+        pad->logfile   = path.logdir + "jobman.log";
+        pad->kill_kids = true;
+        pad->term_cb   = multi_done;
+        pad->start();
+        if (pad->error) {
+            logerror("Cannot launch manager for all queues: %s\n\tCommand: %s", pad->error, qcmd);
+            delete pad;
+            return;
+        }
+        multi_pid    = pad->pid;
+        known_queues = curr_queues;
+        changed_queues.clear();                     // it reads their configs as it starts
+        loginfo("Manager for all queues started as PID %d", pad->pid);
+        logdebug("  Command: %s", qcmd);
+        return;
+    }
+
+    // What's gone, what's new, what's changed
+    job::stringlist orders;
+    job::stringlist gone_queues = job::diff(known_queues, curr_queues);
+    job::stringlist new_queues  = job::diff(curr_queues, known_queues);
+    for (size_t g=0; g < gone_queues.size(); g++) {
+        loginfo("Queue %s: Removed, stopping queue", gone_queues[g]);
+        orders.push_back("-" + gone_queues[g]);
+    }
+    for (size_t i=0; i < new_queues.size(); i++) {
+        loginfo("Queue %s: Added, starting queue", new_queues[i]);
+        orders.push_back("+" + new_queues[i]);
+    }
+    for (std::set<std::string>::iterator it = changed_queues.begin(); it != changed_queues.end(); ++it) {
+        if (!job::has(known_queues, *it) || !job::has(curr_queues, *it)) continue;
+        loginfo("Queue %s: Config changed, reloading queue", *it);
+        orders.push_back("=" + *it);
+    }
+    if (orders.empty()) return;
+
+    job::notice jobman;     // the spool's own
+    if (jobman.send(orders)) {
+        logwarn("Cannot tell the manager of queue changes, will try again: %s", jobman.error);
+        return;
+    }
+    known_queues = curr_queues;
+    changed_queues.clear();
+}
 
-// Watch for queues that come and go; launch individual job managers for each queue
+// The PID of a queue's own jobman, or 0 if none
+static pid_t jobman_of(const std::string & qname) {
+    for (job::launch::finmap_t::iterator it = job::launch::finmap.begin();
+         it != job::launch::finmap.end();
+         it++) {
+        job::launch* pad = it->second;
+        if (!pad || !pad->term_ua || (pad->term_cb != q_done)) continue;
+        if (*(std::string*)pad->term_ua == qname) return it->first;
+    }
+    return 0;
+}
+
+// Check for new, deleted or changed queues; launch individual job managers
+//  for each queue, or keep the one for them all up to date.
+static void check_queues(const std::string & jobmancmd, const bool multi) {
+    logverbose("Checking for changes to queues");
+
+    // A queue's there once it has its config too; mkjobq makes that last
+    job::stringlist curr_queues;
+    job::status err = job::queue::get_queues(curr_queues);
+    if (err) die("*** "+err);
+    for (size_t i=0; i < curr_queues.size(); ) {
+        struct stat sb;
+        if (stat((path.qcfdir + curr_queues[i] + ".conf").c_str(), &sb)) {
+            logverbose("Queue %s: No config yet", curr_queues[i]);
+            curr_queues.erase(curr_queues.begin() + i);
+        }
+        else ++i;
+    }
+    if (multi) {
+        one_for_all(jobmancmd, curr_queues);
+        return;
+    }
+
+    // What's gone?  gone = known - curr
+    job::stringlist gone_queues = job::diff(known_queues, curr_queues);
+    if (gone_queues.size())
+        logverbose("Gone queues: %s", job::join(gone_queues, ", "));
+
+    // Stop each queue that is now gone
+    for (size_t g=0; g < gone_queues.size(); g++) {
+        std::string & gone_q = gone_queues[g];
+        loginfo("Queue %s: Removed, stopping queue", gone_q);
+
+        // Kill this subordinate queue manager; the q_done callback will do the rest
+        pid_t pid = jobman_of(gone_q);
+        if (!pid) {
+            logverbose("Queue %s: queue manager process already gone", gone_q);
+            continue;
+        }
+        if (kill(pid, SIGKILL)) {
+            logerror("Queue %s: Could not kill queue manager process %d: %s",
+                      gone_q, pid, SYS_status);
+        }
+        else {
+            logverbose("Queue %s: killed queue manager process %d", gone_q, pid);
+        }
+    }
+
+    // Have the manager of each queue whose config changed reload it in place.
+    //  It's not stopped: its running jobs would go with it.
+    for (std::set<std::string>::iterator it = changed_queues.begin(); it != changed_queues.end(); ++it) {
+        if (!job::has(known_queues, *it) || !job::has(curr_queues, *it)) continue;
+        pid_t pid = jobman_of(*it);
+        if (!pid) continue;
+        loginfo("Queue %s: Config changed, reloading queue", *it);
+        if (kill(pid, SIGHUP))
+            logerror("Queue %s: Could not signal queue manager process %d: %s", *it, pid, SYS_status);
+    }
+    changed_queues.clear();
+
+    // If gone, they're no longer on the failed list
+    failed_queues = job::diff(failed_queues, gone_queues);
+
+    // What's new?   new = curr - known - failed
+    job::stringlist new_queues  = job::diff(job::diff(curr_queues, known_queues), failed_queues);
+    if (new_queues.size())
+        logverbose("New queues: %s", job::join(new_queues, ", "));
+
+    // Start these new queues
+    for (size_t i=0; i < new_queues.size(); i++) {
+        std::string qname = new_queues[i];
+        std::string qcmd  = jobmancmd  + " " + qname;
+
+        // Launch it
+        job::launch* pad = new job::launch;         // deleted in queue completion handler
+        pad->command   = qcmd;
+        pad->logfile   = path.logdir + "queue:" + qname + ".log";
+        pad->kill_kids = true;
+        pad->term_cb   = q_done;
+        pad->term_ua   = new std::string(qname);    // deleted in queue completion handler
+        pad->start();
+        if (pad->error) {
+            logerror("Queue %s: Cannot launch: %s\n\tCommand: %s", qname, pad->error, qcmd);
+            failed_queues.push_back(qname);
+            delete pad;
+            pad = NULL;
+            continue;
+        }
+        known_queues.push_back(qname);
+        loginfo("Queue %s: Manager started as PID %d", qname, pad->pid);
+        logdebug("  Command: %s", qcmd);
+    }
+}
+
+// What the event handlers need to watch the queues
+struct lookout {
+    std::string jobmancmd;
+    bool        multi;
+    int         t_check;            // The check, periodic and as things change
+    int         w_spool;            // Watches on the spool and the queue configs
+    int         w_qdefs;
+};
+
+// Signal event handler
+static int on_signal(job::poller & pol, int fd, uint32_t sig, void* ua) {
+    if (sig == SIGCHLD) {
+        job::launch::reap_zombies(true);    // fallback for children without a pidfd
+        return 0;
+    }
+    signal_handler(sig);
+    return 0;
+}
+
+// Timer event handler - check the queues
+static int on_timer(job::poller & pol, int fd, uint32_t n, void* ua) {
+    lookout* lk = (lookout*)ua;
+    check_queues(lk->jobmancmd, lk->multi);
+    return 0;
+}
+
+// Test mode timeout
+static int on_deadline(job::poller & pol, int fd, uint32_t n, void* ua) {
+    run_queues = false;
+    return 0;
+}
+
+// Directory change handler - a queue's directory came or went, or its config changed
+static int on_change(job::poller & pol, int fd, uint32_t what, void* ua) {
+    lookout* lk = (lookout*)ua;
+    job::poller::changes_t chg;
+    job::status e = job::poller::changes(fd, chg);
+    if (e) logwarn("Reading directory changes: %s", e);
+    if (chg.empty()) return 0;
+    logdebug("%d changes seen on fd %d", chg.size(), fd);
+    for (size_t i = 0; (fd == lk->w_qdefs) && (i < chg.size()); i++) {
+        const std::string & name = chg[i].second;
+        if ((name.size() > 5) && (name.compare(name.size() - 5, 5, ".conf") == 0))
+            changed_queues.insert(name.substr(0, name.size() - 5));
+    }
+    pol.soon(lk->t_check, SETTLE_MSECS);
+    return 0;
+}
+
+// Watch for queues that come and go; launch individual job managers for each queue,
+//  or one for them all.  Queues are seen via inotify as they're made, removed or
+//  changed; the periodic check remains as a safety net.
 void yearn_for_queues(
         std::string & jobmancmd,
+        bool multi,
         int next_check,
         int test_end) {
 
-    // Run the checkloop - stay in here unless we're signalled to die
-    int    next_reap  = 1;      // every second
-    time_t now        = time(NULL);
-    time_t when_check = now + 1;
-    time_t when_reap  = 0;
-    run_queues        = true;
-    do {
-        time_t now = time(NULL);
-        if (test_end && (now > test_end)) break;
+    job::poller pol;
+    if (pol.error) die("Cannot create event poller: %s", pol.error);
+    lookout lk = {jobmancmd, multi, -1, -1, -1};
+
+    // Our jobmen are reaped thru their pidfds as they exit; SIGCHLD catches the rest.
+    //  Signals are taken as events.
+    job::launch::events = &pol;
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGCHLD);
+    sigaddset(&sigs, SIGHUP);
+    sigaddset(&sigs, SIGTERM);
+    if (pol.signals(sigs, on_signal, &lk) < 0)
+        die("*** Cannot take signals: %s", pol.error);
+
+    // The check, first right away
+    lk.t_check = pol.timer(on_timer, &lk);
+    if (lk.t_check < 0) die("*** Cannot create timers: %s", pol.error);
+    pol.arm(lk.t_check, 1, next_check * 1000);
+    if (test_end) {
+        int t_end = pol.timer(on_deadline);
+        if (t_end < 0) die("*** Cannot create timers: %s", pol.error);
+        time_t left = test_end - time(NULL);
+        pol.arm(t_end, (left > 0) ? left * 1000 : 1);   // already past, end at once
+    }
+
+    // Watch for queues made and removed, and configs changed.  If we can't, the check still does it.
+    lk.w_spool = pol.watch(path.jobdir, IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM, on_change, &lk);
+    if (lk.w_spool < 0)
+        logwarn("Cannot watch for queues, will check every %d secs: %s", next_check, pol.error);
+    lk.w_qdefs = pol.watch(path.qcfdir, IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM, on_change, &lk);
+    if (lk.w_qdefs < 0)
+        logwarn("Cannot watch queue configs, will check every %d secs: %s", next_check, pol.error);
+
+    // Run the check loop - stay in here unless we're signalled to die
+    run_queues = true;
+    while (run_queues) {
+        if (pol.wait() < 0) {
+            logerror("Event wait failed: %s", pol.error);
+            sleep(1);   // don't spin
+        }
 
         // Signalled to check things again soon?
         if (check_soon) {
             check_soon = false;
-            when_reap  = now;
-            when_check = now;
+            pol.soon(lk.t_check, 0);
         }
-
-        // Reaper
-        if (now >= when_reap) {
-            when_reap = now + next_reap;
-            job::launch::reap_zombies();
-        }
-
-        // Check for new or deleted queueus
-        if (now >= when_check) {
-
-            logverbose("Checking for changes to queues");
-            when_check = now + next_check;
-
-            job::stringlist curr_queues;
-            job::status err = job::queue::get_queues(curr_queues);
-            if (err) die("*** "+err);
-
-            // What's gone?  gone = known - curr
-            job::stringlist gone_queues = job::diff(known_queues, curr_queues);
-            if (gone_queues.size())
-                logverbose("Gone queues: %s", job::join(gone_queues, ", "));
-
-            // Stop each queue that is now gone
-            for (size_t g=0; g < gone_queues.size(); g++) {
-                std::string & gone_q = gone_queues[g];
-                loginfo("Queue %s: Removed, stopping queue", gone_q);
-
-                // Find the PID for that queue's job manager
-                bool found = false;
-                for (job::launch::finmap_t::iterator it = job::launch::finmap.begin();
-                     it != job::launch::finmap.end();
-                     it++) {
-                    pid_t        pid = it->first;
-                    job::launch* pad = it->second;
-                    if (!pad) continue;
-                    if (!pad->term_ua) continue;
-                    std::string* pqnam = (std::string*)pad->term_ua;
-                    if (*pqnam != gone_q) continue;
-                    found = true;
-
-                    // Kill this subordinate queue manager; the q_done callback will do the rest
-                    int err = kill(pid, SIGKILL);
-                    if (err) {
-                        logerror("Queue %s: Could not kill queue manager process %d: %s",
-                                  gone_q, pid, SYS_status);
-                    }
-                    else {
-                        logverbose("Queue %s: killed queue manager process %d", gone_q, pid);
-                    }
-                    break;
-                }
-                if (!found) logverbose("Queue %s: queue manager process already gone", gone_q);
-            }
-
-            // If gone, they're no longer on the failed list
-            failed_queues = job::diff(failed_queues, gone_queues);
-
-            // What's new?   new = curr - known - failed
-            job::stringlist new_queues  = job::diff(job::diff(curr_queues, known_queues), failed_queues);
-            if (new_queues.size())
-                logverbose("New queues: %s", job::join(new_queues, ", "));
-
-            // Start these new queues
-            for (size_t i=0; i < new_queues.size(); i++) {
-                std::string qname = new_queues[i];
-                std::string qcmd  = jobmancmd  + " " + qname;
-
-                // Launch it
-                job::launch* pad = new job::launch;         // deleted in queue completion handler
-                pad->command   = qcmd;
-                pad->logfile   = path.logdir + "queue:" + qname + ".log";
-                pad->kill_kids = true;
-                pad->term_cb   = q_done;
-                pad->term_ua   = new std::string(qname);    // deleted in queue completion handler
-                pad->start();
-                if (pad->error) {
-                    logerror("Queue %s: Cannot launch: %s\n\tCommand: %s", qname, pad->error, qcmd);
-                    failed_queues.push_back(qname);
-                    delete pad;
-                    pad = NULL;
-                    continue;
-                }
-                known_queues.push_back(qname);
-                loginfo("Queue %s: Manager started as PID %d", qname, pad->pid);
-                logdebug("  Command: %s", qcmd);
-            }
-        }
-
-    } while (sleep(1) || run_queues);
+    }
 
     // Cleanup - although we can just exit out, doing so makes
     //  memory testing (valgrind etc) difficult; so we'll be diligent
     //  here and cleanup stuff anyway.
     // -- Kill off all the job managers we started --
+    job::launch::events = NULL;
     for (job::launch::finmap_t::iterator it =  job::launch::finmap.begin();
                                          it != job::launch::finmap.end();
                                          ++it) {
@@ -358,6 +537,7 @@ int main(int argc, const char* argv[]) {
     }
 
     // Get or default the CLI values we'll need when 'yearning'
+    bool multi = cli.opts[opMULT] || (jobcfg.get("job", "jobmen", "each") == "one");
     int next_check = cli.opts[opPOLL]
                         ? str2int(cli.opts[opPOLL].arg)
                         : jobcfg.geti("job",   "queue-watch-secs", 180);
@@ -378,7 +558,7 @@ int main(int argc, const char* argv[]) {
     job::launch::set_process_name(test_prefix + "queman");
 
     // Watch for new queues or removed queues
-    yearn_for_queues(mecmd, next_check, test_end);
+    yearn_for_queues(mecmd, multi, next_check, test_end);
 
     // Done
     isafe::close(fd);
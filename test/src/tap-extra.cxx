@@ -28,6 +28,7 @@
 #include <fstream>      // std::ifstream
 #include <sstream>
 #include <stdio.h>
+#include <sys/time.h>     // gettimeofday()
 #include <sys/types.h>
 #include <regex.h>
 #include <unistd.h>
@@ -186,3 +187,9 @@ int test_end() {
     return exit_status();
 }
 
+// Seconds now, to the microsecond
+double test_now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
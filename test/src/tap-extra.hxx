@@ -54,6 +54,7 @@ class test_capture_output {
 
 // Misc utility functions
 int test_end();
+double test_now();      // Seconds now, for timing
 
 #endif
 
@@ -0,0 +1,74 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  Tests for job::array, which says which elements an array job has.
+
+#include "job/array.hxx"
+#include "job/path.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <string>
+
+using namespace std;
+using namespace TAP;
+
+int main(int argc, char* argv[]) {
+
+    plan(22);
+    job::path.set_root("./kit");
+
+    note("  -- specs --");
+    job::array a("1-10000");
+    isok(a, "1-10000");
+    is(a.size(), (size_t)10000, "  size");
+    is(a.at(0), (uint64_t)1, "  first");
+    is(a.at(9999), (uint64_t)10000, "  last");
+    is(a.to_string(), string("1-10000:1"), "  to_string()");
+
+    job::array b("0-99:3");
+    isok(b, "0-99:3");
+    is(b.size(), (size_t)34, "  size");
+    is(b.at(1), (uint64_t)3, "  second");
+    is(b.at(33), (uint64_t)99, "  last");
+
+    job::array c("5-5");
+    isok(c, "5-5");
+    is(c.size(), (size_t)1, "  one element");
+
+    job::array d;
+    is(d.size(), (size_t)0, "none, if no spec");
+    is(job::array(d.to_string()).size(), (size_t)0, "  so round trip isn't good");
+    job::array e(b.to_string());
+    is(e.size(), b.size(), "but it is for a good one");
+
+    note("  -- bad specs --");
+    const char* bad[] = {"10", "10-1", "1-10:0", "-1-10", "1-10:", "1-x", "1-0100000000000"};
+    for (size_t i = 0; i < sizeof(bad)/sizeof(bad[0]); i++) {
+        job::array x(bad[i]);
+        ok(x.error && !x.size(), string("  ") + bad[i]);
+    }
+
+    note("  -- output file --");
+    like(job::array::output_name("batch", 123, 42), "/batch/\\.array/j0000123\\.42$", "output_name()");
+
+    return test_end();
+}
@@ -0,0 +1,146 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  Tests for job::batch, which makes many jobs from a template of one.
+//  Give a count of jobs as the first arg to run a bigger benchmark.
+
+#include "job/batch.hxx"
+#include "job/path.hxx"
+#include "job/string.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <stdio.h>
+#include <string>
+#include <sys/stat.h>         // chmod()
+#include <sys/wait.h>
+#include <unistd.h>         // access()
+
+using namespace std;
+using namespace TAP;
+
+int main(int argc, char* argv[]) {
+
+    plan(29);
+    job::path.set_root("./kit");
+
+    // The template
+    job::file proto;
+    proto.submitter = "batcher";
+    proto.priority  = 3;
+    proto.try_limit = 7;
+    proto.notify    = true;
+    proto.state     = job::pend;
+    job::id_t first = proto.id;
+
+    note("  -- making jobs --");
+    job::batch bt(proto, 3);
+    isok(bt, "batch()");
+    job::stringlist args;
+    args.push_back("-c1");
+    args.push_back("a spaced arg");
+    is(bt.make("ping", args), first, "first job has the template's ID");
+    isok(bt, "  no error");
+    job::id_t second = bt.make("true", job::stringlist());
+    ok(second > first, "second job's ID is later");
+    for (int i = 3; i <= 10; i++) args.push_back("arg" + job::int2str(i));
+    job::id_t third = bt.make("echo", args);
+    is(third, second + 1, "third follows it");
+    is(bt.made.size(), (size_t)3, "  three made");
+    is(bt.make("one-too-many", args), (job::id_t)0, "no more than reserved");
+    ok(bt.error, "  with an error");
+    is(bt.failed, (size_t)1, "  failed count");
+
+    note("  -- a job --");
+    job::file jf(first);
+    isok(jf, "found by ID");
+    is((int)jf.state, (int)job::pend, "  pending");
+    is(jf.priority, 3, "  priority");
+    is(jf.submitter, string("batcher"), "  submitter");
+    jf.load(true);
+    isok(jf, "  load(true)");
+    is(jf.command, string("ping"), "  command");
+    is(jf.args.size(), (size_t)2, "  two arguments");
+    is(jf.get(0, "Job-Arg-2"), string("a spaced arg"), "  ...as given");
+    is(jf.try_limit, 7, "  try limit");
+    ok(jf.notify, "  notify");
+    ok(jf.ties.empty(), "  no ties");
+    ok(access(jf.index_name().c_str(), F_OK) == 0, "  has a section index");
+
+    job::file jf3(third);
+    jf3.load(true);
+    is(jf3.args.size(), (size_t)10, "a job with ten arguments");
+    is(jf3.get(0, "Job-Arg-10"), string("arg10"), "  the tenth");
+    job::file jf2(second);
+    jf2.load(true);
+    is(jf2.args.size(), (size_t)0, "and one with none");
+
+    // Cleanup
+    jf.remove();
+    jf2.remove();
+    jf3.remove();
+
+    note("  -- reading batch files --");
+    string bfile = "test/tmp/batch.tmp";
+    FILE* fp = fopen(bfile.c_str(), "w");
+    fputs("echo one\necho two\n", fp);
+    fclose(fp);
+    string text;
+    job::batch::read(bfile, text);
+    is(text, "echo one\necho two\n", "read()");
+    if (geteuid()) skip(2, "not root");
+    else {
+        // As a setuid root mkjob would be: really someone else
+        chmod(bfile.c_str(), 0600);
+        int st[2];
+        for (int i = 0; i < 2; i++) {
+            pid_t pid = fork();
+            if (!pid) {
+                if (i && setresuid(65534, 0, 0)) _exit(2);
+                string t;
+                _exit(job::batch::read(bfile, t) ? 1 : 0);
+            }
+            waitpid(pid, &st[i], 0);
+        }
+        is(WEXITSTATUS(st[0]), 0, "  root may read a root-only file");
+        is(WEXITSTATUS(st[1]), 1, "  setuid root on behalf of another user may not");
+    }
+    unlink(bfile.c_str());
+
+    note("  -- speed --");
+    size_t n = (argc > 1) ? job::str2int(argv[1]) : 5000;
+    job::file big;
+    big.submitter = "batcher";
+    big.state     = job::pend;
+    double t0 = test_now();
+    job::batch lots(big, n);
+    for (size_t i = 0; i < n; i++) lots.make("echo", args);
+    double t1 = test_now();
+    is(lots.made.size(), n, "made them all");
+    note("  ", (int)(n / (t1 - t0)), " jobs/s");
+    is(lots.failed, 0u, "  none failed");
+    for (size_t i = 0; i < lots.made.size(); i++) {
+        job::file k(lots.made[i]);
+        k.remove();
+    }
+
+    return test_end();
+}
@@ -0,0 +1,131 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  Tests for job::client, the API for submitting jobs from a program, and its C wrapper.
+//  Give a count of jobs as the first arg to run a bigger benchmark.
+
+#include "job/client.h"
+#include "job/client.hxx"
+#include "job/path.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <string>
+#include <unistd.h>         // access()
+
+using namespace std;
+using namespace TAP;
+
+int main(int argc, char* argv[]) {
+
+    plan(32);
+
+    job::client jc("./kit");
+    isok(jc, "client()");
+    is(jc.default_queue, string("batch"), "  default queue from the config");
+
+    note("  -- submit --");
+    job::jobspec js;
+    is(jc.submit(js), (job::id_t)0, "nothing to run, no job");
+    ok(jc.error, "  with an error");
+    js.queue = "no-such-queue";
+    js.command = "true";
+    is(jc.submit(js), (job::id_t)0, "no such queue, no job");
+    like(string(jc.error), "No such queue", "  says so");
+    js.queue.clear();
+    js.priority = 12;
+    is(jc.submit(js), (job::id_t)0, "bad priority, no job");
+    js.priority = 3;
+    js.submitter = "clientele";
+    js.args.push_back("a spaced arg");
+    job::id_t id = jc.submit(js);
+    ok(id, "submit()");
+    isok(jc, "  no error");
+    is((int)jc.state(id), (int)job::pend, "  pending");
+    job::file jf(id);
+    jf.load(true);
+    is(jf.command, string("true"), "  command");
+    is(jf.get(0, "Job-Arg-1"), string("a spaced arg"), "  argument");
+    is(jf.priority, 3, "  priority");
+    is(jf.submitter, string("clientele"), "  submitter");
+
+    note("  -- cancel --");
+    jc.cancel(id);
+    isok(jc, "cancel() a pending job");
+    is((int)jc.state(id), (int)job::done, "  now done");
+    job::file jd(id);
+    jd.load();
+    is(jd[jd.size()-1]["Exit-Note"], string("Cancelled"), "  with a result saying so");
+    is((int)jc.cancel(id), (int)job::ERR_BADSTATE, "can't cancel it again");
+    is((int)jc.state(999999999), (int)job::unk, "no such job's state");
+    ok(jc.error, "  with an error");
+    jd.remove();
+
+    note("  -- batch --");
+    vector<job::stringlist> cmds;
+    cmds.push_back(job::split("echo one", " "));
+    cmds.push_back(job::stringlist());
+    cmds.push_back(job::split("echo three 3", " "));
+    job::idlist_t ids;
+    is(jc.submit_batch(js, cmds, ids), (size_t)2, "submit_batch() makes two of three");
+    ok(jc.error, "  an error for the empty one");
+    is(ids.size(), (size_t)3, "  an ID for each");
+    ok(ids[0] && !ids[1] && (ids[2] > ids[0]), "  0 for the one not made");
+    job::file b3(ids[2]);
+    b3.load(true);
+    is(b3.get(0, "Job-Arg-2"), string("3"), "  third job's last arg");
+    b3.remove();
+    job::file(ids[0]).remove();
+
+    note("  -- C --");
+    job_client* cc = job_open("./kit");
+    is(string(job_error(cc)), string(""), "job_open()");
+    struct job_spec cs = {0};
+    const char* cargs[] = {"hello", NULL};
+    cs.command = "echo";
+    cs.args    = cargs;
+    job_id_t cid = job_submit(cc, &cs);
+    ok(cid, "job_submit()");
+    is(job_status(cc, cid), (int)JOB_PEND, "  job_status()");
+    is(job_cancel(cc, cid), 0, "  job_cancel()");
+    is(job_status(cc, cid), (int)JOB_DONE, "  now done");
+    job::file(cid).remove();
+    job_close(cc);
+
+    note("  -- speed --");
+    size_t n = (argc > 1) ? job::str2int(argv[1]) : 2000;
+    cmds.assign(n, job::split("echo hello world", " "));
+    ids.clear();
+    double t0 = test_now();
+    size_t made = jc.submit_batch(js, cmds, ids);
+    double t1 = test_now();
+    is(made, n, "made them all");
+    note("  batch: ", (int)(n / (t1 - t0)), " jobs/s");
+    for (size_t i = 0; i < 200; i++) ids.push_back(jc.submit(js));
+    double t2 = test_now();
+    note("  one at a time: ", (int)(200 / (t2 - t1)), " jobs/s");
+    size_t got = 0;
+    for (size_t i = 0; i < ids.size(); i++) if (ids[i]) ++got;
+    is(got, n + 200,                "  and one at a time");
+    for (size_t i = 0; i < ids.size(); i++) job::file(ids[i]).remove();
+
+    return test_end();
+}
@@ -0,0 +1,101 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  Tests for job::fanout, which makes the child jobs of a group job.
+
+#include "job/fanout.hxx"
+#include "job/path.hxx"
+#include "job/string.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <string>
+#include <unistd.h>         // access(), readlink()
+
+using namespace std;
+using namespace TAP;
+
+int main(int argc, char* argv[]) {
+
+    plan(27);
+    job::path.set_root("./kit");
+
+    // A group job, tied to three stations
+    job::file grp;
+    grp.submitter = "fanner";
+    grp.command   = "ping";
+    grp.args.push_back("-c1");
+    job::stringlist stations;
+    stations.push_back("alpha");
+    stations.push_back("bravo");
+    stations.push_back("charlie");
+    grp.tie_to(stations);
+    grp.state = job::tied;
+    grp.store();
+    isok(grp, "group job stored");
+
+    note("  -- reserving IDs --");
+    job::fanout fo(grp);
+    isok(fo, "fanout()");
+    is(grp.ties["alpha"],   grp.id + 1, "  first child ID follows the group's");
+    is(grp.ties["bravo"],   grp.id + 2, "  then the next");
+    is(grp.ties["charlie"], grp.id + 3, "  and the next");
+    is(fo.todo.size(), (size_t)3, "  three to make");
+    ok(!fo.done(), "  not done");
+
+    note("  -- making them --");
+    is(fo.step(2), (size_t)2, "step(2) makes two");
+    isok(fo, "  no errors");
+    is(fo.made, (size_t)2, "  made count");
+    ok(!fo.done(), "  not done");
+    is(fo.step(100), (size_t)1, "step(100) makes the last one");
+    ok(fo.done(), "  done");
+    is(fo.made, (size_t)3, "  made count");
+    is(fo.failed, (size_t)0, "  none failed");
+
+    note("  -- a child --");
+    job::file kid(grp.ties["bravo"]);
+    isok(kid, "found by ID");
+    is((int)kid.state, (int)job::pend, "  pending");
+    kid.load(true);
+    isok(kid, "  load(true)");
+    is(kid.mid, grp.id, "  group's ID");
+    is(kid.command, string("ping"), "  command");
+    is(kid.get(0, "Job-Arg-1"), string("-c1"), "  argument");
+    is(kid.ties.size(), (size_t)1, "  one tie");
+    is(kid.ties["bravo"], (job::id_t)0, "  ...to its station");
+    ok(access(kid.index_name().c_str(), F_OK) == 0, "  has a section index");
+    is(kid.try_count, 0, "  not tried yet");
+
+    note("  -- again --");
+    job::fanout again(grp);
+    isok(again, "fanout() of the same group");
+    is(grp.ties["bravo"], kid.id, "  keeps the child IDs");
+
+    // Cleanup
+    for (job::ties_t::iterator it = grp.ties.begin(); it != grp.ties.end(); ++it) {
+        job::file k(it->second);
+        k.remove();
+    }
+    grp.remove();
+
+    return test_end();
+}
@@ -42,7 +42,7 @@ using namespace TAP;
 
 int main(int argc, char* argv[]) {
 
-    plan(85);
+    plan(94);
     job::path.set_root("./kit");
 
     // Inits
@@ -150,6 +150,38 @@ int main(int argc, char* argv[]) {
         like(jf.name(), "/batch/hold/t0946684799.p5.j0000022.zoned.out$", "file name");
     }
 
+    // ID index
+    {
+        note("  -- ID index --");
+        char target[PATH_MAX];
+        job::file jf;
+        jf.submitter = "seeker";
+        jf.store();
+        isok(jf, "store()");
+        string lnk = job::file::id_name(jf.id);
+        ok(readlink(lnk.c_str(), target, sizeof(target)) > 0, "  indexed");
+        is(jf.find(jf.id), jf.name(), "find() thru the ID index");
+        jf.state = job::pend;
+        jf.repath();
+        is(jf.find(jf.id), jf.name(), "  after repath()");
+
+        unlink(lnk.c_str());
+        is(jf.find(jf.id), jf.name(), "find() when not indexed");
+        ok(readlink(lnk.c_str(), target, sizeof(target)) > 0, "  indexed again");
+
+        job::file moved(jf.name());
+        moved.priority = 2;
+        string elsewhere = moved.name();
+        rename(jf.name().c_str(), elsewhere.c_str());   // behind the index's back
+        is(jf.find(jf.id), elsewhere, "find() with a stale link");
+        job::file byid(jf.id);
+        is(byid.priority, 2, "  constructor by ID finds it too");
+        rename(elsewhere.c_str(), jf.name().c_str());
+
+        jf.remove();
+        ok(readlink(lnk.c_str(), target, sizeof(target)) < 0, "remove() unindexes");
+    }
+
     // Name parsing - bad cases
     note("  -- Name parsing: black smoke --");
     {
@@ -0,0 +1,78 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  Tests for the job::histogram struct, log-linear buckets for latencies.
+
+#include "job/histogram.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <stdint.h>
+
+using namespace std;
+using namespace TAP;
+
+int main(int argc, char* argv[]) {
+
+    plan(18);
+
+    // Buckets
+    note("  -- buckets --");
+    is(job::histogram::index(0), 0,         "0 has its own bucket");
+    is(job::histogram::index(7), 7,         "7 has its own bucket");
+    is(job::histogram::index(8), 8,         "8 starts the log buckets");
+    is(job::histogram::index(16), 16,       "16 is a power of two later");
+    is(job::histogram::index((uint64_t)-1), HIST_BUCKETS - 1, "huge values go in the top bucket");
+    bool fits = true, close = true, steps = true;
+    for (uint64_t v = 1; v < (1ULL << 42); v = v * 3 / 2 + 1) {
+        int i = job::histogram::index(v);
+        if ((v < job::histogram::lowest(i)) || (v > job::histogram::highest(i))) fits = false;
+        if ((job::histogram::highest(i) - job::histogram::lowest(i)) * 8 > job::histogram::lowest(i)) close = false;
+    }
+    for (int i = 0; i < HIST_BUCKETS - 1; i++) {
+        if (job::histogram::lowest(i+1) != job::histogram::highest(i) + 1) steps = false;
+    }
+    ok(fits,    "each value is within its bucket's bounds");
+    ok(close,   "  which are within 12.5% of each other");
+    ok(steps,   "  and the buckets cover every value, without overlap");
+    ok(job::histogram::lowest(HIST_BUCKETS - 1) > 86400ULL * 1000000 * 90,
+                "the top bucket starts past 90 days of microseconds");
+
+    // Recording
+    note("  -- recording --");
+    job::histogram h;
+    h.clear();
+    is(h.percentile(50), 0u,                "empty: no percentiles");
+    for (uint64_t v = 1; v <= 1000; v++) h.record(v * 1000);    // 1ms to 1s
+    is(h.count, 1000u,                      "count");
+    is(h.min, 1000u,                        "min");
+    is(h.max, 1000000u,                     "max");
+    is(h.mean(), 500500u,                   "mean");
+    uint64_t p50 = h.percentile(50);
+    uint64_t p99 = h.percentile(99);
+    ok((p50 >= 500000) && (p50 <= 500000 * 9 / 8), "  p50 within 12.5%");
+    ok((p99 >= 990000) && (p99 <= 1000000), "  p99 within 12.5%, and no more than the max");
+    is(h.percentile(100), 1000000u,         "  p100 is the max");
+    h.clear();
+    is(h.count, 0u,                         "clear()");
+
+    return test_end();
+}
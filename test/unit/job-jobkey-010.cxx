@@ -0,0 +1,112 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  Basic tests for the job::jobkey struct.
+
+#include "job/jobkey.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <algorithm>        // std::sort
+#include <stdlib.h>         // rand()
+#include <string>
+
+using namespace std;
+using namespace TAP;
+
+int main(int argc, char* argv[]) {
+
+    plan(39);
+
+    // Parsing
+    note("  -- parse --");
+    job::jobkey k;
+    ok(k.parse("t0946684799.p5.j0000001.tester"), "parse typical name");
+    is(k.run_time, 946684799, "  run time");
+    is(k.priority, 5,         "  priority");
+    is(k.id, 1U,              "  id");
+    is(k.submitter(), "tester", "  submitter");
+    is(k.name(), "t0946684799.p5.j0000001.tester", "  name round trip");
+
+    ok(k.parse("t1500000000.p1.j123456789.bob@example.com"), "parse long id, email submitter");
+    is(k.id, 123456789U, "  id");
+    is(k.submitter(), "bob@example.com", "  submitter");
+    is(k.name(), "t1500000000.p1.j123456789.bob@example.com", "  name round trip");
+
+    job::jobkey k2;
+    k2.parse("t0000000001.p9.j0000002.tester");
+    is(k2.who, k.parse("t0000000001.p9.j0000003.tester") ? k.who : 0, "submitter is interned once");
+
+    ok(!k.parse(""),                                "reject empty");
+    ok(!k.parse(".hidden"),                         "reject dot file");
+    ok(!k.parse("t0946684799.p5.j0000001."),        "reject missing submitter");
+    ok(!k.parse("t0946684799.p0.j0000001.tester"),  "reject priority 0");
+    ok(!k.parse("t0946684799.p10.j0000001.tester"), "reject priority 10");
+    ok(!k.parse("t0946684799.p5.jx.tester"),        "reject bad id");
+    ok(!k.parse("tABC.p5.j0000001.tester"),         "reject bad time");
+    ok(!k.parse("x0946684799.p5.j0000001.tester"),  "reject bad prefix");
+    ok(!k.parse("123"),                             "reject kill file name");
+    ok(!k.parse("t946684799.p5.j0000001.tester"),   "reject unpadded time");
+    ok(!k.parse("t00946684799.p5.j0000001.tester"), "reject time padded too far");
+    ok(!k.parse("t0946684799.p5.j1.tester"),        "reject unpadded id");
+    ok(!k.parse("t0946684799.p5.j00000001.tester"), "reject id padded too far");
+    ok(!k.parse("t0946684799.p05.j0000001.tester"), "reject padded priority");
+    ok(!k.parse("t0946684799.p5.j0000001.bob smith"), "reject blank in submitter");
+    ok(!k.parse("t0946684799.p99999999999999999999.j0000001.tester"), "reject long priority");
+    ok(!k.parse("t99999999999999999999999.p5.j0000001.tester"),       "reject long time");
+    ok(k.parse("t1.p9.j1.z@z.zork", false),         "not exact, unpadded is fine");
+    is(k.name(), "t0000000001.p9.j0000001.z@z.zork", "  but named as it should be");
+    ok(!k.parse("t1.p99999999999.j1.z", false),     "  priority still checked");
+
+    // Comparisons
+    note("  -- compare --");
+    job::jobkey a, b;
+    a.parse("t0000000100.p5.j0000001.tester");
+    b.parse("t0000000200.p1.j0000002.tester");
+    ok(a < b,                     "time order: earlier first");
+    ok(job::jobkey::by_prio()(b, a), "priority order: better first");
+    ok(a != b,                    "not equal");
+    b = a;
+    ok(a == b,                    "equal after copy");
+
+    // Sorting, both small (comparison sort) and big (radix)
+    note("  -- sort --");
+    for (int pass = 0; pass < 2; pass++) {
+        size_t n = pass ? 5000 : 20;
+        job::keylist_t keys(n);
+        for (size_t i = 0; i < n; i++) {
+            keys[i].run_time = 946684799 + (rand() % 1000) * ((rand() % 2) ? 1 : 100000);
+            keys[i].priority = 1 + rand() % 9;
+            keys[i].id       = rand() % 100000000;
+            keys[i].who      = 0;
+        }
+        job::keylist_t want = keys;
+        job::keylist_t got  = keys;
+        std::sort(want.begin(), want.end(), job::jobkey::by_time());
+        job::jobkey::sort(got);
+        ok(want == got, pass ? "radix sort by time" : "small sort by time");
+        std::sort(want.begin(), want.end(), job::jobkey::by_prio());
+        job::jobkey::sort_by_prio(got);
+        ok(want == got, pass ? "radix sort by priority" : "small sort by priority");
+    }
+
+    return test_end();
+}
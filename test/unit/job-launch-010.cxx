@@ -0,0 +1,203 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  Tests for job::launch, both the fork and spawn methods,
+//  reaping thru pidfds on a poller, and a benchmark of launches per second for each.
+//  Give a count as the first arg to run a bigger benchmark.
+
+#include "job/launch.hxx"
+#include "job/poller.hxx"
+#include "job/string.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <fstream>
+#include <grp.h>            // setgroups()
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>         // memset()
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+using namespace TAP;
+#define TESTDIR "test/tmp/"
+
+// Read a whole file
+static string slurp(const string & fnam) {
+    ifstream in(fnam.c_str());
+    stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// Reap until all our children are done
+static void reap_all() {
+    while (job::launch::running()) {
+        usleep(1000);
+        job::launch::reap_zombies();
+    }
+}
+
+// Run a command to completion with the given method, return its output
+static string run(job::launch::method_t m, const string & cmd, int & xstat, int nice = 0) {
+    string log = TESTDIR "launch.out";
+    unlink(log.c_str());
+    job::launch pad;
+    pad.method    = m;
+    pad.command   = cmd;
+    pad.logfile   = log;
+    pad.procname  = "tst";
+    pad.niceness  = nice;
+    pad.kill_kids = true;
+    pad.start();
+    if (pad.error) note("start: ", pad.error.c_str());
+    reap_all();
+    xstat = pad.xstat;
+    return slurp(log);
+}
+
+// Termination callback: note who ended
+static int ended(job::launch & pad, void* ua, pid_t pid, int cstat) {
+    *(pid_t*)ua = pid;
+    return 0;
+}
+
+// Launches per second
+static double bench(job::launch::method_t m, int n) {
+    job::launch* pads = new job::launch[n];
+    double t0 = test_now();
+    for (int i = 0; i < n; i++) {
+        pads[i].method  = m;
+        pads[i].command = "/bin/true";
+        pads[i].logfile = "/dev/null";
+        pads[i].start();
+    }
+    double t1 = test_now();
+    reap_all();
+    delete[] pads;
+    return n / (t1 - t0);
+}
+
+int main(int argc, char* argv[]) {
+
+    plan(26);
+
+    is(job::launch::str2method("spawn"), job::launch::SPAWN, "str2method(spawn)");
+    is(job::launch::str2method("fork"),  job::launch::FORK,  "str2method(fork)");
+
+    const char* mnam[] = {"fork", "spawn"};
+    job::launch::method_t meth[] = {job::launch::FORK, job::launch::SPAWN};
+    for (int i = 0; i < 2; i++) {
+        note("  -- method ", mnam[i], " --");
+        int xstat = 0;
+        string out = run(meth[i], "sh -c 'echo hello; exit 3'", xstat);
+        is(out, "hello\n", string(mnam[i]) + ": output to logfile");
+        is(xstat, 3,       string(mnam[i]) + ": exit status");
+
+        out = run(meth[i], "cat /proc/self/cmdline", xstat);
+        like(out, "^tst: cat", string(mnam[i]) + ": process name");
+
+        out = run(meth[i], "nice", xstat, 7);
+        is(out, "7\n", string(mnam[i]) + ": niceness");
+
+        out = run(meth[i], "echo $(echo sub)", xstat);
+        is(out, "sub\n", string(mnam[i]) + ": command substitution");
+
+        out = run(meth[i], "/no/such/program", xstat);
+        isnt(xstat, 0, string(mnam[i]) + ": bad command fails");
+        like(out, "no/such/program", string(mnam[i]) + ": ...and says why");
+    }
+
+    // A spawned job has its user's groups, not ours
+    note("  -- groups --");
+    if (geteuid()) skip(2, "not root");
+    else {
+        gid_t extra[] = {0, 4242};
+        setgroups(2, extra);
+        string log = TESTDIR "launch.out";
+        unlink(log.c_str());
+        job::launch pad;
+        pad.method  = job::launch::SPAWN;
+        pad.command = "grep ^Groups: /proc/self/status";
+        pad.logfile = log;
+        pad.uid     = 65534;
+        pad.gid     = 65534;
+        pad.start();
+        reap_all();
+        string out = slurp(log);
+        like(out, "^Groups:", "spawn as another user");
+        not_like(out, "4242", "  without our groups");
+        setgroups(1, extra);
+    }
+
+    // Reaping thru a pidfd on the poller, with no SIGCHLD handling at all
+    note("  -- pidfd --");
+    {
+        job::poller pol;
+        job::launch::events = &pol;
+        pid_t who = 0;
+        job::launch pad;
+        pad.method  = job::launch::SPAWN;
+        pad.command = "sh -c 'exit 5'";
+        pad.logfile = "/dev/null";
+        pad.term_cb = ended;
+        pad.term_ua = &who;
+        pad.start();
+        ok(pad.pidfd >= 0, "child has a pidfd");
+        for (int i = 0; (i < 50) && !who; i++) pol.wait(100);
+        is(who, pad.pid,   "  exit seen thru the poller");
+        is(pad.xstat, 5,   "  exit status");
+        is(pad.pidfd, -1,  "  pidfd closed");
+
+        // A SIGCHLD sweep leaves a child with a pidfd to its poller
+        who = 0;
+        job::launch pad2;
+        pad2.command = "true";
+        pad2.logfile = "/dev/null";
+        pad2.term_cb = ended;
+        pad2.term_ua = &who;
+        pad2.start();
+        usleep(300000);                 // it's exited by now
+        job::launch::reap_zombies(true);
+        is(who, 0,         "sweep on SIGCHLD passes over a child with a pidfd");
+        for (int i = 0; (i < 50) && !who; i++) pol.wait(100);
+        is(who, pad2.pid,  "  the poller reaps it");
+        job::launch::events = NULL;
+    }
+
+    // Benchmark: give ourselves some resident memory, as a busy jobman would have,
+    //  since that's what makes fork() slow.
+    int n = (argc > 1) ? job::str2int(argv[1]) : 200;
+    size_t ballast = 256*1024*1024;
+    char* mem = (char*)malloc(ballast);
+    memset(mem, 1, ballast);
+    note("  -- benchmark: ", n, " launches with 256MB resident --");
+    double fork_rate  = bench(job::launch::FORK,  n);
+    double spawn_rate = bench(job::launch::SPAWN, n);
+    note("  fork:  ", (int)fork_rate,  " launches/sec");
+    note("  spawn: ", (int)spawn_rate, " launches/sec");
+    ok(fork_rate  > 0, "fork benchmark ran");
+    ok(spawn_rate > 0, "spawn benchmark ran");
+    free(mem);
+
+    return test_end();
+}
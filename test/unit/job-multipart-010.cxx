@@ -28,12 +28,19 @@
 #include "tap++/tap++.hxx"
 #include "tap-extra.hxx"
 
+#include <fstream>
+#include <sstream>
 #include <stdio.h>          // fopen, ...
 #include <stdlib.h>         // mkstemps()
 #include <string>
 #include <string.h>         // memset()
 #include <linux/limits.h>   // PATH_MAX
-#include <unistd.h>         // unlink(), write(), readlink()
+#include <fcntl.h>          // open()
+#include <errno.h>
+#include <sys/file.h>       // flock()
+#include <sys/stat.h>       // stat()
+#include <sys/wait.h>       // waitpid()
+#include <unistd.h>         // unlink(), write(), readlink(), fork()
 
 using namespace std;
 using namespace TAP;
@@ -69,9 +76,26 @@ class multifile {
 };
 string multifile::tmpdir = "";
 
+// Read a whole file
+static string slurp(const string & fnam) {
+    ifstream in(fnam.c_str());
+    stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// File content without the section 0 padding line
+static string unpadded(const string & fnam) {
+    string s = slurp(fnam);
+    size_t p = s.find("\n#");
+    size_t e = (p == string::npos) ? p : s.find('\n', p+1);
+    if (e != string::npos) s.erase(p+1, e-p);
+    return s;
+}
+
 int main(int argc, char* argv[]) {
 
-    plan(122);
+    plan(168);
 
     // Paths
     multifile::tmpdir = job::path.tsttmp;
@@ -379,6 +403,248 @@ int main(int argc, char* argv[]) {
     }
 
 
+    // Growing a file in place: append sections, update section 0 headers
+    {
+        note("  -- append & update --");
+        multifile mf("");
+        job::multipart mp;
+        mp.header_pad = 40;
+        mp.resize(1);
+        mp[0]["Alpha"] = "1";
+        mp[0]["Beta"]  = "2";
+        mp[0]["__BODY__"] = "tie x 1\n";
+        mp.store(mf.filename);
+        isok(mp, "store() with header pad");
+
+        mp.resize(2);
+        mp[1]["Section"]  = "output";
+        mp[1]["__BODY__"] = "\n";
+        mp.closed = false;
+        mp.append(mf.filename, 1);
+        isok(mp, "append() open section");
+        ok(!mp.boundary.empty(), "  boundary made");
+        is(unpadded(mf.filename), mp.to_string(), "  same as whole file");
+
+        FILE* fp = fopen(mf.filename.c_str(), "a");     // the job's output
+        fputs("hello\n", fp);
+        fclose(fp);
+
+        mp.resize(3);
+        mp[2]["Section"] = "result";
+        mp.closed = true;
+        mp.append(mf.filename, 2);
+        isok(mp, "append() closing section");
+        mp[0]["Alpha"] = "one";
+        mp.update_headers(mf.filename);
+        isok(mp, "update_headers() in the padding");
+
+        job::multipart mp2;
+        mp2.load(mf.filename);
+        is(mp2.size(), 3U, "  three sections");
+        is(mp2[0]["alpha"], "one", "  header updated");
+        is(mp2[1]["__BODY__"], "\nhello\n", "  output kept");
+        ok(mp2.closed, "  closed");
+        is(unpadded(mf.filename), mp2.to_string(), "  same as whole file");
+
+        struct stat sb1;
+        stat(mf.filename.c_str(), &sb1);
+        mp[0]["Gamma"] = string(200, 'g');
+        mp.update_headers(mf.filename);
+        isok(mp, "update_headers() bigger than the room");
+        job::multipart mp3;
+        mp3.load(mf.filename);
+        struct stat sb2;
+        stat(mf.filename.c_str(), &sb2);
+        ok((mp3[0]["gamma"] == string(200, 'g')) && (mp3[1]["__BODY__"] == "\nhello\n")
+            && mp3.closed && (mp3.size() == 3) && (sb1.st_ino != sb2.st_ino),
+            "  bodies moved down, in a new file");
+
+        int lfd = open(mf.filename.c_str(), O_RDONLY | O_CLOEXEC);
+        flock(lfd, LOCK_EX);
+        int was = lfd;
+        mp[0]["Delta"] = string(400, 'd');
+        mp.update_headers(mf.filename, &lfd);
+        isok(mp, "update_headers() bigger again, holding a lock");
+        int ofd = open(mf.filename.c_str(), O_RDONLY | O_CLOEXEC);
+        ok((lfd != was) && (flock(ofd, LOCK_EX | LOCK_NB) < 0) && (errno == EWOULDBLOCK),
+            "  the new file is locked");
+        close(ofd);
+        close(lfd);
+        job::multipart mp4;
+        mp4.load(mf.filename);
+        ok((mp4[0]["delta"] == string(400, 'd')) && (mp4[1]["__BODY__"] == "\nhello\n"),
+            "  and whole");
+
+        note("  -- lazy load --");
+        job::multipart lz;
+        lz.load(mf.filename, true);
+        isok(lz, "load() head only");
+        ok(lz.lazy && (lz.size() == 1), "  just section 0");
+        is(lz[0]["__BODY__"], "tie x 1\n", "  section 0 body");
+        is(lz.body(1), "\nhello\n", "  body() read from the file");
+        is(lz.size(), 2U, "  ...which loaded section 1 headers");
+        ok(!lz[1].count("__BODY__"), "  ...but not its body");
+        lz.load_headers();
+        ok(!lz.lazy && lz.closed && (lz.size() == 3), "load_headers() to the end");
+        is(lz[2]["section"], "result", "  last section headers");
+        lz.store(mf.filename);
+        is(unpadded(mf.filename), mp4.to_string(), "store() after a lazy load keeps the bodies");
+    }
+
+    // Section index, kept as a job's file grows thru two tries
+    {
+        note("  -- section index --");
+        multifile mf("");
+        string ixf = mf.filename + ".ix";
+        job::multipart mp;
+        mp.index = ixf;
+        mp.header_pad = 40;
+        mp.resize(2);
+        mp[0]["Alpha"]     = "1";
+        mp[0]["__BODY__"]  = "tie x 1\n";
+        mp[1]["Section"]   = "output";
+        mp[1]["Try-Count"] = "1";
+        mp[1]["__BODY__"]  = "\n";
+        mp.closed = false;
+        mp.store(mf.filename);
+        isok(mp, "store() with an index");
+        job::secindex ix(ixf);
+        ix.load();
+        isok(ix, "  index loads");
+        ok((ix.size() == 2) && (ix[1].end == -1), "  two sections, the last open");
+
+        FILE* fp = fopen(mf.filename.c_str(), "a");
+        fputs("## one\nfirst\n", fp);
+        fclose(fp);
+        mp.resize(3);
+        mp[2]["Section"]   = "result";
+        mp[2]["Try-Count"] = "1";
+        mp.append(mf.filename, 2);
+        mp.resize(4);
+        mp[3]["Section"]   = "output";
+        mp[3]["Try-Count"] = "2";
+        mp[3]["__BODY__"]  = "\n";
+        mp.append(mf.filename, 3);
+        fp = fopen(mf.filename.c_str(), "a");
+        fputs("## two\nsecond", fp);
+        fclose(fp);
+        mp.resize(5);
+        mp[4]["Section"]   = "result";
+        mp[4]["Try-Count"] = "2";
+        mp.closed = true;
+        mp.append(mf.filename, 4);
+        mp[0]["Gamma"] = string(200, 'g');
+        mp.update_headers(mf.filename);
+        isok(mp, "appends and a moving update");
+
+        ix.load();
+        is(ix.size(), 5U, "  index has all five sections");
+        ok((ix[3].type == job::secindex::OUTPUT) && (ix[3].tries == 2)
+            && (ix[4].type == job::secindex::RESULT) && (ix[4].end >= 0), "  types, tries, closed");
+        is(ix.find(job::secindex::OUTPUT, 1), 1, "  find() output of try 1");
+        is(ix.find(job::secindex::RESULT, 0), 4, "  find() last result");
+
+        job::multipart full;
+        full.load(mf.filename);
+        job::multipart lz;
+        lz.index = ixf;
+        lz.load(mf.filename, true);
+        lz.load_headers();
+        isok(lz, "load_headers() with the index");
+        bool same = (lz.size() == full.size()) && (full.size() == 5);
+        for (size_t s = 0; same && (s < full.size()); s++) {
+            same = (lz.body(s) == full.body(s))
+                && (lz.get(s, "Section") == full.get(s, "Section"))
+                && (lz.get(s, "Try-Count") == full.get(s, "Try-Count"));
+        }
+        ok(same, "  same headers and bodies as a full load");
+        is(lz.body(3), "\n## two\nsecond", "  body() of try 2");
+        is(lz.substatus, "two", "  sub-status from the last output");
+        ok(lz.closed && !lz.lazy, "  closed, all there");
+
+        // Appended to by something that doesn't keep the index
+        mp.index.clear();
+        mp.resize(6);
+        mp[5]["Section"] = "note";
+        mp.append(mf.filename, 5);
+        job::multipart st;
+        st.index = ixf;
+        st.load(mf.filename, true);
+        st.load_headers();
+        ok((st.size() == 6) && (st.get(5, "Section") == "note") && (st.body(3) == lz.body(3)),
+            "stale index ignored");
+        unlink(ixf.c_str());
+
+        string outf = mf.filename + ".out";
+        int ofd = open(outf.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        st.send_body(3, ofd);
+        close(ofd);
+        isok(st, "send_body()");
+        is(slurp(outf), "\n## two\nsecond", "  body sent from the file");
+
+        // A section whose body comes from another file, as an array element's output does
+        ofd = open(outf.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        string big(200000, 'x');
+        if (write(ofd, big.data(), big.size()) != (ssize_t)big.size()) ok(false, "write");
+        close(ofd);
+        mp.index = ixf;
+        st.index = ixf;
+        st.store(mf.filename);                      // a fresh index to keep
+        st.resize(8);
+        st[6]["Section"]  = "output";
+        st[6]["__BODY__"] = "\n";
+        st[7]["Section"]  = "result";
+        st.closed = true;
+        ofd = open(outf.c_str(), O_RDONLY);
+        st.append(mf.filename, 6, ofd);
+        close(ofd);
+        st.append(mf.filename, 7);
+        isok(st, "append() a body from a file");
+        job::multipart fb;
+        fb.load(mf.filename);
+        ok((fb.size() == 8) && fb.closed && (fb.body(6) == "\n" + big), "  it's all there");
+        job::multipart fx;
+        fx.index = ixf;
+        fx.load(mf.filename, true);
+        fx.load_headers();
+        job::secindex ix2(ixf);
+        ix2.load();
+        ok((ix2.size() == 8) && (fx.size() == 8) && (fx.body(6) == "\n" + big)
+            && (fx.get(7, "Section") == "result"), "  and the index finds it");
+        unlink(ixf.c_str());
+        unlink(outf.c_str());
+    }
+
+    // Following a section as it grows, like a running job's output
+    {
+        note("  -- follow --");
+        multifile mf("Content-Type:  multipart/mixed; boundary=xyzzy\n"
+                     "\n--xyzzy\n"
+                     "Section:       output\n"
+                     "\n\nabc");
+        job::multipart mp;
+        mp.load(mf.filename, true);
+        pid_t kid = fork();
+        if (!kid) {
+            const char* more[] = {"def\n--x", "yz", "zy", "\nSection: result\n"};
+            for (int i = 0; i < 4; i++) {
+                usleep(100000);
+                FILE* fp = fopen(mf.filename.c_str(), "a");
+                fputs(more[i], fp);
+                fclose(fp);
+            }
+            _exit(0);
+        }
+        string outf = mf.filename + ".out";
+        int ofd = open(outf.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        mp.follow_body(1, ofd);
+        close(ofd);
+        waitpid(kid, NULL, 0);
+        isok(mp, "follow_body()");
+        is(slurp(outf), "\nabcdef", "  followed to the boundary, split as it was");
+        unlink(outf.c_str());
+    }
+
     // Simple two-part
 
 
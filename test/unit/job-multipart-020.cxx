@@ -0,0 +1,145 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  The job::multipart parsers: the mapped one must agree with the stdio one,
+//  and be much faster on a job file with lots of output.  A stdio load() is
+//  how job files were always read; a mapped index (all headers, bodies left
+//  in place) is what the lazy users of job files now get.  With a section
+//  index alongside, the bodies needn't be looked thru at all.
+//  Give a count of tries as the first arg to run a bigger benchmark.
+
+#include "job/multipart.hxx"
+#include "job/path.hxx"
+#include "job/string.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <stdio.h>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+using namespace TAP;
+
+// Write a job file like one that's been tried many times, each with lots of output
+static size_t make_job(const string & fnam, int tries, int lines) {
+    FILE* fp = fopen(fnam.c_str(), "w");
+    if (!fp) bail_out("Cannot create " + fnam);
+    const char* b = "0d8e7c3a-0000-4000-8000-5eedface0001";
+    fprintf(fp, "Command:       make world\n"
+                "Content-Type:  multipart/mixed; boundary=%s\n"
+                "job-id:        1234\n"
+                "job-state:     done\n"
+                "#                      \n"
+                "\n"
+                "tie alpha 1235\n"
+                "\n--%s\n", b, b);
+    for (int t = 1; t <= tries; t++) {
+        fprintf(fp, "Section:       output\nTry-Count:     %d\n\n\n", t);
+        for (int i = 0; i < lines; i++) {
+            if (i % 500 == 0) fprintf(fp, "## step %d of try %d\n", i, t);
+            else fprintf(fp, "%06d compiling src/some/longish/path/module%d.cxx -O2 -g -Wall\n", i, i);
+        }
+        fprintf(fp, "\n--%s\nExit-Status:   %d\nSection:       result\nTry-Count:     %d\n"
+                    "\n--%s%s\n", b, t < tries, t, b, (t == tries) ? "--" : "");
+    }
+    long size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+// Parse the file n times with the given parser; returns MB/s.
+//  Either load it all, or just index it: all headers, and where the bodies are.
+static double bench(const string & fnam, bool mapped, bool all, int n, size_t size,
+                    const string & ixf = "") {
+    job::multipart::use_mmap = mapped;
+    double t0 = test_now();
+    for (int i = 0; i < n; i++) {
+        job::multipart mp;
+        mp.index = ixf;
+        mp.load(fnam, !all);
+        mp.load_headers();
+    }
+    double t1 = test_now();
+    return (n * size / 1e6) / (t1 - t0);
+}
+
+int main(int argc, char* argv[]) {
+
+    plan(9);
+
+    int tries = (argc > 1) ? job::str2int(argv[1]) : 20;
+    string fnam = job::path.tsttmp + "/job-multi-020.tmp";
+    size_t size = make_job(fnam, tries, 5000);
+
+    // Both parsers give the same result
+    note("  -- same results --");
+    job::multipart::use_mmap = false;
+    job::multipart slow;
+    slow.load(fnam);
+    isok(slow, "stdio parser load()");
+    job::multipart::use_mmap = true;
+    job::multipart fast;
+    fast.load(fnam);
+    isok(fast, "mapped parser load()");
+    is(fast.size(), slow.size(),    "  same number of sections");
+    ok((job::vecmap_t&)fast == (job::vecmap_t&)slow, "  same headers and bodies");
+    is(fast.substatus, slow.substatus, "  same sub-status");
+    ok(fast.closed && slow.closed,  "  both closed");
+
+    job::multipart lz;
+    lz.load(fnam, true);
+    lz.load_headers();
+    is(lz.body(2*tries - 1), slow[2*tries - 1]["__BODY__"], "  lazy body() of the last output");
+
+    // Speed
+    note("  -- benchmark: ", tries, " tries, ", (int)(size / 1000000), " MB --");
+    double slow_rate = bench(fnam, false, true, 3, size);
+    double fast_rate = bench(fnam, true,  true, 3, size);
+    note("  load all, stdio:  ", (int)slow_rate, " MB/s");
+    note("  load all, mapped: ", (int)fast_rate, " MB/s");
+    double slow_index = bench(fnam, false, false, 3, size);
+    double fast_index = bench(fnam, true,  false, 3, size);
+    note("  index, stdio:     ", (int)slow_index, " MB/s");
+    note("  index, mapped:    ", (int)fast_index, " MB/s");
+    note("  mapped load all is ", fast_rate / slow_rate, "x a stdio load()");
+    note("  mapped index is    ", fast_index / slow_rate, "x a stdio load()");
+
+    // Again, with a section index
+    string ixf = fnam + ".ix";
+    fast.index = ixf;
+    fast.store(fnam);
+    bench(fnam, true, false, 1, size, ixf);                         // warm up
+    double sect_index = bench(fnam, true, false, 30, size, ixf);   // it takes little time
+    note("  section index:    ", (int)sect_index, " MB/s");
+    note("  section index is   ", sect_index / fast_index, "x a mapped index");
+    job::multipart::use_mmap = true;
+    job::multipart ix;
+    ix.index = ixf;
+    ix.load(fnam, true);
+    ix.load_headers();
+    isok(ix, "load thru the section index");
+    is(ix.body(2*tries - 1), slow[2*tries - 1]["__BODY__"], "  same last output");
+
+    unlink(ixf.c_str());
+    unlink(fnam.c_str());
+    return test_end();
+}
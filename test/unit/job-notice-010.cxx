@@ -0,0 +1,132 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  Tests for the job::notice class, telling a jobman of new pending jobs.
+
+#include "job/notice.hxx"
+#include "job/path.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace TAP;
+
+int main(int argc, char* argv[]) {
+
+    plan(22);
+    job::path.set_root("./kit");
+
+    job::notice none("no-such-queue");
+    isnt(none.error, 0,             "no notices for a queue that doesn't exist");
+    is(none.listen(), -1,           "  nor can it listen");
+
+    job::notice in("batch");
+    isok(in, "construct");
+    like(in.addr, "/\\.notice/batch$", "  named for the queue");
+
+    // Nobody listening yet
+    job::notice out("batch");
+    job::stringlist one(1, "t0000000000.p5.j0000001.tester");
+    isnt(out.send(one), 0,          "send() with no jobman fails");
+
+    note("  -- listening --");
+    ok(in.listen() >= 0,            "listen()");
+    struct stat sb;
+    ok(!lstat(in.dir.c_str(), &sb) && S_ISDIR(sb.st_mode) && !(sb.st_mode & 022),
+                                    "  made its directory");
+
+    // Someone else's socket: we don't tell them our jobs
+    if (geteuid() == 0) {
+        job::notice squat("batch");
+        pid_t pid = fork();
+        if (!pid) {
+            if (setgid(65534) || setuid(65534)) _exit(1);
+            _exit(squat.listen() < 0 ? 0 : 1);
+        }
+        int ws = -1;
+        waitpid(pid, &ws, 0);
+        is(ws, 0,                       "another user can't bind a queue's socket");
+        if (chown(in.addr.c_str(), 65534, 65534)) {}
+        job::notice theirs("batch");
+        theirs.send(one);
+        like(string(theirs.error), "isn't a jobman's", "  nor is one of theirs sent to");
+        if (chown(in.addr.c_str(), 0, 0)) {}
+    }
+    else skip(2, "needs root, to be another user");
+
+    // Nor if anyone else could have put it there
+    chmod(in.dir.c_str(), 0777);
+    job::notice loose("batch");
+    loose.send(one);
+    like(string(loose.error), "isn't safe", "no notices thru a directory others can write");
+    chmod(in.dir.c_str(), 0755);
+    job::notice other("batch");
+    is(other.listen(), -1,          "  only one listener per queue");
+    like(string(other.error), "in use", "  ...address in use");
+
+    job::stringlist got;
+    in.receive(got);
+    isok(in, "receive() with nothing there");
+    is(got.size(), 0u,              "  doesn't block, gets nothing");
+
+    // Paths are sent as their basenames
+    job::stringlist two;
+    two.push_back(job::path.jobdir + "batch/pend/t0000000000.p5.j0000001.tester");
+    two.push_back("t0000000000.p5.j0000002.tester");
+    out.send(two);
+    isok(out, "send() two");
+    in.receive(got);
+    is(got.size() == 2 ? got[0] + " " + got[1] : string("?"),
+       "t0000000000.p5.j0000001.tester t0000000000.p5.j0000002.tester", "  got them, as basenames");
+
+    // A big batch takes more than one notice
+    job::stringlist many;
+    for (int i = 0; i < 1000; i++) many.push_back("t0000000000.p5.j" + job::int2str(1000000 + i) + ".tester");
+    out.send(many);
+    got.clear();
+    in.receive(got);
+    is(got.size(), many.size(),     "a batch of 1000 all got thru");
+    ok(got.size() && (got.back() == many.back()), "  in order");
+
+    // Ours only: we're our own user, so they're taken
+    out.send(one);
+    got.clear();
+    in.receive(got, true);
+    is(got.size(), 1u,              "receive() ours only takes our own");
+
+    // The spool's own, for orders to a jobman of many queues
+    job::notice spool;
+    isok(spool, "construct the spool's own");
+    isnt(spool.addr, in.addr,       "  not the queue's");
+    spool.listen();
+    job::notice orders;
+    orders.send(job::stringlist(1, "+batch"));
+    got.clear();
+    spool.receive(got, true);
+    is(got.size() ? got[0] : string("?"), "+batch", "  orders got thru");
+
+    return test_end();
+}
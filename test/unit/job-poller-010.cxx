@@ -0,0 +1,154 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+#include "job/poller.hxx"
+#include <tap++/tap++.hxx>
+#include "tap-extra.hxx"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace job;
+using namespace std;
+using namespace TAP;
+#define TESTDIR "test/tmp/"
+
+// What the callbacks saw
+static int         ncalls = 0;
+static int         lastfd = -1;
+static uint32_t    lastwhat = 0;
+static std::string lastname;
+
+static int count_it(poller & pol, int fd, uint32_t what, void* ua) {
+    ++ncalls;
+    lastfd   = fd;
+    lastwhat = what;
+    return 0;
+}
+
+static int drain_it(poller & pol, int fd, uint32_t what, void* ua) {
+    char buf[64];
+    read(fd, buf, sizeof(buf));
+    return count_it(pol, fd, what, ua);
+}
+
+static int remove_me(poller & pol, int fd, uint32_t what, void* ua) {
+    pol.remove(fd);
+    return count_it(pol, fd, what, ua);
+}
+
+static int see_changes(poller & pol, int fd, uint32_t what, void* ua) {
+    poller::changes_t chg;
+    poller::changes(fd, chg);
+    for (size_t i = 0; i < chg.size(); i++) {
+        if (chg[i].first & IN_CLOSE_WRITE) lastname = chg[i].second;
+    }
+    return count_it(pol, fd, what, ua);
+}
+
+// Milliseconds now
+static long msnow() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000L + tv.tv_usec / 1000L;
+}
+
+int main (int argc, char* argv[]) {
+
+    plan(22);
+    poller pol;
+    isok(pol, "poller constructed");
+
+    // One-shot timer
+    note("Timers");
+    int t = pol.timer(count_it);
+    ok(t >= 0, "timer created");
+    is(pol.wait(50), 0, "disarmed timer does not fire");
+    pol.arm(t, 20);
+    long t0 = msnow();
+    is(pol.wait(1000), 1, "armed timer fires");
+    ok(msnow() - t0 < 500, "  ...in about the right time");
+    is(lastfd, t, "  ...for the right fd");
+    is(lastwhat, 1U, "  ...with one expiration");
+    is(pol.wait(50), 0, "one-shot timer does not repeat");
+
+    // Soon pulls a far timer in, but leaves a near one alone
+    pol.arm(t, 60000);
+    pol.soon(t, 10);
+    t0 = msnow();
+    is(pol.wait(1000), 1, "soon() pulls in a far timer");
+    ok(msnow() - t0 < 500, "  ...to fire right away");
+    pol.arm(t, 10);
+    pol.soon(t, 60000);
+    is(pol.wait(1000), 1, "soon() leaves a near timer alone");
+
+    // Signals
+    note("Signals");
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGUSR1);
+    int sfd = pol.signals(sigs, count_it);
+    ok(sfd >= 0, "signalfd created");
+    kill(getpid(), SIGUSR1);
+    is(pol.wait(1000), 1, "signal delivered as event");
+    is(lastwhat, (uint32_t)SIGUSR1, "  ...with the signal number");
+
+    // Plain descriptors; caller owns them
+    note("Descriptors");
+    int pfd[2];
+    pipe(pfd);
+    is((std::string)pol.add(pfd[0], EPOLLIN, drain_it), "OK", "pipe added");
+    write(pfd[1], "x", 1);
+    is(pol.wait(1000), 1, "pipe readable");
+    is(lastfd, pfd[0], "  ...for the right fd");
+    pol.remove(pfd[0]);
+    ok(fcntl(pfd[0], F_GETFD) != -1, "removed caller fd is not closed");
+
+    // A callback can remove itself
+    pol.add(pfd[0], EPOLLIN, remove_me);
+    write(pfd[1], "x", 1);
+    ncalls = 0;
+    pol.wait(1000);
+    pol.wait(50);       // still readable, but no longer watched
+    is(ncalls, 1, "callback can remove itself");
+    pol.remove(t);
+    close(pfd[0]);
+    close(pfd[1]);
+
+    // Directory watch
+    note("Watches");
+    int w = pol.watch(TESTDIR, IN_CLOSE_WRITE, see_changes);
+    ok(w >= 0, "watch created");
+    std::string fnam = TESTDIR "poller.tmp";
+    FILE* fp = fopen(fnam.c_str(), "w");
+    if (fp) fclose(fp);
+    is(pol.wait(1000), 1, "watch event delivered");
+    is(lastname, "poller.tmp", "  ...with the file name");
+    unlink(fnam.c_str());
+
+    return test_end();
+}
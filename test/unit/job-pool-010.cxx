@@ -0,0 +1,120 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  Tests for the job::pool class, a few threads working thru a list of tasks.
+
+#include "job/pool.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <string>
+#include <unistd.h>         // usleep()
+#include <vector>
+
+using namespace std;
+using namespace TAP;
+
+// What the tasks do, and what we saw of it
+struct work {
+    vector<int>     made;       // Each task's result
+    vector<size_t>  order;      // The order the results were handed on
+    int             running;    // Tasks running now
+    int             most;       // ...and the most at once
+    size_t          ahead;      // How far ahead of the ordered callback a task started
+    size_t          handed;     // How many have been handed on
+};
+
+static void square(const size_t i, void* ua) {
+    work* w = (work*)ua;
+    int now = __sync_add_and_fetch(&w->running, 1);
+    int was;
+    while ((was = w->most) < now) __sync_bool_compare_and_swap(&w->most, was, now);
+    size_t gap = i - w->handed;
+    size_t aw;
+    while ((aw = w->ahead) < gap) __sync_bool_compare_and_swap(&w->ahead, aw, gap);
+    usleep(((i * 7) % 5) * 1000);   // finish out of order
+    w->made[i] = i * i;
+    __sync_sub_and_fetch(&w->running, 1);
+}
+
+static void hand_on(const size_t i, void* ua) {
+    work* w = (work*)ua;
+    if (w->made[i] == (int)(i * i)) w->order.push_back(i);
+    w->handed = i + 1;
+}
+
+static void reset(work & w, size_t n) {
+    w.made.assign(n, -1);
+    w.order.clear();
+    w.running = w.most = 0;
+    w.ahead = w.handed = 0;
+}
+
+static bool in_order(const work & w, size_t n) {
+    if (w.order.size() != n) return false;
+    for (size_t i = 0; i < n; i++) if (w.order[i] != i) return false;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+
+    plan(14);
+    work w;
+
+    // All the work gets done
+    note("  -- four threads --");
+    job::pool p(4);
+    is(p.nthreads, 4u, "four threads");
+    reset(w, 200);
+    p.run(200, square, NULL, &w);
+    isok(p, "run() without ordering");
+    bool all = true;
+    for (size_t i = 0; i < 200; i++) if (w.made[i] != (int)(i * i)) all = false;
+    ok(all,                         "  every task done");
+    ok(w.most > 1,                  "  tasks ran at the same time");
+    ok(w.most <= 4,                 "  no more than four at once");
+
+    // Handed on in order, each after it's done
+    reset(w, 200);
+    p.run(200, square, hand_on, &w);
+    isok(p, "run() with ordering");
+    ok(in_order(w, 200),            "  all handed on, in order, once done");
+
+    // A window keeps the workers from getting far ahead
+    reset(w, 200);
+    p.run(200, square, hand_on, &w, 8);
+    isok(p, "run() with a window of 8");
+    ok(in_order(w, 200),            "  all handed on in order");
+    ok(w.ahead < 8,                 "  no task started 8 or more ahead");
+
+    // One thread, and none to do
+    note("  -- one thread --");
+    job::pool one(1);
+    reset(w, 50);
+    one.run(50, square, hand_on, &w);
+    isok(one, "run() with one thread");
+    ok(in_order(w, 50),             "  all handed on in order");
+    is(w.most, 1,                   "  one at a time");
+    p.run(0, square, hand_on, &w);
+    isok(p, "run() of no tasks");
+
+    return test_end();
+}
@@ -0,0 +1,131 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  Tests for the job::readyset class, jobman's in-memory index of pending jobs.
+
+#include "job/readyset.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace TAP;
+#define TESTDIR "test/tmp/readyset.tmp/"
+
+// A job file name, as job::file makes them
+static string jn(time_t t, int prio, int id) {
+    char nam[64];
+    snprintf(nam, sizeof(nam), "t%10.10ld.p%d.j%7.7d.tester", (long)t, prio, id);
+    return nam;
+}
+
+static void touch(const string & nam) {
+    int fd = open((TESTDIR + nam).c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd >= 0) close(fd);
+}
+
+int main(int argc, char* argv[]) {
+
+    plan(32);
+    mkdir(TESTDIR, 0755);
+    time_t now    = time(NULL);
+    time_t later  = now + 3600;
+    string a = jn(1000, 5, 1);
+    string b = jn(1000, 2, 2);
+    string c = jn(2000, 2, 3);
+    string d = jn(later, 1, 4);
+
+    job::readyset none(TESTDIR "no-such-dir/");
+    isnt(none.seed(), 0,            "seed() of a missing directory fails");
+
+    job::readyset rs(TESTDIR);
+    rs.seed();
+    isok(rs, "seed() an empty directory");
+    is(rs.size(), 0u,               "  nothing pending");
+    is(rs.due(), 0,                 "  nothing due");
+
+    note("  -- ordering --");
+    touch(a);
+    touch(b);
+    touch(c);
+    touch(d);
+    touch("not-a-job");
+    rs.seed();
+    isok(rs, "seed()");
+    is(rs.size(), 4u,               "  job files only");
+    is(rs.eligible(now), 3u,        "  those eligible now");
+    is(rs.due(), later,             "  the future one is due later");
+
+    job::stringlist jobs;
+    is(rs.next(now, 2, jobs), 2u,   "next() takes two");
+    is(jobs.size(), 2u,             "  and lists two");
+    is(jobs[0], TESTDIR + b,        "  best priority, earliest time first");
+    is(jobs[1], TESTDIR + c,        "  same priority, later time next");
+    jobs.clear();
+    is(rs.next(now, 5, jobs), 1u,   "next() takes only those eligible");
+    is(jobs[0], TESTDIR + a,        "  lowest priority last");
+    is(rs.size(), 1u,               "  taken jobs leave the index");
+    jobs.clear();
+    is(rs.next(later, 5, jobs), 1u, "future job eligible in its time");
+    is(jobs[0], TESTDIR + d,        "  that's it");
+    is(rs.due(), 0,                 "  nothing more due");
+
+    note("  -- add and drop --");
+    string e = jn(later, 3, 5);
+    ok(rs.add(e),                   "add()");
+    ok(!rs.add(e),                  "  not twice");
+    ok(!rs.add("not-a-job"),        "  not a job file");
+    is(rs.due(), later,             "  due later");
+    ok(rs.drop(e),                  "drop()");
+    ok(!rs.drop(e),                 "  not twice");
+    is(rs.size(), 0u,               "  none left");
+
+    note("  -- promotion --");
+    string f = jn(1500, 4, 6);
+    rs.add(f);
+    is(rs.due(), 1500,              "past-due job waits until promoted");
+    is(rs.eligible(now), 1u,        "  eligible() promotes it");
+    is(rs.due(), 0,                 "  and nothing's due after");
+
+    note("  -- reconcile --");
+    rs.reconcile();
+    isok(rs, "reconcile()");
+    is(rs.size(), 4u,               "  files not in the index added, those gone dropped");
+    is(rs.eligible(now), 3u,        "  ...eligible ones");
+    jobs.clear();
+    rs.next(now, 1, jobs);
+    unlink((TESTDIR + b).c_str());
+    rs.reconcile();
+    is(rs.size(), 3u,               "  one taken and its file gone");
+
+    unlink((TESTDIR + a).c_str());
+    unlink((TESTDIR + c).c_str());
+    unlink((TESTDIR + d).c_str());
+    unlink(TESTDIR "not-a-job");
+    rmdir(TESTDIR);
+    return test_end();
+}
@@ -25,9 +25,11 @@
 #include <tap++/tap++.hxx>
 #include "tap-extra.hxx"
 #define __STDC_FORMAT_MACROS    // Enable PRI macros
+#include <fcntl.h>
 #include <inttypes.h>           // PRI macros
 #include <stdio.h>
 #include <string>
+#include <sys/stat.h>
 
 using namespace job;
 using namespace std;
@@ -40,9 +42,10 @@ int main (int argc, char* argv[]) {
     string seqfile = TESTDIR "seq.tmp";
     seqnum sq(seqfile);
 
-    // sequence generator
+    // sequence generator; from the page if a second arg
     int n;
     if ((argc > 1) && (n = str2int(argv[1]))) {
+        sq.paged = (argc > 2);
         for (int i=0; i<n; i++) {
             printf("%" PRI_seqnum_t "\n", sq.next());
             if (sq.error) printf("*** Had error: %s\n", sq.error.c_str());
@@ -51,7 +54,7 @@ int main (int argc, char* argv[]) {
     }
 
     // Inits 2
-    plan(32);
+    plan(60);
 
     // nuke the sequence file
     unlink(seqfile.c_str());
@@ -63,6 +66,42 @@ int main (int argc, char* argv[]) {
         isok(sq, "error status ok");
     }
 
+    // reserve a block of them
+    is(sq.next(5), (uint64_t)11, "block of 5 starts at 11");
+    is(sq.value, (uint64_t)15, "  exposed value is its last");
+    isok(sq, "  error status ok");
+    is(sq.next(), (uint64_t)16, "next after the block");
+
+    // leases
+    note("Leases");
+    string gapfile = seqfile + ".gaps";
+    unlink(gapfile.c_str());
+    {
+        seqnum a(seqfile);
+        a.lease = 10;
+        is(a.next(), (uint64_t)17, "leased next() claims a block");
+        is(a.next(), (uint64_t)18, "  and issues from it");
+        seqnum b(seqfile);
+        is(b.next(), (uint64_t)27, "plain next() is past the block");
+        a.release();
+        isok(a, "release() of a block that's not on top");
+        seqnum c(seqfile);
+        c.lease = 10;
+        is(c.next(), (uint64_t)19, "  the next lease gets what was left of it");
+    }
+    unlink(gapfile.c_str());
+    {
+        seqnum e(seqfile);
+        e.lease = 10;
+        is(e.next(), (uint64_t)28, "leased next() claims another block");
+        e.release();
+        isok(e, "release() of a block on top");
+        is(sq.curr(), (uint64_t)28, "  winds back the sequence");
+        is(e.next(50), (uint64_t)29, "next(n) bigger than the lease is not leased");
+        is(e.next(), (uint64_t)79, "  and a lease after that claims past it");
+    }
+    unlink(gapfile.c_str());
+
     // launch a bunch of generators in parallel
     note("Starting parallel generator test");
     #define NGENS 200
@@ -81,10 +120,12 @@ int main (int argc, char* argv[]) {
     }
     //(wait for them to finish)
     note("Waiting for generators to finish");
+    int unfinished = 0;
     for (int i=0; i<NGENS; i++) {
-        gens[i]->wait(20);
+        if (gens[i]->wait(300)) ++unfinished;    // else its output may end mid-number
         delete gens[i];
     }
+    is(unfinished, 0, "All generators finished");
     note("Checking results");
     cmd = "sort -n ";
     for (int i=0; i<NGENS; i++) {
@@ -100,6 +141,83 @@ int main (int argc, char* argv[]) {
         ok(system("rm " TESTDIR "sq.out.*") == 0, "removed temp files");
     }
 
+    // The node's counter page
+    note("Counter page");
+    {
+        string pagefile = TESTDIR "seqp.tmp";
+        unlink(pagefile.c_str());
+        seqnum p(pagefile);
+        p.paged = true;
+        is(p.next(), (uint64_t)1, "paged next()");
+        is(p.next(), (uint64_t)2, "  and the next");
+        seqnum f(pagefile);
+        ok(f.curr() > 2, "  the file is ahead of the page");
+        uint64_t top = f.next();
+        is(p.next(), (uint64_t)3, "  still from the page, after a plain next()");
+        seqnum p2(pagefile);
+        p2.paged = true;
+        is(p2.next(), (uint64_t)4, "  another user of the page follows on");
+        ok(p.next(top) > top, "  a page claim past the plain next() skips it");
+
+        // Speed
+        double t0 = test_now();
+        uint64_t m = 0;
+        for (int i = 0; i < 1000000; i++) m = p.next();
+        double secs = test_now() - t0;
+        note("  ", (int)(1000000 / secs), " paged numbers per second");
+        isok(p, "  a million of them");
+        ok(m > top, "  still unique");
+
+        // A page someone else could have rigged isn't used: make it
+        //  writable by all, and wind its counter back (it's at offset 8)
+        struct stat sb;
+        stat(pagefile.c_str(), &sb);
+        char nam[64];
+        snprintf(nam, sizeof(nam), "/dev/shm/job-seq.%lx.%lx", (unsigned long)sb.st_dev, (unsigned long)sb.st_ino);
+        chmod(nam, 0666);
+        uint64_t lo[3] = {0, 0, 1};     // next, gen, lo
+        int pfd = open(nam, O_WRONLY);
+        ok((pfd >= 0) && (pwrite(pfd, lo, sizeof(lo), 8) == sizeof(lo)), "  rigged the page");
+        close(pfd);
+        seqnum p3(pagefile);
+        p3.paged = true;
+        ok(p3.next() > m, "  a world-writable page isn't used");
+        unlink(nam);
+        unlink(pagefile.c_str());
+    }
+
+    // Paged and plain users of the same file, in parallel
+    note("Starting parallel paged generator test");
+    #define NPAGED 40
+    unlink(seqfile.c_str());
+    for (int i=0; i<NPAGED; i++) {
+        char log[255];
+        snprintf(log, sizeof(log), TESTDIR "sq.out.%d", i);
+        logs[i] = log;
+        gens[i] = new job::launch();
+        gens[i]->command   = (std::string)argv[0] + ((i & 1) ? " 2000" : " 50000 paged");
+        gens[i]->logfile   = log;
+        gens[i]->kill_kids = true;
+        gens[i]->start();
+    }
+    unfinished = 0;
+    for (int i=0; i<NPAGED; i++) {
+        if (gens[i]->wait(300)) ++unfinished;
+        delete gens[i];
+    }
+    is(unfinished, 0, "All generators finished");
+    cmd = "sort -n ";
+    for (int i=0; i<NPAGED; i++) {
+        cmd += logs[i];
+        cmd += " ";
+    }
+    cmd += "| uniq -d | wc -l | grep '^0$' 1>/dev/null";
+    ret = system(cmd.c_str());
+    is(ret, 0, "All values unique");
+    if (!ret) {
+        ok(system("rm " TESTDIR "sq.out.*") == 0, "removed temp files");
+    }
+
     // Fini
     return test_end();
 }
@@ -0,0 +1,126 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  Tests for the job::slots class, the node's run slots shared among its queues.
+
+#include "job/path.hxx"
+#include "job/slots.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace TAP;
+
+// Slots held by all in the pool, and the holders
+static int held_in(job::slotpage & p, int & holders) {
+    int n = 0;
+    holders = 0;
+    for (int i = 0; i < SLOTS_HOLDERS; i++) {
+        if (!p.holders[i].pid) continue;
+        ++holders;
+        n += p.holders[i].held;
+    }
+    return n;
+}
+
+int main(int argc, char* argv[]) {
+
+    plan(29);
+    job::path.set_root("./kit");
+
+    // Not in a pool, there's no limit
+    job::slots a;
+    like(a.fnam, "^/dev/shm/job-slots\\.", "named in /dev/shm");
+    unlink(a.fnam.c_str());
+    is(a.take(7), 7,                "no pool, no limit");
+    is(a.give(7), "",               "  and none to nudge");
+
+    note("  -- lending --");
+    job::slots b;
+    a.join("batch", 4, 1);
+    isok(a, "join()");
+    b.join("alpha", 4, 1);
+    isok(b, "  a second queue");
+    is(a.take(3), 3,                "idle queue lends its share");
+    is(a.held(), 3,                 "  held");
+    is(b.take(2), 1,                "lender gets what's free");
+    is(a.take(1), 0,                "  borrower can't take what the lender's short of");
+    is(a.give(1), "alpha",          "give() names the queue short of slots");
+    is(b.take(1), 1,                "  which gets it");
+    is(a.take(1), 0,                "  all taken");
+    a.give(2);
+    b.give(2);
+    is(a.held() + b.held(), 0,      "all given back");
+
+    note("  -- weights --");
+    job::slots c;
+    b.leave();
+    a.join("batch", 6, 1);
+    isok(a, "rejoin()");
+    c.join("gamma", 6, 2);
+    isok(c, "  a queue with twice the weight");
+    is(a.take(6), 6,                "alone, it takes all");
+    is(c.take(6), 0,                "  none left");
+    is(a.give(6), "gamma",          "  give() names the one that wants them");
+    is(a.take(6), 2,                "lighter queue gets its third");
+    is(c.take(6), 4,                "  heavier its two thirds");
+    a.leave();
+    c.leave();
+
+    note("  -- reclaim --");
+    pid_t pid = fork();
+    if (!pid) {
+        job::slots d;
+        d.join("delta", 4, 1);
+        d.take(4);
+        _exit(0);                   // no destructor: as if it crashed
+    }
+    int wstat;
+    waitpid(pid, &wstat, 0);
+    job::slots r;
+    job::slotpage p;
+    int holders;
+    ok(r.read(p),                   "read()");
+    is(p.total, 4,                  "  total");
+    is(held_in(p, holders), 4,      "  dead jobman still holds them");
+    a.join("batch", 4, 1);
+    isok(a, "join() after");
+    is(a.take(4), 4,                "  slots reclaimed");
+    a.leave();
+    r.read(p);
+    is(held_in(p, holders), 0,      "leave() gives them back");
+    is(holders, 0,                  "  and the holder");
+
+    // One anyone could have changed isn't trusted, to join or to read
+    chmod(a.fnam.c_str(), 0666);
+    job::slots w;
+    isnt(w.join("batch", 4, 1), 0,  "a world-writable pool isn't joined");
+    job::slots r2;
+    ok(!r2.read(p),                 "  nor read");
+    unlink(a.fnam.c_str());
+
+    return test_end();
+}
@@ -0,0 +1,138 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  Tests for the job::stats class, a jobman's live statistics in shared memory.
+
+#include "job/path.hxx"
+#include "job/stats.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace TAP;
+
+int main(int argc, char* argv[]) {
+
+    plan(28);
+    job::path.set_root("./kit");
+
+    // Nothing there yet
+    job::stats none("no-such-queue");
+    isnt(none.error, 0,             "no stats for a queue that doesn't exist");
+
+    job::stats w("batch");
+    isok(w, "construct");
+    like(w.fnam, "^/dev/shm/job-stats\\.", "  named in /dev/shm");
+    unlink(w.fnam.c_str());
+    job::stats r0("batch");
+    isnt(r0.open(), 0,              "open() with no segment fails");
+
+    // The jobman makes it and counts things
+    note("  -- counting --");
+    w.create();
+    isok(w, "create()");
+    w.add(&job::statpage::launches);
+    w.add(&job::statpage::launches);
+    w.add(&job::statpage::completions);
+    w.add(&job::statpage::moved, 5);
+    w.set(&job::statpage::run_limit, 10);
+    w.set_jobs(job::statpage::NPHASES, 0);          // harmless
+    w.set_jobs(2, 42);
+    w.timed(job::statpage::POLL, 100);
+    w.timed(job::statpage::POLL, 300);
+
+    job::stats r("batch");
+    r.open();
+    isok(r, "open() by a reader");
+    job::statpage p;
+    ok(r.read(p),                   "  read()");
+    is(p.pid, (int64_t)getpid(),    "  our PID");
+    is(p.launches, 2u,              "  launches");
+    is(p.completions, 1u,           "  completions");
+    is(p.moved, 5u,                 "  moved");
+    is(p.run_limit, 10,             "  run limit");
+    is(p.jobs[2], 42,               "  jobs in a state");
+    is(p.phases[job::statpage::POLL].runs, 2u,       "  phase runs");
+    is(p.phases[job::statpage::POLL].total_us, 400u, "  phase total");
+    is(p.phases[job::statpage::POLL].max_us, 300u,   "  phase max");
+    is(p.phases[job::statpage::POLL].last_us, 300u,  "  phase last");
+    is(string(job::stats::phase2str(job::statpage::REAP)), "reap", "phase2str()");
+
+    // Latencies, by priority and type
+    note("  -- latencies --");
+    w.latency(job::statpage::WAITED, 3, "", 1500);
+    w.latency(job::statpage::WAITED, 3, "backup", 2500);
+    w.latency(job::statpage::WAITED, 12, "backup", 100);    // priority clamped to 9
+    r.read(p);
+    is(p.by_prio[job::statpage::WAITED][2].count, 2u,       "by priority");
+    is(p.by_prio[job::statpage::WAITED][8].count, 1u,       "  out of range ones at the end");
+    is(string(p.types[1]), "backup",                        "a job type gets a slot");
+    is(p.by_type[job::statpage::WAITED][1].max, 2500u,      "  and its own histogram");
+    w.reset_latency();
+    r.read(p);
+    is(p.by_type[job::statpage::WAITED][0].count, 0u,       "reset_latency()");
+
+    // A reader sees whole changes only, while the writer keeps going.
+    //  Each change sets two fields the same; a torn read would show them differ.
+    note("  -- reading while it changes --");
+    pid_t kid = fork();
+    if (!kid) {
+        for (uint64_t i = 1; i <= 2000000; i++) {
+            w.add(&job::statpage::launches);
+            w.add(&job::statpage::completions);     // out of step between the two adds
+            w.timed(job::statpage::SYNC, i);        // runs and last_us change together
+        }
+        _exit(0);
+    }
+    int reads = 0, torn = 0;
+    int kstat = 0;
+    while (waitpid(kid, &kstat, WNOHANG) == 0) {
+        job::statpage q;
+        if (!r.read(q)) continue;
+        ++reads;
+        const job::statpage::phase & ph = q.phases[job::statpage::SYNC];
+        if (ph.runs != ph.last_us) ++torn;
+    }
+    note("  ", reads, " reads");
+    ok(reads > 0,                   "reader got copies");
+    is(torn, 0,                     "  none torn");
+
+    // One anyone could have changed isn't trusted, by writer or reader
+    chmod(w.fnam.c_str(), 0666);
+    job::stats w2("batch");
+    isnt(w2.create(), 0,            "a world-writable segment isn't used");
+    job::stats r2("batch");
+    isnt(r2.open(), 0,              "  nor read");
+    chmod(w.fnam.c_str(), 0644);
+
+    // A fresh start clears it
+    w.create();
+    r.read(p);
+    is(p.launches, 0u,              "create() again starts over");
+
+    unlink(w.fnam.c_str());
+    return test_end();
+}
@@ -0,0 +1,87 @@
+/*  LGPL 2.1+
+
+    job - the Linux Batch Facility
+    (c) Copyright 2014-2016 Hewlett Packard Enterprise Development LP
+    Created by Uncle Spook <spook(at)MisfitMountain(dot)org>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+    USA
+*/
+
+//  Tests for the job::tally class, the completion count of a group job.
+
+#include "job/path.hxx"
+#include "job/tally.hxx"
+#include "tap++/tap++.hxx"
+#include "tap-extra.hxx"
+#include <string>
+#include <unistd.h>         // access()
+
+using namespace std;
+using namespace TAP;
+
+int main(int argc, char* argv[]) {
+
+    plan(24);
+    job::path.set_root("./kit");
+
+    // No tally, no complaints
+    job::tally nt("batch", 9999901);
+    nt.remove();
+    nt.count(9999902, true);
+    isok(nt, "count() with no tally");
+    ok(!nt.complete(),          "  not complete");
+    isnt(nt.load(), 0,          "load() with no tally fails");
+
+    // Count them up
+    note("  -- three children --");
+    job::tally t("batch", 9999910);
+    t.create(3);
+    isok(t, "create()");
+    ok(access(t.fnam.c_str(), F_OK) == 0, "  tally file exists");
+    is(t.total, 3,              "  total");
+    ok(!t.complete(),           "  not complete");
+
+    job::tally c("batch", 9999910);     // each child has its own
+    c.count(9999911, true);
+    isok(c, "count() first child");
+    is(c.done, 1,               "  one done");
+    ok(!c.complete(),           "  not complete");
+    c.count(9999911, true);             // counted twice, as after a crash
+    isok(c, "count() first child again");
+    ok(!c.complete(),           "  still not complete");
+    c.count(9999912, false);
+    isok(c, "count() second child");
+    ok(!c.complete(),           "  still not complete");
+    c.count(9999913, true);
+    isok(c, "count() last child");
+    ok(c.complete(),            "  complete");
+    is(c.done,   3,             "  three done");
+    is(c.ok,     2,             "  two ok");
+    is(c.failed, 1,             "  one failed");
+
+    job::tally r("batch", 9999910);
+    r.load();
+    isok(r, "load()");
+    ok(r.complete() && (r.ok == 2) && (r.failed == 1), "  same counts");
+
+    r.remove();
+    isok(r, "remove()");
+    ok(access(r.fnam.c_str(), F_OK) != 0, "  tally file gone");
+    r.remove();
+    isok(r, "remove() again");
+
+    return test_end();
+}